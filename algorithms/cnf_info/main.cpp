@@ -1,8 +1,11 @@
 #include <iostream>
+#include <optional>
 #include <string>
 #include "thesis/cli.hpp"
 #include "thesis/cnf.hpp"
 #include "thesis/timer.hpp"
+#include "thesis/numa.hpp"
+#include "thesis/profile.hpp"
 
 int main(int argc, char** argv) {
     using namespace thesis;
@@ -10,6 +13,8 @@ int main(int argc, char** argv) {
     std::string path;
     bool compact = true;
     bool normalize = true;
+    unsigned threads = 1;
+    std::optional<profile::Session> prof; // option mode only
 
     // If first arg looks like an option, use ArgParser; otherwise, keep legacy positional behavior.
     bool use_options = (argc <= 1) || (argc > 1 && argv[1][0] == '-');
@@ -18,6 +23,9 @@ int main(int argc, char** argv) {
         cli.add_option(OptionSpec{.longName = "input", .shortName = 'i', .type = ArgType::String, .valueName = "FILE|-", .help = "Path to CNF file or '-' for stdin", .required = true});
         cli.add_flag("no-compact", '\0', "Disable variable compaction during parsing");
         cli.add_flag("no-normalize", '\0', "Disable clause normalization during parsing");
+        cli.add_option(OptionSpec{.longName = "threads", .shortName = 't', .type = ArgType::UInt64, .valueName = "N", .help = "Parser threads (0=auto)", .required = false, .defaultValue = "1"});
+        add_placement_option(cli);
+        profile::Session::add_options(cli);
 
         bool proceed = true;
         try {
@@ -30,10 +38,14 @@ int main(int argc, char** argv) {
             std::cout << cli.help(argv[0]);
             return 0;
         }
+        prof.emplace(cli);
+        if (!prof->ok()) return 1;
+        if (!apply_placement_option(cli)) return 1;
 
         path = cli.get_string("input");
         compact = !cli.get_flag("no-compact");
         normalize = !cli.get_flag("no-normalize");
+        threads = static_cast<unsigned>(cli.get_uint64("threads"));
     } else {
         // Legacy: cnf_info <file.cnf|-> [no-compact]
         if (argc < 2) {
@@ -46,21 +58,30 @@ int main(int argc, char** argv) {
 
     thesis::Timer t_total;
     thesis::Timer t_parse;
-    thesis::CNF cnf = (path == "-") ? thesis::CNF(std::cin, compact, normalize)
-                                     : thesis::CNF(path, compact, normalize);
+    thesis::CNF cnf = (path == "-") ? thesis::CNF(std::cin, compact, normalize, threads)
+                                     : thesis::CNF(path, compact, normalize, threads);
     const double sec_parse = t_parse.sec();
     if (!cnf.is_valid()) {
-        std::cerr << "Invalid CNF or mismatch with declared clause count." << std::endl;
+        std::cerr << "Invalid CNF: " << cnf.error() << std::endl;
         return 2;
     }
 
+    // Clause-size profile straight from the clause arena
+    std::size_t max_clause = 0;
+    for (const ClauseView c : cnf.clauses()) {
+        if (c.size() > max_clause) max_clause = c.size();
+    }
+
     const double sec_total = t_total.sec();
     std::cout << "vars=" << cnf.get_variable_count()
               << " clauses=" << cnf.get_clause_count()
+              << " literals=" << cnf.literal_count()
+              << " max_clause=" << max_clause
               << " parse_sec=" << sec_parse
               << " total_sec=" << sec_total
               << " compacted=" << (compact ? 1 : 0)
               << " normalized=" << (normalize ? 1 : 0)
+              << " threads=" << (threads == 0 ? -1 : (int)threads)
               << "\n";
     return 0;
 }
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+#include "thesis/cli.hpp"
+#include "thesis/cnf.hpp"
+#include "thesis/vig.hpp"
+#include "thesis/edge_sort.hpp"
+#include "thesis/segmentation.hpp"
+#include "thesis/timer.hpp"
+#include "thesis/numa.hpp"
+#include "thesis/profile.hpp"
+
+// Micro-benchmark of the segmentation merge loop's state layouts: sorts one edge
+// list and builds its neighbor lists once, then times run_presorted() for every
+// (layout, relabel) pair and checks that all of them give the same components.
+
+namespace {
+
+// Random graph with VIG-like weights (few distinct values, many ties).
+thesis::VIG random_graph(unsigned n, double degree, uint64_t seed) {
+    thesis::VIG g;
+    g.n = n;
+    if (n < 2) return g;
+    uint64_t s = seed;
+    auto next = [&s]() {
+        uint64_t z = (s += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    };
+    const std::size_t m = static_cast<std::size_t>(degree * n / 2.0);
+    g.edges.reserve(m);
+    for (std::size_t i = 0; i < m; ++i) {
+        unsigned u = static_cast<unsigned>(next() % n);
+        unsigned v = static_cast<unsigned>(next() % n);
+        if (u == v) continue;
+        if (u > v) std::swap(u, v);
+        g.edges.push_back(thesis::Edge{u, v, 1.0 / static_cast<double>(1 + next() % 8)});
+    }
+    // A VIG has one edge per pair: keep the first weight drawn for duplicates.
+    std::sort(g.edges.begin(), g.edges.end(), [](const thesis::Edge& a, const thesis::Edge& b) {
+        return a.u != b.u ? a.u < b.u : a.v < b.v;
+    });
+    g.edges.erase(std::unique(g.edges.begin(), g.edges.end(), [](const thesis::Edge& a, const thesis::Edge& b) {
+        return a.u == b.u && a.v == b.v;
+    }), g.edges.end());
+    return g;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    using namespace thesis;
+
+    ArgParser cli("Time the segmentation merge loop for each state layout and node relabeling.");
+    cli.add_option(OptionSpec{.longName = "input", .shortName = 'i', .type = ArgType::String, .valueName = "FILE|-", .help = "DIMACS CNF (or '-' for stdin); omit to use --random-nodes", .required = false, .defaultValue = ""});
+    cli.add_option(OptionSpec{.longName = "tau", .shortName = '\0', .type = ArgType::UInt64, .valueName = "N|inf", .help = "Clause size threshold for the VIG", .required = false, .defaultValue = "inf", .allowInfToken = true});
+    cli.add_option(OptionSpec{.longName = "random-nodes", .shortName = '\0', .type = ArgType::Size, .valueName = "N", .help = "Benchmark a random graph with N nodes instead of a CNF (K/M/G suffix)", .required = false, .defaultValue = "0"});
+    cli.add_option(OptionSpec{.longName = "random-degree", .shortName = '\0', .type = ArgType::String, .valueName = "D", .help = "Mean degree of the random graph", .required = false, .defaultValue = "8"});
+    cli.add_option(OptionSpec{.longName = "seed", .shortName = '\0', .type = ArgType::UInt64, .valueName = "S", .help = "Random graph seed", .required = false, .defaultValue = "1"});
+    cli.add_option(OptionSpec{.longName = "k", .shortName = 'k', .type = ArgType::String, .valueName = "K", .help = "Segmentation parameter k (double)", .required = false, .defaultValue = std::to_string(GraphSegmenterFH::kDefaultK)});
+    cli.add_flag("no-mod-guard", '\0', "Disable modularity guard (ΔQ tests)");
+    cli.add_option(OptionSpec{.longName = "repeat", .shortName = 'r', .type = ArgType::UInt64, .valueName = "R", .help = "Runs per configuration; the fastest is reported", .required = false, .defaultValue = "3"});
+    cli.add_option(OptionSpec{.longName = "threads", .shortName = 't', .type = ArgType::UInt64, .valueName = "N", .help = "Threads for CNF parsing, VIG build and edge sort (0=auto)", .required = false, .defaultValue = "0"});
+    add_placement_option(cli);
+    profile::Session::add_options(cli);
+
+    bool proceed = true;
+    try {
+        proceed = cli.parse(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << cli.usage(argv[0]) << "\n" << e.what() << "\n";
+        return 1;
+    }
+    if (!proceed) {
+        std::cout << cli.help(argv[0]);
+        return 0;
+    }
+    profile::Session prof(cli);
+    if (!prof.ok()) return 1;
+    if (!apply_placement_option(cli)) return 1;
+
+    const unsigned tau = static_cast<unsigned>(cli.get_uint64("tau"));
+    const std::size_t random_nodes = cli.get_size("random-nodes");
+    const unsigned threads = static_cast<unsigned>(cli.get_uint64("threads"));
+    const std::size_t repeat = std::max<std::size_t>(1, cli.get_uint64("repeat"));
+    const bool guard = !cli.get_flag("no-mod-guard");
+    double k = GraphSegmenterFH::kDefaultK;
+    double degree = 8.0;
+    try {
+        k = std::stod(cli.get_string("k"));
+        degree = std::stod(cli.get_string("random-degree"));
+    } catch (...) {
+        std::cerr << "Invalid k or random-degree value" << std::endl;
+        return 1;
+    }
+    if (cli.provided("input") == (random_nodes != 0) || random_nodes > std::numeric_limits<unsigned>::max() / 2) {
+        std::cerr << "Give exactly one of --input and --random-nodes (< 2^31)" << std::endl;
+        return 1;
+    }
+
+    VIG g;
+    if (random_nodes != 0) {
+        g = random_graph(static_cast<unsigned>(random_nodes), degree, cli.get_uint64("seed"));
+    } else {
+        const std::string path = cli.get_string("input");
+        CNF cnf = (path == "-") ? CNF(std::cin, /*variable_compaction=*/true, /*normalize=*/true, threads)
+                                : CNF(path, /*variable_compaction=*/true, /*normalize=*/true, threads);
+        if (!cnf.is_valid()) {
+            std::cerr << "Failed to parse CNF: " << path << ": " << cnf.error() << "\n";
+            return 2;
+        }
+        const unsigned hc = std::thread::hardware_concurrency();
+        g = build_vig_optimized(cnf, tau, 50000000, threads == 0 ? (hc ? hc : 1u) : threads);
+    }
+
+    EdgeSortOptions sort_opt;
+    sort_opt.threads = threads;
+    sort_edges_desc(g.edges, sort_opt);
+    const SegNeighbors neighbors = SegNeighbors::build(g.n, g.edges, guard);
+
+    const SegStateLayout layouts[] = {SegStateLayout::Split, SegStateLayout::Packed};
+    const NodeRelabel relabels[] = {NodeRelabel::None, NodeRelabel::Bfs, NodeRelabel::Degree};
+    std::vector<unsigned> reference; // component of each node under the first configuration
+    double base_sec = 0.0;
+    bool all_agree = true;
+    for (NodeRelabel relabel : relabels) {
+        for (SegStateLayout layout : layouts) {
+            double best = std::numeric_limits<double>::infinity();
+            unsigned comps = 0;
+            bool agree = true;
+            for (std::size_t rep = 0; rep < repeat; ++rep) {
+                GraphSegmenterFH seg;
+                GraphSegmenterFH::Config cfg = seg.config();
+                cfg.use_modularity_guard = guard;
+                cfg.state_layout = layout;
+                cfg.relabel = relabel;
+                seg.set_config(cfg);
+                seg.reset(g.n, k);
+                Timer t;
+                seg.run_presorted(g.edges, neighbors);
+                best = std::min(best, t.sec());
+                comps = seg.num_components();
+                if (rep != 0) continue;
+                if (reference.empty()) {
+                    reference.resize(g.n);
+                    for (unsigned x = 0; x < g.n; ++x) reference[x] = seg.component_no_compress(x);
+                } else {
+                    for (unsigned x = 0; x < g.n && agree; ++x) agree = seg.component_no_compress(x) == reference[x];
+                }
+            }
+            if (base_sec == 0.0) base_sec = best;
+            all_agree = all_agree && agree;
+            std::cout << "vars=" << g.n
+                      << " edges=" << g.edges.size()
+                      << " k=" << k
+                      << " modGuard=" << (guard ? 1 : 0)
+                      << " layout=" << seg_state_layout_name(layout)
+                      << " relabel=" << node_relabel_name(relabel)
+                      << " comps=" << comps
+                      << " seg_sec=" << best
+                      << " speedup=" << (best > 0.0 ? base_sec / best : 0.0)
+                      << " agree=" << (agree ? 1 : 0) << "\n";
+        }
+    }
+    return all_agree ? 0 : 3;
+}
@@ -4,39 +4,59 @@
 #include <vector>
 #include <limits>
 #include <algorithm>
+#include <thread>
+#include <type_traits>
+#include <memory>
+#include <ostream>
 #include "thesis/cli.hpp"
 #include "thesis/cnf.hpp"
 #include "thesis/vig.hpp"
+#include "thesis/vig_cache.hpp"
 #include "thesis/segmentation.hpp"
 #include "thesis/timer.hpp"
 #include "thesis/csv.hpp"
+#include "thesis/columnar.hpp"
 #include "thesis/comp_metrics.hpp"
-#include "thesis/modularity.hpp"
+#include "thesis/partition_eval.hpp"
+#include "thesis/multilevel.hpp"
+#include "thesis/numa.hpp"
+#include "thesis/profile.hpp"
+#include "thesis/service.hpp"
 
-int main(int argc, char **argv)
+namespace
 {
-    using namespace thesis;
+using namespace thesis;
 
-    ArgParser cli("Segment the variable interaction graph (VIG) of a CNF.");
-    cli.add_option(OptionSpec{.longName = "input", .shortName = 'i', .type = ArgType::String, .valueName = "FILE|-", .help = "Path to DIMACS CNF or '-' for stdin", .required = true});
+// Segmentation options; shared by the command line and the --serve requests.
+void add_segmentation_options(ArgParser &cli, bool input_required)
+{
+    cli.add_option(OptionSpec{.longName = "input", .shortName = 'i', .type = ArgType::String, .valueName = "FILE|-", .help = input_required ? "Path to DIMACS CNF" : "Path to DIMACS CNF or '-' for stdin (required without --serve)", .required = input_required});
     cli.add_option(OptionSpec{.longName = "tau", .shortName = '\0', .type = ArgType::UInt64, .valueName = "N|inf", .help = "Clause size threshold for VIG; use 'inf' for no limit", .required = false, .defaultValue = "inf", .allowInfToken = true});
     cli.add_option(OptionSpec{.longName = "k", .shortName = 'k', .type = ArgType::String, .valueName = "K", .help = "Segmentation parameter k (double)", .required = false, .defaultValue = std::to_string(GraphSegmenterFH::kDefaultK)});
     cli.add_option(OptionSpec{.longName = "maxbuf", .shortName = '\0', .type = ArgType::Size, .valueName = "BYTES", .help = "VIG optimized builder max contributions buffer", .required = false, .defaultValue = "50000000"});
-    cli.add_option(OptionSpec{.longName = "threads", .shortName = 't', .type = ArgType::UInt64, .valueName = "N", .help = "Threads for optimized VIG build (0=auto)", .required = false, .defaultValue = "0"});
+    cli.add_option(OptionSpec{.longName = "mem-limit", .shortName = '\0', .type = ArgType::Size, .valueName = "BYTES", .help = "Build the VIG with the streaming builder within this working-memory budget (K/M/G suffix; replaces --maxbuf)", .required = false, .defaultValue = ""});
+    cli.add_option(OptionSpec{.longName = "spill-dir", .shortName = '\0', .type = ArgType::String, .valueName = "DIR", .help = "Directory for the streaming builder's clause spill file (default: system temp dir)", .required = false, .defaultValue = ""});
+    cli.add_option(OptionSpec{.longName = "threads", .shortName = 't', .type = ArgType::UInt64, .valueName = "N", .help = "Threads for CNF parsing, optimized VIG build and radix edge sort (0=auto)", .required = false, .defaultValue = "0"});
     cli.add_option(OptionSpec{.longName = "comp-out", .shortName = '\0', .type = ArgType::String, .valueName = "DIR", .help = "Optional dir to write components CSV (auto-named: <cnf>_components.csv)", .required = false, .defaultValue = ""});
     // Deprecated: comp-base (kept for compatibility). Prefer --output-base.
     cli.add_option(OptionSpec{.longName = "comp-base", .shortName = '\0', .type = ArgType::String, .valueName = "NAME", .help = "[deprecated] Base name for components file (use --output-base instead)", .required = false, .defaultValue = ""});
     cli.add_option(OptionSpec{.longName = "output-base", .shortName = '\0', .type = ArgType::String, .valueName = "NAME", .help = "Optional base name for outputs (used by --comp-out, --graph-out, --cross-out)", .required = false, .defaultValue = ""});
+    cli.add_option(OptionSpec{.longName = "layout", .shortName = '\0', .type = ArgType::String, .valueName = "aos|soa", .help = "VIG edge storage: array of structs or struct of arrays", .required = false, .defaultValue = "aos"});
+    cli.add_option(OptionSpec{.longName = "weights", .shortName = '\0', .type = ArgType::String, .valueName = "double|float", .help = "VIG edge weight precision", .required = false, .defaultValue = "double"});
     cli.add_flag("naive", '\0', "Use naive VIG builder");
     cli.add_flag("opt", '\0', "Use optimized VIG builder (default)");
     cli.add_option(OptionSpec{.longName = "graph-out", .shortName = '\0', .type = ArgType::String, .valueName = "DIR", .help = "Write graph CSVs into DIR as <base>.node.csv and <base>.edges.csv", .required = false, .defaultValue = ""});
+    cli.add_option(OptionSpec{.longName = "vig-cache", .shortName = '\0', .type = ArgType::String, .valueName = "DIR", .help = "Reuse/store the VIG in DIR keyed on (CNF hash, tau)", .required = false, .defaultValue = ""});
     cli.add_option(OptionSpec{.longName = "cross-out", .shortName = '\0', .type = ArgType::String, .valueName = "DIR", .help = "Write strongest cross-component edges CSV into DIR as <base>_cross.csv (columns: u,v,w)", .required = false, .defaultValue = ""});
+    cli.add_option(OptionSpec{.longName = "out-format", .shortName = '\0', .type = ArgType::String, .valueName = "csv|tcol", .help = "File format of --graph-out and --cross-out (tcol: binary columnar, see columnar.hpp)", .required = false, .defaultValue = "csv"});
+    cli.add_option(OptionSpec{.longName = "cross-candidates", .shortName = '\0', .type = ArgType::String, .valueName = "pairmax|all", .help = "Rejected edges kept for --cross-out: the heaviest per pair of roots, or all (same CSV)", .required = false, .defaultValue = candidate_store_name(CandidateStore::PairMax)});
     // Segmentation behavior knobs
     cli.add_option(OptionSpec{.longName = "size-exp", .shortName = '\0', .type = ArgType::String, .valueName = "X", .help = "Exponent for |C| in gate denominator (1.0 => k/|C|)", .required = false, .defaultValue = std::to_string(GraphSegmenterFH::Config::kDefaultSizeExponent)});
     // Modularity guard knobs
     cli.add_flag("no-mod-guard", '\0', "Disable modularity guard (ΔQ tests)");
     cli.add_option(OptionSpec{.longName = "gamma", .shortName = '\0', .type = ArgType::String, .valueName = "G", .help = "Modularity resolution gamma", .required = false, .defaultValue = std::to_string(GraphSegmenterFH::Config::kDefaultGamma)});
     cli.add_flag("no-anneal-guard", '\0', "Disable annealing of ΔQ tolerance (use fixed 0)");
+    cli.add_flag("no-hub-index", '\0', "Scan every neighbor list in the guard's weight lookups (no hub index; same result)");
     {
         std::ostringstream ossTol; ossTol << GraphSegmenterFH::Config::kDefaultDqTolerance0;
         cli.add_option(OptionSpec{.longName = "dq-tol0", .shortName = '\0', .type = ArgType::String, .valueName = "T", .help = "Initial ΔQ tolerance (e.g., 1e-3)", .required = false, .defaultValue = ossTol.str()});
@@ -50,373 +70,697 @@ int main(int argc, char **argv)
         std::ostringstream ossGM; ossGM << GraphSegmenterFH::Config::kDefaultGateMarginRatio;
         cli.add_option(OptionSpec{.longName = "gate-margin", .shortName = '\0', .type = ArgType::String, .valueName = "RATIO", .help = "Gate margin ratio for 'margin' policy (e.g., 0.05)", .required = false, .defaultValue = ossGM.str()});
     }
+    cli.add_option(OptionSpec{.longName = "edge-sort", .shortName = '\0', .type = ArgType::String, .valueName = "auto|std|radix", .help = "Initial edge sort (auto: radix above --radix-threshold edges)", .required = false, .defaultValue = edge_sort_name(GraphSegmenterFH::Config::kDefaultEdgeSort)});
+    cli.add_option(OptionSpec{.longName = "seg-threads", .shortName = '\0', .type = ArgType::UInt64, .valueName = "N", .help = "Threads for the segmentation merge loop (1=sequential, 0=auto; same result for any N)", .required = false, .defaultValue = std::to_string(GraphSegmenterFH::Config::kDefaultSegThreads)});
+    cli.add_option(OptionSpec{.longName = "seg-layout", .shortName = '\0', .type = ArgType::String, .valueName = "split|packed", .help = "Per-component state layout of the sequential merge loop", .required = false, .defaultValue = seg_state_layout_name(GraphSegmenterFH::Config::kDefaultStateLayout)});
+    cli.add_option(OptionSpec{.longName = "relabel", .shortName = '\0', .type = ArgType::String, .valueName = "none|bfs|degree", .help = "Renumber nodes for the merge loop (results keep the input ids)", .required = false, .defaultValue = node_relabel_name(GraphSegmenterFH::Config::kDefaultRelabel)});
+    cli.add_option(OptionSpec{.longName = "levels", .shortName = '\0', .type = ArgType::UInt64, .valueName = "L", .help = "Coarser levels to build by segmenting the quotient graph of each level (0 = flat only)", .required = false, .defaultValue = "0"});
+    cli.add_option(OptionSpec{.longName = "level-k-factor", .shortName = '\0', .type = ArgType::String, .valueName = "F", .help = "k of level L is k * F^L", .required = false, .defaultValue = "1"});
+    cli.add_option(OptionSpec{.longName = "level-weight", .shortName = '\0', .type = ArgType::String, .valueName = "sum|max", .help = "Quotient edge weight: summed or strongest cross-component weight", .required = false, .defaultValue = quotient_weight_name(QuotientWeight::Sum)});
+    cli.add_option(OptionSpec{.longName = "radix-threshold", .shortName = '\0', .type = ArgType::Size, .valueName = "N", .help = "Edge count from which --edge-sort auto uses the radix sort", .required = false, .defaultValue = std::to_string(GraphSegmenterFH::Config::kDefaultRadixSortThreshold)});
+}
 
-    bool proceed = true;
-    try
-    {
-        proceed = cli.parse(argc, argv);
-    }
-    catch (const std::exception &e)
-    {
-        std::cerr << cli.usage(argv[0]) << "\n"
-                  << e.what() << "\n";
-        return 1;
-    }
-    if (!proceed)
-    {
-        std::cout << cli.help(argv[0]);
-        return 0;
-    }
-
+// One segmentation run as the command line describes it. With a cache, the CNF
+// and the default-layout VIG are kept for later requests (see --serve).
+int run_segmentation(const ArgParser &cli, std::ostream &out, std::ostream &err, GraphCache *cache)
+{
     const std::string path = cli.get_string("input");
     const unsigned tau = static_cast<unsigned>(cli.get_uint64("tau"));
     const std::size_t maxbuf = cli.get_size("maxbuf");
     const unsigned threads = static_cast<unsigned>(cli.get_uint64("threads"));
+    const std::string layout = cli.get_string("layout");
+    const std::string weights = cli.get_string("weights");
+    if ((layout != "aos" && layout != "soa") || (weights != "double" && weights != "float"))
+    {
+        err << "--layout must be aos|soa and --weights double|float" << std::endl;
+        return 1;
+    }
     const bool use_naive = cli.get_flag("naive");
     bool use_opt = cli.get_flag("opt");
     if (!use_naive && !use_opt)
         use_opt = true;
+    const std::size_t mem_limit = cli.provided("mem-limit") ? cli.get_size("mem-limit") : 0;
+    const std::string spill_dir = cli.provided("spill-dir") ? cli.get_string("spill-dir") : std::string();
+    if (mem_limit != 0 && (use_naive || cli.provided("maxbuf")))
+    {
+        err << "--mem-limit selects the streaming optimized builder; drop --naive/--maxbuf" << std::endl;
+        return 1;
+    }
 
-    double k = GraphSegmenterFH::kDefaultK;
+    const std::string out_format = cli.get_string("out-format");
+    if (out_format != "csv" && out_format != "tcol")
+    {
+        err << "Invalid out-format (use csv|tcol)" << std::endl;
+        return 1;
+    }
+    const bool tcol_out = out_format == "tcol";
+
+    MultilevelOptions ml_opt;
+    ml_opt.levels = static_cast<unsigned>(cli.get_uint64("levels"));
     try
     {
-        k = std::stod(cli.get_string("k"));
+        ml_opt.k_factor = std::stod(cli.get_string("level-k-factor"));
     }
     catch (...)
     {
-        std::cerr << "Invalid k value" << std::endl;
+        err << "Invalid level-k-factor value" << std::endl;
         return 1;
     }
-
-    Timer t_total; // start total before parsing
-    Timer t_parse;
-    CNF cnf = (path == "-") ? CNF(std::cin, /*variable_compaction=*/true)
-                            : CNF(path, /*variable_compaction=*/true);
-    const double sec_parse = t_parse.sec();
-    if (!cnf.is_valid())
+    if (!parse_quotient_weight(cli.get_string("level-weight"), ml_opt.weight))
     {
-        std::cerr << "Failed to parse CNF: " << path << "\n";
-        return 2;
+        err << "Invalid level-weight (use sum|max)" << std::endl;
+        return 1;
     }
 
-    Timer t_build;
-    VIG g;
-    if (use_naive)
+    double k = GraphSegmenterFH::kDefaultK;
+    try
     {
-        g = build_vig_naive(cnf, tau);
+        k = std::stod(cli.get_string("k"));
     }
-    else
+    catch (...)
     {
-        if (threads == 0)
-            g = build_vig_optimized(cnf, tau, maxbuf);
-        else
-            g = build_vig_optimized(cnf, tau, maxbuf, threads);
+        err << "Invalid k value" << std::endl;
+        return 1;
     }
-    const double sec_build = t_build.sec();
 
-    Timer t_seg;
-    GraphSegmenterFH seg(g.n, k);
-    // Apply optional config knobs
+    if (cache && path == "-")
     {
-        GraphSegmenterFH::Config cfg = seg.config();
-        try {
-            cfg.sizeExponent = std::stod(cli.get_string("size-exp"));
-        } catch (...) {
-            std::cerr << "Invalid size-exp value" << std::endl;
-            return 1;
-        }
-        if (cli.get_flag("no-mod-guard")) cfg.use_modularity_guard = false;
-        try {
-            cfg.gamma = std::stod(cli.get_string("gamma"));
-        } catch (...) {
-            std::cerr << "Invalid gamma value" << std::endl;
-            return 1;
-        }
-        if (cli.get_flag("no-anneal-guard")) cfg.anneal_modularity_guard = false;
-        try {
-            cfg.dq_tolerance0 = std::stod(cli.get_string("dq-tol0"));
-        } catch (...) {
-            std::cerr << "Invalid dq-tol0 value" << std::endl;
-            return 1;
-        }
-        try {
-            cfg.dq_vscale = std::stod(cli.get_string("dq-vscale"));
-        } catch (...) {
-            std::cerr << "Invalid dq-vscale value" << std::endl;
-            return 1;
-        }
-        // ambiguous policy
+        err << "--serve requests need an input file; stdin carries the requests" << std::endl;
+        return 1;
+    }
+    // With a cache (--serve) a file is parsed once. The streaming builder
+    // consumes its CNF, so --mem-limit runs always parse their own.
+    const std::string cnf_key = (cache && mem_limit == 0) ? cnf_cache_key(path) : std::string();
+
+    Timer t_total; // start total before parsing
+    Timer t_parse;
+    std::shared_ptr<const CNF> shared_cnf = cnf_key.empty() ? nullptr : cache->find_cnf(cnf_key);
+    const bool cnf_mem_hit = shared_cnf != nullptr;
+    std::shared_ptr<CNF> parsed;
+    if (!cnf_mem_hit)
+    {
+        parsed = (path == "-") ? std::make_shared<CNF>(std::cin, /*variable_compaction=*/true, /*normalize=*/true, threads)
+                               : std::make_shared<CNF>(path, /*variable_compaction=*/true, /*normalize=*/true, threads);
+        if (!parsed->is_valid())
         {
-            std::string pol = cli.get_string("ambiguous");
-            std::transform(pol.begin(), pol.end(), pol.begin(), [](unsigned char c){ return std::tolower(c); });
-            if (pol == "accept") cfg.ambiguous_policy = GraphSegmenterFH::Config::Ambiguous::Accept;
-            else if (pol == "reject") cfg.ambiguous_policy = GraphSegmenterFH::Config::Ambiguous::Reject;
-            else if (pol == "margin" || pol == "gatemargin") cfg.ambiguous_policy = GraphSegmenterFH::Config::Ambiguous::GateMargin;
-            else {
-                std::cerr << "Invalid ambiguous policy (use accept|reject|margin)" << std::endl;
-                return 1;
-            }
+            err << "Failed to parse CNF: " << path << ": " << parsed->error() << "\n";
+            return 2;
         }
-        try {
-            cfg.gate_margin_ratio = std::stod(cli.get_string("gate-margin"));
-        } catch (...) {
-            std::cerr << "Invalid gate-margin value" << std::endl;
-            return 1;
-        }
-        seg.set_config(cfg);
+        if (!cnf_key.empty())
+            cache->store_cnf(cnf_key, parsed);
+        shared_cnf = parsed;
     }
-    seg.run(g.edges);
-    const double sec_seg = t_seg.sec();
-    const double sec_total = t_total.sec();
+    const CNF &cnf = *shared_cnf;
+    const double sec_parse = t_parse.sec();
+    const unsigned clause_count = cnf.get_clause_count(); // --mem-limit consumes the CNF
 
-    // Compute modularity of the segmentation (resolution gamma=1.0)
-    double Q = modularity(
-        static_cast<uint32_t>(g.n),
-        g.edges,
-        [&](uint32_t v)
-        { return seg.component_no_compress(v); },
-        1.0);
+    const std::string cache_dir = cli.provided("vig-cache") ? cli.get_string("vig-cache") : std::string();
+    const uint64_t cnf_hash = cache_dir.empty() ? 0 : cnf_fingerprint(cnf);
 
-    // Compute metrics once
-    auto sizes = thesis::component_sizes(static_cast<uint32_t>(g.n), [&](uint32_t v)
-                                         { return seg.component_no_compress(v); });
-    thesis::CompSummary cs = thesis::summarize_components(sizes);
+    const bool soa = (layout == "soa");
+    const bool f32 = (weights == "float");
+    if ((soa || f32) && !cache_dir.empty())
+    {
+        err << "--vig-cache needs the default layout (--layout aos --weights double)" << std::endl;
+        return 1;
+    }
 
-    // Optional: write full graph (nodes with component labels, then edges) to files
-    if (cli.provided("graph-out"))
+    // Everything after parsing is generic over the VIG layout.
+    auto run = [&]<class G>(std::type_identity<G>) -> int
     {
-        const std::string graph_out_dir = cli.get_string("graph-out");
-        if (graph_out_dir.empty())
+        Timer t_build;
+        const unsigned hc = std::thread::hardware_concurrency();
+        const unsigned build_threads = threads == 0 ? (hc ? hc : 1u) : threads;
+        // In-memory cache: keyed on everything that shapes the builder's output
+        // (agg_memory depends on maxbuf and the thread count).
+        std::shared_ptr<G> shared_g;
+        std::string vig_key;
+        if constexpr (std::is_same_v<G, VIG>)
         {
-            std::cerr << "--graph-out requires a directory path\n";
-            return 3;
-        }
-        std::error_code ec;
-        std::filesystem::path gdir(graph_out_dir);
-        if (!std::filesystem::exists(gdir, ec))
-        {
-            if (!std::filesystem::create_directories(gdir, ec))
+            if (!cnf_key.empty())
             {
-                std::cerr << "Failed to create output directory: " << graph_out_dir << "\n";
-                return 3;
+                vig_key = cnf_key + "|tau=" + std::to_string(tau) +
+                          (use_naive ? std::string("|naive") : "|opt|maxbuf=" + std::to_string(maxbuf) + "|threads=" + std::to_string(build_threads));
+                shared_g = cache->find_vig(vig_key);
             }
         }
-        else if (!std::filesystem::is_directory(gdir, ec))
+        const bool vig_mem_hit = shared_g != nullptr;
+        if (!vig_mem_hit)
+            shared_g = std::make_shared<G>();
+        G &g = *shared_g;
+        bool cache_hit = false;
+        if constexpr (std::is_same_v<G, VIG>)
+            cache_hit = !vig_mem_hit && !cache_dir.empty() && vig_cache_load(cache_dir, cnf_hash, tau, g);
+        if (!cache_hit && !vig_mem_hit)
         {
-            std::cerr << "--graph-out path is not a directory: " << graph_out_dir << "\n";
-            return 3;
-        }
-        std::string graph_base = cli.provided("output-base") ? cli.get_string("output-base") : std::string{};
-        if (graph_base.empty())
-        {
-            if (path != "-")
+            if (use_naive)
             {
-                std::filesystem::path p(path);
-                p = p.filename();
-                while (p.has_extension())
-                    p = p.stem();
-                graph_base = p.string();
-                if (graph_base.empty())
-                    graph_base = "cnf";
+                g = build_vig_naive<G>(cnf, tau);
             }
             else
             {
-                graph_base = "stdin";
+                if (mem_limit == 0)
+                    g = build_vig_optimized<G>(cnf, tau, maxbuf, build_threads);
+                else
+                {
+                    try
+                    {
+                        g = build_vig_streaming<G>(std::move(*parsed), tau, mem_limit, build_threads, spill_dir);
+                    }
+                    catch (const std::exception &e)
+                    {
+                        err << "Streaming VIG build failed: " << e.what() << std::endl;
+                        return 3;
+                    }
+                }
             }
         }
-        const std::string nodes_path = (gdir / (graph_base + ".node.csv")).string();
-        const std::string edges_path = (gdir / (graph_base + ".edges.csv")).string();
-
-        CSVWriter ncsv(nodes_path);
-        if (!ncsv.is_open())
-        {
-            std::cerr << "Failed to open nodes output file: " << nodes_path << "\n";
-            return 3;
-        }
-        CSVWriter ecsv(edges_path);
-        if (!ecsv.is_open())
+        const double sec_build = t_build.sec();
+        // A failed store only costs the next run a rebuild; the edges are canonical either way.
+        if constexpr (std::is_same_v<G, VIG>)
         {
-            std::cerr << "Failed to open edges output file: " << edges_path << "\n";
-            return 3;
+            if (!cache_dir.empty() && !cache_hit && !vig_mem_hit)
+                vig_cache_store(cache_dir, cnf_hash, tau, g);
+            if (!vig_key.empty() && !vig_mem_hit)
+                cache->store_vig(vig_key, shared_g);
         }
 
-        // Nodes CSV: id,component
-        ncsv.header("id", "component");
-        for (unsigned v = 0; v < g.n; ++v)
+        Timer t_seg;
+        GraphSegmenterFH seg(g.n, k);
+        // Apply optional config knobs
         {
-            unsigned r = seg.component_no_compress(v);
-            ncsv.row(v, r);
+            GraphSegmenterFH::Config cfg = seg.config();
+            try {
+                cfg.sizeExponent = std::stod(cli.get_string("size-exp"));
+            } catch (...) {
+                err << "Invalid size-exp value" << std::endl;
+                return 1;
+            }
+            if (cli.get_flag("no-mod-guard")) cfg.use_modularity_guard = false;
+            try {
+                cfg.gamma = std::stod(cli.get_string("gamma"));
+            } catch (...) {
+                err << "Invalid gamma value" << std::endl;
+                return 1;
+            }
+            if (cli.get_flag("no-anneal-guard")) cfg.anneal_modularity_guard = false;
+            if (cli.get_flag("no-hub-index")) cfg.hub_index = false;
+            try {
+                cfg.dq_tolerance0 = std::stod(cli.get_string("dq-tol0"));
+            } catch (...) {
+                err << "Invalid dq-tol0 value" << std::endl;
+                return 1;
+            }
+            try {
+                cfg.dq_vscale = std::stod(cli.get_string("dq-vscale"));
+            } catch (...) {
+                err << "Invalid dq-vscale value" << std::endl;
+                return 1;
+            }
+            // ambiguous policy
+            {
+                std::string pol = cli.get_string("ambiguous");
+                std::transform(pol.begin(), pol.end(), pol.begin(), [](unsigned char c){ return std::tolower(c); });
+                if (pol == "accept") cfg.ambiguous_policy = GraphSegmenterFH::Config::Ambiguous::Accept;
+                else if (pol == "reject") cfg.ambiguous_policy = GraphSegmenterFH::Config::Ambiguous::Reject;
+                else if (pol == "margin" || pol == "gatemargin") cfg.ambiguous_policy = GraphSegmenterFH::Config::Ambiguous::GateMargin;
+                else {
+                    err << "Invalid ambiguous policy (use accept|reject|margin)" << std::endl;
+                    return 1;
+                }
+            }
+            try {
+                cfg.gate_margin_ratio = std::stod(cli.get_string("gate-margin"));
+            } catch (...) {
+                err << "Invalid gate-margin value" << std::endl;
+                return 1;
+            }
+            if (!parse_edge_sort(cli.get_string("edge-sort"), cfg.edge_sort))
+            {
+                err << "Invalid edge-sort (use auto|std|radix)" << std::endl;
+                return 1;
+            }
+            cfg.radix_sort_threshold = cli.get_size("radix-threshold");
+            cfg.sort_threads = threads;
+            cfg.seg_threads = static_cast<unsigned>(cli.get_uint64("seg-threads"));
+            if (!parse_seg_state_layout(cli.get_string("seg-layout"), cfg.state_layout))
+            {
+                err << "Invalid seg-layout (use split|packed)" << std::endl;
+                return 1;
+            }
+            if (!parse_node_relabel(cli.get_string("relabel"), cfg.relabel))
+            {
+                err << "Invalid relabel (use none|bfs|degree)" << std::endl;
+                return 1;
+            }
+            // Rejected edges are only needed for --cross-out.
+            cfg.candidates = CandidateStore::None;
+            if (cli.provided("cross-out") &&
+                (!parse_candidate_store(cli.get_string("cross-candidates"), cfg.candidates) || cfg.candidates == CandidateStore::None))
+            {
+                err << "Invalid cross-candidates (use pairmax|all)" << std::endl;
+                return 1;
+            }
+            seg.set_config(cfg);
         }
+        seg.run(g.edges);
+        const double sec_seg = t_seg.sec();
+        const double sec_total = t_total.sec();
 
-        // Edges CSV: u,v,w
-        ecsv.header("u", "v", "w");
-        for (const auto &e : g.edges)
-        {
-            ecsv.row(e.u, e.v, e.w);
-        }
-    }
+        // Flatten the DSU once; modularity (gamma=1.0), size metrics and the
+        // CSV outputs below all read these labels.
+        std::vector<unsigned> labels;
+        seg.component_labels(labels);
+        const PartitionEvaluator evaluator(static_cast<uint32_t>(g.n), g.edges, threads);
+        const PartitionScore score = evaluator.evaluate(labels);
+        const double Q = score.Q;
+        const thesis::CompSummary& cs = score.cs;
 
-    // Optional: write strongest cross-component edges to CSV
-    if (cli.provided("cross-out"))
-    {
-        const std::string cross_out_dir = cli.get_string("cross-out");
-        if (cross_out_dir.empty())
-        {
-            std::cerr << "--cross-out requires a directory path\n";
-            return 3;
-        }
-        std::error_code ec;
-        std::filesystem::path cdir(cross_out_dir);
-        if (!std::filesystem::exists(cdir, ec))
+        // Optional: coarser levels over the quotient graphs, scored on the full graph.
+        Timer t_levels;
+        const std::vector<SegLevel> levels = ml_opt.levels ? segment_levels(labels, g.edges, k, seg.config(), ml_opt)
+                                                           : std::vector<SegLevel>{};
+        const double sec_levels = t_levels.sec();
+
+        // Optional: write full graph (nodes with component labels, then edges) to files
+        if (cli.provided("graph-out"))
         {
-            if (!std::filesystem::create_directories(cdir, ec))
+            const std::string graph_out_dir = cli.get_string("graph-out");
+            if (graph_out_dir.empty())
             {
-                std::cerr << "Failed to create output directory: " << cross_out_dir << "\n";
+                err << "--graph-out requires a directory path\n";
                 return 3;
             }
-        }
-        else if (!std::filesystem::is_directory(cdir, ec))
-        {
-            std::cerr << "--cross-out path is not a directory: " << cross_out_dir << "\n";
-            return 3;
-        }
-        std::string base = cli.provided("output-base") ? cli.get_string("output-base") : std::string{};
-        if (base.empty())
-        {
-            if (path != "-")
+            std::error_code ec;
+            std::filesystem::path gdir(graph_out_dir);
+            if (!std::filesystem::exists(gdir, ec))
+            {
+                if (!std::filesystem::create_directories(gdir, ec))
+                {
+                    err << "Failed to create output directory: " << graph_out_dir << "\n";
+                    return 3;
+                }
+            }
+            else if (!std::filesystem::is_directory(gdir, ec))
+            {
+                err << "--graph-out path is not a directory: " << graph_out_dir << "\n";
+                return 3;
+            }
+            std::string graph_base = cli.provided("output-base") ? cli.get_string("output-base") : std::string{};
+            if (graph_base.empty())
             {
-                std::filesystem::path p(path);
-                p = p.filename();
-                while (p.has_extension())
-                    p = p.stem();
-                base = p.string();
-                if (base.empty())
-                    base = "cnf";
+                if (path != "-")
+                {
+                    std::filesystem::path p(path);
+                    p = p.filename();
+                    while (p.has_extension())
+                        p = p.stem();
+                    graph_base = p.string();
+                    if (graph_base.empty())
+                        graph_base = "cnf";
+                }
+                else
+                {
+                    graph_base = "stdin";
+                }
+            }
+            const std::string ext = tcol_out ? ".tcol" : ".csv";
+            const std::string nodes_path = (gdir / (graph_base + ".node" + ext)).string();
+            const std::string edges_path = (gdir / (graph_base + ".edges" + ext)).string();
+
+            if (tcol_out)
+            {
+                using W = std::remove_cvref_t<decltype(edge_at(g.edges, 0).w)>;
+                const std::size_t m = edge_count(g.edges);
+                ColumnarWriter nout(nodes_path, g.n, {{"id", TcolType::U32}, {"component", TcolType::U32}});
+                ColumnarWriter eout(edges_path, m, {{"u", TcolType::U32}, {"v", TcolType::U32}, {"w", tcol_type_of<W>()}});
+                if (!nout.is_open() || !eout.is_open())
+                {
+                    err << "Failed to open graph output files: " << nodes_path << ", " << edges_path << "\n";
+                    return 3;
+                }
+                nout.column<uint32_t>([](uint64_t i) { return i; });
+                nout.column<uint32_t>([&](uint64_t i) { return labels[i]; });
+                eout.column<uint32_t>([&](uint64_t i) { return edge_at(g.edges, i).u; });
+                eout.column<uint32_t>([&](uint64_t i) { return edge_at(g.edges, i).v; });
+                eout.column<W>([&](uint64_t i) { return edge_at(g.edges, i).w; });
+                if (!nout.close() || !eout.close())
+                {
+                    err << "Failed to write graph output files: " << nodes_path << ", " << edges_path << "\n";
+                    return 3;
+                }
             }
             else
             {
-                base = "stdin";
+                CSVWriter ncsv(nodes_path);
+                if (!ncsv.is_open())
+                {
+                    err << "Failed to open nodes output file: " << nodes_path << "\n";
+                    return 3;
+                }
+                CSVWriter ecsv(edges_path);
+                if (!ecsv.is_open())
+                {
+                    err << "Failed to open edges output file: " << edges_path << "\n";
+                    return 3;
+                }
+
+                // Nodes CSV: id,component
+                ncsv.header("id", "component");
+                for (unsigned v = 0; v < g.n; ++v)
+                {
+                    ncsv.row(v, labels[v]);
+                }
+
+                // Edges CSV: u,v,w
+                ecsv.header("u", "v", "w");
+                for_each_edge(g.edges, [&](uint32_t u, uint32_t v, auto w)
+                              { ecsv.row(u, v, w); });
             }
         }
-        const std::filesystem::path cross_file = cdir / (base + "_cross.csv");
-        CSVWriter csv(cross_file.string());
-        if (!csv.is_open())
-        {
-            std::cerr << "Failed to open cross-out file: " << cross_file.string() << "\n";
-            return 3;
-        }
-        csv.header("u", "v", "w");
-        auto strongest = seg.strongest_inter_component_edges();
-        std::sort(strongest.begin(), strongest.end(), [](const SegEdge &a, const SegEdge &b)
-                  { return a.w > b.w; });
-        for (const auto &e : strongest)
-            csv.row(e.u, e.v, e.w);
-    }
 
-    // Optional: write components CSV with size and minimum internal weight per component
-    if (cli.provided("comp-out"))
-    {
-        const std::string comp_out_dir = cli.get_string("comp-out");
-        std::error_code ec;
-        std::filesystem::path outdir(comp_out_dir);
-        if (comp_out_dir.empty())
-        {
-            std::cerr << "--comp-out requires a directory path\n";
-            return 3;
-        }
-        if (!std::filesystem::exists(outdir, ec))
+        // Optional: write strongest cross-component edges to CSV (or .tcol)
+        if (cli.provided("cross-out"))
         {
-            if (!std::filesystem::create_directories(outdir, ec))
+            const std::string cross_out_dir = cli.get_string("cross-out");
+            if (cross_out_dir.empty())
             {
-                std::cerr << "Failed to create output directory: " << comp_out_dir << "\n";
+                err << "--cross-out requires a directory path\n";
                 return 3;
             }
-        }
-        else if (!std::filesystem::is_directory(outdir, ec))
-        {
-            std::cerr << "--comp-out path is not a directory: " << comp_out_dir << "\n";
-            return 3;
-        }
-
-        // Derive base name from input CNF path unless overridden by --output-base (preferred) or --comp-base
-        std::string base_name = cli.provided("output-base") ? cli.get_string("output-base")
-                                                            : (cli.provided("comp-base") ? cli.get_string("comp-base") : std::string{});
-        if (base_name.empty())
-        {
-            if (path != "-")
+            std::error_code ec;
+            std::filesystem::path cdir(cross_out_dir);
+            if (!std::filesystem::exists(cdir, ec))
             {
-                std::filesystem::path p(path);
-                p = p.filename();
-                while (p.has_extension())
-                    p = p.stem();
-                base_name = p.string();
-                if (base_name.empty())
-                    base_name = "cnf";
+                if (!std::filesystem::create_directories(cdir, ec))
+                {
+                    err << "Failed to create output directory: " << cross_out_dir << "\n";
+                    return 3;
+                }
+            }
+            else if (!std::filesystem::is_directory(cdir, ec))
+            {
+                err << "--cross-out path is not a directory: " << cross_out_dir << "\n";
+                return 3;
+            }
+            std::string base = cli.provided("output-base") ? cli.get_string("output-base") : std::string{};
+            if (base.empty())
+            {
+                if (path != "-")
+                {
+                    std::filesystem::path p(path);
+                    p = p.filename();
+                    while (p.has_extension())
+                        p = p.stem();
+                    base = p.string();
+                    if (base.empty())
+                        base = "cnf";
+                }
+                else
+                {
+                    base = "stdin";
+                }
+            }
+            const std::filesystem::path cross_file = cdir / (base + (tcol_out ? "_cross.tcol" : "_cross.csv"));
+            auto strongest = seg.strongest_inter_component_edges();
+            std::stable_sort(strongest.begin(), strongest.end(), [](const SegEdge &a, const SegEdge &b)
+                             { return a.w > b.w; });
+            if (tcol_out)
+            {
+                ColumnarWriter out(cross_file.string(), strongest.size(), {{"u", TcolType::U32}, {"v", TcolType::U32}, {"w", TcolType::F64}});
+                out.column<uint32_t>([&](uint64_t i) { return strongest[i].u; });
+                out.column<uint32_t>([&](uint64_t i) { return strongest[i].v; });
+                out.column<double>([&](uint64_t i) { return strongest[i].w; });
+                if (!out.close())
+                {
+                    err << "Failed to write cross-out file: " << cross_file.string() << "\n";
+                    return 3;
+                }
             }
             else
             {
-                base_name = "stdin";
+                CSVWriter csv(cross_file.string());
+                if (!csv.is_open())
+                {
+                    err << "Failed to open cross-out file: " << cross_file.string() << "\n";
+                    return 3;
+                }
+                csv.header("u", "v", "w");
+                for (const auto &e : strongest)
+                    csv.row(e.u, e.v, e.w);
             }
         }
-        const std::filesystem::path out_file = outdir / (base_name + "_components.csv");
 
-        CSVWriter ofs(out_file.string());
-        if (!ofs.is_open())
+        // Optional: write components CSV with size and minimum internal weight per component
+        if (cli.provided("comp-out"))
         {
-            std::cerr << "Failed to open components output file: " << out_file.string() << "\n";
-            return 3;
+            const std::string comp_out_dir = cli.get_string("comp-out");
+            std::error_code ec;
+            std::filesystem::path outdir(comp_out_dir);
+            if (comp_out_dir.empty())
+            {
+                err << "--comp-out requires a directory path\n";
+                return 3;
+            }
+            if (!std::filesystem::exists(outdir, ec))
+            {
+                if (!std::filesystem::create_directories(outdir, ec))
+                {
+                    err << "Failed to create output directory: " << comp_out_dir << "\n";
+                    return 3;
+                }
+            }
+            else if (!std::filesystem::is_directory(outdir, ec))
+            {
+                err << "--comp-out path is not a directory: " << comp_out_dir << "\n";
+                return 3;
+            }
+
+            // Derive base name from input CNF path unless overridden by --output-base (preferred) or --comp-base
+            std::string base_name = cli.provided("output-base") ? cli.get_string("output-base")
+                                                                : (cli.provided("comp-base") ? cli.get_string("comp-base") : std::string{});
+            if (base_name.empty())
+            {
+                if (path != "-")
+                {
+                    std::filesystem::path p(path);
+                    p = p.filename();
+                    while (p.has_extension())
+                        p = p.stem();
+                    base_name = p.string();
+                    if (base_name.empty())
+                        base_name = "cnf";
+                }
+                else
+                {
+                    base_name = "stdin";
+                }
+            }
+            const std::filesystem::path out_file = outdir / (base_name + "_components.csv");
+
+            CSVWriter ofs(out_file.string());
+            if (!ofs.is_open())
+            {
+                err << "Failed to open components output file: " << out_file.string() << "\n";
+                return 3;
+            }
+            ofs.header("component_id", "size", "min_internal_weight");
+            std::vector<char> seen(g.n, 0);
+            std::vector<unsigned> reps;
+            reps.reserve(seg.num_components());
+            for (unsigned v = 0; v < g.n; ++v)
+            {
+                unsigned r = labels[v];
+                if (seen[r])
+                    continue;
+                seen[r] = 1;
+                reps.push_back(r);
+            }
+            std::sort(reps.begin(), reps.end(), [&](unsigned a, unsigned b)
+                      { return seg.comp_size(a) > seg.comp_size(b); });
+            for (unsigned r : reps)
+            {
+                ofs.row(r, seg.comp_size(r), seg.comp_min_weight(r));
+            }
+
+            // Dendrogram next to it: every component of every level with its size
+            // and the component containing it one level up (-1 at the top). Ids are
+            // level-0 representatives, so a component id is a member of its parent.
+            if (!levels.empty())
+            {
+                const std::filesystem::path levels_file = outdir / (base_name + "_levels.csv");
+                CSVWriter lcsv(levels_file.string());
+                if (!lcsv.is_open())
+                {
+                    err << "Failed to open levels output file: " << levels_file.string() << "\n";
+                    return 3;
+                }
+                lcsv.header("level", "component_id", "size", "parent_id");
+                std::vector<unsigned> size(g.n);
+                for (std::size_t l = 0; l <= levels.size(); ++l)
+                {
+                    const std::vector<unsigned> &lab = l == 0 ? labels : levels[l - 1].labels;
+                    std::fill(size.begin(), size.end(), 0u);
+                    for (unsigned v = 0; v < g.n; ++v)
+                        ++size[lab[v]];
+                    for (unsigned c = 0; c < g.n; ++c)
+                    {
+                        if (size[c] == 0)
+                            continue;
+                        const long long parent = l < levels.size() ? static_cast<long long>(levels[l].labels[c]) : -1;
+                        lcsv.row(l, c, size[c], parent);
+                    }
+                }
+            }
         }
-        ofs.header("component_id", "size", "min_internal_weight");
-        std::vector<char> seen(g.n, 0);
-        std::vector<unsigned> reps;
-        reps.reserve(seg.num_components());
-        for (unsigned v = 0; v < g.n; ++v)
+
+        const auto cfg = seg.config();
+        out << "vars=" << g.n
+                  << " clauses=" << clause_count
+                  << " edges=" << edge_count(g.edges)
+                  << " comps=" << seg.num_components()
+                  << " k=" << k
+                  << " tau=" << (tau == std::numeric_limits<unsigned>::max() ? -1 : (int)tau)
+                  << " parse_sec=" << sec_parse
+                  << " vig_build_sec=" << sec_build
+                  << " seg_sec=" << sec_seg
+                  << " total_sec=" << sec_total
+                  << " impl=" << (use_naive ? "naive" : (mem_limit ? "stream" : "opt"))
+                  << " threads=" << (use_naive ? 1 : (threads == 0 ? -1 : (int)threads))
+                  << " agg_memory=" << g.aggregation_memory
+                  << " keff=" << cs.keff
+                  << " gini=" << cs.gini
+                  << " pmax=" << cs.pmax
+                  << " entropyJ=" << cs.entropyJ
+                  << " modularity=" << Q
+                  // Segmentation knobs summary for benchmarking
+                  << " size_exp=" << cfg.sizeExponent
+                  << " modGuard=" << (cfg.use_modularity_guard ? 1 : 0)
+                  << " gamma=" << cfg.gamma
+                  << " anneal=" << (cfg.anneal_modularity_guard ? 1 : 0)
+                  << " dqTol0=" << cfg.dq_tolerance0
+                  << " dqVscale=" << cfg.dq_vscale
+                  << " amb=" << (cfg.ambiguous_policy == GraphSegmenterFH::Config::Ambiguous::Accept ? "accept" : (cfg.ambiguous_policy == GraphSegmenterFH::Config::Ambiguous::Reject ? "reject" : "margin"))
+                  << " gateMargin=" << cfg.gate_margin_ratio
+                  << " modGateAcc=" << seg.mod_guard_lb_accepts()
+                  << " modGateRej=" << seg.mod_guard_ub_rejects()
+                  << " modGateAmb=" << seg.mod_guard_ambiguous()
+                  << " modLookups=" << seg.mod_guard_lookups()
+                  << " modLookupScanned=" << seg.mod_guard_scanned()
+                  << " modLookupProbed=" << seg.mod_guard_probed()
+                  << " edgeSort=" << edge_sort_name(seg.last_edge_sort())
+                  << " segThreads=" << seg.last_seg_threads()
+                  << " segLayout=" << seg_state_layout_name(seg.last_state_layout())
+                  << " relabel=" << node_relabel_name(cfg.relabel);
+        if (seg.last_seg_threads() > 1)
+            out << " segPrefetched=" << seg.parallel_prefetched() << " segReplayed=" << seg.parallel_replayed();
+        if (!levels.empty())
         {
-            unsigned r = seg.component_no_compress(v);
-            if (seen[r])
-                continue;
-            seen[r] = 1;
-            reps.push_back(r);
+            out << " levels=" << levels.size() << " levelComps=";
+            for (std::size_t l = 0; l < levels.size(); ++l)
+                out << (l ? "/" : "") << levels[l].comps;
+            out << " levelQ=";
+            for (std::size_t l = 0; l < levels.size(); ++l)
+                out << (l ? "/" : "") << evaluator.evaluate(levels[l].labels).Q;
+            out << " level_sec=" << sec_levels;
         }
-        std::sort(reps.begin(), reps.end(), [&](unsigned a, unsigned b)
-                  { return seg.comp_size(a) > seg.comp_size(b); });
-        for (unsigned r : reps)
+        if (cli.provided("cross-out"))
+            out << " crossCandidates=" << seg.inter_component_candidates().size();
+        if (soa || f32)
+            out << " layout=" << (soa ? "soa" : "aos") << " weights=" << (f32 ? "float" : "double");
+        if (!cache_dir.empty())
+            out << " vig_cache=" << (cache_hit ? "hit" : "miss");
+        if (cache)
+            out << " cnf_mem=" << (cnf_key.empty() ? "off" : (cnf_mem_hit ? "hit" : "miss"))
+                << " vig_mem=" << (vig_key.empty() ? "off" : (vig_mem_hit ? "hit" : "miss"))
+                << " mem_cache_bytes=" << cache->bytes() << " mem_cache_entries=" << cache->entries();
+        out << "\n";
+        return 0;
+    };
+
+    if (soa)
+        return f32 ? run(std::type_identity<VIGColumns>{}) : run(std::type_identity<VIGColumnsD>{});
+    return f32 ? run(std::type_identity<VIGF>{}) : run(std::type_identity<VIG>{});
+}
+
+} // namespace
+int main(int argc, char **argv)
+{
+    using namespace thesis;
+
+    ArgParser cli("Segment the variable interaction graph (VIG) of a CNF.");
+    add_segmentation_options(cli, /*input_required=*/false);
+    cli.add_flag("serve", '\0', "Service mode: answer JSON-line requests (segmentation options per request) from stdin or --socket");
+    cli.add_option(OptionSpec{.longName = "socket", .shortName = '\0', .type = ArgType::String, .valueName = "PATH", .help = "With --serve: listen on this Unix socket instead of stdin/stdout", .required = false, .defaultValue = ""});
+    cli.add_option(OptionSpec{.longName = "cache-mem", .shortName = '\0', .type = ArgType::Size, .valueName = "BYTES", .help = "With --serve: memory budget of the CNF/VIG cache (K/M/G suffix)", .required = false, .defaultValue = "4G"});
+    add_placement_option(cli);
+    profile::Session::add_options(cli);
+
+    bool proceed = true;
+    try
+    {
+        proceed = cli.parse(argc, argv);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << cli.usage(argv[0]) << "\n"
+                  << e.what() << "\n";
+        return 1;
+    }
+    if (!proceed)
+    {
+        std::cout << cli.help(argv[0]);
+        return 0;
+    }
+    profile::Session prof(cli);
+    if (!prof.ok())
+        return 1;
+    if (!apply_placement_option(cli))
+        return 1;
+
+    if (!cli.get_flag("serve"))
+    {
+        if (!cli.provided("input"))
         {
-            ofs.row(r, seg.comp_size(r), seg.comp_min_weight(r));
+            std::cerr << cli.usage(argv[0]) << "\n"
+                      << "missing required option --input" << "\n";
+            return 1;
         }
+        return run_segmentation(cli, std::cout, std::cerr, nullptr);
     }
 
-    const auto cfg = seg.config();
-    std::cout << "vars=" << g.n
-              << " clauses=" << cnf.get_clause_count()
-              << " edges=" << g.edges.size()
-              << " comps=" << seg.num_components()
-              << " k=" << k
-              << " tau=" << (tau == std::numeric_limits<unsigned>::max() ? -1 : (int)tau)
-              << " parse_sec=" << sec_parse
-              << " vig_build_sec=" << sec_build
-              << " seg_sec=" << sec_seg
-              << " total_sec=" << sec_total
-              << " impl=" << (use_naive ? "naive" : "opt")
-              << " threads=" << (use_naive ? 1 : (threads == 0 ? -1 : (int)threads))
-              << " agg_memory=" << g.aggregation_memory
-              << " keff=" << cs.keff
-              << " gini=" << cs.gini
-              << " pmax=" << cs.pmax
-              << " entropyJ=" << cs.entropyJ
-              << " modularity=" << Q
-              // Segmentation knobs summary for benchmarking
-              << " size_exp=" << cfg.sizeExponent
-              << " modGuard=" << (cfg.use_modularity_guard ? 1 : 0)
-              << " gamma=" << cfg.gamma
-              << " anneal=" << (cfg.anneal_modularity_guard ? 1 : 0)
-              << " dqTol0=" << cfg.dq_tolerance0
-              << " dqVscale=" << cfg.dq_vscale
-              << " amb=" << (cfg.ambiguous_policy == GraphSegmenterFH::Config::Ambiguous::Accept ? "accept" : (cfg.ambiguous_policy == GraphSegmenterFH::Config::Ambiguous::Reject ? "reject" : "margin"))
-              << " gateMargin=" << cfg.gate_margin_ratio
-              << " modGateAcc=" << seg.mod_guard_lb_accepts()
-              << " modGateRej=" << seg.mod_guard_ub_rejects()
-              << " modGateAmb=" << seg.mod_guard_ambiguous()
-              << "\n";
+    // Service mode: every request is a segmentation command line of its own;
+    // placement and profiling stay process-wide.
+    if (cli.provided("input"))
+    {
+        std::cerr << "--serve takes the input (and all segmentation options) per request" << std::endl;
+        return 1;
+    }
+    GraphCache cache(cli.get_size("cache-mem"));
+    const ServiceHandler handler = [&](const std::vector<std::string> &args, std::ostream &out, std::ostream &err) -> int
+    {
+        ArgParser req("segmentation request");
+        add_segmentation_options(req, /*input_required=*/true);
+        std::vector<char *> req_argv{argv[0]};
+        for (const std::string &a : args)
+            req_argv.push_back(const_cast<char *>(a.c_str()));
+        try
+        {
+            if (!req.parse(static_cast<int>(req_argv.size()), req_argv.data()))
+            {
+                out << req.help("segmentation");
+                return 0;
+            }
+        }
+        catch (const std::exception &e)
+        {
+            err << e.what() << "\n";
+            return 1;
+        }
+        return run_segmentation(req, out, err, &cache);
+    };
+    if (cli.provided("socket"))
+        return serve_unix_socket(cli.get_string("socket"), handler) ? 0 : 1;
+    serve_stream(std::cin, std::cout, handler);
     return 0;
 }
@@ -6,15 +6,27 @@
 #include <algorithm>
 #include <cctype>
 #include <cstdint>
+#include <span>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <map>
+#include <optional>
+#include <tuple>
+#include <thread>
 
 #include "thesis/cli.hpp"
 #include "thesis/timer.hpp"
 #include "thesis/cnf.hpp"
 #include "thesis/vig.hpp"
+#include "thesis/vig_cache.hpp"
 #include "thesis/segmentation.hpp"
-#include "thesis/modularity.hpp"
+#include "thesis/partition_eval.hpp"
+#include "thesis/refine.hpp"
 #include "thesis/comp_metrics.hpp"
 #include "thesis/csv.hpp"
+#include "thesis/numa.hpp"
+#include "thesis/profile.hpp"
 
 using namespace thesis;
 
@@ -77,8 +89,15 @@ int main(int argc, char **argv) {
     cli.add_option(OptionSpec{.longName = "k", .shortName = 'k', .type = ArgType::String, .valueName = "K[,K2,...]", .help = "Segmentation parameter(s); comma-separated doubles", .required = false, .defaultValue = std::to_string(GraphSegmenterFH::kDefaultK)});
     cli.add_flag("naive", '\0', "Use naive VIG builder (single-threaded)");
     cli.add_flag("opt", '\0', "Use optimized VIG builder (default)");
-    cli.add_option(OptionSpec{.longName = "threads", .shortName = 't', .type = ArgType::UInt64, .valueName = "N", .help = "Threads for optimized VIG build (0=auto)", .required = false, .defaultValue = "0"});
+    cli.add_option(OptionSpec{.longName = "threads", .shortName = 't', .type = ArgType::UInt64, .valueName = "N", .help = "Threads for CNF parsing, optimized VIG build and radix edge sort (0=auto)", .required = false, .defaultValue = "0"});
+    cli.add_option(OptionSpec{.longName = "sweep-threads", .shortName = '\0', .type = ArgType::UInt64, .valueName = "N", .help = "Segment sweep points on N threads (0=auto); rows keep sweep order", .required = false, .defaultValue = "1"});
+    cli.add_flag("incremental-k", '\0', "Guard-off points: reuse each run for the next larger k (same results, see README)");
     cli.add_option(OptionSpec{.longName = "maxbuf", .shortName = '\0', .type = ArgType::Size, .valueName = "BYTES", .help = "Max buffer for optimized VIG build", .required = false, .defaultValue = "50000000"});
+    cli.add_option(OptionSpec{.longName = "vig-cache", .shortName = '\0', .type = ArgType::String, .valueName = "DIR", .help = "Reuse/store both VIGs in DIR keyed on (CNF hash, tau)", .required = false, .defaultValue = ""});
+    cli.add_option(OptionSpec{.longName = "sample-cutoff", .shortName = '\0', .type = ArgType::UInt64, .valueName = "N", .help = "Approximate clauses larger than N by sampled pairs in VIGs with tau > N (0 = exact)", .required = false, .defaultValue = "0"});
+    cli.add_option(OptionSpec{.longName = "sample-pairs", .shortName = '\0', .type = ArgType::UInt64, .valueName = "N", .help = "Pairs drawn per literal of each approximated clause", .required = false, .defaultValue = "16"});
+    cli.add_option(OptionSpec{.longName = "sample-seed", .shortName = '\0', .type = ArgType::UInt64, .valueName = "N", .help = "Seed of the pair sampling", .required = false, .defaultValue = "1"});
+    cli.add_flag("sample-check", '\0', "Also build the exact tau=inf VIG and report the exact modularity next to the sampled one");
 
     // Sweepable segmentation knobs
     // Booleans: offer list-style options; if not provided, derive from single flags where applicable.
@@ -103,6 +122,13 @@ int main(int argc, char **argv) {
         std::ostringstream oss; oss << GraphSegmenterFH::Config::kDefaultGateMarginRatio;
         cli.add_option(OptionSpec{.longName = "gate-margin", .shortName = '\0', .type = ArgType::String, .valueName = "R[,..]", .help = "Gate margin ratio list for 'margin' policy", .required = false, .defaultValue = oss.str()});
     }
+    cli.add_option(OptionSpec{.longName = "refine-rounds", .shortName = '\0', .type = ArgType::UInt64, .valueName = "N", .help = "Refine every partition for modularity on the tau=inf VIG for up to N local-move rounds (0 = off)", .required = false, .defaultValue = "0"});
+    cli.add_option(OptionSpec{.longName = "refine-time", .shortName = '\0', .type = ArgType::String, .valueName = "SEC", .help = "Time budget of one refinement in seconds (0 = none)", .required = false, .defaultValue = "0"});
+    cli.add_option(OptionSpec{.longName = "refine-threads", .shortName = '\0', .type = ArgType::UInt64, .valueName = "N", .help = "Threads of one refinement (0=auto); results do not depend on it", .required = false, .defaultValue = "1"});
+    cli.add_option(OptionSpec{.longName = "edge-sort", .shortName = '\0', .type = ArgType::String, .valueName = "auto|std|radix", .help = "Initial edge sort (auto: radix above --radix-threshold edges)", .required = false, .defaultValue = edge_sort_name(GraphSegmenterFH::Config::kDefaultEdgeSort)});
+    cli.add_option(OptionSpec{.longName = "radix-threshold", .shortName = '\0', .type = ArgType::Size, .valueName = "N", .help = "Edge count from which --edge-sort auto uses the radix sort", .required = false, .defaultValue = std::to_string(GraphSegmenterFH::Config::kDefaultRadixSortThreshold)});
+    add_placement_option(cli);
+    profile::Session::add_options(cli);
 
     bool proceed = true;
     try { proceed = cli.parse(argc, argv); } catch (const std::exception &e) {
@@ -110,6 +136,9 @@ int main(int argc, char **argv) {
         return 1;
     }
     if (!proceed) { std::cout << cli.help(argv[0]); return 0; }
+    profile::Session prof(cli);
+    if (!prof.ok()) return 1;
+    if (!apply_placement_option(cli)) return 1;
 
     const std::string path = cli.get_string("input");
     const unsigned tau_user = static_cast<unsigned>(cli.get_uint64("tau"));
@@ -118,6 +147,32 @@ int main(int argc, char **argv) {
     if (!use_naive && !use_opt) use_opt = true;
     const unsigned threads = static_cast<unsigned>(cli.get_uint64("threads"));
     const std::size_t maxbuf = cli.get_size("maxbuf");
+    const unsigned sweep_threads_opt = static_cast<unsigned>(cli.get_uint64("sweep-threads"));
+    HugeClauseSampling sampling;
+    sampling.cutoff = static_cast<unsigned>(cli.get_uint64("sample-cutoff"));
+    sampling.pairs_per_literal = static_cast<std::size_t>(cli.get_uint64("sample-pairs"));
+    sampling.seed = cli.get_uint64("sample-seed");
+    const bool sample_check = cli.get_flag("sample-check");
+    if (sampling.cutoff != 0 && (use_naive || cli.provided("vig-cache") || sampling.pairs_per_literal == 0)) {
+        std::cerr << "--sample-cutoff needs the optimized builder without --vig-cache, and --sample-pairs > 0\n";
+        return 1;
+    }
+    if (sample_check && sampling.cutoff == 0) {
+        std::cerr << "--sample-check requires --sample-cutoff\n";
+        return 1;
+    }
+    const bool incremental_k = cli.get_flag("incremental-k");
+    GraphSegmenterFH::Config::EdgeSort edge_sort{};
+    if (!parse_edge_sort(cli.get_string("edge-sort"), edge_sort)) { std::cerr << "invalid edge-sort value (use auto|std|radix)\n"; return 1; }
+    const std::size_t radix_threshold = cli.get_size("radix-threshold");
+    RefineOptions refine_opt;
+    refine_opt.max_rounds = static_cast<unsigned>(cli.get_uint64("refine-rounds"));
+    refine_opt.threads = static_cast<unsigned>(cli.get_uint64("refine-threads"));
+    try { refine_opt.time_limit = std::stod(cli.get_string("refine-time")); } catch (const std::exception&) {
+        std::cerr << "invalid refine-time value: " << cli.get_string("refine-time") << "\n";
+        return 1;
+    }
+    const bool refine_on = refine_opt.max_rounds > 0;
 
     std::vector<double> k_values;
     try { k_values = parse_double_list(cli.get_string("k"), "k"); } catch (const std::exception &e) { std::cerr << e.what() << "\n"; return 1; }
@@ -179,103 +234,104 @@ int main(int argc, char **argv) {
     // Parse CNF once
     Timer t_total;
     Timer t_parse;
-    CNF cnf = (path == "-") ? CNF(std::cin, /*variable_compaction=*/true)
-                              : CNF(path, /*variable_compaction=*/true);
+    CNF cnf = (path == "-") ? CNF(std::cin, /*variable_compaction=*/true, /*normalize=*/true, threads)
+                              : CNF(path, /*variable_compaction=*/true, /*normalize=*/true, threads);
     const double sec_parse = t_parse.sec();
-    if (!cnf.is_valid()) { std::cerr << "Failed to parse CNF: " << path << "\n"; return 2; }
+    if (!cnf.is_valid()) { std::cerr << "Failed to parse CNF: " << path << ": " << cnf.error() << "\n"; return 2; }
 
     const uint32_t nvars = cnf.get_variable_count();
     const std::string out_csv = cli.get_string("out-csv");
 
+    // VIGs come from the cache when --vig-cache is given and holds them; missing ones are built and stored
+    const std::string cache_dir = cli.provided("vig-cache") ? cli.get_string("vig-cache") : std::string();
+    const uint64_t cnf_hash = cache_dir.empty() ? 0 : cnf_fingerprint(cnf);
+    auto build_vig = [&](unsigned tau, bool& hit, HugeClauseStats* sampled) {
+        VIG g;
+        hit = !cache_dir.empty() && vig_cache_load(cache_dir, cnf_hash, tau, g);
+        if (hit) return g;
+        if (use_naive) {
+            g = build_vig_naive(cnf, tau);
+        } else if (sampled) {
+            const unsigned hc = std::thread::hardware_concurrency();
+            g = build_vig_optimized<VIG>(cnf, tau, maxbuf, threads == 0 ? (hc ? hc : 1u) : threads, sampling, sampled);
+        } else {
+            if (threads == 0) g = build_vig_optimized(cnf, tau, maxbuf);
+            else              g = build_vig_optimized(cnf, tau, maxbuf, threads);
+        }
+        if (!cache_dir.empty()) vig_cache_store(cache_dir, cnf_hash, tau, g);
+        return g;
+    };
+
     // Build VIG with tau=inf (baseline for modularity eval)
     Timer t_build_inf;
-    VIG vig_inf;
-    if (use_naive) {
-        vig_inf = build_vig_naive(cnf, std::numeric_limits<unsigned>::max());
-    } else {
-        if (threads == 0) vig_inf = build_vig_optimized(cnf, std::numeric_limits<unsigned>::max(), maxbuf);
-        else              vig_inf = build_vig_optimized(cnf, std::numeric_limits<unsigned>::max(), maxbuf, threads);
-    }
+    bool hit_inf = false;
+    HugeClauseStats sampled_inf, sampled_user;
+    const bool sampling_on = sampling.cutoff != 0;
+    VIG vig_inf = build_vig(std::numeric_limits<unsigned>::max(), hit_inf, sampling_on ? &sampled_inf : nullptr);
     const double sec_build_inf = t_build_inf.sec();
 
+    // --sample-check: the exact tau=inf VIG, only used for the reference modularity
+    Timer t_build_exact;
+    bool hit_exact = false;
+    VIG vig_inf_exact;
+    if (sample_check) vig_inf_exact = build_vig(std::numeric_limits<unsigned>::max(), hit_exact, nullptr);
+    const double sec_build_exact = t_build_exact.sec();
+
     // Build VIG with user tau (for segmentation)
     Timer t_build_user;
-    VIG vig_user;
-    if (use_naive) {
-        vig_user = build_vig_naive(cnf, tau_user);
-    } else {
-        if (threads == 0) vig_user = build_vig_optimized(cnf, tau_user, maxbuf);
-        else              vig_user = build_vig_optimized(cnf, tau_user, maxbuf, threads);
-    }
+    bool hit_user = false;
+    VIG vig_user = build_vig(tau_user, hit_user, sampling_on ? &sampled_user : nullptr);
     const double sec_build_user = t_build_user.sec();
 
-    // Status: one-time timing report for parse and VIG builds
+    // Prepare once: sort the user VIG into segmentation order and index it. Every
+    // run below only reads these (GraphSegmenterFH::run_presorted).
+    Timer t_presort;
+    EdgeSortOptions sort_opt;
+    sort_opt.method = edge_sort;
+    sort_opt.radix_threshold = radix_threshold;
+    sort_opt.threads = threads;
+    const EdgeSortMethod sort_used = sort_edges_desc(vig_user.edges, sort_opt);
+    const std::span<const Edge> edges_user(vig_user.edges);
+    const bool any_guard = std::find(mod_guards.begin(), mod_guards.end(), true) != mod_guards.end();
+    const SegNeighbors neighbors_user = SegNeighbors::build(nvars, edges_user, any_guard);
+    const double sec_presort = t_presort.sec();
+
+    // --refine-rounds: adjacency and colouring of the tau=inf VIG, shared by all rows
+    Timer t_refine_prep;
+    const SegNeighbors neighbors_inf = refine_on ? SegNeighbors::build(nvars, vig_inf.edges, false) : SegNeighbors{};
+    const std::optional<ModularityRefiner> refiner =
+        refine_on ? std::optional<ModularityRefiner>(std::in_place, neighbors_inf) : std::nullopt;
+    const double sec_refine_prep = t_refine_prep.sec();
+
+    // Status: one-time timing report for parse, VIG builds and the shared sort
     std::cout << "segmentation_eval: parse_sec=" << sec_parse
               << " build_inf_sec=" << sec_build_inf
-              << " build_user_sec=" << sec_build_user << "\n";
-
-    // Prepare once: copy of edges we can sort per run without touching original
-    std::vector<Edge> edges_user = vig_user.edges; // will be sorted per run
-
-    // Compute total combinations with conditional sweeping
-    auto count_total = [&]() -> uint64_t {
-        uint64_t cnt = 0;
-        for (double k : k_values) {
-            
-            for (double sx : size_exps) {
-                for (bool mg : mod_guards) {
-                    const std::vector<double>& gamma_list =
-                        mg ? gammas : std::vector<double>{ gammas.front() };
-                    const std::vector<bool>& anneal_list =
-                        mg ? anneals : std::vector<bool>{ anneals.front() };
-                    const std::vector<double>& dq_tol_list =
-                        mg ? dq_tols : std::vector<double>{ dq_tols.front() };
-                    for (double gma : gamma_list) {
-                        for (bool an : anneal_list) {
-                            const std::vector<double>& vscale_list =
-                                (mg && an) ? dq_vscales : std::vector<double>{ dq_vscales.front() };
-                            for (double tol0 : dq_tol_list) {
-                                for (double vs : vscale_list) {
-                                    const std::vector<std::string> amb_list =
-                                        mg ? ambs : std::vector<std::string>{ ambs.front() };
-                                    for (const auto& amb : amb_list) {
-                                        const bool is_margin = (to_lower(amb) == "margin");
-                                        const std::vector<double> gmarg_list =
-                                            (mg && is_margin) ? gate_margins : std::vector<double>{ gate_margins.front() };
-                                        for (double gmarg : gmarg_list) {
-                                            (void)k; (void)sx; (void)mg; (void)gma; (void)an; (void)tol0; (void)vs; (void)amb; (void)gmarg;
-                                            ++cnt;
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-        }
-        return cnt;
-    };
-    const uint64_t total = count_total();
-
-    CSVWriter csv(out_csv);
-    if (!csv.is_open()) {
-        std::cerr << "Failed to open output CSV: " << out_csv << "\n";
-        return 3;
+              << " build_user_sec=" << sec_build_user
+              << " presort_sec=" << sec_presort
+              << " edge_sort=" << edge_sort_name(sort_used);
+    if (!cache_dir.empty())
+        std::cout << " vig_cache_inf=" << (hit_inf ? "hit" : "miss") << " vig_cache_user=" << (hit_user ? "hit" : "miss");
+    if (sampling_on) {
+        std::cout << " sampled_clauses_inf=" << sampled_inf.clauses << " sampled_pairs_inf=" << sampled_inf.pairs_drawn
+                  << " replaced_pairs_inf=" << sampled_inf.pairs_replaced << " sampled_clauses_user=" << sampled_user.clauses;
+        if (sample_check) std::cout << " build_exact_sec=" << sec_build_exact;
     }
-    csv.header(
-        "vars","edges_user","edges_inf","comps","k","tau_user",
-        "seg_sec",
-        "impl","threads","agg_memory_inf","agg_memory_user",
-        "keff","gini","pmax","entropyJ","modularity",
-        "size_exp","modGuard","gamma","anneal",
-        "dqTol0","dqVscale","amb","gateMargin","modGateAcc","modGateRej","modGateAmb"
-    );
-
-    std::cout << "segmentation_eval: writing " << total << " rows to " << out_csv << "\n";
+    if (refiner) std::cout << " refine_prep_sec=" << sec_refine_prep << " refine_colours=" << refiner->colours();
+    std::cout << "\n";
 
-    // Run segmentation for each combination without rebuilding VIG (conditional sweep)
-    uint64_t written = 0;
+    // One sweep point per CSV row, enumerated with conditional sweeping (knobs that
+    // do not apply to a setting take their first value). Rows are written in this
+    // order whatever --sweep-threads is.
+    struct SweepPoint {
+        double k, sx;
+        bool mg;
+        double gma;
+        bool an;
+        double tol0, vs;
+        std::string amb;
+        double gmarg;
+    };
+    std::vector<SweepPoint> points;
     for (double k : k_values) {
         for (double sx : size_exps) {
             for (bool mg : mod_guards) {
@@ -298,64 +354,7 @@ int main(int argc, char **argv) {
                                     const std::vector<double> gmarg_list =
                                         (mg && is_margin) ? gate_margins : std::vector<double>{ gate_margins.front() };
                                     for (double gmarg : gmarg_list) {
-                                        GraphSegmenterFH seg(nvars, k);
-                                        GraphSegmenterFH::Config cfg = seg.config();
-                                        cfg.sizeExponent = sx;
-                                        cfg.use_modularity_guard = mg;
-                                        cfg.gamma = gma;
-                                        cfg.anneal_modularity_guard = an;
-                                        cfg.dq_tolerance0 = tol0;
-                                        cfg.dq_vscale = vs;
-                                        std::string pol = amb; std::string pl = pol;
-                                        std::transform(pl.begin(), pl.end(), pl.begin(), [](unsigned char c){ return std::tolower(c); });
-                                        if (pl == "accept") cfg.ambiguous_policy = GraphSegmenterFH::Config::Ambiguous::Accept;
-                                        else if (pl == "reject") cfg.ambiguous_policy = GraphSegmenterFH::Config::Ambiguous::Reject;
-                                        else cfg.ambiguous_policy = GraphSegmenterFH::Config::Ambiguous::GateMargin;
-                                        cfg.gate_margin_ratio = gmarg;
-                                        seg.set_config(cfg);
-
-                                        std::vector<Edge> edges = edges_user; // copy then sort
-                                        Timer t_seg;
-                                        seg.run(edges);
-                                        const double sec_seg = t_seg.sec();
-
-                                        auto comm_of = [&seg](uint32_t v) { return static_cast<int>(seg.component_no_compress(v)); };
-                                        const double Q = modularity(nvars, vig_inf.edges, comm_of, /*gamma*/1.0);
-
-                                        const auto sizes = component_sizes(nvars, [&seg](uint32_t v){ return seg.component_no_compress(v); });
-                                        const auto cs = summarize_components(sizes);
-
-                                        const double sec_total = t_total.sec();
-
-                                        const std::string amb_out = mg ? (
-                                            cfg.ambiguous_policy == GraphSegmenterFH::Config::Ambiguous::Accept ? "accept" :
-                                            (cfg.ambiguous_policy == GraphSegmenterFH::Config::Ambiguous::Reject ? "reject" : "margin")
-                                        ) : "n/a";
-                                        const double gmarg_out = (mg && cfg.ambiguous_policy == GraphSegmenterFH::Config::Ambiguous::GateMargin) ? gmarg : -1.0;
-
-                                        csv.row(
-                                            nvars,
-                                            static_cast<uint64_t>(vig_user.edges.size()),
-                                            static_cast<uint64_t>(vig_inf.edges.size()),
-                                            static_cast<uint64_t>(seg.num_components()),
-                                            k,
-                                            (tau_user == std::numeric_limits<unsigned>::max() ? -1 : static_cast<int>(tau_user)),
-                                            sec_seg,
-                                            (use_naive ? "naive" : "opt"),
-                                            (use_naive ? 1 : (threads == 0 ? -1 : (int)threads)),
-                                            static_cast<uint64_t>(vig_inf.aggregation_memory),
-                                            static_cast<uint64_t>(vig_user.aggregation_memory),
-                                            cs.keff, cs.gini, cs.pmax, cs.entropyJ, Q,
-                                            sx, (mg ? 1 : 0), gma, (an ? 1 : 0),
-                                            tol0, vs,
-                                            amb_out,
-                                            gmarg_out,
-                                            seg.mod_guard_lb_accepts(), seg.mod_guard_ub_rejects(), seg.mod_guard_ambiguous()
-                                        );
-                                        ++written;
-                                        if (total > 0 && (written % 1000 == 0)) {
-                                            std::cout << "progress: " << written << "/" << total << " rows written\n";
-                                        }
+                                        points.push_back(SweepPoint{k, sx, mg, gma, an, tol0, vs, amb, gmarg});
                                     }
                                 }
                             }
@@ -365,7 +364,269 @@ int main(int argc, char **argv) {
             }
         }
     }
+    const uint64_t total = points.size();
+
+    // Units of work: one point each, or with --incremental-k every guard-off group
+    // of points that differ only in k, visited in increasing k by one segmenter.
+    std::vector<std::vector<std::size_t>> tasks;
+    {
+        std::map<std::tuple<double, double, bool, double, double, std::string, double>, std::size_t> group_of;
+        for (std::size_t i = 0; i < points.size(); ++i) {
+            const SweepPoint& p = points[i];
+            if (!incremental_k || p.mg) { tasks.push_back({i}); continue; }
+            const auto key = std::make_tuple(p.sx, p.gma, p.an, p.tol0, p.vs, p.amb, p.gmarg);
+            auto [it, fresh] = group_of.emplace(key, tasks.size());
+            if (fresh) tasks.emplace_back();
+            tasks[it->second].push_back(i);
+        }
+        for (auto& t : tasks)
+            std::stable_sort(t.begin(), t.end(), [&](std::size_t a, std::size_t b) { return points[a].k < points[b].k; });
+    }
+
+    CSVWriter csv(out_csv);
+    if (!csv.is_open()) {
+        std::cerr << "Failed to open output CSV: " << out_csv << "\n";
+        return 3;
+    }
+    csv.header(
+        "vars","edges_user","edges_inf","comps","k","tau_user",
+        "seg_sec",
+        "impl","threads","agg_memory_inf","agg_memory_user",
+        "keff","gini","pmax","entropyJ","modularity",
+        "size_exp","modGuard","gamma","anneal",
+        "dqTol0","dqVscale","amb","gateMargin","modGateAcc","modGateRej","modGateAmb",
+        "same_partition_k",
+        "modLookups","modLookupScanned","modLookupProbed",
+        "sampledClausesInf","modularityExact",
+        "modularityRefined","refineComps","refineRounds","refineMoves","refine_sec"
+    );
+
+    unsigned sweep_threads = sweep_threads_opt;
+    if (sweep_threads == 0) {
+        const unsigned hc = std::thread::hardware_concurrency();
+        sweep_threads = hc ? hc : 1u;
+    }
+    if (sweep_threads > tasks.size()) sweep_threads = static_cast<unsigned>(std::max<std::size_t>(tasks.size(), 1));
+
+    std::cout << "segmentation_eval: writing " << total << " rows to " << out_csv
+              << " (sweep_threads=" << sweep_threads << ")\n";
+
+    // Everything a row needs beyond the shared columns.
+    struct SweepResult {
+        uint64_t comps = 0;
+        double sec_seg = 0.0;
+        CompSummary cs{};
+        double Q = 0.0;
+        double Q_exact = std::numeric_limits<double>::quiet_NaN(); // --sample-check only ("nan" otherwise)
+        GraphSegmenterFH::Config::Ambiguous policy{};
+        unsigned acc = 0, rej = 0, amb = 0;
+        double same_k = -1.0; // smallest k of the group with the same partition (incremental only)
+        uint64_t lookups = 0, scanned = 0, probed = 0;
+        // --refine-rounds only ("nan" / 0 otherwise)
+        double Q_refined = std::numeric_limits<double>::quiet_NaN();
+        uint64_t refine_comps = 0, refine_rounds = 0, refine_moves = 0;
+        double sec_refine = 0.0;
+    };
+
+    auto configure = [&](GraphSegmenterFH& seg, const SweepPoint& p) {
+        GraphSegmenterFH::Config cfg = seg.config();
+        cfg.sizeExponent = p.sx;
+        cfg.use_modularity_guard = p.mg;
+        cfg.gamma = p.gma;
+        cfg.anneal_modularity_guard = p.an;
+        cfg.dq_tolerance0 = p.tol0;
+        cfg.dq_vscale = p.vs;
+        const std::string pl = to_lower(p.amb);
+        if (pl == "accept") cfg.ambiguous_policy = GraphSegmenterFH::Config::Ambiguous::Accept;
+        else if (pl == "reject") cfg.ambiguous_policy = GraphSegmenterFH::Config::Ambiguous::Reject;
+        else cfg.ambiguous_policy = GraphSegmenterFH::Config::Ambiguous::GateMargin;
+        cfg.gate_margin_ratio = p.gmarg;
+        cfg.record_trajectory = incremental_k && !p.mg;
+        cfg.candidates = CandidateStore::None; // rows never read the rejected edges
+        seg.set_config(cfg);
+    };
+
+    // Strengths and total weight of the tau=inf graphs, computed once for the
+    // whole sweep. Sequential per row: the sweep workers already run rows in
+    // parallel, and one thread keeps Q bit-identical to modularity().
+    using InfEvaluator = PartitionEvaluator<std::vector<Edge>>;
+    const InfEvaluator eval_inf(nvars, vig_inf.edges, 1);
+    const InfEvaluator eval_exact(sample_check ? nvars : 0u, vig_inf_exact.edges, 1);
+
+    // labels: seg's flattened roots (component_labels()).
+    auto collect = [&](GraphSegmenterFH& seg, double sec_seg, const std::vector<unsigned>& labels,
+                       InfEvaluator::Scratch& scratch) {
+        SweepResult r;
+        r.sec_seg = sec_seg;
+
+        const PartitionScore score = eval_inf.evaluate(labels, scratch);
+        r.Q = score.Q;
+        r.cs = score.cs;
+        if (sample_check) r.Q_exact = eval_exact.evaluate(labels, scratch).Q;
+        r.comps = seg.num_components();
+        r.policy = seg.config().ambiguous_policy;
+        r.acc = seg.mod_guard_lb_accepts();
+        r.rej = seg.mod_guard_ub_rejects();
+        r.amb = seg.mod_guard_ambiguous();
+        r.lookups = seg.mod_guard_lookups();
+        r.scanned = seg.mod_guard_scanned();
+        r.probed = seg.mod_guard_probed();
+        if (refiner) {
+            std::vector<unsigned> refined = labels;
+            const RefineStats rs = refiner->refine(refined, refine_opt);
+            const PartitionScore after = eval_inf.evaluate(refined, scratch);
+            r.Q_refined = after.Q;
+            r.refine_comps = after.comps;
+            r.refine_rounds = rs.rounds;
+            r.refine_moves = rs.moves;
+            r.sec_refine = rs.sec;
+        }
+        return r;
+    };
+
+    // Same partition iff the root maps are related by a bijection.
+    auto same_partition = [&](const std::vector<unsigned>& a, const std::vector<unsigned>& b) {
+        std::vector<unsigned> map(a.size(), std::numeric_limits<unsigned>::max());
+        std::vector<unsigned char> used(b.size(), 0);
+        for (std::size_t x = 0; x < a.size(); ++x) {
+            unsigned& m = map[a[x]];
+            if (m == std::numeric_limits<unsigned>::max()) {
+                if (used[b[x]]) return false;
+                used[b[x]] = 1;
+                m = b[x];
+            } else if (m != b[x]) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // Segment the points of one task into results(i, r). Only reads the shared
+    // sorted edges, neighbor lists and tau=inf VIG, so workers can run tasks
+    // concurrently.
+    auto evaluate = [&](const std::vector<std::size_t>& task, auto&& emit) {
+        GraphSegmenterFH seg(nvars, points[task.front()].k);
+        configure(seg, points[task.front()]);
+        std::vector<unsigned> prev_roots, roots;
+        InfEvaluator::Scratch scratch;
+        double prev_same_k = -1.0;
+        for (std::size_t ti = 0; ti < task.size(); ++ti) {
+            const SweepPoint& p = points[task[ti]];
+            Timer t_seg;
+            if (ti == 0) {
+                seg.run_presorted(edges_user, neighbors_user);
+            } else {
+                seg.resume_presorted(p.k, edges_user, neighbors_user);
+            }
+            const double sec_seg = t_seg.sec();
+            seg.component_labels(roots);
+            SweepResult r = collect(seg, sec_seg, roots, scratch);
+            if (task.size() > 1) {
+                if (ti > 0 && same_partition(prev_roots, roots))
+                    r.same_k = prev_same_k >= 0 ? prev_same_k : points[task[ti - 1]].k;
+                prev_same_k = r.same_k;
+                prev_roots.swap(roots);
+            }
+            emit(task[ti], std::move(r));
+        }
+    };
+
+    uint64_t written = 0;
+    double max_abs_dq = 0.0; // --sample-check: largest |Q(sampled) - Q(exact)| over the rows
+    auto write_row = [&](const SweepPoint& p, const SweepResult& r) {
+        const std::string amb_out = p.mg ? (
+            r.policy == GraphSegmenterFH::Config::Ambiguous::Accept ? "accept" :
+            (r.policy == GraphSegmenterFH::Config::Ambiguous::Reject ? "reject" : "margin")
+        ) : "n/a";
+        const double gmarg_out = (p.mg && r.policy == GraphSegmenterFH::Config::Ambiguous::GateMargin) ? p.gmarg : -1.0;
+
+        csv.row(
+            nvars,
+            static_cast<uint64_t>(vig_user.edges.size()),
+            static_cast<uint64_t>(vig_inf.edges.size()),
+            r.comps,
+            p.k,
+            (tau_user == std::numeric_limits<unsigned>::max() ? -1 : static_cast<int>(tau_user)),
+            r.sec_seg,
+            (use_naive ? "naive" : "opt"),
+            (use_naive ? 1 : (threads == 0 ? -1 : (int)threads)),
+            static_cast<uint64_t>(vig_inf.aggregation_memory),
+            static_cast<uint64_t>(vig_user.aggregation_memory),
+            r.cs.keff, r.cs.gini, r.cs.pmax, r.cs.entropyJ, r.Q,
+            p.sx, (p.mg ? 1 : 0), p.gma, (p.an ? 1 : 0),
+            p.tol0, p.vs,
+            amb_out,
+            gmarg_out,
+            r.acc, r.rej, r.amb,
+            r.same_k,
+            r.lookups, r.scanned, r.probed,
+            static_cast<uint64_t>(sampled_inf.clauses),
+            r.Q_exact,
+            r.Q_refined, r.refine_comps, r.refine_rounds, r.refine_moves, r.sec_refine
+        );
+        if (sample_check) max_abs_dq = std::max(max_abs_dq, std::abs(r.Q - r.Q_exact));
+        ++written;
+        if (total > 0 && (written % 1000 == 0)) {
+            std::cout << "progress: " << written << "/" << total << " rows written\n";
+        }
+    };
+
+    // Run segmentation for each combination without rebuilding VIG
+    if (sweep_threads <= 1 && tasks.size() == points.size()) {
+        for (std::size_t i = 0; i < points.size(); ++i)
+            evaluate(tasks[i], [&](std::size_t pi, SweepResult r) { write_row(points[pi], r); });
+    } else {
+        // Work queue over the points; the main thread writes results in point order
+        // as soon as the next one is ready, so at most the out-of-order tail is held.
+        std::vector<std::optional<SweepResult>> results(points.size());
+        std::atomic<std::size_t> next{0};
+        std::mutex mu;
+        std::condition_variable cv;
+        std::string error;
+
+        auto worker = [&]() {
+            for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < tasks.size();) {
+                try {
+                    evaluate(tasks[i], [&](std::size_t pi, SweepResult r) {
+                        {
+                            std::lock_guard<std::mutex> lk(mu);
+                            results[pi] = std::move(r);
+                        }
+                        cv.notify_all();
+                    });
+                } catch (const std::exception& e) {
+                    {
+                        std::lock_guard<std::mutex> lk(mu);
+                        if (error.empty()) error = e.what();
+                    }
+                    next.store(tasks.size(), std::memory_order_relaxed); // stop handing out work
+                    cv.notify_all();
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        pool.reserve(sweep_threads);
+        for (unsigned t = 0; t < sweep_threads; ++t) pool.emplace_back(worker);
+
+        for (std::size_t i = 0; i < points.size(); ++i) {
+            SweepResult r;
+            {
+                std::unique_lock<std::mutex> lk(mu);
+                cv.wait(lk, [&] { return results[i].has_value() || !error.empty(); });
+                if (!results[i]) break;
+                r = *results[i];
+                results[i].reset();
+            }
+            write_row(points[i], r);
+        }
+        for (auto& th : pool) th.join();
+        if (!error.empty()) {
+            std::cerr << "segmentation_eval: sweep failed: " << error << "\n";
+            return 4;
+        }
+    }
 
+    if (sample_check) std::cout << "segmentation_eval: sample_check max_abs_dQ=" << max_abs_dq << "\n";
     std::cout << "segmentation_eval: done (" << written << " rows) -> " << out_csv << "\n";
 
     return 0;
@@ -0,0 +1,534 @@
+#include <algorithm>
+#include <barrier>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "thesis/cli.hpp"
+#include "thesis/cnf.hpp"
+#include "thesis/comp_metrics.hpp"
+#include "thesis/concurrent_disjoint_set.hpp"
+#include "thesis/disjoint_set.hpp"
+#include "thesis/edge_sort.hpp"
+#include "thesis/modularity.hpp"
+#include "thesis/partition_eval.hpp"
+#include "thesis/segmentation.hpp"
+#include "thesis/timer.hpp"
+#include "thesis/vig.hpp"
+#include "thesis/numa.hpp"
+#include "thesis/profile.hpp"
+
+// Micro-benchmarks of the kernels behind the tools: CNF parsing, the naive and
+// optimized VIG builders, the edge sort, DisjointSets and ConcurrentDisjointSets, the segmentation merge
+// loop with and without the modularity guard (its sum_weights_to_comp lookups),
+// modularity(), summarize_components() and the fused PartitionEvaluator. Inputs are synthetic CNFs with a
+// chosen clause-size distribution; every kernel is timed --repeat times and the
+// fastest and median runs are reported on stdout and, with --json, as JSON.
+
+namespace {
+
+using namespace thesis;
+
+// Results the compiler must not drop as unused.
+volatile uint64_t g_sink = 0;
+
+struct SplitMix64 {
+    uint64_t s;
+    uint64_t next() {
+        uint64_t z = (s += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    double uniform() { return static_cast<double>(next() >> 11) * 0x1.0p-53; }
+};
+
+enum class SizeDist { Uniform, Geometric, Zipf };
+
+// Clause sizes in [min_size, max_size]: uniform; min_size + Geometric(param)
+// truncated to the range; or P(s) ~ s^-param over the range.
+struct ClauseSizeSampler {
+    SizeDist dist;
+    unsigned min_size, max_size;
+    double param;
+    std::vector<double> cdf; // Zipf only
+
+    ClauseSizeSampler(SizeDist d, unsigned lo, unsigned hi, double p) : dist(d), min_size(lo), max_size(hi), param(p) {
+        if (dist != SizeDist::Zipf) return;
+        double acc = 0.0;
+        for (unsigned s = min_size; s <= max_size; ++s)
+            cdf.push_back(acc += std::pow(static_cast<double>(s), -param));
+        for (double& c : cdf) c /= acc;
+    }
+
+    unsigned operator()(SplitMix64& rng) const {
+        switch (dist) {
+        case SizeDist::Uniform:
+            return min_size + static_cast<unsigned>(rng.next() % (max_size - min_size + 1));
+        case SizeDist::Geometric: {
+            unsigned s = min_size;
+            while (s < max_size && rng.uniform() >= param) ++s;
+            return s;
+        }
+        case SizeDist::Zipf:
+            break;
+        }
+        const auto it = std::lower_bound(cdf.begin(), cdf.end(), rng.uniform());
+        return min_size + static_cast<unsigned>(std::min<std::ptrdiff_t>(it - cdf.begin(), cdf.size() - 1));
+    }
+};
+
+// DIMACS text of a random CNF: `clauses` clauses over `vars` variables, each
+// with distinct variables and random signs.
+std::string synthetic_cnf(unsigned vars, std::size_t clauses, const ClauseSizeSampler& sizes, uint64_t seed) {
+    SplitMix64 rng{seed};
+    std::string out = "p cnf " + std::to_string(vars) + " " + std::to_string(clauses) + "\n";
+    std::vector<unsigned> clause;
+    char buf[16];
+    for (std::size_t i = 0; i < clauses; ++i) {
+        const unsigned s = std::min(sizes(rng), vars);
+        clause.clear();
+        while (clause.size() < s) {
+            const unsigned v = 1 + static_cast<unsigned>(rng.next() % vars);
+            if (std::find(clause.begin(), clause.end(), v) == clause.end()) clause.push_back(v);
+        }
+        for (unsigned v : clause) {
+            if (rng.next() & 1) out.push_back('-');
+            out.append(buf, std::to_chars(buf, buf + sizeof(buf), v).ptr);
+            out.push_back(' ');
+        }
+        out.append("0\n");
+    }
+    return out;
+}
+
+std::vector<unsigned long long> parse_uint_list(const std::string& s, const char* label) {
+    std::vector<unsigned long long> out;
+    std::string tok;
+    std::stringstream ss(s);
+    while (std::getline(ss, tok, ',')) {
+        if (tok.empty()) continue;
+        try {
+            out.push_back(std::stoull(tok));
+        } catch (...) {
+            throw std::runtime_error(std::string("invalid ") + label + " value: " + tok);
+        }
+    }
+    if (out.empty()) throw std::runtime_error(std::string("no valid ") + label + " provided");
+    return out;
+}
+
+std::string json_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out.push_back('\\');
+        if (static_cast<unsigned char>(c) >= 0x20) out.push_back(c);
+    }
+    return out;
+}
+
+// One benchmark result: kernel name, its parameters, the fastest and median of
+// the timed runs, and the items processed per run (clauses, pairs, edges, ...).
+struct BenchResult {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> params;
+    double min_sec = 0.0, median_sec = 0.0;
+    uint64_t items = 0;
+    std::string items_unit;
+    std::vector<std::pair<std::string, uint64_t>> counters{}; // kernel statistics of the last run
+};
+
+class Bench {
+public:
+    Bench(std::size_t repeat, const std::vector<std::string>& suites) : repeat_(repeat), suites_(suites) {}
+
+    bool enabled(const std::string& suite) const {
+        return suites_.empty() || std::find(suites_.begin(), suites_.end(), suite) != suites_.end();
+    }
+
+    // Time body() --repeat times, each after an untimed setup(); body returns
+    // the items it processed. counters() is read once after the last run.
+    void run(BenchResult r, const std::function<void()>& setup, const std::function<uint64_t()>& body,
+             const std::function<std::vector<std::pair<std::string, uint64_t>>()>& counters = {}) {
+        std::vector<double> secs;
+        for (std::size_t rep = 0; rep < repeat_; ++rep) {
+            setup();
+            Timer t;
+            r.items = body();
+            secs.push_back(t.sec());
+        }
+        std::sort(secs.begin(), secs.end());
+        r.min_sec = secs.front();
+        r.median_sec = secs[secs.size() / 2];
+        if (counters) r.counters = counters();
+        std::cout << "bench=" << r.name;
+        for (const auto& [k, v] : r.params) std::cout << " " << k << "=" << v;
+        std::cout << " min_sec=" << r.min_sec << " median_sec=" << r.median_sec << " " << r.items_unit << "=" << r.items
+                  << " per_sec=" << (r.min_sec > 0.0 ? static_cast<double>(r.items) / r.min_sec : 0.0);
+        for (const auto& [k, v] : r.counters) std::cout << " " << k << "=" << v;
+        std::cout << "\n";
+        results_.push_back(std::move(r));
+    }
+
+    bool write_json(const std::string& path, const std::vector<std::pair<std::string, std::string>>& context) const {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) return false;
+        out.precision(9);
+        out << "{\n  \"context\": {";
+        for (std::size_t i = 0; i < context.size(); ++i)
+            out << (i ? ", " : "") << "\"" << json_escape(context[i].first) << "\": \"" << json_escape(context[i].second) << "\"";
+        out << "},\n  \"benchmarks\": [\n";
+        for (std::size_t i = 0; i < results_.size(); ++i) {
+            const BenchResult& r = results_[i];
+            out << "    {\"name\": \"" << json_escape(r.name) << "\", \"params\": {";
+            for (std::size_t j = 0; j < r.params.size(); ++j)
+                out << (j ? ", " : "") << "\"" << json_escape(r.params[j].first) << "\": \"" << json_escape(r.params[j].second) << "\"";
+            out << "}, \"min_sec\": " << r.min_sec << ", \"median_sec\": " << r.median_sec << ", \"repeat\": " << repeat_
+                << ", \"items\": " << r.items << ", \"items_unit\": \"" << r.items_unit << "\", \"counters\": {";
+            for (std::size_t j = 0; j < r.counters.size(); ++j)
+                out << (j ? ", " : "") << "\"" << json_escape(r.counters[j].first) << "\": " << r.counters[j].second;
+            out << "}}"
+                << (i + 1 < results_.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+        return static_cast<bool>(out);
+    }
+
+private:
+    std::size_t repeat_;
+    std::vector<std::string> suites_;
+    std::vector<BenchResult> results_;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    ArgParser cli("Micro-benchmarks of the parsing, VIG, sort, union-find, segmentation and metrics kernels on synthetic CNFs.");
+    cli.add_option(OptionSpec{.longName = "vars", .shortName = '\0', .type = ArgType::Size, .valueName = "N", .help = "Variables of the synthetic CNF (K/M/G suffix)", .required = false, .defaultValue = "100000"});
+    cli.add_option(OptionSpec{.longName = "clauses", .shortName = '\0', .type = ArgType::Size, .valueName = "N", .help = "Clauses of the synthetic CNF (0 = 4 x vars)", .required = false, .defaultValue = "0"});
+    cli.add_option(OptionSpec{.longName = "size-dist", .shortName = '\0', .type = ArgType::String, .valueName = "uniform|geometric|zipf", .help = "Clause-size distribution over [min-size, max-size]", .required = false, .defaultValue = "geometric"});
+    cli.add_option(OptionSpec{.longName = "size-param", .shortName = '\0', .type = ArgType::String, .valueName = "P", .help = "geometric: stop probability per extra literal; zipf: exponent", .required = false, .defaultValue = "0.4"});
+    cli.add_option(OptionSpec{.longName = "min-size", .shortName = '\0', .type = ArgType::UInt64, .valueName = "N", .help = "Smallest clause size", .required = false, .defaultValue = "2"});
+    cli.add_option(OptionSpec{.longName = "max-size", .shortName = '\0', .type = ArgType::UInt64, .valueName = "N", .help = "Largest clause size", .required = false, .defaultValue = "40"});
+    cli.add_option(OptionSpec{.longName = "seed", .shortName = '\0', .type = ArgType::UInt64, .valueName = "S", .help = "Seed of the synthetic CNF", .required = false, .defaultValue = "1"});
+    cli.add_option(OptionSpec{.longName = "tau", .shortName = '\0', .type = ArgType::UInt64, .valueName = "N|inf", .help = "Clause size threshold of the VIG builds", .required = false, .defaultValue = "inf", .allowInfToken = true});
+    cli.add_option(OptionSpec{.longName = "threads", .shortName = 't', .type = ArgType::String, .valueName = "N[,N2,...]", .help = "Thread counts for parsing, the optimized VIG build, the radix sort, the concurrent DSU and the partition evaluator", .required = false, .defaultValue = "1"});
+    cli.add_option(OptionSpec{.longName = "maxbuf", .shortName = '\0', .type = ArgType::String, .valueName = "B[,B2,...]", .help = "Buffer capacities (contributions) of the optimized VIG build", .required = false, .defaultValue = "50000000"});
+    cli.add_option(OptionSpec{.longName = "k", .shortName = 'k', .type = ArgType::String, .valueName = "K", .help = "Segmentation parameter for the segment and metrics benchmarks", .required = false, .defaultValue = std::to_string(GraphSegmenterFH::kDefaultK)});
+    cli.add_option(OptionSpec{.longName = "suite", .shortName = '\0', .type = ArgType::String, .valueName = "S[,S2,...]", .help = "Subset of parse,vig,sort,dsu,segment,metrics (default: all)", .required = false, .defaultValue = ""});
+    cli.add_option(OptionSpec{.longName = "repeat", .shortName = 'r', .type = ArgType::UInt64, .valueName = "R", .help = "Timed runs per benchmark", .required = false, .defaultValue = "3"});
+    cli.add_option(OptionSpec{.longName = "json", .shortName = '\0', .type = ArgType::String, .valueName = "FILE", .help = "Also write the results as JSON", .required = false, .defaultValue = ""});
+    cli.add_option(OptionSpec{.longName = "label", .shortName = '\0', .type = ArgType::String, .valueName = "STR", .help = "Run label stored in the JSON context (e.g. a commit id)", .required = false, .defaultValue = ""});
+    add_placement_option(cli);
+    profile::Session::add_options(cli);
+
+    bool proceed = true;
+    try {
+        proceed = cli.parse(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << cli.usage(argv[0]) << "\n" << e.what() << "\n";
+        return 1;
+    }
+    if (!proceed) {
+        std::cout << cli.help(argv[0]);
+        return 0;
+    }
+    profile::Session prof(cli);
+    if (!prof.ok()) return 1;
+    if (!apply_placement_option(cli)) return 1;
+
+    const std::size_t vars = cli.get_size("vars");
+    const std::size_t clauses = cli.get_size("clauses") ? cli.get_size("clauses") : 4 * vars;
+    const unsigned min_size = static_cast<unsigned>(cli.get_uint64("min-size"));
+    const unsigned max_size = static_cast<unsigned>(cli.get_uint64("max-size"));
+    const unsigned tau = static_cast<unsigned>(cli.get_uint64("tau"));
+    const std::size_t repeat = std::max<std::size_t>(1, cli.get_uint64("repeat"));
+    const std::string dist_name = cli.get_string("size-dist");
+    SizeDist dist = SizeDist::Geometric;
+    if (dist_name == "uniform") dist = SizeDist::Uniform;
+    else if (dist_name == "zipf") dist = SizeDist::Zipf;
+    else if (dist_name != "geometric") {
+        std::cerr << "invalid size-dist value (use uniform|geometric|zipf)\n";
+        return 1;
+    }
+    double size_param = 0.0, k = GraphSegmenterFH::kDefaultK;
+    std::vector<unsigned long long> thread_list, maxbuf_list;
+    try {
+        size_param = std::stod(cli.get_string("size-param"));
+        k = std::stod(cli.get_string("k"));
+        thread_list = parse_uint_list(cli.get_string("threads"), "threads");
+        maxbuf_list = parse_uint_list(cli.get_string("maxbuf"), "maxbuf");
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    if (vars < 2 || vars > std::numeric_limits<unsigned>::max() / 2 || min_size < 1 || max_size < min_size) {
+        std::cerr << "Need 2 <= --vars < 2^31 and 1 <= --min-size <= --max-size\n";
+        return 1;
+    }
+    std::vector<std::string> suites;
+    {
+        std::string tok;
+        std::stringstream ss(cli.provided("suite") ? cli.get_string("suite") : std::string());
+        while (std::getline(ss, tok, ',')) {
+            if (tok.empty()) continue;
+            if (tok != "parse" && tok != "vig" && tok != "sort" && tok != "dsu" && tok != "segment" && tok != "metrics") {
+                std::cerr << "invalid suite value: " << tok << "\n";
+                return 1;
+            }
+            suites.push_back(tok);
+        }
+    }
+    for (unsigned long long& t : thread_list) {
+        if (t == 0) {
+            const unsigned hc = std::thread::hardware_concurrency();
+            t = hc ? hc : 1u;
+        }
+    }
+
+    const ClauseSizeSampler sizes(dist, min_size, max_size, size_param);
+    Timer t_gen;
+    const std::string text = synthetic_cnf(static_cast<unsigned>(vars), clauses, sizes, cli.get_uint64("seed"));
+    std::istringstream text_in(text);
+    const CNF cnf(text_in, /*variable_compaction=*/true, /*normalize=*/true, 1);
+    if (!cnf.is_valid()) {
+        std::cerr << "Failed to parse the synthetic CNF: " << cnf.error() << "\n";
+        return 2;
+    }
+    std::cout << "thesis_bench: vars=" << cnf.get_variable_count() << " clauses=" << cnf.get_clause_count()
+              << " literals=" << cnf.literal_count() << " size_dist=" << dist_name << " gen_sec=" << t_gen.sec() << "\n";
+
+    Bench bench(repeat, suites);
+    auto nothing = [] {};
+    const std::string tau_str = tau == std::numeric_limits<unsigned>::max() ? "inf" : std::to_string(tau);
+
+    if (bench.enabled("parse")) {
+        for (unsigned long long t : thread_list) {
+            bench.run({"parse", {{"threads", std::to_string(t)}}, 0, 0, 0, "clauses"}, nothing, [&] {
+                std::istringstream in(text);
+                const CNF c(in, true, true, static_cast<unsigned>(t));
+                return static_cast<uint64_t>(c.get_clause_count());
+            });
+        }
+    }
+
+    // Reference VIG for the sort, segmentation and metrics benchmarks.
+    VIG g = build_vig_optimized(cnf, tau, maxbuf_list.front(), static_cast<unsigned>(thread_list.front()));
+    if (bench.enabled("vig")) {
+        bench.run({"vig_naive", {{"tau", tau_str}}, 0, 0, 0, "edges"}, nothing, [&] {
+            return static_cast<uint64_t>(build_vig_naive(cnf, tau).edges.size());
+        });
+        for (unsigned long long t : thread_list) {
+            for (unsigned long long mb : maxbuf_list) {
+                bench.run({"vig_opt", {{"tau", tau_str}, {"threads", std::to_string(t)}, {"maxbuf", std::to_string(mb)}}, 0, 0, 0, "edges"},
+                          nothing, [&] {
+                              return static_cast<uint64_t>(build_vig_optimized(cnf, tau, static_cast<std::size_t>(mb), static_cast<unsigned>(t)).edges.size());
+                          });
+            }
+        }
+    }
+
+    std::vector<Edge> edges;
+    if (bench.enabled("sort")) {
+        EdgeSortOptions opt;
+        opt.method = EdgeSortMethod::Std;
+        bench.run({"edge_sort", {{"method", "std"}}, 0, 0, 0, "edges"}, [&] { edges = g.edges; }, [&] {
+            sort_edges_desc(edges, opt);
+            return static_cast<uint64_t>(edges.size());
+        });
+        opt.method = EdgeSortMethod::Radix;
+        for (unsigned long long t : thread_list) {
+            opt.threads = static_cast<unsigned>(t);
+            bench.run({"edge_sort", {{"method", "radix"}, {"threads", std::to_string(t)}}, 0, 0, 0, "edges"}, [&] { edges = g.edges; }, [&] {
+                sort_edges_desc(edges, opt);
+                return static_cast<uint64_t>(edges.size());
+            });
+        }
+    }
+
+    // Everything below runs on the VIG in segmentation order.
+    sort_edges_desc(g.edges, EdgeSortOptions{});
+    const unsigned n = g.n;
+
+    if (bench.enabled("dsu")) {
+        DisjointSets dsu;
+        // Unite the endpoints of every edge in segmentation order (the merge loop's pattern).
+        bench.run({"dsu_unite", {{"order", "sorted"}}, 0, 0, 0, "unites"}, [&] { dsu.reset(n); }, [&] {
+            for (const Edge& e : g.edges) dsu.unite(e.u, e.v);
+            return static_cast<uint64_t>(g.edges.size());
+        });
+        // The same unites in random order: no locality between consecutive calls.
+        std::vector<Edge> shuffled = g.edges;
+        SplitMix64 rng{7};
+        for (std::size_t i = shuffled.size(); i > 1; --i)
+            std::swap(shuffled[i - 1], shuffled[rng.next() % i]);
+        bench.run({"dsu_unite", {{"order", "random"}}, 0, 0, 0, "unites"}, [&] { dsu.reset(n); }, [&] {
+            for (const Edge& e : shuffled) dsu.unite(e.u, e.v);
+            return static_cast<uint64_t>(shuffled.size());
+        });
+        // Finds on the forest left by a chain of unites, before and after compression.
+        std::vector<unsigned> labels;
+        bench.run({"dsu_find", {{"pattern", "chain"}}, 0, 0, 0, "finds"}, [&] {
+            dsu.reset(n);
+            for (unsigned x = 1; x < n; ++x) dsu.unite(x - 1, x);
+        }, [&] {
+            uint64_t sum = 0;
+            for (unsigned x = 0; x < n; ++x) sum += dsu.find(x);
+            g_sink = sum;
+            return static_cast<uint64_t>(n);
+        });
+        bench.run({"dsu_flatten", {}, 0, 0, 0, "nodes"}, [&] {
+            dsu.reset(n);
+            for (const Edge& e : shuffled) dsu.unite(e.u, e.v);
+        }, [&] {
+            dsu.flatten(labels);
+            return static_cast<uint64_t>(labels.size());
+        });
+        // The parallel merge loop's pattern on ConcurrentDisjointSets per thread count:
+        // per block of edges, every thread finds the endpoints of its slice, then
+        // thread 0 unites the block with unite_serial() while the others already
+        // find in the next one. Counter: exact = 1 when every node has its root under
+        // DisjointSets::unite over the same edges.
+        DisjointSets ref(n);
+        for (const Edge& e : shuffled) ref.unite(e.u, e.v);
+        ConcurrentDisjointSets pdsu;
+        constexpr std::size_t kBlock = 16384;
+        for (const unsigned long long t : thread_list) {
+            const unsigned threads = static_cast<unsigned>(t);
+            bench.run({"dsu_concurrent", {{"threads", std::to_string(t)}}, 0, 0, 0, "edges"}, [&] { pdsu.reset(n); }, [&] {
+                std::barrier sync(threads);
+                std::vector<uint64_t> sums(threads, 0);
+                auto worker = [&](unsigned tid) {
+                    for (std::size_t lo = 0; lo < shuffled.size(); lo += kBlock) {
+                        const std::size_t hi = std::min(lo + kBlock, shuffled.size());
+                        // Slices rotate per block, so thread 0's unites overlap other threads' finds.
+                        const unsigned slot = static_cast<unsigned>((tid + lo / kBlock) % threads);
+                        const std::size_t jb = lo + ((hi - lo) * slot) / threads, je = lo + ((hi - lo) * (slot + 1)) / threads;
+                        for (std::size_t j = jb; j < je; ++j) sums[tid] += pdsu.find(shuffled[j].u) + pdsu.find(shuffled[j].v);
+                        sync.arrive_and_wait();
+                        if (tid == 0)
+                            for (std::size_t j = lo; j < hi; ++j) pdsu.unite_serial(shuffled[j].u, shuffled[j].v);
+                    }
+                };
+                std::vector<std::thread> pool;
+                for (unsigned tid = 1; tid < threads; ++tid) pool.emplace_back(worker, tid);
+                worker(0);
+                for (auto& th : pool) th.join();
+                uint64_t sum = 0;
+                for (const uint64_t x : sums) sum += x;
+                g_sink = sum;
+                return static_cast<uint64_t>(shuffled.size());
+            }, [&] {
+                DisjointSets out;
+                pdsu.copy_to(out);
+                uint64_t exact = out.components() == ref.components();
+                for (unsigned x = 0; x < n && exact; ++x) exact = out.find_no_compress(x) == ref.find_no_compress(x);
+                return std::vector<std::pair<std::string, uint64_t>>{{"exact", exact}};
+            });
+        }
+    }
+
+    // One segmentation shared by the metrics benchmarks.
+    std::vector<unsigned> labels;
+    {
+        GraphSegmenterFH seg(n, k);
+        seg.run_presorted(g.edges);
+        seg.component_labels(labels);
+    }
+    if (bench.enabled("segment")) {
+        const SegNeighbors neighbors = SegNeighbors::build(n, g.edges);
+        for (bool guard : {false, true}) {
+            GraphSegmenterFH seg;
+            GraphSegmenterFH::Config cfg = seg.config();
+            cfg.use_modularity_guard = guard;
+            cfg.candidates = CandidateStore::None;
+            seg.set_config(cfg);
+            // With the guard, the extra time is dominated by its w_ab lookups
+            // (sum_weights_to_comp), counted in `lookups`.
+            bench.run({"segment", {{"k", cli.get_string("k")}, {"modGuard", guard ? "1" : "0"}}, 0, 0, 0, "edges"},
+                      [&] { seg.reset(n, k); },
+                      [&] {
+                          seg.run_presorted(g.edges, neighbors);
+                          return static_cast<uint64_t>(g.edges.size());
+                      },
+                      [&] {
+                          return std::vector<std::pair<std::string, uint64_t>>{
+                              {"comps", seg.num_components()},
+                              {"lookups", seg.mod_guard_lookups()},
+                              {"lookupScanned", seg.mod_guard_scanned()},
+                              {"lookupProbed", seg.mod_guard_probed()}};
+                      });
+        }
+    }
+
+    if (bench.enabled("metrics")) {
+        bench.run({"modularity", {}, 0, 0, 0, "edges"}, nothing, [&] {
+            const double q = modularity(n, g.edges, [&](uint32_t v) { return labels[v]; });
+            g_sink = static_cast<uint64_t>(q * 1e9);
+            return static_cast<uint64_t>(g.edges.size());
+        });
+        std::vector<uint32_t> comp_sizes;
+        bench.run({"component_sizes", {}, 0, 0, 0, "nodes"}, nothing, [&] {
+            comp_sizes = component_sizes(n, [&](uint32_t v) { return labels[v]; });
+            return static_cast<uint64_t>(n);
+        });
+        bench.run({"summarize_components", {}, 0, 0, 0, "components"}, nothing, [&] {
+            const CompSummary cs = summarize_components(comp_sizes);
+            g_sink = static_cast<uint64_t>(cs.keff);
+            return static_cast<uint64_t>(comp_sizes.size());
+        });
+        // The fused PartitionEvaluator per thread count. Counters: exact = 1 when Q,
+        // the summary and the count equal modularity() + summarize_components() bit
+        // for bit (promised for threads=1); repeatable = 1 when a second evaluation
+        // reproduces them.
+        const double q_ref = modularity(n, g.edges, [&](uint32_t v) { return labels[v]; });
+        const CompSummary cs_ref = summarize_components(comp_sizes);
+        auto same = [](const PartitionScore& s, double q, const CompSummary& cs, std::size_t comps) -> uint64_t {
+            return s.Q == q && s.cs.K == cs.K && s.cs.N == cs.N && s.cs.keff == cs.keff && s.cs.gini == cs.gini &&
+                   s.cs.pmax == cs.pmax && s.cs.entropyJ == cs.entropyJ && s.comps == comps;
+        };
+        for (const unsigned long long t : thread_list) {
+            const PartitionEvaluator<std::vector<Edge>> evaluator(n, g.edges, static_cast<unsigned>(t));
+            PartitionEvaluator<std::vector<Edge>>::Scratch scratch;
+            PartitionScore score;
+            bench.run({"partition_eval", {{"threads", std::to_string(t)}}, 0, 0, 0, "edges"}, nothing, [&] {
+                score = evaluator.evaluate(labels, scratch);
+                return static_cast<uint64_t>(g.edges.size());
+            }, [&] {
+                const PartitionScore again = evaluator.evaluate(labels);
+                return std::vector<std::pair<std::string, uint64_t>>{
+                    {"exact", same(score, q_ref, cs_ref, comp_sizes.size())},
+                    {"repeatable", same(again, score.Q, score.cs, score.comps)}};
+            });
+        }
+    }
+
+    const std::string json_path = cli.provided("json") ? cli.get_string("json") : std::string();
+    if (!json_path.empty()) {
+        const std::vector<std::pair<std::string, std::string>> context = {
+            {"label", cli.provided("label") ? cli.get_string("label") : std::string()},
+            {"vars", std::to_string(cnf.get_variable_count())},
+            {"clauses", std::to_string(cnf.get_clause_count())},
+            {"literals", std::to_string(cnf.literal_count())},
+            {"edges", std::to_string(g.edges.size())},
+            {"size_dist", dist_name},
+            {"size_param", cli.get_string("size-param")},
+            {"min_size", std::to_string(min_size)},
+            {"max_size", std::to_string(max_size)},
+            {"seed", std::to_string(cli.get_uint64("seed"))},
+            {"hardware_threads", std::to_string(std::thread::hardware_concurrency())},
+        };
+        if (!bench.write_json(json_path, context)) {
+            std::cerr << "Failed to write JSON: " << json_path << "\n";
+            return 3;
+        }
+    }
+    return 0;
+}
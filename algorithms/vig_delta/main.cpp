@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "thesis/cli.hpp"
+#include "thesis/cnf.hpp"
+#include "thesis/numa.hpp"
+#include "thesis/partition_eval.hpp"
+#include "thesis/profile.hpp"
+#include "thesis/segmentation.hpp"
+#include "thesis/timer.hpp"
+#include "thesis/vig.hpp"
+#include "thesis/vig_delta.hpp"
+
+using namespace thesis;
+
+namespace {
+
+// One edit of a delta file: add ('a') or delete ('d') a clause.
+struct Edit {
+    bool add;
+    std::vector<int> lits;
+};
+
+// Delta file: "a <lits> 0" adds a clause, "d <lits> 0" deletes one, "s" ends a
+// step (so does end of file), "c" starts a comment. Blank lines are skipped.
+bool read_delta(const std::string& path, std::vector<std::vector<Edit>>& steps, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "cannot open delta file: " + path;
+        return false;
+    }
+    steps.assign(1, {});
+    std::string line;
+    std::size_t line_no = 0;
+    while (std::getline(in, line)) {
+        ++line_no;
+        std::istringstream ss(line);
+        std::string op;
+        if (!(ss >> op) || op[0] == 'c') continue;
+        if (op == "s") {
+            steps.emplace_back();
+            continue;
+        }
+        if (op != "a" && op != "d") {
+            error = path + ":" + std::to_string(line_no) + ": expected 'a', 'd', 's' or 'c'";
+            return false;
+        }
+        Edit e{op == "a", {}};
+        int lit = 0;
+        bool closed = false;
+        while (ss >> lit) {
+            if (lit == 0) {
+                closed = true;
+                break;
+            }
+            e.lits.push_back(lit);
+        }
+        if (!closed) {
+            error = path + ":" + std::to_string(line_no) + ": clause must end with 0";
+            return false;
+        }
+        steps.back().push_back(std::move(e));
+    }
+    if (steps.back().empty() && steps.size() > 1) steps.pop_back();
+    return true;
+}
+
+// A clause as CNF normalization leaves it (literals by variable, no repeats), or
+// empty for a tautology.
+std::vector<int> normalized(std::vector<int> lits) {
+    std::sort(lits.begin(), lits.end(), [](int a, int b) {
+        const int x = std::abs(a), y = std::abs(b);
+        return x != y ? x < y : a < b;
+    });
+    lits.erase(std::unique(lits.begin(), lits.end()), lits.end());
+    for (std::size_t i = 1; i < lits.size(); ++i)
+        if (lits[i] == -lits[i - 1]) return {};
+    return lits;
+}
+
+// Rebuild-from-scratch reference for --check: the edited formula's clauses in
+// formula order (additions at the end), so the rebuild sums pair weights in the
+// same order as the patched graph.
+class ClauseList {
+public:
+    explicit ClauseList(const CNF& cnf) {
+        for (const auto& c : cnf.clauses()) push(std::vector<int>(c.begin(), c.end()));
+    }
+
+    void add(const std::vector<int>& lits) {
+        auto c = normalized(lits);
+        if (!c.empty()) push(std::move(c));
+    }
+    // Drops the earliest live copy of the clause; false if there is none.
+    bool remove(const std::vector<int>& lits) {
+        const auto it = index_.find(normalized(lits));
+        if (it == index_.end()) return false;
+        live_[it->second.front()] = 0;
+        it->second.erase(it->second.begin());
+        if (it->second.empty()) index_.erase(it);
+        --live_count_;
+        return true;
+    }
+
+    CNF to_cnf(uint32_t n) const {
+        std::stringstream ss;
+        ss << "p cnf " << n << ' ' << live_count_ << '\n';
+        for (std::size_t i = 0; i < clauses_.size(); ++i) {
+            if (!live_[i]) continue;
+            for (const int lit : clauses_[i]) ss << lit << ' ';
+            ss << "0\n";
+        }
+        return CNF(ss, false, true, 1);
+    }
+
+private:
+    void push(std::vector<int> c) {
+        index_[c].push_back(clauses_.size());
+        clauses_.push_back(std::move(c));
+        live_.push_back(1);
+        ++live_count_;
+    }
+
+    std::vector<std::vector<int>> clauses_;
+    std::vector<unsigned char> live_;
+    std::size_t live_count_ = 0;
+    std::map<std::vector<int>, std::vector<std::size_t>> index_; // live copies by position
+};
+
+struct CheckResult {
+    double rebuild_sec = 0.0;
+    std::size_t edge_mismatch = 0;
+    double max_abs_dw = 0.0;
+    double modularity = 0.0;
+    double full_seg_sec = 0.0;
+    std::size_t full_comps = 0;
+    double full_modularity = 0.0;
+};
+
+CheckResult check_against_rebuild(const ClauseList& clauses, const MutableVIG& g,
+                                  const IncrementalSegmentation& inc, double k,
+                                  const GraphSegmenterFH::Config& cfg) {
+    CheckResult r;
+    Timer timer;
+    VIG ref = build_vig_naive(clauses.to_cnf(g.n()), g.tau());
+    r.rebuild_sec = timer.sec();
+    std::sort(ref.edges.begin(), ref.edges.end(),
+              [](const Edge& a, const Edge& b) { return a.u != b.u ? a.u < b.u : a.v < b.v; });
+
+    const VIG cur = g.to_vig();
+    std::size_t i = 0, j = 0;
+    while (i < cur.edges.size() || j < ref.edges.size()) {
+        if (j == ref.edges.size() ||
+            (i < cur.edges.size() && (cur.edges[i].u != ref.edges[j].u ? cur.edges[i].u < ref.edges[j].u
+                                                                        : cur.edges[i].v < ref.edges[j].v))) {
+            ++r.edge_mismatch;
+            ++i;
+        } else if (i == cur.edges.size() || cur.edges[i].u != ref.edges[j].u || cur.edges[i].v != ref.edges[j].v) {
+            ++r.edge_mismatch;
+            ++j;
+        } else {
+            r.max_abs_dw = std::max(r.max_abs_dw, std::abs(cur.edges[i].w - ref.edges[j].w));
+            ++i;
+            ++j;
+        }
+    }
+
+    const PartitionEvaluator<std::vector<Edge>> eval(ref.n, ref.edges);
+    r.modularity = eval.evaluate(inc.labels()).Q;
+
+    timer.reset();
+    std::vector<Edge> edges = ref.edges;
+    GraphSegmenterFH seg(ref.n, k);
+    seg.set_config(cfg);
+    seg.run(edges);
+    r.full_seg_sec = timer.sec();
+    std::vector<unsigned> labels;
+    seg.component_labels(labels);
+    r.full_comps = seg.num_components();
+    r.full_modularity = eval.evaluate(labels).Q;
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    ArgParser cli("Apply clause additions/removals to a VIG in place and re-segment only the affected components.");
+    cli.add_option(OptionSpec{.longName = "input", .shortName = 'i', .type = ArgType::String, .valueName = "FILE", .help = "Path to the base DIMACS CNF", .required = true, .defaultValue = ""});
+    cli.add_option(OptionSpec{.longName = "delta", .shortName = 'd', .type = ArgType::String, .valueName = "FILE", .help = "Clause edits: 'a|d <lits> 0' per line, 's' ends a step", .required = true, .defaultValue = ""});
+    cli.add_option(OptionSpec{.longName = "tau", .shortName = '\0', .type = ArgType::UInt64, .valueName = "N|inf", .help = "Clause size threshold; 'inf' for no limit", .required = false, .defaultValue = "inf", .allowInfToken = true});
+    cli.add_option(OptionSpec{.longName = "k", .shortName = 'k', .type = ArgType::String, .valueName = "K", .help = "Segmentation parameter k", .required = false, .defaultValue = std::to_string(GraphSegmenterFH::kDefaultK)});
+    cli.add_option(OptionSpec{.longName = "size-exp", .shortName = '\0', .type = ArgType::String, .valueName = "E", .help = "Size exponent in the gate denominator", .required = false, .defaultValue = std::to_string(GraphSegmenterFH::Config::kDefaultSizeExponent)});
+    cli.add_flag("no-mod-guard", '\0', "Disable the modularity guard");
+    cli.add_option(OptionSpec{.longName = "threads", .shortName = 't', .type = ArgType::UInt64, .valueName = "N", .help = "Threads for CNF parsing (0=auto)", .required = false, .defaultValue = "0"});
+    cli.add_flag("check", '\0', "After every step, rebuild the VIG and segment it from scratch; report the differences. "
+                                 "Also rejects deleting an absent clause whose pairs all still have clauses");
+    add_placement_option(cli);
+    profile::Session::add_options(cli);
+
+    bool proceed = true;
+    try { proceed = cli.parse(argc, argv); } catch (const std::exception& e) {
+        std::cerr << cli.usage(argv[0]) << "\n" << e.what() << "\n";
+        return 1;
+    }
+    if (!proceed) { std::cout << cli.help(argv[0]); return 0; }
+    profile::Session prof(cli);
+    if (!prof.ok()) return 1;
+    if (!apply_placement_option(cli)) return 1;
+
+    const std::string path = cli.get_string("input");
+    const unsigned tau = static_cast<unsigned>(cli.get_uint64("tau"));
+    const unsigned threads = static_cast<unsigned>(cli.get_uint64("threads"));
+    const bool check = cli.get_flag("check");
+    double k = 0.0;
+    GraphSegmenterFH::Config cfg;
+    try {
+        k = std::stod(cli.get_string("k"));
+        cfg.sizeExponent = std::stod(cli.get_string("size-exp"));
+    } catch (const std::exception&) {
+        std::cerr << "invalid --k or --size-exp value\n";
+        return 1;
+    }
+    cfg.use_modularity_guard = !cli.get_flag("no-mod-guard");
+
+    std::vector<std::vector<Edit>> steps;
+    std::string error;
+    if (!read_delta(cli.get_string("delta"), steps, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+
+    // No compaction: edits name variables by their DIMACS ids.
+    Timer timer;
+    CNF cnf(path, false, true, threads);
+    if (!cnf.is_valid()) {
+        std::cerr << "Failed to parse CNF: " << path << ": " << cnf.error() << "\n";
+        return 1;
+    }
+    const double parse_sec = timer.sec();
+    timer.reset();
+    MutableVIG g(cnf, tau);
+    const double build_sec = timer.sec();
+    timer.reset();
+    IncrementalSegmentation inc(g, k, cfg);
+    const double seg_sec = timer.sec();
+    std::unique_ptr<ClauseList> clauses;
+    if (check) clauses = std::make_unique<ClauseList>(cnf);
+
+    std::cout << "vars=" << cnf.get_variable_count() << " clauses=" << cnf.get_clause_count()
+              << " edges=" << g.edge_count() << " comps=" << inc.num_components() << " k=" << k
+              << " tau=" << (tau == std::numeric_limits<unsigned>::max() ? std::string("inf") : std::to_string(tau))
+              << " parse_sec=" << parse_sec << " build_sec=" << build_sec << " seg_sec=" << seg_sec << "\n";
+
+    for (std::size_t s = 0; s < steps.size(); ++s) {
+        std::size_t added = 0, deleted = 0, ignored = 0, pairs = 0;
+        timer.reset();
+        for (const Edit& e : steps[s]) {
+            std::size_t p = 0;
+            try {
+                p = e.add ? g.add_clause(e.lits) : g.remove_clause(e.lits);
+            } catch (const std::invalid_argument& ex) {
+                std::cerr << "step " << s + 1 << ": " << ex.what() << "\n";
+                return 1;
+            }
+            // Clauses without pairs (units, tautologies, above tau) are ignored in
+            // both modes, whether or not they are in the formula.
+            if (clauses && e.add) clauses->add(e.lits);
+            if (clauses && !e.add && !clauses->remove(e.lits) && p != 0) {
+                std::cerr << "step " << s + 1 << ": deleted clause is not in the formula\n";
+                return 1;
+            }
+            pairs += p;
+            if (p == 0) ++ignored;
+            else if (e.add) ++added;
+            else ++deleted;
+        }
+        const double update_sec = timer.sec();
+        const ResegmentStats rs = inc.update(g);
+
+        std::cout << "step=" << s + 1 << " added=" << added << " deleted=" << deleted << " ignored=" << ignored
+                  << " pairs=" << pairs << " edges=" << g.edge_count() << " update_sec=" << update_sec
+                  << " invalidated=" << rs.invalidated << " reseg_nodes=" << rs.nodes << " reseg_edges=" << rs.edges
+                  << " reseg_comps=" << rs.components << " reseg_sec=" << rs.sec << " comps=" << inc.num_components();
+        if (clauses) {
+            const CheckResult r = check_against_rebuild(*clauses, g, inc, k, cfg);
+            std::cout << " rebuild_sec=" << r.rebuild_sec << " edge_mismatch=" << r.edge_mismatch
+                      << " max_abs_dw=" << r.max_abs_dw << " modularity=" << r.modularity
+                      << " full_seg_sec=" << r.full_seg_sec << " full_comps=" << r.full_comps
+                      << " full_modularity=" << r.full_modularity;
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
@@ -2,11 +2,18 @@
 #include <string>
 #include <limits>
 #include <iomanip>
+#include <thread>
+#include <type_traits>
 #include "thesis/timer.hpp"
 #include "thesis/cli.hpp"
 #include "thesis/cnf.hpp"
 #include "thesis/vig.hpp"
+#include "thesis/neighbor_reduce.hpp"
+#include "thesis/vig_cache.hpp"
 #include "thesis/csv.hpp"
+#include "thesis/columnar.hpp"
+#include "thesis/numa.hpp"
+#include "thesis/profile.hpp"
 
 int main(int argc, char** argv) {
     using namespace thesis;
@@ -14,10 +21,23 @@ int main(int argc, char** argv) {
     cli.add_option(OptionSpec{.longName = "input", .shortName = 'i', .type = ArgType::String, .valueName = "FILE", .help = "Path to DIMACS CNF file, or '-' for stdin", .required = true});
     cli.add_option(OptionSpec{.longName = "tau", .shortName = '\0', .type = ArgType::UInt64, .valueName = "N|inf", .help = "Clause size threshold; use 'inf' for no limit", .required = false, .defaultValue = "inf", .allowInfToken = true});
     cli.add_option(OptionSpec{.longName = "maxbuf", .shortName = '\0', .type = ArgType::Size, .valueName = "BYTES", .help = "Max contributions buffer in optimized mode", .required = false, .defaultValue = "50000000"});
-    cli.add_option(OptionSpec{.longName = "threads", .shortName = 't', .type = ArgType::UInt64, .valueName = "N", .help = "Number of worker threads (0=auto)", .required = false, .defaultValue = "0"});
+    cli.add_option(OptionSpec{.longName = "mem-limit", .shortName = '\0', .type = ArgType::Size, .valueName = "BYTES", .help = "Build the VIG with the streaming builder within this working-memory budget (K/M/G suffix; replaces --maxbuf)", .required = false, .defaultValue = ""});
+    cli.add_option(OptionSpec{.longName = "spill-dir", .shortName = '\0', .type = ArgType::String, .valueName = "DIR", .help = "Directory for the streaming builder's clause spill file (default: system temp dir)", .required = false, .defaultValue = ""});
+    cli.add_option(OptionSpec{.longName = "sample-cutoff", .shortName = '\0', .type = ArgType::UInt64, .valueName = "N", .help = "Approximate clauses larger than N by sampled pairs (0 = exact)", .required = false, .defaultValue = "0"});
+    cli.add_option(OptionSpec{.longName = "sample-pairs", .shortName = '\0', .type = ArgType::UInt64, .valueName = "N", .help = "Pairs drawn per literal of each approximated clause", .required = false, .defaultValue = "16"});
+    cli.add_option(OptionSpec{.longName = "sample-seed", .shortName = '\0', .type = ArgType::UInt64, .valueName = "N", .help = "Seed of the pair sampling", .required = false, .defaultValue = "1"});
+    cli.add_option(OptionSpec{.longName = "threads", .shortName = 't', .type = ArgType::UInt64, .valueName = "N", .help = "Worker threads for CNF parsing and optimized VIG build (0=auto)", .required = false, .defaultValue = "0"});
+    cli.add_option(OptionSpec{.longName = "accum-kernel", .shortName = '\0', .type = ArgType::String, .valueName = "auto|scalar|avx2|avx512", .help = "Sort-and-reduce kernel of the optimized builder's accumulation phase", .required = false, .defaultValue = "auto"});
+    cli.add_option(OptionSpec{.longName = "accum-strategy", .shortName = '\0', .type = ArgType::String, .valueName = "auto|sort|spa|hash", .help = "Per-variable aggregation of the optimized builder (auto picks per variable)", .required = false, .defaultValue = "auto"});
+    cli.add_option(OptionSpec{.longName = "layout", .shortName = '\0', .type = ArgType::String, .valueName = "aos|soa", .help = "Edge storage: array of structs or struct of arrays", .required = false, .defaultValue = "aos"});
+    cli.add_option(OptionSpec{.longName = "weights", .shortName = '\0', .type = ArgType::String, .valueName = "double|float", .help = "Edge weight precision", .required = false, .defaultValue = "double"});
     cli.add_flag("naive", '\0', "Use naive implementation");
     cli.add_flag("opt", '\0', "Use optimized implementation");
-    cli.add_option(OptionSpec{.longName = "graph-out", .shortName = '\0', .type = ArgType::String, .valueName = "FILE", .help = "Write graph CSVs to FILE.node.csv and FILE.edges.csv", .required = false, .defaultValue = ""});
+    cli.add_option(OptionSpec{.longName = "graph-out", .shortName = '\0', .type = ArgType::String, .valueName = "FILE", .help = "Write graph CSVs to FILE.node.csv and FILE.edges.csv, or a binary graph if FILE ends in .vigb", .required = false, .defaultValue = ""});
+    cli.add_option(OptionSpec{.longName = "out-format", .shortName = '\0', .type = ArgType::String, .valueName = "csv|tcol", .help = "Node/edge file format of --graph-out (tcol: binary columnar, FILE.node.tcol and FILE.edges.tcol)", .required = false, .defaultValue = "csv"});
+    cli.add_option(OptionSpec{.longName = "vig-cache", .shortName = '\0', .type = ArgType::String, .valueName = "DIR", .help = "Reuse/store the VIG in DIR keyed on (CNF hash, tau)", .required = false, .defaultValue = ""});
+    add_placement_option(cli);
+    profile::Session::add_options(cli);
 
     bool proceed = true;
     try {
@@ -30,82 +50,204 @@ int main(int argc, char** argv) {
         std::cout << cli.help(argv[0]);
         return 0;
     }
+    profile::Session prof(cli);
+    if (!prof.ok()) return 1;
+    if (!apply_placement_option(cli)) return 1;
 
     std::string path = cli.get_string("input");
     unsigned tau = static_cast<unsigned>(cli.get_uint64("tau"));
     size_t maxbuf = cli.get_size("maxbuf");
     unsigned threads = static_cast<unsigned>(cli.get_uint64("threads"));
+    const std::string layout = cli.get_string("layout");
+    const std::string weights = cli.get_string("weights");
+    if ((layout != "aos" && layout != "soa") || (weights != "double" && weights != "float")) {
+        std::cerr << "--layout must be aos|soa and --weights double|float\n";
+        return 1;
+    }
+    NeighborKernel accum_kernel;
+    if (!parse_neighbor_kernel(cli.get_string("accum-kernel"), accum_kernel)) {
+        std::cerr << "--accum-kernel must be auto|scalar|avx2|avx512\n";
+        return 1;
+    }
+    if (!neighbor_kernel_supported(accum_kernel)) {
+        std::cerr << "--accum-kernel " << neighbor_kernel_name(accum_kernel) << " is not supported on this CPU/build\n";
+        return 1;
+    }
+    set_neighbor_kernel(accum_kernel);
+    NeighborAccumulator accum_strategy;
+    if (!parse_neighbor_accumulator(cli.get_string("accum-strategy"), accum_strategy)) {
+        std::cerr << "--accum-strategy must be auto|sort|spa|hash\n";
+        return 1;
+    }
+    set_neighbor_accumulator(accum_strategy);
     bool use_naive = cli.get_flag("naive");
     bool use_opt = cli.get_flag("opt");
     if (!use_naive && !use_opt) use_opt = true; // default
+    const size_t mem_limit = cli.provided("mem-limit") ? cli.get_size("mem-limit") : 0;
+    const std::string spill_dir = cli.provided("spill-dir") ? cli.get_string("spill-dir") : std::string();
+    if (mem_limit != 0 && (use_naive || cli.provided("maxbuf"))) {
+        std::cerr << "--mem-limit selects the streaming optimized builder; drop --naive/--maxbuf\n";
+        return 1;
+    }
+    HugeClauseSampling sampling;
+    sampling.cutoff = static_cast<unsigned>(cli.get_uint64("sample-cutoff"));
+    sampling.pairs_per_literal = static_cast<size_t>(cli.get_uint64("sample-pairs"));
+    sampling.seed = cli.get_uint64("sample-seed");
+    if (sampling.cutoff != 0 && (use_naive || mem_limit != 0 || cli.provided("vig-cache") || sampling.pairs_per_literal == 0)) {
+        std::cerr << "--sample-cutoff needs the in-memory optimized builder without --vig-cache, and --sample-pairs > 0\n";
+        return 1;
+    }
 
     Timer t_total; // start total before parsing
     Timer t_parse;
-    CNF cnf = (path == "-") ? CNF(std::cin, /*variable_compaction=*/true)
-                             : CNF(path, /*variable_compaction=*/true);
+    CNF cnf = (path == "-") ? CNF(std::cin, /*variable_compaction=*/true, /*normalize=*/true, threads)
+                             : CNF(path, /*variable_compaction=*/true, /*normalize=*/true, threads);
     const double sec_parse = t_parse.sec();
     if (!cnf.is_valid()) {
-        std::cerr << "Failed to parse CNF: " << path << "\n";
+        std::cerr << "Failed to parse CNF: " << path << ": " << cnf.error() << "\n";
         return 2;
     }
+    const unsigned clause_count = cnf.get_clause_count(); // --mem-limit consumes the CNF
 
-    Timer t_build;
-    VIG g;
-    if (use_naive) {
-        g = build_vig_naive(cnf, tau);
-    } else {
-        if (threads == 0) {
-            g = build_vig_optimized(cnf, tau, maxbuf);
-        } else {
-            g = build_vig_optimized(cnf, tau, maxbuf, threads);
-        }
+    const std::string cache_dir = cli.provided("vig-cache") ? cli.get_string("vig-cache") : std::string();
+    const std::string graph_path = cli.provided("graph-out") ? cli.get_string("graph-out") : std::string();
+    const bool write_vigb_out = graph_path.size() > 5 && graph_path.compare(graph_path.size() - 5, 5, ".vigb") == 0;
+    const uint64_t cnf_hash = (!cache_dir.empty() || write_vigb_out) ? cnf_fingerprint(cnf) : 0;
+    const std::string out_format = cli.get_string("out-format");
+    if (out_format != "csv" && out_format != "tcol") {
+        std::cerr << "Invalid out-format (use csv|tcol)\n";
+        return 1;
     }
-    const double sec_build = t_build.sec();
-    const double sec_total = t_total.sec();
+    const bool tcol_out = out_format == "tcol";
 
-    if (cli.provided("graph-out")) {
-        const std::string graph_path = cli.get_string("graph-out");
-        if (graph_path.empty()) {
-            std::cerr << "--graph-out requires a file path\n";
-            return 3;
-        }
-        const std::string nodes_path = graph_path + ".node.csv";
-        const std::string edges_path = graph_path + ".edges.csv";
+    const bool soa = (layout == "soa");
+    const bool f32 = (weights == "float");
+    if (sampling.cutoff != 0 && write_vigb_out) {
+        std::cerr << "--sample-cutoff graphs are approximate; write them as CSV, not .vigb\n";
+        return 1;
+    }
+    if ((soa || f32) && (!cache_dir.empty() || write_vigb_out)) {
+        std::cerr << "--vig-cache and .vigb output need the default layout (--layout aos --weights double)\n";
+        return 1;
+    }
 
-        CSVWriter ncsv(nodes_path);
-        if (!ncsv.is_open()) {
-            std::cerr << "Failed to open nodes output file: " << nodes_path << "\n";
-            return 3;
+    // Everything after parsing is generic over the VIG layout.
+    auto run = [&]<class G>(std::type_identity<G>) -> int {
+        Timer t_build;
+        G g;
+        bool cache_hit = false;
+        HugeClauseStats sampled;
+        if constexpr (std::is_same_v<G, VIG>)
+            cache_hit = !cache_dir.empty() && vig_cache_load(cache_dir, cnf_hash, tau, g);
+        if (!cache_hit) {
+            if (use_naive) {
+                g = build_vig_naive<G>(cnf, tau);
+            } else {
+                const unsigned hc = std::thread::hardware_concurrency();
+                const unsigned build_threads = threads == 0 ? (hc ? hc : 1u) : threads;
+                if (mem_limit == 0) {
+                    g = build_vig_optimized<G>(cnf, tau, maxbuf, build_threads, sampling, &sampled);
+                } else {
+                    try {
+                        g = build_vig_streaming<G>(std::move(cnf), tau, mem_limit, build_threads, spill_dir);
+                    } catch (const std::exception& e) {
+                        std::cerr << "Streaming VIG build failed: " << e.what() << "\n";
+                        return 3;
+                    }
+                }
+            }
         }
-        CSVWriter ecsv(edges_path);
-        if (!ecsv.is_open()) {
-            std::cerr << "Failed to open edges output file: " << edges_path << "\n";
-            return 3;
+        const double sec_build = t_build.sec();
+        const double sec_total = t_total.sec();
+
+        if constexpr (std::is_same_v<G, VIG>) {
+            if (!cache_dir.empty() && !cache_hit && !vig_cache_store(cache_dir, cnf_hash, tau, g)) {
+                std::cerr << "Failed to store VIG in cache: " << cache_dir << "\n";
+                return 3;
+            }
         }
 
-        // Nodes CSV: id
-        ncsv.header("id");
-        for (unsigned v = 0; v < g.n; ++v) {
-            ncsv.row(v);
+        if (cli.provided("graph-out")) {
+            if (graph_path.empty()) {
+                std::cerr << "--graph-out requires a file path\n";
+                return 3;
+            }
         }
+        if (write_vigb_out) {
+            if constexpr (std::is_same_v<G, VIG>) {
+                canonicalize_edges(g);
+                if (!write_vigb(graph_path, g, tau, cnf_hash)) {
+                    std::cerr << "Failed to write binary graph: " << graph_path << "\n";
+                    return 3;
+                }
+            }
+        } else if (cli.provided("graph-out") && tcol_out) {
+            const std::string nodes_path = graph_path + ".node.tcol";
+            const std::string edges_path = graph_path + ".edges.tcol";
+            using W = std::remove_cvref_t<decltype(edge_at(g.edges, 0).w)>;
+            ColumnarWriter nout(nodes_path, g.n, {{"id", TcolType::U32}});
+            ColumnarWriter eout(edges_path, edge_count(g.edges), {{"u", TcolType::U32}, {"v", TcolType::U32}, {"w", tcol_type_of<W>()}});
+            if (!nout.is_open() || !eout.is_open()) {
+                std::cerr << "Failed to open graph output files: " << nodes_path << ", " << edges_path << "\n";
+                return 3;
+            }
+            nout.column<uint32_t>([](uint64_t i) { return i; });
+            eout.column<uint32_t>([&](uint64_t i) { return edge_at(g.edges, i).u; });
+            eout.column<uint32_t>([&](uint64_t i) { return edge_at(g.edges, i).v; });
+            eout.column<W>([&](uint64_t i) { return edge_at(g.edges, i).w; });
+            if (!nout.close() || !eout.close()) {
+                std::cerr << "Failed to write graph output files: " << nodes_path << ", " << edges_path << "\n";
+                return 3;
+            }
+        } else if (cli.provided("graph-out")) {
+            const std::string nodes_path = graph_path + ".node.csv";
+            const std::string edges_path = graph_path + ".edges.csv";
+
+            CSVWriter ncsv(nodes_path);
+            if (!ncsv.is_open()) {
+                std::cerr << "Failed to open nodes output file: " << nodes_path << "\n";
+                return 3;
+            }
+            CSVWriter ecsv(edges_path);
+            if (!ecsv.is_open()) {
+                std::cerr << "Failed to open edges output file: " << edges_path << "\n";
+                return 3;
+            }
+
+            // Nodes CSV: id
+            ncsv.header("id");
+            for (unsigned v = 0; v < g.n; ++v) {
+                ncsv.row(v);
+            }
 
-        // Edges CSV: u,v,w
-        ecsv.header("u", "v", "w");
-        for (const auto& e : g.edges) {
-            ecsv.row(e.u, e.v, e.w);
+            // Edges CSV: u,v,w
+            ecsv.header("u", "v", "w");
+            for_each_edge(g.edges, [&](uint32_t u, uint32_t v, auto w) { ecsv.row(u, v, w); });
         }
-    }
 
-    std::cout << "vars=" << g.n
-                        << " clauses=" << cnf.get_clause_count()
-                        << " edges=" << g.edges.size()
-                        << " parse_sec=" << sec_parse
-                        << " vig_build_sec=" << sec_build
-                        << " total_sec=" << sec_total
-                        << " impl=" << (use_naive ? "naive" : "opt")
-                        << " tau=" << (tau == std::numeric_limits<unsigned>::max() ? -1 : (int)tau)
-                        << " threads=" << (use_naive ? 1 : (threads == 0 ? -1 : (int)threads))
-                        << " agg_memory=" << g.aggregation_memory
-                        << "\n";
-    return 0;
+        std::cout << "vars=" << g.n
+                            << " clauses=" << clause_count
+                            << " edges=" << edge_count(g.edges)
+                            << " parse_sec=" << sec_parse
+                            << " vig_build_sec=" << sec_build
+                            << " total_sec=" << sec_total
+                            << " impl=" << (use_naive ? "naive" : (mem_limit ? "stream" : "opt"))
+                            << " tau=" << (tau == std::numeric_limits<unsigned>::max() ? -1 : (int)tau)
+                            << " threads=" << (use_naive ? 1 : (threads == 0 ? -1 : (int)threads))
+                            << " agg_memory=" << g.aggregation_memory
+                            << " layout=" << (soa ? "soa" : "aos")
+                            << " weights=" << (f32 ? "float" : "double")
+                            << " edge_bytes=" << edge_storage_bytes(g.edges)
+                            << " accum_sec=" << g.accum_sec
+                            << " accum_kernel=" << neighbor_kernel_name(active_neighbor_kernel());
+        if (!cache_dir.empty()) std::cout << " vig_cache=" << (cache_hit ? "hit" : "miss");
+        if (sampling.cutoff != 0)
+            std::cout << " sampled_clauses=" << sampled.clauses << " sampled_pairs=" << sampled.pairs_drawn
+                      << " replaced_pairs=" << sampled.pairs_replaced;
+        std::cout << "\n";
+        return 0;
+    };
+
+    if (soa) return f32 ? run(std::type_identity<VIGColumns>{}) : run(std::type_identity<VIGColumnsD>{});
+    return f32 ? run(std::type_identity<VIGF>{}) : run(std::type_identity<VIG>{});
 }
@@ -45,7 +45,7 @@ public:
 	std::string get_string(const std::string& longName) const;
 	long long get_int64(const std::string& longName) const;
 	unsigned long long get_uint64(const std::string& longName) const;
-	std::size_t get_size(const std::string& longName) const;
+	std::size_t get_size(const std::string& longName) const; // accepts a K/M/G/T (binary) suffix
 	bool get_flag(const std::string& longName) const;
 
 	// Usage/help renderers.
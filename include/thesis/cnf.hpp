@@ -1,212 +1,153 @@
 #pragma once
 
-#include <vector>
-#include <string>
-#include <fstream>
-#include <iostream>
-#include <cstdlib>   // std::atoi, std::abs
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <istream>
-#include <algorithm>
+#include <span>
+#include <string>
+#include <vector>
 
 namespace thesis {
 
+class DecompressingReader;
+
+// Read-only view of one clause: its literals in DIMACS encoding (no terminating 0).
+using ClauseView = std::span<const int>;
+
+// Random-access view over all clauses of a CNF stored in CSR form
+// (one flat literal array plus clause_count+1 offsets). Cheap to copy.
+class ClauseRange {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = ClauseView;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = ClauseView;
+
+    iterator() = default;
+    iterator(const int *lits, const std::size_t *off) : lits_(lits), off_(off) {}
+
+    ClauseView operator*() const { return ClauseView(lits_ + off_[0], off_[1] - off_[0]); }
+    ClauseView operator[](difference_type i) const { return *(*this + i); }
+    iterator &operator++() { ++off_; return *this; }
+    iterator operator++(int) { iterator t = *this; ++off_; return t; }
+    iterator &operator--() { --off_; return *this; }
+    iterator operator--(int) { iterator t = *this; --off_; return t; }
+    iterator &operator+=(difference_type d) { off_ += d; return *this; }
+    iterator &operator-=(difference_type d) { off_ -= d; return *this; }
+    friend iterator operator+(iterator it, difference_type d) { return it += d; }
+    friend iterator operator+(difference_type d, iterator it) { return it += d; }
+    friend iterator operator-(iterator it, difference_type d) { return it -= d; }
+    friend difference_type operator-(const iterator &a, const iterator &b) { return a.off_ - b.off_; }
+    friend bool operator==(const iterator &a, const iterator &b) { return a.off_ == b.off_; }
+    friend auto operator<=>(const iterator &a, const iterator &b) { return a.off_ <=> b.off_; }
+
+  private:
+    const int *lits_ = nullptr;
+    const std::size_t *off_ = nullptr;
+  };
+
+  ClauseRange() = default;
+  ClauseRange(const int *lits, const std::size_t *offsets, std::size_t count)
+      : lits_(lits), off_(offsets), count_(count) {}
+
+  std::size_t size() const { return count_; }
+  bool empty() const { return count_ == 0; }
+  ClauseView operator[](std::size_t i) const { return ClauseView(lits_ + off_[i], off_[i + 1] - off_[i]); }
+  iterator begin() const { return iterator(lits_, off_); }
+  iterator end() const { return iterator(lits_, off_ + count_); }
+
+private:
+  const int *lits_ = nullptr;
+  const std::size_t *off_ = nullptr;
+  std::size_t count_ = 0;
+};
+
 // Parses a DIMACS CNF file and loads its clauses.
 // Optional variable compaction remaps variable indices to a dense range [1..k].
+//
+// Storage is a flat clause arena: `literals` holds every literal back to back and
+// clause i spans [clause_offsets[i], clause_offsets[i+1]). Files are memory-mapped
+// and scanned in a single pass; clauses may span several lines and comment lines may
+// appear anywhere. A '%' token ends the clause section (SATLIB convention).
+// gzip, xz and bzip2 files/streams are recognised by their magic bytes and
+// decompressed on the fly (when the library was found at build time).
+// Large inputs can be parsed, compacted and normalized on several threads.
+// A failed parse leaves is_valid() false and the reason in error(); nothing is
+// printed, so each caller reports it on its own stream.
 class CNF {
 private:
   bool valid = false;
+  std::string error_message;
   unsigned int variable_count = 0;
   unsigned int clause_count = 0;
-  std::vector<std::vector<int>> clauses;
-  
-  void reset() {
-    valid = false;
-    variable_count = 0;
-    clause_count = 0;
-    clauses.clear();
-  }
+  std::vector<int> literals;
+  std::vector<std::size_t> clause_offsets{0};
+
+  void reset();
 
   // Internal: perform variable compaction on current clauses/data.
-  void do_compact_variables() {
-    // Remap variable indices to a dense range starting at 1, preserving sign.
-    std::vector<int> variable_map(variable_count, 0);
-    unsigned int current_renamed_variable = 1;
-    for (size_t c_idx = 0; c_idx < clauses.size(); c_idx++) {
-      auto &clause = clauses[c_idx];
-      for (size_t l_idx = 0; l_idx < clause.size(); l_idx++) {
-        int literal = clause[l_idx];
-        unsigned int var_idx = static_cast<unsigned int>(std::abs(literal)) - 1;
-        if (var_idx >= variable_map.size()) {
-          // Extend map if the file declared fewer variables than used
-          variable_map.resize(var_idx + 1, 0);
-        }
-        if (variable_map[var_idx] == 0) {
-          variable_map[var_idx] = current_renamed_variable++;
-        }
-        int literal_sign = (literal < 0) ? -1 : 1;
-        clause[l_idx] = literal_sign * variable_map[var_idx];
-      }
-    }
-    variable_count = current_renamed_variable - 1;
-  }
+  // Runs on up to num_threads threads (0 = hardware concurrency); the result does not
+  // depend on the thread count.
+  void do_compact_variables(unsigned num_threads = 1);
 
   // Internal: normalize clauses (sort by abs(var), dedup, drop tautologies/empties) and
-  // update clause_count accordingly.
-  void do_normalize_clauses() {
-    std::vector<std::vector<int>> normalized;
-    normalized.reserve(clauses.size());
-
-    for (auto &clause : clauses) {
-      if (clause.empty()) continue; // Skip empty
-
-      std::sort(clause.begin(), clause.end(), [](int a, int b) {
-        int aa = std::abs(a), bb = std::abs(b);
-        if (aa != bb) return aa < bb;
-        return a < b; // tie-break for deterministic order
-      });
-
-      std::vector<int> out;
-      out.reserve(clause.size());
-      bool taut = false;
-
-      int prev_abs = 0;
-      int prev_sign = 0;
-      bool has_prev = false;
-      for (int lit : clause) {
-        const int a = std::abs(lit);
-        const int s = (lit < 0) ? -1 : 1;
-        if (has_prev && a == prev_abs) {
-          if (s != prev_sign) { taut = true; break; } // literal and its negation present
-          // duplicate with same sign, skip
-          continue;
-        }
-        // new variable (by abs)
-        out.push_back(lit);
-        prev_abs = a; prev_sign = s; has_prev = true;
-      }
-
-      if (!taut && !out.empty()) {
-        normalized.push_back(std::move(out));
-      }
-    }
-
-    clauses.swap(normalized);
-    clause_count = static_cast<unsigned int>(clauses.size());
-  }
+  // update clause_count accordingly. Parallel like do_compact_variables.
+  void do_normalize_clauses(unsigned num_threads = 1);
 
-  bool parse_stream(std::istream& file, bool variable_compaction, bool normalize) {
-    reset();
-
-    std::string line;
-
-    // Skip comment lines (starting with 'c') and blank lines
-    while (std::getline(file, line)) {
-      if (!line.empty() && line[0] != 'c')
-        break;
-    }
-
-    // Parse the 'p cnf' line
-    if (!line.empty() && line[0] == 'p') {
-      const char *str = line.c_str();
-      while (*str && (*str != ' ')) ++str; // Skip 'p'
-      if (*str == ' ') ++str;              // Skip space
-      while (*str && (*str != ' ')) ++str; // Skip 'cnf'
-      variable_count = std::atoi(++str);
-      while (*str && (*str != ' ')) ++str; // Skip to clause count
-      clause_count = std::atoi(++str);
-
-      clauses.reserve(clause_count);
-    } else {
-      std::cerr << "Error: No valid problem line (starting with 'p') found." << std::endl;
-      return false;
-    }
-
-    // Read and parse the clauses
-    while (std::getline(file, line)) {
-      if (line.empty()) continue;
-      const char *str = line.c_str();
-      if (*str == 'c') continue; // comment line
-
-      while (*str && *str == ' ') { // Skip possible initial whitespace
-        ++str;
-      }
-
-      const char *str_cursor = str;
-      std::vector<int> clause;
-      size_t clause_length = 0;
-
-      // First pass: count literals to reserve
-      while (*str_cursor) {
-        if (*str_cursor == '0') break;
-        ++clause_length;
-        while (*str_cursor && *str_cursor != ' ') ++str_cursor; // end of label
-        while (*str_cursor && *str_cursor == ' ') ++str_cursor; // next label
-      }
-
-      str_cursor = str;
-      clause.reserve(clause_length);
-
-      // Second pass: parse literals
-      while (*str_cursor) {
-        if (*str_cursor == '0') break; // Clause end
-        int literal = std::atoi(str_cursor);
-        clause.push_back(literal);
-        while (*str_cursor && *str_cursor != ' ') ++str_cursor; // end of label
-        while (*str_cursor && *str_cursor == ' ') ++str_cursor; // next label
-      }
-
-      if (!clause.empty()) {
-        clauses.push_back(std::move(clause));
-      }
-    }
-
-    // Perform optional variable compaction first
-    valid = true; // We'll normalize and set clause_count to actual retained clauses
-
-    if (variable_compaction) {
-      do_compact_variables();
-    }
-
-    // Normalize all clauses and update clause_count if requested
-    if (valid && normalize) {
-      do_normalize_clauses();
-    }
-    return valid;
-  }
+  // Split clauses into `parts` contiguous ranges of similar literal count
+  // (returns parts+1 clause indices).
+  std::vector<std::size_t> clause_partition(unsigned parts) const;
 
-public:
-  CNF(std::istream& in, bool variable_compaction = true, bool normalize = true) {
-    parse_stream(in, variable_compaction, normalize);
-  }
+  bool parse_buffer(const char *begin, const char *end, bool variable_compaction, bool normalize,
+                    unsigned num_threads);
+  // Incremental parse of decompressed blocks (compressed inputs).
+  bool parse_stream(DecompressingReader &reader, bool variable_compaction, bool normalize, unsigned num_threads);
+  // Shared tail of both parsers: fix variable_count, then compact/normalize.
+  bool finalize(std::uint64_t max_var, bool variable_compaction, bool normalize, unsigned num_threads);
 
-  CNF(const std::string &file_path, bool variable_compaction = true, bool normalize = true) {
-    std::ifstream file(file_path);
-    if (!file.is_open()) {
-      std::cerr << "Error: Could not open the file!" << std::endl;
-      return;
-    }
-    parse_stream(file, variable_compaction, normalize);
-  }
+public:
+  // num_threads: parser threads (0 = hardware concurrency). Small inputs are parsed
+  // serially regardless; the parsed CNF is identical for every thread count.
+  CNF(std::istream &in, bool variable_compaction = true, bool normalize = true, unsigned num_threads = 1);
+  CNF(const std::string &file_path, bool variable_compaction = true, bool normalize = true,
+      unsigned num_threads = 1);
 
   bool is_valid() const { return valid; }
-  const std::vector<std::vector<int>> &get_clauses() const { return clauses; }
+  const std::string &error() const { return error_message; }
   unsigned int get_variable_count() const { return variable_count; }
   unsigned int get_clause_count() const { return clause_count; }
 
+  // Clause access (views stay valid while the CNF is alive and unmodified).
+  ClauseRange clauses() const {
+    return ClauseRange(literals.data(), clause_offsets.data(), clause_offsets.size() - 1);
+  }
+  ClauseView clause(std::size_t i) const {
+    return ClauseView(literals.data() + clause_offsets[i], clause_offsets[i + 1] - clause_offsets[i]);
+  }
+  std::size_t literal_count() const { return literals.size(); }
+
+  // Raw CSR arrays, for consumers that want to work on the arena directly.
+  const std::vector<int> &get_literals() const { return literals; }
+  const std::vector<std::size_t> &get_clause_offsets() const { return clause_offsets; }
+
   // Public API: perform variable compaction on the current CNF.
   // Maintains backward compatibility: constructors already call this when requested.
   // Idempotent: calling multiple times leaves the CNF in a compacted state.
-  void compact_variables() {
+  void compact_variables(unsigned num_threads = 1) {
     if (!valid) return;
-    do_compact_variables();
+    do_compact_variables(num_threads);
   }
 
   // Public API: normalize clauses (sort, deduplicate, drop tautologies/empties).
   // Updates clause_count to the number of retained clauses.
   // Idempotent: calling multiple times has no further effect.
-  void normalize_clauses() {
+  void normalize_clauses(unsigned num_threads = 1) {
     if (!valid) return;
-    do_normalize_clauses();
+    do_normalize_clauses(num_threads);
   }
 };
 
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace thesis {
+
+// ------------------------------------------------------------------
+// Binary columnar table format (.tcol), version 1. Used for the graph,
+// node and cross-edge outputs so scripts can load them without parsing text
+// (scripts/benchmarks/tcol_utils.py reads it with the standard library).
+//
+//   TcolHeader                  (32 bytes)
+//   TcolColumn  columns[column_count]   (32 bytes each)
+//   column data, one column after the other: row_count values of its type,
+//   zero-padded to a multiple of 8 bytes
+//
+// Native byte order; `endian_tag` lets readers reject files from a machine of
+// the other endianness.
+// ------------------------------------------------------------------
+enum class TcolType : uint32_t { U32 = 1, U64 = 2, F32 = 3, F64 = 4 };
+
+struct TcolHeader {
+    static constexpr char kMagic[8] = {'T', 'H', 'T', 'C', 'O', 'L', '\0', '\n'};
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kEndianTag = 0x01020304u;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t endian_tag;
+    uint32_t column_count;
+    uint32_t reserved;
+    uint64_t row_count;
+};
+static_assert(sizeof(TcolHeader) == 32, "TcolHeader layout must stay fixed");
+
+struct TcolColumn {
+    char name[24]; // NUL-padded, at most 23 characters
+    TcolType type;
+    uint32_t reserved;
+};
+static_assert(sizeof(TcolColumn) == 32, "TcolColumn layout must stay fixed");
+
+template <class T>
+constexpr TcolType tcol_type_of() {
+    if constexpr (std::is_same_v<T, uint32_t>) return TcolType::U32;
+    else if constexpr (std::is_same_v<T, uint64_t>) return TcolType::U64;
+    else if constexpr (std::is_same_v<T, float>) return TcolType::F32;
+    else {
+        static_assert(std::is_same_v<T, double>, "unsupported .tcol column type");
+        return TcolType::F64;
+    }
+}
+
+// Streams a .tcol file with a known row count: the constructor writes the
+// header and column table, then column<T>() writes each column in table order
+// from value_of(i), i = 0 .. rows-1, through a fixed chunk buffer.
+class ColumnarWriter {
+public:
+    struct Spec {
+        std::string name;
+        TcolType type;
+    };
+
+    ColumnarWriter(const std::string& path, uint64_t rows, const std::vector<Spec>& columns);
+    ~ColumnarWriter();
+
+    ColumnarWriter(const ColumnarWriter&) = delete;
+    ColumnarWriter& operator=(const ColumnarWriter&) = delete;
+
+    bool is_open() const { return static_cast<bool>(out_); }
+
+    // Write the next column; T must match its declared type.
+    template <class T, class Fn>
+    void column(Fn&& value_of) {
+        if (!begin_column(tcol_type_of<T>())) return;
+        constexpr std::size_t kChunk = (std::size_t{1} << 16) / sizeof(T);
+        T chunk[kChunk];
+        std::size_t k = 0;
+        for (uint64_t i = 0; i < rows_; ++i) {
+            chunk[k++] = static_cast<T>(value_of(i));
+            if (k == kChunk) {
+                write_bytes(chunk, k * sizeof(T));
+                k = 0;
+            }
+        }
+        write_bytes(chunk, k * sizeof(T));
+        end_column(rows_ * sizeof(T));
+    }
+
+    // Flush and close; false on an I/O error or if not every column was written.
+    bool close();
+
+private:
+    std::ofstream out_{};
+    uint64_t rows_ = 0;
+    std::vector<TcolType> types_{};
+    std::size_t next_ = 0;
+
+    bool begin_column(TcolType type);
+    void end_column(uint64_t bytes);
+    void write_bytes(const void* p, std::size_t n);
+};
+
+} // namespace thesis
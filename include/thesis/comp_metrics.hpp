@@ -13,6 +13,7 @@
 //  - Time: O(N + K log K), Memory: O(N) worst-case for counting array.
 
 #include <vector>
+#include <cstddef>
 #include <cstdint>
 
 namespace thesis {
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "thesis/disjoint_set.hpp"
+
+namespace thesis {
+
+// Disjoint sets whose find() may run on many threads at once, for the parallel
+// find/gate prefetch of the segmentation merge loop: parent links are atomics
+// and find() does path halving with CAS. Unions come from one thread at a time
+// (unite_serial()), concurrently with those finds.
+// Indices are 0..n-1; reset()/assign() must not race with anything else.
+class ConcurrentDisjointSets {
+public:
+    explicit ConcurrentDisjointSets(std::size_t n = 0);
+
+    // Reset to n singleton sets.
+    void reset(std::size_t n);
+    // Take over the forest of `s` (same roots, ranks and component count).
+    void assign(const DisjointSets& s);
+    // Write the forest back into `s`; its roots are the roots of this forest.
+    void copy_to(DisjointSets& s) const;
+
+    std::size_t size() const { return n_; }
+
+    // Representative of x. Halves the path with CAS; safe under concurrent
+    // find() calls from any number of threads and one unite_serial() caller.
+    unsigned find(unsigned x);
+
+    // Union with the root choice of DisjointSets::unite (by rank, the first
+    // argument wins ties), so a single linking thread reproduces the sequential
+    // forest's roots exactly. Safe alongside concurrent find(), but links must
+    // come from one thread at a time.
+    unsigned unite_serial(unsigned a, unsigned b);
+
+    unsigned components() const { return comp_count_.load(std::memory_order_relaxed); }
+
+private:
+    std::size_t n_ = 0;
+    std::unique_ptr<std::atomic<unsigned>[]> parent_;
+    std::vector<unsigned char> rank_;
+    std::atomic<unsigned> comp_count_{0};
+};
+
+} // namespace thesis
@@ -1,9 +1,9 @@
 #pragma once
 
+#include <charconv>
+#include <cstddef>
 #include <fstream>
 #include <initializer_list>
-#include <ios>
-#include <iomanip>
 #include <sstream>
 #include <string>
 #include <string_view>
@@ -14,13 +14,23 @@
 namespace thesis {
 
 // Lightweight CSV writer with basic quoting and numeric formatting.
+//
+// Rows are formatted with std::to_chars straight into one reusable buffer and
+// written with a single write() per kBufferSize bytes; the typed (variadic)
+// row() allocates nothing per row. Floating-point cells match the stream
+// formatting of earlier versions (printf %.Nf when fixed, %.Ng otherwise).
 class CSVWriter {
 public:
+    static constexpr std::size_t kBufferSize = std::size_t{1} << 20;
+
     // If fixedFloat is true, floating point values are written with fixed and the given precision.
-    // Otherwise default stream formatting is used.
+    // Otherwise the shortest general form with that many significant digits is used.
     explicit CSVWriter(const std::string& filePath, bool fixedFloat = true, int precision = 17);
     ~CSVWriter();
 
+    CSVWriter(const CSVWriter&) = delete;
+    CSVWriter& operator=(const CSVWriter&) = delete;
+
     bool is_open() const { return static_cast<bool>(ofs_); }
     void close();
 
@@ -31,48 +41,91 @@ public:
     // Write a row from pre-formatted string cells.
     void row(const std::vector<std::string>& cells);
 
-    // Convenience variadic row/header with automatic formatting.
+    // Typed row/header: each value is formatted in place (see cell()).
     template <typename... Ts>
     void row(const Ts&... values) {
-        std::vector<std::string> cells;
-        cells.reserve(sizeof...(Ts));
-        (cells.emplace_back(to_string(values)), ...);
-        row(cells);
+        if (!ofs_) return;
+        bool first = true;
+        auto one = [&](const auto& v) {
+            if (!first) put(',');
+            first = false;
+            cell(v);
+        };
+        (one(values), ...);
+        put('\n');
     }
 
     template <typename... Ts>
     void header(const Ts&... names) {
-        std::vector<std::string> cols;
-        cols.reserve(sizeof...(Ts));
-        (cols.emplace_back(std::string(names)), ...);
-        header(cols);
+        if (!ofs_) return;
+        bool first = true;
+        auto one = [&](std::string_view name) {
+            if (!first) put(',');
+            first = false;
+            text(name);
+        };
+        (one(std::string_view(names)), ...);
+        put('\n');
     }
 
 private:
+    // Longest cell cell() formats without a bounds check: a fixed-format double
+    // (up to 309 integer digits) plus the fraction.
+    static constexpr std::size_t kMaxNumberChars = 352;
+
     std::ofstream ofs_{};
     bool fixedFloat_ = true;
     int precision_ = 17;
+    std::vector<char> buf_;
+    std::size_t len_ = 0;
 
-    static bool needs_quoting(std::string_view s);
-    static std::string escape_cell(std::string_view s);
+    void flush_buffer();
+    char* reserve(std::size_t n) {
+        if (buf_.size() - len_ < n) flush_buffer();
+        return buf_.data() + len_;
+    }
+    void put(char c) { *reserve(1) = c; ++len_; }
+    void raw(std::string_view s);
+    // String cell, quoted when it holds a separator, quote, newline or edge space.
+    void text(std::string_view s);
 
     template <typename T>
-    std::string to_string(const T& v) const {
-        if constexpr (std::is_same_v<T, std::string>) {
-            return v;
-        } else if constexpr (std::is_same_v<T, const char*>) {
-            return std::string(v);
-        } else if constexpr (std::is_same_v<T, char*>) {
-            return std::string(v);
-        } else if constexpr (std::is_floating_point_v<T>) {
-            std::ostringstream oss;
-            if (fixedFloat_) oss.setf(std::ios::fixed, std::ios::floatfield);
-            oss << std::setprecision(precision_) << v;
-            return std::move(oss).str();
+    void number(const T& v) {
+        char* p = reserve(kMaxNumberChars);
+        std::to_chars_result r;
+        if constexpr (std::is_floating_point_v<T>) {
+            if (precision_ < 0 || precision_ > 32) {
+                // Out of to_chars' bounded range: fall back to the stream.
+                std::ostringstream oss;
+                if (fixedFloat_) oss.setf(std::ios::fixed, std::ios::floatfield);
+                oss.precision(precision_);
+                oss << v;
+                raw(oss.str());
+                return;
+            }
+            r = std::to_chars(p, p + kMaxNumberChars, v,
+                              fixedFloat_ ? std::chars_format::fixed : std::chars_format::general, precision_);
+        } else {
+            r = std::to_chars(p, p + kMaxNumberChars, v);
+        }
+        len_ += static_cast<std::size_t>(r.ptr - p);
+    }
+
+    template <typename T>
+    void cell(const T& v) {
+        using U = std::decay_t<T>;
+        if constexpr (std::is_convertible_v<const U&, std::string_view>) {
+            text(std::string_view(v));
+        } else if constexpr (std::is_same_v<U, bool>) {
+            put(v ? '1' : '0');
+        } else if constexpr (std::is_same_v<U, char>) {
+            text(std::string_view(&v, 1));
+        } else if constexpr (std::is_arithmetic_v<U>) {
+            number(v);
         } else {
             std::ostringstream oss;
             oss << v;
-            return std::move(oss).str();
+            text(oss.str());
         }
     }
 };
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace thesis {
+
+// Compressed container formats recognised by their magic bytes.
+enum class Compression { None, Gzip, Xz, Bzip2 };
+
+// Detect the format from the first bytes of a file (at least 6 bytes for xz).
+Compression detect_compression(const char* data, std::size_t size);
+
+// Short lowercase name ("none", "gzip", "xz", "bzip2").
+const char* compression_name(Compression c);
+
+// Whether support for `c` was compiled in (zlib / liblzma / libbz2 found by CMake).
+bool compression_supported(Compression c);
+
+// Streams decompressed bytes produced by a background thread.
+//
+// The decoder thread fills a bounded ring of fixed-size buffers, so
+// decompression overlaps with whatever the consumer does with each block.
+// Blocks are handed out in order and stay valid until the next call to next().
+class DecompressingReader {
+public:
+    static constexpr std::size_t kDefaultBuffers = 4;
+    static constexpr std::size_t kDefaultBufferBytes = std::size_t{4} << 20;
+
+    // Decompress an in-memory (e.g. memory-mapped) input; `data` must outlive the reader.
+    DecompressingReader(Compression c, const char* data, std::size_t size,
+                        std::size_t buffers = kDefaultBuffers, std::size_t buffer_bytes = kDefaultBufferBytes);
+
+    // Decompress `prefix` followed by the remainder of `in` (read on the decoder thread).
+    DecompressingReader(Compression c, std::istream& in, std::string prefix,
+                        std::size_t buffers = kDefaultBuffers, std::size_t buffer_bytes = kDefaultBufferBytes);
+
+    ~DecompressingReader();
+    DecompressingReader(const DecompressingReader&) = delete;
+    DecompressingReader& operator=(const DecompressingReader&) = delete;
+
+    // Next block of decompressed bytes. Returns false at end of data or on error.
+    bool next(std::string_view& block);
+
+    // Set after next() returned false because decoding failed.
+    bool failed() const { return failed_; }
+    const std::string& error() const { return error_; }
+
+private:
+    struct Buffer {
+        std::vector<char> data;
+        std::size_t used = 0;
+    };
+
+    // Pulls compressed input; returns an empty view at end of input.
+    using Source = std::function<std::string_view()>;
+
+    void start(Compression c, Source src, std::size_t buffers, std::size_t buffer_bytes);
+    void produce(Compression c, Source src);
+
+    // Producer side of the ring.
+    Buffer* acquire_free();           // nullptr if the consumer went away
+    void publish(Buffer* b);
+    void finish(const std::string& err);
+
+    std::vector<std::unique_ptr<Buffer>> storage_;
+    std::deque<Buffer*> free_;
+    std::deque<Buffer*> filled_;
+    Buffer* held_ = nullptr; // block currently lent to the consumer
+    bool done_ = false;      // producer finished (success or error)
+    bool stop_ = false;      // consumer destroyed the reader
+    bool failed_ = false;
+    std::string error_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::thread worker_;
+};
+
+} // namespace thesis
@@ -42,6 +42,18 @@ public:
     // Roots of the current forest
     std::vector<unsigned> roots() const;
 
+    // out[x] = representative of x for every element, in O(n) total: each
+    // path is walked once and its nodes take the root found at its end.
+    void flatten(std::vector<unsigned>& out) const;
+
+    // Raw forest (parent links and ranks), e.g. to hand the state to
+    // ConcurrentDisjointSets and back.
+    const std::vector<unsigned>& parents() const { return parent_; }
+    const std::vector<unsigned char>& ranks() const { return rank_; }
+    // Replace the forest; parent must describe a valid forest over 0..n-1 and
+    // rank must have the same size. Recounts the components.
+    void assign(std::vector<unsigned> parent, std::vector<unsigned char> rank);
+
 private:
     std::vector<unsigned> parent_;
     std::vector<unsigned char> rank_; // 8-bit rank is typically sufficient
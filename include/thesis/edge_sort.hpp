@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "thesis/vig.hpp"
+
+namespace thesis {
+
+// Segmentation edge order: weight descending, ties broken by (u, v) ascending.
+// The order is total for a VIG (no duplicate pairs), so every sort method and
+// thread count produces the same sequence.
+template <class W>
+inline bool edge_order_before(const BasicEdge<W>& a, const BasicEdge<W>& b) {
+    if (a.w != b.w) return a.w > b.w;
+    if (a.u != b.u) return a.u < b.u;
+    return a.v < b.v;
+}
+
+// Pair order: (u, v) ascending, ties by weight descending. Groups the edges of
+// each endpoint pair, heaviest first (used to reduce candidate lists per pair).
+template <class W>
+inline bool pair_order_before(const BasicEdge<W>& a, const BasicEdge<W>& b) {
+    if (a.u != b.u) return a.u < b.u;
+    if (a.v != b.v) return a.v < b.v;
+    return a.w > b.w;
+}
+
+enum class EdgeSortMethod {
+    Auto,  // Radix at or above EdgeSortOptions::radix_threshold edges, std::sort below
+    Std,   // std::sort with edge_order_before (single-threaded)
+    Radix  // parallel LSD radix sort on the key (~bits(w), u, v)
+};
+
+// "auto", "std", "radix"
+const char* edge_sort_name(EdgeSortMethod m);
+// Parse a name accepted by edge_sort_name(); returns false on unknown input.
+bool parse_edge_sort(const std::string& s, EdgeSortMethod& out);
+
+struct EdgeSortOptions {
+    static constexpr std::size_t kDefaultRadixThreshold = std::size_t{1} << 17;
+
+    EdgeSortMethod method = EdgeSortMethod::Auto;
+    std::size_t radix_threshold = kDefaultRadixThreshold;
+    unsigned threads = 0; // radix workers; 0 => hardware concurrency
+};
+
+// Sort into segmentation order. Weights must be non-negative (radix keys use the
+// IEEE-754 bit pattern, which orders like the value for w >= 0).
+// Returns the method actually used (Std or Radix).
+EdgeSortMethod sort_edges_desc(std::vector<Edge>& edges, const EdgeSortOptions& opt = {});
+EdgeSortMethod sort_edges_desc(std::vector<EdgeF>& edges, const EdgeSortOptions& opt = {});
+EdgeSortMethod sort_edges_desc(EdgeColumns<double>& edges, const EdgeSortOptions& opt = {});
+EdgeSortMethod sort_edges_desc(EdgeColumns<float>& edges, const EdgeSortOptions& opt = {});
+
+// Sort into pair order with the same methods (Radix keys (u, v, ~bits(w))).
+// Duplicate pairs are allowed; weights must be non-negative.
+EdgeSortMethod sort_edges_by_pair(std::vector<Edge>& edges, const EdgeSortOptions& opt = {});
+
+} // namespace thesis
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace thesis {
+
+// Read-only view of a whole file. Uses mmap(2) where available and falls back to
+// reading the file into an owned buffer elsewhere. Move-only; releases the
+// mapping on destruction.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool is_open() const { return open_; }
+    const char* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    std::string_view view() const { return std::string_view(data_, size_); }
+
+    // Release the mapping (or buffer). Safe to call multiple times.
+    void close();
+
+private:
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+    bool open_ = false;
+    bool mapped_ = false;        // true if data_ points to an mmap region
+    std::vector<char> buffer_{}; // fallback storage when mmap is unavailable
+};
+
+} // namespace thesis
@@ -13,10 +13,11 @@ using Edge = thesis::Edge;
 // where m = sum of edge weights (each undirected edge counted once),
 // Σ_in(c) = sum of weights of edges inside community c (each undirected edge counted once),
 // Σ_tot(c) = sum of weighted degrees of vertices in community c.
-template <typename CommFn>
+// `edges` may use any VIG edge layout (std::vector<Edge>, std::vector<EdgeF>, EdgeColumns<W>).
+template <typename Edges, typename CommFn>
 double modularity(
     uint32_t n,
-    const std::vector<Edge>& edges,
+    const Edges& edges,
     CommFn&& comm_of,
     double gamma = 1.0
 ) {
@@ -25,11 +26,11 @@ double modularity(
   // strengths (degrees) k_i and total edge weight m
   std::vector<double> k(n, 0.0);
   double m = 0.0; // sum of weights over undirected edges
-  for (const auto& e : edges) {
-    k[e.u] += e.w;
-    k[e.v] += e.w;
-    m += e.w;
-  }
+  thesis::for_each_edge(edges, [&](uint32_t u, uint32_t v, double w) {
+    k[u] += w;
+    k[v] += w;
+    m += w;
+  });
   if (m == 0.0) return 0.0; // no edges → define Q = 0
   const double two_m = 2.0 * m;
 
@@ -64,14 +65,14 @@ double modularity(
     if (cid >= 0) sum_tot[static_cast<size_t>(cid)] += k[v];
   }
 
-  for (const auto& e : edges) {
-    int cu = remap[comm[e.u]];
-    int cv = remap[comm[e.v]];
+  thesis::for_each_edge(edges, [&](uint32_t u, uint32_t v, double w) {
+    int cu = remap[comm[u]];
+    int cv = remap[comm[v]];
     if (cu >= 0 && cu == cv) {
       // Each undirected internal edge counted once
-      sum_in[static_cast<size_t>(cu)] += e.w;
+      sum_in[static_cast<size_t>(cu)] += w;
     }
-  }
+  });
 
   // Q = sum_c [ (Σ_in(c) / m) - gamma * (Σ_tot(c) / (2m))^2 ]
   double Q = 0.0;
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "thesis/segmentation.hpp"
+#include "thesis/vig.hpp"
+
+namespace thesis {
+
+// How the quotient graph weighs the edge between two supernodes.
+enum class QuotientWeight {
+    Sum, // sum of all edge weights between the two components
+    Max  // the strongest single edge (as strongest_inter_component_edges())
+};
+// "sum", "max"
+const char* quotient_weight_name(QuotientWeight q);
+// Parse a name accepted by quotient_weight_name(); returns false on unknown input.
+bool parse_quotient_weight(const std::string& s, QuotientWeight& out);
+
+struct MultilevelOptions {
+    unsigned levels = 1;             // coarser levels to build above the flat segmentation
+    double k_factor = 1.0;           // k of level L is k * k_factor^L
+    QuotientWeight weight = QuotientWeight::Sum;
+};
+
+// One level of the dendrogram above the flat (level 0) segmentation.
+struct SegLevel {
+    unsigned level = 0;
+    double k = 0.0;
+    unsigned nodes = 0;              // supernodes (components of the level below)
+    std::size_t edges = 0;           // quotient edges between them
+    unsigned comps = 0;              // components after segmenting the quotient
+    double sec = 0.0;                // quotient build + segmentation
+    // Component of every original node at this level. A component is named by
+    // a level-0 representative (a root id of the flat segmentation), so ids
+    // nest: a level-L id is also the id of one of its level-(L-1) children.
+    std::vector<unsigned> labels;
+};
+
+// Multilevel segmentation. Starting from the flat partition `labels` (root id
+// of every node, as GraphSegmenterFH::component_labels()) of `edges`, each
+// level contracts the components of the level below into supernodes, joins
+// two supernodes by the summed or strongest weight of the edges between their
+// components (intra-component edges are dropped), and runs GraphSegmenterFH
+// with `cfg` on that quotient graph. The quotient is built with the pair-order
+// edge sort (Config::edge_sort, sort_threads) and shrinks with every level, so
+// a level costs a pass over the previous level's edges plus a segmentation of
+// a much smaller graph. Supernodes enter each level as singletons (size 1, no
+// internal distance). Stops early when a quotient has no edges or a level
+// merges nothing; levels are returned bottom-up, starting at level 1.
+template <class Edges>
+std::vector<SegLevel> segment_levels(std::span<const unsigned> labels, const Edges& edges, double k,
+                                     const GraphSegmenterFH::Config& cfg, const MultilevelOptions& opt);
+
+extern template std::vector<SegLevel> segment_levels(std::span<const unsigned>, const std::vector<Edge>&, double,
+                                                     const GraphSegmenterFH::Config&, const MultilevelOptions&);
+extern template std::vector<SegLevel> segment_levels(std::span<const unsigned>, const std::vector<EdgeF>&, double,
+                                                     const GraphSegmenterFH::Config&, const MultilevelOptions&);
+extern template std::vector<SegLevel> segment_levels(std::span<const unsigned>, const EdgeColumns<float>&, double,
+                                                     const GraphSegmenterFH::Config&, const MultilevelOptions&);
+extern template std::vector<SegLevel> segment_levels(std::span<const unsigned>, const EdgeColumns<double>&, double,
+                                                     const GraphSegmenterFH::Config&, const MultilevelOptions&);
+
+} // namespace thesis
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace thesis {
+
+// One buffered contribution of the optimized VIG builder: neighbor id and pair weight.
+struct NeighborContribution {
+    uint32_t b;
+    float w;
+};
+
+// Sort-and-reduce kernels for a variable's contribution run (ACCUM phase).
+enum class NeighborKernel {
+    Auto,   // best kernel this CPU supports
+    Scalar, // std::sort + sequential reduce
+    Avx2,   // 4-lane bitonic sort/merge, gathered segment sums
+    Avx512  // 8-lane bitonic sort/merge, compress + gathered segment sums (AVX-512F/VL)
+};
+
+// "auto", "scalar", "avx2", "avx512"
+const char* neighbor_kernel_name(NeighborKernel k);
+// Parse a name accepted by neighbor_kernel_name(); returns false on unknown input.
+bool parse_neighbor_kernel(const std::string& s, NeighborKernel& out);
+
+// Whether this build and CPU can run `k` (Auto and Scalar always can).
+bool neighbor_kernel_supported(NeighborKernel k);
+// Kernel used by sort_reduce_neighbors(): the one forced with set_neighbor_kernel(),
+// else the best supported one. Never returns Auto.
+NeighborKernel active_neighbor_kernel();
+// Force a kernel process-wide (Auto restores detection). Throws std::invalid_argument
+// if `k` is not supported.
+void set_neighbor_kernel(NeighborKernel k);
+
+// How reduce_neighbors() aggregates a run.
+enum class NeighborAccumulator {
+    Auto, // per run, from its length, neighbor-id window and a sampled distinct count
+    Sort, // sort_reduce_neighbors()
+    Spa,  // dense counters over (neighbor window x distinct weights)
+    Hash  // open-addressing table of distinct (neighbor, weight) keys
+};
+
+// "auto", "sort", "spa", "hash"
+const char* neighbor_accumulator_name(NeighborAccumulator a);
+// Parse a name accepted by neighbor_accumulator_name(); returns false on unknown input.
+bool parse_neighbor_accumulator(const std::string& s, NeighborAccumulator& out);
+// Force a strategy process-wide (Auto restores the per-run choice). A forced Spa
+// falls back to Hash for runs whose counters would exceed the dense-array cap.
+void set_neighbor_accumulator(NeighborAccumulator a);
+NeighborAccumulator forced_neighbor_accumulator();
+
+// One distinct (neighbor, weight) key of the Hash strategy with its multiplicity.
+struct NeighborAccumEntry {
+    uint64_t key; // (b << 32) | bits(w)
+    uint64_t count;
+};
+
+// Per-thread working memory; grows to the longest run seen and is reused.
+struct NeighborReduceScratch {
+    std::vector<uint64_t> keys, tmp;
+    std::vector<uint32_t> starts;
+    std::vector<uint32_t> spa; // Spa counters, all zero between runs
+    std::vector<NeighborAccumEntry> table, entries;
+    std::vector<uint32_t> out_b; // result: distinct neighbors, ascending
+    std::vector<double> out_w;   // result: summed weight per neighbor
+    // Runs aggregated by each strategy (reduce_neighbors() only).
+    std::size_t sort_runs = 0, spa_runs = 0, hash_runs = 0;
+};
+
+// Sort run[0, n) by (neighbor, weight) and sum the weights of each neighbor in
+// double, adding them in ascending weight order. Fills scratch.out_b/out_w and
+// returns the number of distinct neighbors. The order of the run does not matter,
+// and every kernel produces bit-identical results.
+std::size_t sort_reduce_neighbors(const NeighborContribution* run, std::size_t n, NeighborReduceScratch& scratch);
+
+// Same result as sort_reduce_neighbors(), computed by the strategy chosen for this
+// run (see NeighborAccumulator). Spa and Hash count each distinct key and then add
+// its weight `count` times in key order, which is exactly the sort path's sequence
+// of additions, so every strategy is bit-identical. Bumps the scratch's run counter.
+std::size_t reduce_neighbors(const NeighborContribution* run, std::size_t n, NeighborReduceScratch& scratch);
+
+} // namespace thesis
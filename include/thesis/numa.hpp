@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace thesis {
+
+class ArgParser;
+
+// ------------------------------------------------------------------
+// NUMA-aware thread placement, shared by the library's thread pools.
+//
+// With a placement other than None, worker `tid` of a pool of `threads` is
+// pinned to the CPUs of one NUMA node for the lifetime of a ScopedPlacement,
+// and the VIG builder places its per-batch memory on the node of the worker
+// that owns the batch (see build_vig_optimized). Results never depend on the
+// placement. The topology is read from sysfs on Linux, restricted to the CPUs
+// the process may run on; elsewhere, or when it cannot be read, there is one
+// node and pinning only restricts threads to the allowed CPUs.
+// ------------------------------------------------------------------
+
+enum class ThreadPlacement {
+    None,    // leave threads to the OS scheduler
+    Compact, // fill node 0's CPUs first, then node 1's, ...
+    Spread   // round-robin workers over the nodes
+};
+
+// "none", "compact", "spread"
+const char* thread_placement_name(ThreadPlacement p);
+// Parse a name accepted by thread_placement_name(); returns false on unknown input.
+bool parse_thread_placement(const std::string& s, ThreadPlacement& out);
+
+// Process-wide placement of the library's worker threads (default None).
+// Set it before starting work, like set_neighbor_accumulator().
+void set_thread_placement(ThreadPlacement p);
+ThreadPlacement thread_placement();
+
+// The NUMA nodes this process may run on, each with its allowed CPUs.
+struct NumaTopology {
+    std::vector<unsigned> node_ids;               // kernel node numbers
+    std::vector<std::vector<unsigned>> node_cpus; // allowed CPUs per node
+
+    unsigned nodes() const { return static_cast<unsigned>(node_ids.size()); }
+    std::size_t cpus() const;
+
+    // Read once, on first use.
+    static const NumaTopology& system();
+};
+
+// Node index (into NumaTopology::system()) that pool worker `tid` runs on
+// under the current placement; 0 with None.
+unsigned placement_node(unsigned tid);
+
+// Pins the calling thread to its node as worker `tid` of `threads` and
+// restores the previous CPU mask on destruction (pool workers usually include
+// the calling thread as tid 0). Does nothing with ThreadPlacement::None.
+class ScopedPlacement {
+public:
+    ScopedPlacement(unsigned tid, unsigned threads);
+    ~ScopedPlacement();
+    ScopedPlacement(const ScopedPlacement&) = delete;
+    ScopedPlacement& operator=(const ScopedPlacement&) = delete;
+
+    unsigned node() const { return node_; }
+
+private:
+    unsigned node_ = 0;
+    bool pinned_ = false;
+    std::vector<unsigned char> saved_; // previous cpu_set_t
+};
+
+// Spread the pages of [p, p + bytes) round-robin over the nodes (Linux mbind,
+// moving pages already touched), for data every worker reads, e.g. the clause
+// arena. Does nothing with ThreadPlacement::None or a single node.
+void interleave_pages(const void* p, std::size_t bytes);
+
+// Touch one byte per page of [p, p + bytes) from the calling thread so that,
+// under the kernel's first-touch policy, the pages land on its node.
+void first_touch(void* p, std::size_t bytes);
+
+// The tools' --placement none|compact|spread option.
+void add_placement_option(ArgParser& cli);
+// Apply --placement after ArgParser::parse(); false (with a message on stderr)
+// for an unknown value.
+bool apply_placement_option(const ArgParser& cli);
+
+} // namespace thesis
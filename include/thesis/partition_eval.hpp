@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "thesis/comp_metrics.hpp"
+#include "thesis/vig.hpp"
+
+namespace thesis {
+
+// Scores of one partition: modularity, size metrics and component count.
+struct PartitionScore {
+    double Q = 0.0;
+    CompSummary cs{};
+    uint32_t comps = 0;
+};
+
+// Scores many partitions of one graph. The constructor computes the node
+// strengths k_i and the total weight m once; evaluate() then needs a single
+// pass over the nodes and one over the edges per partition to produce Q (as in
+// modularity()), the CompSummary and the component count together.
+//
+// Labels are flattened root ids in [0, n) (GraphSegmenterFH::component_labels()),
+// so per-community sums are indexed by label directly, without a remap.
+// With threads == 1 the sums run in the same order as modularity() and
+// component_sizes(), so the results are bit-identical; with more threads each
+// thread accumulates a contiguous slice and the slices are added in thread
+// order, so Q stays deterministic for a given thread count but may differ from
+// the sequential value in the last bits.
+//
+// Holds a reference to `edges`, which must outlive the evaluator and not change.
+template <class Edges>
+class PartitionEvaluator {
+public:
+    // Per-caller buffers, reused across evaluate() calls (one per thread when
+    // evaluating from several threads at once).
+    struct Scratch {
+        std::vector<std::vector<double>> tot, in;  // [thread][label]
+        std::vector<std::vector<uint32_t>> count;  // [thread][label]
+        std::vector<unsigned char> seen;
+        std::vector<uint32_t> sizes;
+    };
+
+    // threads: 0 = hardware concurrency.
+    PartitionEvaluator(uint32_t n, const Edges& edges, unsigned threads = 1);
+
+    PartitionScore evaluate(std::span<const unsigned> labels, Scratch& scratch, double gamma = 1.0) const;
+    PartitionScore evaluate(std::span<const unsigned> labels, double gamma = 1.0) const {
+        Scratch scratch;
+        return evaluate(labels, scratch, gamma);
+    }
+
+    uint32_t node_count() const { return n_; }
+    double total_weight() const { return m_; }
+    const std::vector<double>& strengths() const { return k_; }
+
+private:
+    uint32_t n_ = 0;
+    const Edges* edges_ = nullptr;
+    unsigned threads_ = 1;
+    std::vector<double> k_;
+    double m_ = 0.0;
+};
+
+extern template class PartitionEvaluator<std::vector<Edge>>;
+extern template class PartitionEvaluator<std::vector<EdgeF>>;
+extern template class PartitionEvaluator<EdgeColumns<float>>;
+extern template class PartitionEvaluator<EdgeColumns<double>>;
+
+} // namespace thesis
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace thesis {
+
+class ArgParser;
+
+// ------------------------------------------------------------------
+// Runtime-switchable instrumentation shared by all tools.
+//
+//  - Phases: wall time (inclusive), call count, and the peak RSS seen at the
+//    end of each call, keyed by a static name such as "vig.fill". Recorded with
+//    a ScopedPhase on the calling thread, or with add_phase() when the caller
+//    measured the interval itself (e.g. one worker timing a barrier-delimited
+//    phase of a thread pool).
+//  - Counters: named totals (add()) and per-thread values (add_thread()), for
+//    kernel statistics such as guard lookups or per-worker busy time. Meant to
+//    be flushed once per kernel call from locally accumulated values, never
+//    from a hot loop.
+//  - Hardware counters (Linux, perf_event_open): cycles, instructions, cache
+//    and branch misses per ScopedPhase, counting the calling thread and the
+//    threads it starts inside the phase. Silently absent when the kernel
+//    refuses them (e.g. perf_event_paranoid).
+//
+// When profiling is off every entry point returns after one relaxed atomic
+// load, so instrumented code pays a predictable branch per call site.
+// Profiling is enabled once, before the instrumented work starts.
+// ------------------------------------------------------------------
+namespace profile {
+
+enum class Format { Off, Text, Json };
+
+// "off", "text", "json"
+const char* format_name(Format f);
+// Parse a name accepted by format_name(); returns false on unknown input.
+bool parse_format(const std::string& s, Format& out);
+
+namespace detail {
+extern std::atomic<bool> g_enabled;
+extern std::atomic<bool> g_hardware;
+} // namespace detail
+
+inline bool enabled() { return detail::g_enabled.load(std::memory_order_relaxed); }
+
+// Turn recording on (hardware: also open perf counters per ScopedPhase).
+void enable(bool hardware = false);
+// Drop everything recorded so far (the switch keeps its state).
+void reset();
+
+// Add one call of `name` lasting `sec` (no hardware counters).
+void add_phase(const char* name, double sec);
+// Add `value` to the counter `name`.
+void add(const char* name, double value);
+// Add `value` to thread `tid`'s slot of the per-thread counter `name`.
+void add_thread(const char* name, unsigned tid, double value);
+
+// Peak resident set size of the process so far, in bytes (0 if unknown).
+std::size_t peak_rss_bytes();
+
+// Write everything recorded so far.
+//  text: one "profile phase=... calls=... sec=... peak_rss=..." line per phase,
+//        then "profile counter=NAME value=V" and "profile thread_counter=NAME
+//        tid=T value=V" lines;
+//  json: {"peak_rss_bytes": N, "phases": [...], "counters": {...},
+//        "thread_counters": {"NAME": [v0, v1, ...]}}.
+void report(std::ostream& out, Format format);
+
+// Times the enclosing scope as one call of phase `name` when profiling is on.
+class ScopedPhase {
+public:
+    explicit ScopedPhase(const char* name) {
+        if (enabled()) start(name);
+    }
+    ~ScopedPhase() {
+        if (name_) stop();
+    }
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+private:
+    static constexpr int kHwCounters = 4;
+    const char* name_ = nullptr;
+    int64_t start_ns_ = 0;
+    int hw_fd_[kHwCounters] = {-1, -1, -1, -1};
+
+    void start(const char* name);
+    void stop();
+};
+
+// The tools' --profile text|json, --profile-out FILE and --profile-hw options.
+// Construct after ArgParser::parse(); profiling starts here and the report is
+// written when the session ends (stderr unless --profile-out is given).
+class Session {
+public:
+    static void add_options(ArgParser& cli);
+
+    explicit Session(const ArgParser& cli);
+    ~Session();
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    // False (with a message on stderr) for an invalid --profile value.
+    bool ok() const { return ok_; }
+
+private:
+    bool ok_ = true;
+    Format format_ = Format::Off;
+    std::string out_path_;
+};
+
+} // namespace profile
+} // namespace thesis
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "thesis/segmentation.hpp"
+
+namespace thesis {
+
+struct RefineOptions {
+    unsigned max_rounds = 8;    // sweeps over the active nodes
+    double time_limit = 0.0;    // seconds, checked between colour batches; 0 = no limit
+    double gamma = 1.0;         // modularity resolution
+    double min_round_gain = 0.0; // stop once a round gains no more than this
+    unsigned threads = 1;       // 0 = hardware concurrency
+};
+
+struct RefineStats {
+    unsigned rounds = 0;
+    uint64_t moves = 0;
+    uint64_t evaluated = 0;     // node move decisions computed
+    double gain = 0.0;          // summed ΔQ of the applied moves
+    double sec = 0.0;
+    bool converged = false;     // last round moved nothing (false: round or time budget hit)
+};
+
+// Louvain-style local-move refinement of a partition for modularity, meant to
+// run after GraphSegmenterFH on the graph the partition is scored on.
+//
+// Each round visits the nodes by colour class of a greedy distance-1
+// colouring: nodes of one colour share no edge, so their weights towards the
+// neighbouring communities cannot change while the batch is decided. Threads
+// decide the best move of a contiguous slice of the batch in parallel against
+// the community volumes at the start of the batch; one thread then applies the
+// moves in node order, re-checking each gain against the current volumes.
+// The result is therefore identical for every thread count. A node is only
+// re-decided in the next round if one of its neighbours moved since; every
+// other node's neighbourhood is unchanged, so its last decision (no move)
+// stands up to the drift of the community volumes. Nodes only move into a
+// neighbouring community, never out into a singleton of their own.
+//
+// Holds a reference to `nb`, which must outlive the refiner and not change.
+class ModularityRefiner {
+public:
+    // nb: CSR adjacency of the graph (SegNeighbors::build()); the node
+    // strengths, total weight and colouring are computed once here.
+    explicit ModularityRefiner(const SegNeighbors& nb);
+
+    // Refine `labels` (community id in [0, n) per node, e.g. the flattened
+    // roots of GraphSegmenterFH::component_labels()) in place. Community ids
+    // stay in [0, n) but need not be the id of a member afterwards.
+    RefineStats refine(std::vector<unsigned>& labels, const RefineOptions& opt) const;
+
+    uint32_t node_count() const { return n_; }
+    unsigned colours() const { return static_cast<unsigned>(colour_offsets_.size() - 1); }
+
+private:
+    const SegNeighbors* nb_ = nullptr;
+    uint32_t n_ = 0;
+    std::vector<double> k_;
+    double m_ = 0.0;
+    // Nodes of colour c: colour_nodes_[colour_offsets_[c] .. colour_offsets_[c+1]), ascending.
+    std::vector<std::size_t> colour_offsets_;
+    std::vector<unsigned> colour_nodes_;
+};
+
+} // namespace thesis
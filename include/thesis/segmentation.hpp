@@ -5,11 +5,15 @@
 #include <cstdint>
 #include <cmath>
 #include <limits>
+#include <span>
+#include <string>
 #include <utility>
 #include <vector>
 #include <unordered_map>
 
+#include "thesis/concurrent_disjoint_set.hpp"
 #include "thesis/disjoint_set.hpp"
+#include "thesis/edge_sort.hpp"
 #include "thesis/vig.hpp" // for Edge (u,v,w)
 
 namespace thesis {
@@ -17,6 +21,60 @@ namespace thesis {
 // Edge with similarity weight (larger = more similar)
 using SegEdge = thesis::Edge;
 
+// Node incidence lists of an edge list in CSR form: the neighbors of x are
+// adj[offsets[x] .. offsets[x+1]) as (other endpoint, weight). Depends only on
+// the (sorted) edges, so one instance can serve many runs over the same graph.
+struct SegNeighbors {
+    // Nodes with at least this many neighbors get a by-id index (hub_index).
+    static constexpr std::size_t kHubDegree = 64;
+
+    std::vector<std::size_t> offsets;                // n + 1 entries
+    std::vector<std::pair<unsigned, double>> adj;    // 2 * |E| entries
+
+    // Hubs only: hub_index[hub_offsets[x] .. hub_offsets[x+1]) holds (neighbor,
+    // position within x's adj range) sorted by neighbor; empty for other nodes.
+    std::vector<std::size_t> hub_offsets;            // n + 1 entries
+    std::vector<std::pair<unsigned, unsigned>> hub_index;
+
+    // Build for n nodes from edges in segmentation order (see run_presorted()).
+    // Only modularity-guard runs read the hub index; hub_index = false skips it
+    // (hub_offsets stays empty and the guard scans every neighbor list).
+    static SegNeighbors build(unsigned n, std::span<const SegEdge> edges, bool hub_index = true);
+};
+
+// Memory layout of the merge loop's per-component state.
+enum class SegStateLayout {
+    Split, // union-find arrays plus one array per field (size, max_dist, volume, ...)
+    Packed // one record per node (24 bytes, 40 with the guard); a root's parent word holds its rank
+};
+// "split", "packed"
+const char* seg_state_layout_name(SegStateLayout l);
+// Parse a name accepted by seg_state_layout_name(); returns false on unknown input.
+bool parse_seg_state_layout(const std::string& s, SegStateLayout& out);
+
+// Node renumbering applied for the merge loop only (results use the input ids).
+enum class NodeRelabel {
+    None,
+    Bfs,   // breadth-first order over the edges, neighbors in adjacency order
+    Degree // by degree descending, ties by id
+};
+// "none", "bfs", "degree"
+const char* node_relabel_name(NodeRelabel r);
+// Parse a name accepted by node_relabel_name(); returns false on unknown input.
+bool parse_node_relabel(const std::string& s, NodeRelabel& out);
+
+// Which non-union (cross-component) edges the merge loop keeps for
+// strongest_inter_component_edges().
+enum class CandidateStore {
+    All,     // every rejected edge, in edge order (inter_component_candidates())
+    PairMax, // only the first (= heaviest) rejected edge per pair of roots at the time
+    None     // nothing; strongest_inter_component_edges() is empty
+};
+// "all", "pairmax", "none"
+const char* candidate_store_name(CandidateStore c);
+// Parse a name accepted by candidate_store_name(); returns false on unknown input.
+bool parse_candidate_store(const std::string& s, CandidateStore& out);
+
 // Graph segmentation based on the Felzenszwalb–Huttenlocher (FH) predicate with a modularity guard.
 //
 // Semantics:
@@ -28,10 +86,19 @@ using SegEdge = thesis::Edge;
 //  - Modularity guard (Config::use_modularity_guard): fast lower-bound accept
 //    and upper-bound reject tests around ΔQ with resolution gamma; optional
 //    annealed tolerance; ambiguous policy configurable.
-//  - Edges are processed in descending weight order and stored if they do not
-//    merge components. strongest_inter_component_edges() returns one strongest
-//    edge per unordered pair of resulting components.
+//  - Edges are processed in descending weight order (ties by (u, v)) and stored if they do not
+//    merge components (all of them, or one per pair of roots, Config::candidates).
+//    strongest_inter_component_edges() returns one strongest edge per unordered
+//    pair of resulting components.
 //  - Backbone: union-find with union-by-rank and path compression.
+//  - Parallel mode (Config::seg_threads): edges are taken in blocks; workers
+//    prefetch roots and FH gates of a block against the state at its start with
+//    concurrent DSU finds, then one thread walks the block in order, keeping every
+//    decision whose two roots no earlier union of the block touched and
+//    recomputing the rest. The partition (and its representatives) is the
+//    sequential one.
+//  - State layout and relabeling (Config::state_layout, Config::relabel) only
+//    change where the state lives: same partition and representatives.
 
 class GraphSegmenterFH {
 public:
@@ -50,6 +117,15 @@ public:
             enum class Ambiguous {Accept, Reject, GateMargin};
             static constexpr Ambiguous kDefaultAmbiguousPolicy = Ambiguous::GateMargin;
             static constexpr double kDefaultGateMarginRatio = 0.05;      // 5% margin
+            using EdgeSort = EdgeSortMethod;
+            static constexpr EdgeSort kDefaultEdgeSort = EdgeSort::Auto;
+            static constexpr std::size_t kDefaultRadixSortThreshold = EdgeSortOptions::kDefaultRadixThreshold;
+            static constexpr unsigned kDefaultSortThreads = 0;          // 0 => hardware concurrency
+            static constexpr unsigned kDefaultSegThreads = 1;           // sequential merge loop
+            using StateLayout = SegStateLayout;
+            static constexpr StateLayout kDefaultStateLayout = StateLayout::Split;
+            static constexpr NodeRelabel kDefaultRelabel = NodeRelabel::None;
+            static constexpr CandidateStore kDefaultCandidates = CandidateStore::All;
 
         // Size exponent in the gate denominator: tau = k_eff / (|C|^sizeExponent)
         // - 1.0 reproduces FH (k/|C|)
@@ -68,6 +144,38 @@ public:
             double dq_vscale = kDefaultDqVscale;
             Ambiguous ambiguous_policy = kDefaultAmbiguousPolicy;
             double gate_margin_ratio = kDefaultGateMarginRatio; // used only for GateMargin (e.g., 0.05 = need 5% room)
+
+        // Initial edge sort: Auto picks the radix sort at or above radix_sort_threshold
+        // edges. The order (w desc, then u, v) is the same for every method.
+            EdgeSort edge_sort = kDefaultEdgeSort;
+            std::size_t radix_sort_threshold = kDefaultRadixSortThreshold;
+            unsigned sort_threads = kDefaultSortThreads;
+
+        // Keep the merge trajectory of each run (unions and the gate state of every
+        // rejected edge) so resume_presorted() can move to a larger k. Guard off only,
+        // and not with CandidateStore::PairMax; costs about 48 bytes per rejected edge.
+            bool record_trajectory = false;
+
+        // Merge loop threads: 1 runs it sequentially, 0 => hardware concurrency.
+        // Same partition and representatives for every value.
+            unsigned seg_threads = kDefaultSegThreads;
+
+        // Per-component state layout of the sequential merge loop (the parallel loop
+        // always uses Split), and an optional node renumbering for locality. Relabeling
+        // copies the edge list and, with the guard on, rebuilds its neighbor lists.
+            StateLayout state_layout = kDefaultStateLayout;
+            NodeRelabel relabel = kDefaultRelabel;
+
+        // Rejected-edge storage. PairMax keeps one edge per pair of roots at
+        // rejection time (later edges of the pair are lighter), which gives the
+        // same strongest_inter_component_edges() in far less memory; None skips
+        // the storage for runs that never ask for it.
+            CandidateStore candidates = kDefaultCandidates;
+
+        // Let the guard's weight lookups probe the by-id index of high-degree nodes
+        // (SegNeighbors::hub_index) instead of scanning them; false always scans.
+        // Same sums, hence the same partition, either way.
+            bool hub_index = true;
     };
 
     // Construct a segmenter for n nodes and parameter k.
@@ -82,18 +190,43 @@ public:
     const Config& config() const { return cfg_; }
 
     // Run segmentation in-place on the provided edges.
-    // Edges will be sorted descending by weight.
-    void run(std::vector<SegEdge>& edges);
+    // Edges will be sorted descending by weight, ties by (u, v). Accepts every VIG
+    // edge layout (std::vector<Edge>, std::vector<EdgeF>, EdgeColumns<float|double>).
+    template <class Edges>
+    void run(Edges& edges);
+
+    // Run on edges that are already in segmentation order (edge_order_before,
+    // e.g. from sort_edges_desc()); the edges are only read. The second form
+    // reuses neighbor lists built from the same edges, so sweeps over k or guard
+    // settings can sort and index once and share the result across segmenters.
+    // Both give the same partition as run() on an unsorted copy.
+    void run_presorted(std::span<const SegEdge> edges);
+    void run_presorted(std::span<const SegEdge> edges, const SegNeighbors& neighbors);
+
+    // Incremental k-sweep. Moves the result of the last run over the same sorted
+    // edges (recorded with Config::record_trajectory, guard off) to k >= the
+    // current k, giving exactly the partition run_presorted() would give at k.
+    // The FH gate only grows with k for fixed component state, so the new run
+    // follows the old one up to the first rejected edge that passes at the new k;
+    // only the unions before that edge are replayed, and edges from there on are
+    // processed normally. Returns that edge position, edges.size() if no decision
+    // changes (identical partition, O(#rejected) work). Falls back to a full
+    // run_presorted() (returning 0) when no usable trajectory exists or k shrinks.
+    std::size_t resume_presorted(double k, std::span<const SegEdge> edges, const SegNeighbors& neighbors);
 
     // After run(), compute strongest inter-component edges.
     // Returns one edge per unordered pair of components (u,v) with maximum similarity weight.
-    // The endpoints u,v are component representatives (roots) at the end of segmentation.
-    // If there is no edge between two components in the input, it won't appear in the result.
+    // The endpoints u,v are component representatives (roots) at the end of segmentation,
+    // u < v, and the edges come in (u, v) order. If there is no edge between two
+    // components in the input, it won't appear in the result. The candidates are
+    // relabeled by final root in parallel and sorted by pair (Config::edge_sort,
+    // sort_threads), then the first edge of each pair is kept.
     std::vector<SegEdge> strongest_inter_component_edges() const;
 
     // Access the non-union edges that connect two different components at the
     // time they were considered (i.e., potential inter-component connections).
-    // Stored in the same descending order used during segmentation.
+    // Stored in the same descending order used during segmentation; a subset
+    // (one per pair of roots) with CandidateStore::PairMax, empty with None.
     const std::vector<SegEdge>& inter_component_candidates() const { return intercomp_candidates_; }
 
     // Accessors
@@ -104,6 +237,9 @@ public:
     unsigned component(unsigned x) { return dsu_.find(x); }
     // Const variant without compression.
     unsigned component_no_compress(unsigned x) const { return dsu_.find_no_compress(x); }
+    // Root id of every node at once (out[x] == component_no_compress(x)), in
+    // O(n); reuse `out` across runs to keep its allocation.
+    void component_labels(std::vector<unsigned>& out) const { dsu_.flatten(out); }
 
     // Size of the component whose representative is r.
     unsigned comp_size(unsigned r) const { return comp_size_[r]; }
@@ -111,6 +247,9 @@ public:
     // Minimum similarity weight observed within the component (representative r).
     double comp_min_weight(unsigned r) const { return max_dist_[r] > 0 ? 1.0 / max_dist_[r] : std::numeric_limits<double>::infinity(); }
 
+    // Sort method used by the last run() (Std or Radix once Auto is resolved).
+    EdgeSortMethod last_edge_sort() const { return last_edge_sort_; }
+
     // Effective scaling applied to k (median of base distances); informative only.
     double k_scale() const { return d_scale_; }
 
@@ -119,39 +258,101 @@ public:
     unsigned mod_guard_ub_rejects() const { return mod_guard_ub_rejects_; }
     unsigned mod_guard_ambiguous() const { return mod_guard_ambiguous_; }
 
+    // Merge loop threads used by the last run (1 when it ran sequentially), and
+    // in parallel runs the cross-component edges decided from the block
+    // prefetch versus recomputed because an earlier union touched a root.
+    unsigned last_seg_threads() const { return last_seg_threads_; }
+    // State layout used by the last run's merge loop.
+    SegStateLayout last_state_layout() const { return last_state_layout_; }
+    std::uint64_t parallel_prefetched() const { return par_prefetched_; }
+    std::uint64_t parallel_replayed() const { return par_replayed_; }
+
+    // Cost of the guard's w_ab lookups: number of endpoint-to-component sums,
+    // neighbor entries scanned, and component members probed (hub path).
+    std::uint64_t mod_guard_lookups() const { return mod_lookups_; }
+    std::uint64_t mod_guard_scanned() const { return mod_lookup_scanned_; }
+    std::uint64_t mod_guard_probed() const { return mod_lookup_probed_; }
+
 private:
-    inline double gate(unsigned r) const {
+    // Merge loop over sorted edges; shared by run() and run_presorted().
+    template <class Edges>
+    void run_sorted(const Edges& edges, const SegNeighbors& neighbors);
+    // Process edges[begin..) from the current state (merge loop of run_sorted()),
+    // sequentially or in parallel blocks per Config::seg_threads.
+    template <class Edges>
+    void merge_edges(const Edges& edges, const SegNeighbors& neighbors, std::size_t begin);
+    // Roots and FH gate decision of one edge against the state at the start of its
+    // block (parallel mode).
+    struct EdgePrefetch {
+        unsigned a, b;
+        unsigned char kind; // see merge_range()
+    };
+    // Modularity guard variant a merge loop is compiled for (Config::use_modularity_guard
+    // and anneal_modularity_guard); merge_edges() picks it once per run.
+    enum class GuardMode { Off, Static, Annealed };
+    // merge_edges() body for one guard mode and size-term policy (|C|^sizeExponent
+    // of a merged component, see segmentation.cpp).
+    template <GuardMode Guard, class Edges, class SizeTerm>
+    void merge_edges_with(const Edges& edges, const SegNeighbors& neighbors, std::size_t begin, const SizeTerm& term);
+    // Merge loop over edges[begin, end) on the state view `st`. With `pre` (entry
+    // i - begin per edge), decisions whose roots were not touched since the block
+    // began are taken from it; `block` tags the roots touched in this block.
+    template <GuardMode Guard, class Edges, class State, class SizeTerm>
+    void merge_range(const Edges& edges, const SegNeighbors& neighbors, std::size_t begin, std::size_t end,
+                     State& st, const SizeTerm& term, const EdgePrefetch* pre, unsigned block);
+    // Renumber every per-node array (and the union-find forest) so node x becomes to[x].
+    void permute_nodes(const std::vector<unsigned>& to);
+    template <GuardMode Guard, class Edges, class SizeTerm>
+    void merge_edges_parallel(const Edges& edges, const SegNeighbors& neighbors, std::size_t begin, unsigned threads,
+                              const SizeTerm& term);
+
+    // Views of the per-component state for the merge loop (size, max_dist, vol, lb
+    // and union-find over the arrays below, or over packed records); defined in
+    // segmentation.cpp.
+    template <class Dsu, bool Guard>
+    struct SplitState;
+    template <bool Guard>
+    struct PackedState;
+
+    static inline double gate_value(double max_dist, double size_term, double k) {
         // Gate bias controlled by k and the size exponent in the denominator.
-        const double size_term = std::pow(static_cast<double>(comp_size_[r]), cfg_.sizeExponent);
-        const double tau = k_ / (size_term > 0 ? size_term : 1.0);
-        return max_dist_[r] + tau;
+        return max_dist + k / size_term;
     }
-    inline bool allow_merge(unsigned a, unsigned b, double connection_distance) const {
-        const double ga = gate(a);
-        const double gb = gate(b);
+    template <class S>
+    inline double gate(const S& st, unsigned r) const { return gate_value(st.max_dist(r), st.size_term(r), k_); }
+    template <class S>
+    inline bool allow_merge(const S& st, unsigned a, unsigned b, double connection_distance) const {
+        const double ga = gate(st, a);
+        const double gb = gate(st, b);
         return connection_distance <= (ga < gb ? ga : gb);
     }
-    inline double dq_tolerance(unsigned a, unsigned b) const {
-        if (!cfg_.anneal_modularity_guard) return 0.0; // static guard
-        const double maxVol = std::max(comp_vol_[a], comp_vol_[b]);
-        double vscale = cfg_.dq_vscale;
-        if (!(vscale > 0.0)) {
-            const double n = static_cast<double>(node_count());
-            vscale = (n > 0.0) ? std::max(1.0, (2.0 * sum_weights_) / n) : 1.0; // ~mean degree
+    template <GuardMode Guard, class S>
+    inline double dq_tolerance(const S& st, unsigned a, unsigned b) const {
+        if constexpr (Guard != GuardMode::Annealed) {
+            return 0.0; // static guard
+        } else {
+            const double maxVol = std::max(st.vol(a), st.vol(b));
+            double vscale = cfg_.dq_vscale;
+            if (!(vscale > 0.0)) {
+                const double n = static_cast<double>(node_count());
+                vscale = (n > 0.0) ? std::max(1.0, (2.0 * sum_weights_) / n) : 1.0; // ~mean degree
+            }
+            return -cfg_.dq_tolerance0 * std::exp(-maxVol / vscale); // tiny negative early, goes to 0
         }
-        return -cfg_.dq_tolerance0 * std::exp(-maxVol / vscale); // tiny negative early, goes to 0
     }
-    inline double dq_lower_bound(unsigned a, unsigned b, double ab_w) const {
+    template <class S>
+    inline double dq_lower_bound(const S& st, unsigned a, unsigned b, double ab_w) const {
         // ΔQ_LB = w/m - γ * vol[a]*vol[b] / (2 m^2)
         const double m = sum_weights_;
         if (!(m > 0.0)) return -std::numeric_limits<double>::infinity();
-        return (ab_w / m) - (cfg_.gamma * comp_vol_[a] * comp_vol_[b]) / (2.0 * m * m);
+        return (ab_w / m) - (cfg_.gamma * st.vol(a) * st.vol(b)) / (2.0 * m * m);
     }
-    inline double dq_upper_bound(unsigned a, unsigned b) const {
-        const double va = comp_vol_[a], vb = comp_vol_[b], m = sum_weights_;
+    template <class S>
+    inline double dq_upper_bound(const S& st, unsigned a, unsigned b) const {
+        const double va = st.vol(a), vb = st.vol(b), m = sum_weights_;
         // Upper bounds on cuts
-        const double cutA_ub = std::max(0.0, va - 2.0 * lb_comp_internal_w_[a]);
-        const double cutB_ub = std::max(0.0, vb - 2.0 * lb_comp_internal_w_[b]);
+        const double cutA_ub = std::max(0.0, va - 2.0 * st.lb(a));
+        const double cutB_ub = std::max(0.0, vb - 2.0 * st.lb(b));
         double eab_ub = std::min(cutA_ub, cutB_ub);
         // Trivial bound (optional – never worse)
         eab_ub = std::min(eab_ub, std::min(va, vb));
@@ -160,26 +361,50 @@ private:
         const double dq_max = (eab_ub / m) - (cfg_.gamma * va * vb) / (2.0 * m * m);
         return dq_max;
     }
-    inline bool accept_by_modularity_lowerbound(unsigned a, unsigned b, double ab_w, double tol) const {
-        if (!(cfg_.use_modularity_guard) || !(sum_weights_ > 0.0)) return true; // accept
-        const double dq_min = dq_lower_bound(a, b, ab_w);
+    template <class S>
+    inline bool accept_by_modularity_lowerbound(const S& st, unsigned a, unsigned b, double ab_w, double tol) const {
+        if (!(sum_weights_ > 0.0)) return true; // accept
+        const double dq_min = dq_lower_bound(st, a, b, ab_w);
         return dq_min >= tol; // if worst-case is still above tolerance, accept
     }
-    inline bool reject_by_modularity_upperbound(unsigned a, unsigned b, double tol) const {
-        if (!(cfg_.use_modularity_guard) || !(sum_weights_ > 0.0)) return false; // don't reject
-        const double dq_max = dq_upper_bound(a, b);
+    template <class S>
+    inline bool reject_by_modularity_upperbound(const S& st, unsigned a, unsigned b, double tol) const {
+        if (!(sum_weights_ > 0.0)) return false; // don't reject
+        const double dq_max = dq_upper_bound(st, a, b);
         return dq_max < tol; // if even best-case is below tolerance, reject
     }
     static inline std::uint64_t pair_key(unsigned a, unsigned b) {
         if (a > b) std::swap(a, b);
         return (static_cast<std::uint64_t>(a) << 32) | static_cast<std::uint64_t>(b);
     }
+    // Store rejected edge e between roots a != b per Config::candidates.
+    inline void keep_candidate(unsigned a, unsigned b, const SegEdge& e) {
+        if (cfg_.candidates == CandidateStore::All ||
+            (cfg_.candidates == CandidateStore::PairMax && candidate_pairs_.insert(pair_key(a, b))))
+            intercomp_candidates_.push_back(e);
+    }
+
+    // Flat open-addressing set of pair keys (CandidateStore::PairMax). A pair key
+    // of two distinct roots is never ~0, which marks an empty slot.
+    struct PairKeySet {
+        std::vector<std::uint64_t> slots;
+        std::size_t used = 0;
+        unsigned shift = 64;
+        void clear();
+        // True if key was not in the set yet.
+        bool insert(std::uint64_t key);
+    };
 
     double sum_weights_{0};
     DisjointSets dsu_{};
     std::vector<unsigned> comp_size_{};
     std::vector<double> max_dist_{};
-    std::vector<double> lb_comp_internal_w_{}; // Lower-bound of internal component weights
+    // |C|^sizeExponent (at least 1) of each root, refreshed on merge so gate() does
+    // no pow() per edge.
+    std::vector<double> size_term_{};
+    // Guard only, set up by each run: lower bound of internal component weights, and
+    // component volumes.
+    std::vector<double> lb_comp_internal_w_{};
     std::vector<double> comp_vol_{};
     double k_ = 50.0;
     Config cfg_{}; // tuning knobs
@@ -188,10 +413,45 @@ private:
     // Non-union edges that were cross-component when processed (descending weight order).
     // These are candidates for strongest inter-component connections.
     std::vector<SegEdge> intercomp_candidates_{};
+    PairKeySet candidate_pairs_{};
     // Track modularity guard rejections
     unsigned mod_guard_ub_rejects_{0};
     unsigned mod_guard_ambiguous_{0};
     unsigned mod_guard_lb_accepts_{0};
+    std::uint64_t mod_lookups_{0};
+    std::uint64_t mod_lookup_scanned_{0};
+    std::uint64_t mod_lookup_probed_{0};
+    // Guard only: members of each component as a circular list (next_member_[x]);
+    // merging two components swaps one successor each.
+    std::vector<unsigned> next_member_{};
+    EdgeSortMethod last_edge_sort_{EdgeSortMethod::Std};
+    // Parallel mode: backbone with concurrent finds during the run (copied back into dsu_),
+    // and the last block in which each root took part in a union.
+    ConcurrentDisjointSets pdsu_{};
+    std::vector<unsigned> touched_{};
+    unsigned last_seg_threads_{1};
+    SegStateLayout last_state_layout_{SegStateLayout::Split};
+    std::uint64_t par_prefetched_{0};
+    std::uint64_t par_replayed_{0};
+
+    // Trajectory of the last run (Config::record_trajectory): edge positions of
+    // the unions, and for each rejected edge (1:1 with intercomp_candidates_) the
+    // gate inputs it was rejected with.
+    struct RejectedGate {
+        std::size_t pos;
+        double dist;
+        double max_dist_a, max_dist_b;
+        double size_term_a, size_term_b;
+    };
+    std::vector<std::size_t> traj_unions_{};
+    std::vector<RejectedGate> traj_rejects_{};
+    bool traj_valid_ = false;
+    std::size_t traj_edge_count_ = 0;
 };
 
+extern template void GraphSegmenterFH::run(std::vector<Edge>&);
+extern template void GraphSegmenterFH::run(std::vector<EdgeF>&);
+extern template void GraphSegmenterFH::run(EdgeColumns<float>&);
+extern template void GraphSegmenterFH::run(EdgeColumns<double>&);
+
 } // namespace thesis
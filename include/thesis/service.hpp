@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "thesis/cnf.hpp"
+#include "thesis/vig.hpp"
+
+namespace thesis {
+
+// ------------------------------------------------------------------
+// Long-running tool service: one warm process answers a stream of requests,
+// so sweeps pay for process start, CNF parsing and VIG builds once.
+//
+// Protocol (JSON lines, one request per line, one response line each):
+//
+//   {"id": 7, "input": "f.cnf", "tau": 5, "k": 80, "no-mod-guard": true}
+//   {"id": 8, "args": ["-i", "f.cnf", "--tau", "5", "--k", "80"]}
+//   {"shutdown": true}
+//
+// A request is the tool's command line: either an "args" array, or one member
+// per long option ("--name value"; true gives a bare flag, false/null omit
+// it). "id" is echoed back. The response is
+//
+//   {"id": 7, "status": 0, "output": "<stdout text>", "error": "<stderr text>"}
+//
+// with exactly what the command-line tool would have printed, so callers keep
+// parsing the usual key=value summary. Requests run one at a time.
+// ------------------------------------------------------------------
+
+// Runs one request: `args` without the program name. Returns the exit status.
+using ServiceHandler = std::function<int(const std::vector<std::string>& args, std::ostream& out, std::ostream& err)>;
+
+// One member value of a flat JSON object. Numbers keep their text; strings are
+// unescaped; arrays may hold strings and numbers (their text in `items`).
+struct JsonValue {
+    enum class Kind { String, Number, Bool, Null, Array };
+    Kind kind = Kind::Null;
+    std::string text; // String/Number text, "true"/"false" for Bool
+    std::vector<std::string> items;
+};
+
+// Parse a flat JSON object (no nested objects) into (name, value) pairs in
+// input order. Returns false with `error` set on malformed input.
+bool parse_json_object(const std::string& text, std::vector<std::pair<std::string, JsonValue>>& out,
+                       std::string& error);
+
+// Quote and escape `s` as a JSON string.
+void write_json_string(std::ostream& out, const std::string& s);
+
+// Answer the request on `line` with `handler`. Returns false (after writing
+// the response) for a shutdown request.
+bool serve_request(const std::string& line, const ServiceHandler& handler, std::string& response);
+
+// Serve requests from `in` to `out` until end of input or a shutdown request.
+void serve_stream(std::istream& in, std::ostream& out, const ServiceHandler& handler);
+
+// Listen on the Unix socket `path` (replacing a stale socket file) and serve
+// one connection at a time until a shutdown request; removes the socket file
+// on return. Returns false (with a message on stderr) if the socket cannot be
+// set up or Unix sockets are not available.
+bool serve_unix_socket(const std::string& path, const ServiceHandler& handler);
+
+// ------------------------------------------------------------------
+// In-memory cache of parsed CNFs and built VIGs with a byte budget; the least
+// recently used entries are evicted first. Entries are shared, so an evicted
+// entry stays alive while a request still holds it. An entry larger than the
+// whole budget is not kept.
+//
+// Keys are chosen by the caller; cnf_cache_key() names a file by path, size
+// and modification time, so an edited file is parsed again.
+// ------------------------------------------------------------------
+class GraphCache {
+public:
+    explicit GraphCache(std::size_t budget_bytes) : budget_(budget_bytes) {}
+
+    std::shared_ptr<const CNF> find_cnf(const std::string& key) { return find<const CNF>(key); }
+    void store_cnf(const std::string& key, std::shared_ptr<const CNF> cnf);
+
+    // VIGs are handed out mutable: GraphSegmenterFH::run() sorts the edges in
+    // place, which leaves the graph (and every later result on it) unchanged.
+    std::shared_ptr<VIG> find_vig(const std::string& key) { return find<VIG>(key); }
+    void store_vig(const std::string& key, std::shared_ptr<VIG> vig);
+
+    std::size_t budget() const { return budget_; }
+    std::size_t bytes() const { return bytes_; }
+    std::size_t entries() const { return lru_.size(); }
+    uint64_t hits() const { return hits_; }
+    uint64_t misses() const { return misses_; }
+    uint64_t evictions() const { return evictions_; }
+
+    static std::size_t cnf_bytes(const CNF& cnf);
+    static std::size_t vig_bytes(const VIG& g);
+
+private:
+    using Value = std::variant<std::shared_ptr<const CNF>, std::shared_ptr<VIG>>;
+    struct Entry {
+        std::string key;
+        Value value;
+        std::size_t bytes;
+    };
+
+    template <class T>
+    std::shared_ptr<T> find(const std::string& key) {
+        const auto it = index_.find(key);
+        if (it == index_.end() || !std::holds_alternative<std::shared_ptr<T>>(it->second->value)) {
+            ++misses_;
+            return nullptr;
+        }
+        lru_.splice(lru_.begin(), lru_, it->second);
+        ++hits_;
+        return std::get<std::shared_ptr<T>>(it->second->value);
+    }
+    void store(const std::string& key, Value value, std::size_t bytes);
+
+    std::size_t budget_;
+    std::size_t bytes_ = 0;
+    uint64_t hits_ = 0, misses_ = 0, evictions_ = 0;
+    std::list<Entry> lru_; // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+};
+
+// "<absolute path>|<size>|<mtime>" for a file, or "" if it cannot be stat'ed.
+std::string cnf_cache_key(const std::string& path);
+
+} // namespace thesis
@@ -4,6 +4,8 @@
 #include <vector>
 #include <limits>
 #include <cstddef>
+#include <span>
+#include <string>
 #include "thesis/cnf.hpp"
 #include <assert.h>
 #include <cmath>
@@ -40,20 +42,128 @@ namespace thesis
     return a;
   }
 
-  struct Edge
+  // ------------------------------------------------------------------
+  // Edge storage.
+  //
+  // Weight precision and layout are template parameters so large graphs can
+  // use less memory:
+  //   Edge  = BasicEdge<double>  16 bytes (4 bytes padding), the default
+  //   EdgeF = BasicEdge<float>   12 bytes
+  //   EdgeColumns<W>             structure of arrays (u[], v[], w[]), 12 bytes
+  //                              per edge for float; sorts/scans touch only
+  //                              the columns they need.
+  // Consumers (segmentation, modularity, CSV output) go through edge_count(),
+  // edge_at() and for_each_edge() and accept every layout without copying.
+  // ------------------------------------------------------------------
+  template <class W>
+  struct BasicEdge
   {
+    using weight_type = W;
     uint32_t u; // 0-based variable id, canonical u < v
     uint32_t v; // 0-based variable id
-    double w;   // aggregated weight
+    W w;        // aggregated weight
+  };
+
+  using Edge = BasicEdge<double>;
+  using EdgeF = BasicEdge<float>;
+
+  template <class W>
+  struct EdgeColumns
+  {
+    using weight_type = W;
+    std::vector<uint32_t> u;
+    std::vector<uint32_t> v;
+    std::vector<W> w;
+
+    std::size_t size() const { return w.size(); }
+    bool empty() const { return w.empty(); }
+    std::size_t capacity() const { return w.capacity(); }
+    void reserve(std::size_t n)
+    {
+      u.reserve(n);
+      v.reserve(n);
+      w.reserve(n);
+    }
+    void clear()
+    {
+      u.clear();
+      v.clear();
+      w.clear();
+    }
+    void emplace_back(uint32_t a, uint32_t b, double weight)
+    {
+      u.push_back(a);
+      v.push_back(b);
+      w.push_back(static_cast<W>(weight));
+    }
+    BasicEdge<W> operator[](std::size_t i) const { return BasicEdge<W>{u[i], v[i], w[i]}; }
   };
 
-  struct VIG
+  template <class W>
+  inline std::size_t edge_count(const std::vector<BasicEdge<W>> &e) { return e.size(); }
+  template <class W>
+  inline std::size_t edge_count(const EdgeColumns<W> &e) { return e.size(); }
+  template <class W>
+  inline std::size_t edge_count(std::span<const BasicEdge<W>> e) { return e.size(); }
+
+  template <class W>
+  inline const BasicEdge<W> &edge_at(const std::vector<BasicEdge<W>> &e, std::size_t i) { return e[i]; }
+  template <class W>
+  inline BasicEdge<W> edge_at(const EdgeColumns<W> &e, std::size_t i) { return e[i]; }
+  template <class W>
+  inline const BasicEdge<W> &edge_at(std::span<const BasicEdge<W>> e, std::size_t i) { return e[i]; }
+
+  // fn(u, v, w) for every edge, in storage order.
+  template <class Edges, class Fn>
+  inline void for_each_edge(const Edges &edges, Fn &&fn)
+  {
+    const std::size_t m = edge_count(edges);
+    for (std::size_t i = 0; i < m; ++i)
+    {
+      const auto e = edge_at(edges, i);
+      fn(e.u, e.v, e.w);
+    }
+  }
+
+  // Bytes reserved by the edge storage (for memory accounting).
+  template <class W>
+  inline std::size_t edge_storage_bytes(const std::vector<BasicEdge<W>> &e) { return e.capacity() * sizeof(BasicEdge<W>); }
+  template <class W>
+  inline std::size_t edge_storage_bytes(const EdgeColumns<W> &e)
   {
+    return (e.u.capacity() + e.v.capacity()) * sizeof(uint32_t) + e.w.capacity() * sizeof(W);
+  }
+
+  // Copy edges src[begin, begin + count) to the end of dst.
+  template <class W>
+  inline void append_edges(std::vector<BasicEdge<W>> &dst, const std::vector<BasicEdge<W>> &src,
+                           std::size_t begin, std::size_t count)
+  {
+    dst.insert(dst.end(), src.begin() + begin, src.begin() + begin + count);
+  }
+  template <class W>
+  inline void append_edges(EdgeColumns<W> &dst, const EdgeColumns<W> &src, std::size_t begin, std::size_t count)
+  {
+    dst.u.insert(dst.u.end(), src.u.begin() + begin, src.u.begin() + begin + count);
+    dst.v.insert(dst.v.end(), src.v.begin() + begin, src.v.begin() + begin + count);
+    dst.w.insert(dst.w.end(), src.w.begin() + begin, src.w.begin() + begin + count);
+  }
+
+  template <class Edges>
+  struct BasicVIG
+  {
+    using edge_list = Edges;
     uint32_t n{0};
-    std::vector<Edge> edges;
+    Edges edges;
     size_t aggregation_memory{0};
+    double accum_sec{0.0}; // optimized builders: wall time of the per-variable sort-and-reduce phases
   };
 
+  using VIG = BasicVIG<std::vector<Edge>>;            // AoS, double weights (default)
+  using VIGF = BasicVIG<std::vector<EdgeF>>;          // AoS, float weights
+  using VIGColumns = BasicVIG<EdgeColumns<float>>;    // SoA, float weights
+  using VIGColumnsD = BasicVIG<EdgeColumns<double>>;  // SoA, double weights
+
   // Build VIG by aggregating over clause variable pairs.
   VIG build_vig_naive(const CNF &cnf,
                       unsigned clause_size_threshold = std::numeric_limits<unsigned>::max());
@@ -68,4 +178,74 @@ namespace thesis
                           std::size_t max_buffer_contributions,
                           unsigned num_threads);
 
+  // Same builders for any BasicVIG layout, e.g. build_vig_optimized<VIGColumns>(...).
+  // Accumulation is identical; only the final edge store differs. Instantiated for
+  // VIG, VIGF, VIGColumns and VIGColumnsD.
+  template <class G>
+  G build_vig_naive(const CNF &cnf,
+                    unsigned clause_size_threshold = std::numeric_limits<unsigned>::max());
+
+  template <class G>
+  G build_vig_optimized(const CNF &cnf,
+                        unsigned clause_size_threshold,
+                        std::size_t max_buffer_contributions,
+                        unsigned num_threads);
+
+  // Opt-in approximation of huge clauses (meant for tau=inf builds, where a clause of
+  // size s adds s(s-1)/2 pairs). Clauses with cutoff < s <= tau skip the exact clique:
+  // pairs_per_literal * s pairs are drawn uniformly with replacement, each carrying
+  // w(s) * (s(s-1)/2) / draws, so every pair keeps its expected weight and each clause
+  // its exact total weight. Clauses with at least s(s-1)/2 draws stay exact. cutoff 0 = off.
+  struct HugeClauseSampling
+  {
+    unsigned cutoff{0};
+    std::size_t pairs_per_literal{16};
+    uint64_t seed{1};
+  };
+
+  struct HugeClauseStats
+  {
+    std::size_t clauses{0};      // clauses approximated
+    uint64_t pairs_replaced{0};  // exact pairs those clauses would add
+    uint64_t pairs_drawn{0};     // sampled pairs added instead
+  };
+
+  // build_vig_optimized with HugeClauseSampling. The sampled pairs are aggregated
+  // single-threaded (16 bytes per draw) and merged into the optimized builder's
+  // (u, v)-ordered edges. Deterministic for a given seed. Throws
+  // std::invalid_argument if sampling is on with pairs_per_literal == 0.
+  template <class G>
+  G build_vig_optimized(const CNF &cnf,
+                        unsigned clause_size_threshold,
+                        std::size_t max_buffer_contributions,
+                        unsigned num_threads,
+                        const HugeClauseSampling &sampling,
+                        HugeClauseStats *stats = nullptr);
+
+  // Streaming variant of build_vig_optimized for inputs where the CNF and the round
+  // buffers do not fit in memory together. Consumes `cnf`: eligible clauses
+  // (2 <= size <= tau) are spilled to a temporary file in `spill_dir` (the system
+  // temp directory if empty) while Phase 1 counts contributions, the CNF is freed,
+  // and every round re-reads the memory-mapped spill. Rounds are sized so the
+  // builder's working memory stays within `mem_limit` bytes with two rounds live:
+  // the next round is prepared while the current one is reduced. The returned
+  // edge list is not part of the budget. Throws std::runtime_error on spill I/O errors.
+  template <class G>
+  G build_vig_streaming(CNF &&cnf,
+                        unsigned clause_size_threshold,
+                        std::size_t mem_limit,
+                        unsigned num_threads,
+                        const std::string &spill_dir = "");
+
+#define THESIS_VIG_EXTERN_BUILDERS(G)                                     \
+  extern template G build_vig_naive<G>(const CNF &, unsigned);            \
+  extern template G build_vig_optimized<G>(const CNF &, unsigned, std::size_t, unsigned); \
+  extern template G build_vig_optimized<G>(const CNF &, unsigned, std::size_t, unsigned, const HugeClauseSampling &, HugeClauseStats *); \
+  extern template G build_vig_streaming<G>(CNF &&, unsigned, std::size_t, unsigned, const std::string &);
+  THESIS_VIG_EXTERN_BUILDERS(VIG)
+  THESIS_VIG_EXTERN_BUILDERS(VIGF)
+  THESIS_VIG_EXTERN_BUILDERS(VIGColumns)
+  THESIS_VIG_EXTERN_BUILDERS(VIGColumnsD)
+#undef THESIS_VIG_EXTERN_BUILDERS
+
 } // namespace thesis
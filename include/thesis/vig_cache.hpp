@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include "thesis/cnf.hpp"
+#include "thesis/mapped_file.hpp"
+#include "thesis/vig.hpp"
+
+namespace thesis
+{
+
+  // ------------------------------------------------------------------
+  // Binary VIG file format (.vigb), version 1.
+  //
+  //   VigbHeader                       (64 bytes)
+  //   uint64_t row_offsets[n + 1]      CSR over u: edges of u are [row_offsets[u], row_offsets[u+1])
+  //   Edge     edges[edge_count]       sorted by (u, v), u < v
+  //
+  // Native byte order; `endian_tag` rejects files written on a machine of the
+  // other endianness. Edges are stored in canonical (u, v) order so the file
+  // content depends only on the graph, not on the builder or thread count.
+  // ------------------------------------------------------------------
+  struct VigbHeader
+  {
+    static constexpr char kMagic[8] = {'T', 'H', 'V', 'I', 'G', 'B', '\0', '\n'};
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kEndianTag = 0x01020304u;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t endian_tag;
+    uint32_t n;              // number of variables (nodes)
+    uint32_t tau;            // clause size threshold; UINT_MAX = inf
+    uint64_t edge_count;
+    double alpha;            // weighting exponent used for the edge weights
+    uint64_t cnf_hash;       // cnf_fingerprint() of the source CNF
+    uint64_t aggregation_memory; // builder's agg_memory when the file was written
+    uint64_t reserved;
+  };
+  static_assert(sizeof(VigbHeader) == 64, "VigbHeader layout must stay fixed");
+  static_assert(sizeof(Edge) == 16, "Edge layout must stay fixed for .vigb");
+
+  // 64-bit fingerprint of a parsed CNF (variable count and CSR arena). Equal for the
+  // same formula whatever file/compression it was read from.
+  uint64_t cnf_fingerprint(const CNF &cnf);
+
+  // Sort edges by (u, v). Builders leave edges unordered; files and cache hits use
+  // this order, so a cache miss canonicalises too and both paths see the same graph.
+  void canonicalize_edges(VIG &g);
+
+  // Write `g` (must be canonical) to `path`. The file is written under a temporary
+  // name and renamed, so concurrent readers never see a partial file.
+  // Returns false and prints to std::cerr on failure.
+  bool write_vigb(const std::string &path, const VIG &g, unsigned tau, uint64_t cnf_hash);
+
+  // Memory-mapped .vigb file. Edge and offset views point into the mapping.
+  class VigbFile
+  {
+  public:
+    explicit VigbFile(const std::string &path);
+
+    bool is_valid() const { return valid_; }
+    const std::string &error() const { return error_; }
+
+    const VigbHeader &header() const { return *header_; }
+    std::span<const uint64_t> row_offsets() const { return {offsets_, header_->n + std::size_t{1}}; }
+    std::span<const Edge> edges() const { return {edges_, static_cast<std::size_t>(header_->edge_count)}; }
+
+    // Copy into an owning VIG (aggregation_memory = 0: nothing was aggregated).
+    VIG to_vig() const;
+
+  private:
+    MappedFile file_;
+    bool valid_ = false;
+    std::string error_;
+    const VigbHeader *header_ = nullptr;
+    const uint64_t *offsets_ = nullptr;
+    const Edge *edges_ = nullptr;
+  };
+
+  // ------------------------------------------------------------------
+  // Directory cache keyed on (CNF fingerprint, tau):
+  //   <dir>/<16 hex digits>.tau<N|inf>.vigb
+  // ------------------------------------------------------------------
+  std::string vig_cache_path(const std::string &dir, uint64_t cnf_hash, unsigned tau);
+
+  // Load the cached VIG for (cnf_hash, tau) into `out`. Returns false on a miss or
+  // on a file whose header does not match (which is then ignored).
+  bool vig_cache_load(const std::string &dir, uint64_t cnf_hash, unsigned tau, VIG &out);
+
+  // Canonicalise `g` and store it. Creates `dir` if needed; returns false on failure.
+  bool vig_cache_store(const std::string &dir, uint64_t cnf_hash, unsigned tau, VIG &g);
+
+} // namespace thesis
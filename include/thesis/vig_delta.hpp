@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "thesis/cnf.hpp"
+#include "thesis/segmentation.hpp"
+#include "thesis/vig.hpp"
+
+namespace thesis {
+
+// ------------------------------------------------------------------
+// Incremental VIG maintenance for CNFs that change by whole clauses (learned
+// clauses appended, eliminated clauses removed).
+//
+// A clause of s distinct variables (2 <= s <= tau) adds Weighting::pair_weight(s)
+// to each of its s(s-1)/2 variable pairs, with α derived from tau as in the
+// builders, so add_clause()/remove_clause() patch exactly those pairs: the cost
+// is O(s^2 log deg) per clause, independent of the rest of the formula.
+//
+// Storage is a per-variable adjacency sorted by neighbor id; every edge sits in
+// both endpoints' lists with its weight and the number of clauses that gave
+// it. An edge disappears exactly when its last clause is removed, so removals
+// never leave near-zero weights behind. Weights are summed in double precision
+// in clause order, like build_vig_naive(): a graph built from a CNF and then
+// only added to is bit-identical to build_vig_naive() of the final formula;
+// after removals the weights match a rebuild up to rounding.
+// ------------------------------------------------------------------
+class MutableVIG {
+public:
+    struct Adjacent {
+        uint32_t v;       // neighbor id
+        uint32_t clauses; // clauses contributing to the edge
+        double w;         // aggregated weight
+    };
+
+    // Empty graph on n nodes for clause size threshold `tau` (UINT_MAX = inf).
+    explicit MutableVIG(uint32_t n = 0, unsigned tau = std::numeric_limits<unsigned>::max());
+    // The VIG of every clause of `cnf`, built in one bulk pass.
+    MutableVIG(const CNF& cnf, unsigned tau);
+
+    // Add or remove one clause given as DIMACS literals (variable x is node
+    // x - 1; a trailing 0 is allowed). Repeated literals are merged and a
+    // tautology is ignored, as in CNF normalization, and so are clauses outside
+    // 2..tau variables. A variable beyond n() grows the graph. Return the number
+    // of pairs whose weight changed.
+    std::size_t add_clause(std::span<const int> lits);
+    // The clause must have been added (as a graph built from a CNF, or with
+    // add_clause()); this is only checked per pair: if some pair has no clause
+    // left, throws std::invalid_argument and leaves the graph unchanged.
+    std::size_t remove_clause(std::span<const int> lits);
+
+    uint32_t n() const { return static_cast<uint32_t>(adj_.size()); }
+    std::size_t edge_count() const { return edges_; }
+    unsigned tau() const { return tau_; }
+    const Weighting& weighting() const { return weighting_; }
+
+    // Neighbors of x in ascending id order.
+    std::span<const Adjacent> neighbors(uint32_t x) const { return adj_[x]; }
+
+    // Copy out as a VIG with edges in ascending (u, v) order (aggregation_memory = 0).
+    VIG to_vig() const;
+
+    // Nodes whose incident edges changed since the last clear_dirty(), in order
+    // of their first change.
+    const std::vector<uint32_t>& dirty_nodes() const { return dirty_; }
+    void clear_dirty();
+
+private:
+    // Distinct 0-based variables of a clause, ascending; false (and empty) when
+    // the clause contributes nothing (tautology, fewer than 2 or more than tau
+    // variables). Throws std::invalid_argument on a 0 literal before the end.
+    bool clause_vars(std::span<const int> lits, std::vector<uint32_t>& vars);
+    void grow(uint32_t n);
+    void mark_dirty(uint32_t x);
+
+    std::vector<std::vector<Adjacent>> adj_;
+    std::size_t edges_ = 0;
+    unsigned tau_;
+    Weighting weighting_;
+    std::vector<uint32_t> dirty_;
+    std::vector<unsigned char> is_dirty_;
+    std::vector<uint32_t> scratch_;
+    std::vector<int> scratch_lits_;
+};
+
+// What one IncrementalSegmentation::update() did.
+struct ResegmentStats {
+    std::size_t invalidated = 0; // components dissolved (those holding a dirty node)
+    std::size_t nodes = 0;       // nodes re-segmented
+    std::size_t edges = 0;       // edges with both endpoints among them
+    std::size_t components = 0;  // components they were re-segmented into
+    double sec = 0.0;
+};
+
+// A GraphSegmenterFH partition of a MutableVIG kept current under clause edits.
+//
+// update() dissolves only the components that hold a dirty node and segments
+// the subgraph they induce with the same k and Config; every other component
+// keeps its nodes and label. The work is proportional to the size of the
+// invalidated components and their edges. This is a local repair: edges from
+// the region to untouched components are not revisited and the modularity
+// guard sees the region's own total weight, so the partition can differ from a
+// full run on the edited graph (vig_delta --check reports both).
+//
+// Labels are member node ids, as from GraphSegmenterFH::component_labels().
+class IncrementalSegmentation {
+public:
+    // Segment all of g (and clear its dirty set). The Config's candidate store
+    // and trajectory recording are switched off: only labels are kept.
+    IncrementalSegmentation(MutableVIG& g, double k, const GraphSegmenterFH::Config& cfg = {});
+
+    ResegmentStats update(MutableVIG& g);
+
+    const std::vector<unsigned>& labels() const { return labels_; }
+    std::size_t num_components() const { return components_; }
+
+private:
+    void segment(std::span<const uint32_t> nodes, const MutableVIG& g, ResegmentStats& st);
+
+    double k_;
+    GraphSegmenterFH::Config cfg_;
+    std::vector<unsigned> labels_;
+    std::vector<std::vector<unsigned>> members_; // by label
+    std::size_t components_ = 0;
+    std::vector<uint32_t> region_;               // nodes being re-segmented
+    std::vector<uint32_t> local_;                // node -> id within the region
+};
+
+} // namespace thesis
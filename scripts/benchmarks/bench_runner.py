@@ -34,7 +34,9 @@ if PATHS_JSON.exists():
 # - Writes CSVs to scripts/benchmarks/out with identical headers and row shapes
 # - Keeps logs only on failure or when summary parsing fails
 # - Supports: --reuse-files / --from-csv, --skip-existing, --cache/--no-cache, --memlimits, --dry-run, --verbose
-# - Decompression: streams with xz -dc by default; optional caching to a temp file per file
+# - Decompression: streams with xz -dc by default; optional caching to a temp file per file.
+#   With --native-decompress (or "native_decompress": true in configs) compressed files
+#   (.cnf.xz/.cnf.gz/.cnf.bz2) are passed as paths and the tools decode them in-process.
 
 ROOT_DIR = Path(__file__).resolve().parents[2]
 BENCH_DIR_DEFAULT = ROOT_DIR / "benchmarks"
@@ -82,8 +84,11 @@ def ensure_out_dir(out_dir: Path) -> None:
 # (binary discovery is handled via _discover_bin_by_name and registry-provided lists)
 
 
-def list_bench_files(bench_dir: Path) -> List[Path]:
-    pats = ("*.cnf", "*.cnf.xz")
+def list_bench_files(bench_dir: Path, native_decompress: bool = False) -> List[Path]:
+    pats: Tuple[str, ...] = ("*.cnf", "*.cnf.xz")
+    if native_decompress:
+        # the tools read gzip/bzip2 directly too; only listed when they decode natively
+        pats += ("*.cnf.gz", "*.cnf.bz2")
     files: List[Path] = []
     for root, _dirs, _files in os.walk(bench_dir):
         for p in pats:
@@ -230,11 +235,18 @@ def os_is_darwin() -> bool:
 
 # -------------- Execution helpers --------------
 
+def _pipes_input(infile: Path, native_decompress: bool = False) -> bool:
+    """True when `infile` is fed through `xz -dc` on stdin instead of passed by path."""
+    return infile.suffix == ".xz" and not native_decompress
+
+
 def run_with_streaming(cmd: Sequence[str], infile: Path, log_path: Path, verbose: bool,
                        memlimit_mb: Optional[int] = None,
-                       log_header: Optional[str] = None) -> Tuple[int, List[str]]:
+                       log_header: Optional[str] = None,
+                       native_decompress: bool = False) -> Tuple[int, List[str]]:
     """Run `cmd` with stdin as xz -dc of infile (if .xz) or direct file via -i path,
-    capturing stdout to log and memory-limiting on Linux. Return (exit_code, output_lines)."""
+    capturing stdout to log and memory-limiting on Linux. Return (exit_code, output_lines).
+    With native_decompress, compressed files are always passed by path."""
     ensure_out_dir(log_path.parent)
 
     # Prepare stdin source
@@ -257,7 +269,7 @@ def run_with_streaming(cmd: Sequence[str], infile: Path, log_path: Path, verbose
                 print(f"[warn] Failed to set memlimit: {e}", file=sys.stderr)
 
     try:
-        if infile.suffix == ".xz":
+        if _pipes_input(infile, native_decompress):
             # stream via xz -dc, using XZ_PATH
             xz_cmd = [XZ_PATH, "-dc", "--", str(infile)]
             if verbose:
@@ -307,6 +319,51 @@ def run_with_streaming(cmd: Sequence[str], infile: Path, log_path: Path, verbose
                 pass
 
 
+class ServiceClient:
+    """One warm `BIN --serve` process answering JSON-line requests (see the
+    segmentation README). Each request carries the command line the tool would
+    have been started with; the answer holds the same stdout/stderr text."""
+
+    def __init__(self, bin_path: Path, verbose: bool):
+        cmd = [str(bin_path), "--serve"]
+        if verbose:
+            vprint(True, "SERVE:", " ".join(shlex.quote(x) for x in cmd))
+        self.proc = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE, text=True)
+        self.next_id = 0
+
+    def run(self, cmd: Sequence[str], log_path: Path, verbose: bool,
+            log_header: Optional[str] = None) -> Tuple[int, List[str]]:
+        """Send cmd[1:] as one request; log and return (status, output_lines) like run_with_streaming."""
+        ensure_out_dir(log_path.parent)
+        self.next_id += 1
+        if verbose:
+            vprint(True, "REQ:", " ".join(shlex.quote(x) for x in cmd))
+        assert self.proc.stdin is not None and self.proc.stdout is not None
+        self.proc.stdin.write(json.dumps({"id": self.next_id, "args": list(cmd[1:])}) + "\n")
+        self.proc.stdin.flush()
+        line = self.proc.stdout.readline()
+        if not line:
+            raise RuntimeError("service process exited")
+        resp = json.loads(line)
+        text = resp.get("output", "") + resp.get("error", "")
+        with log_path.open("w") as logf:
+            if log_header:
+                logf.write(log_header if log_header.endswith("\n") else log_header + "\n")
+            logf.write(text)
+        if verbose:
+            sys.stderr.write(text)
+        return int(resp.get("status", 1)), text.splitlines()
+
+    def close(self) -> None:
+        try:
+            assert self.proc.stdin is not None
+            self.proc.stdin.write(json.dumps({"shutdown": True}) + "\n")
+            self.proc.stdin.close()
+        except Exception:
+            pass
+        self.proc.wait()
+
+
 # -------------- Generic config runner helpers --------------
 
 def _load_config(path: Path) -> Dict[str, Any]:
@@ -464,7 +521,8 @@ def _product_sweep(param_specs: List[Dict[str, Any]], base_params: Params) -> Li
     return combos
 
 
-def _format_cmd(cmd_template: Sequence[str], params: Params, infile: Path, bin_path: Optional[Path] = None) -> List[str]:
+def _format_cmd(cmd_template: Sequence[str], params: Params, infile: Path, bin_path: Optional[Path] = None,
+                native_decompress: bool = False) -> List[str]:
     # Replace ${key} occurrences with params[key]; special token ${input} becomes '-' or file path
     # If template references ${bin}, ensure it's resolved
     p = dict(params)
@@ -474,7 +532,8 @@ def _format_cmd(cmd_template: Sequence[str], params: Params, infile: Path, bin_p
             if bin_path is None:
                 raise ConfigError("cmd_template uses ${bin} but no binary path was provided or discovered")
             p["bin"] = str(bin_path)
-    tokens = [tok.replace("${input}", "-" if infile.suffix == ".xz" else str(infile)) for tok in cmd_template]
+    input_tok = "-" if _pipes_input(infile, native_decompress) else str(infile)
+    tokens = [tok.replace("${input}", input_tok) for tok in cmd_template]
     for k, v in p.items():
         tokens = [t.replace(f"${{{k}}}", str(v)) for t in tokens]
     # Drop unresolved placeholder pairs like ['-t','${threads}'] or ['--maxbuf','${maxbuf}']
@@ -626,8 +685,11 @@ def run_from_config(config_path: Path, verbose: bool = False) -> int:
 
     vprint(verbose, f"[DEBUG] Files config - count: {count}, reuse_csv: {reuse_csv_path}, hashes: {len(hashes) if hashes else 'None'}")
 
+    # Compressed inputs: pipe through xz (default) or let the tools decode them
+    native_default = bool(cfg.get("native_decompress", False))
+
     # List all benchmark files
-    all_files = list_bench_files(bench_dir)
+    all_files = list_bench_files(bench_dir, native_decompress=native_default)
     vprint(verbose, f"[DEBUG] Found {len(all_files)} total benchmark files in {bench_dir}")
     if not all_files:
         print(f"No benchmark files found in {bench_dir}", file=sys.stderr)
@@ -710,6 +772,7 @@ def run_from_config(config_path: Path, verbose: bool = False) -> int:
 
         # Per-file caching and memlimit
         cache = bool(algo.get("cache", True))
+        native = bool(algo.get("native_decompress", native_default))
         memlimits = algo.get("memlimits", []) or []
 
         # Base params: registry defaults overridden by config
@@ -783,7 +846,7 @@ def run_from_config(config_path: Path, verbose: bool = False) -> int:
 
             # Optional caching for .xz per file
             cached_path: Optional[Path] = None
-            if cache and (fpath.suffix == ".xz"):
+            if cache and _pipes_input(fpath, native):
                 with tempfile.NamedTemporaryFile(prefix="cached_", suffix=".cnf", delete=False, dir=str(out_dir)) as tf:
                     cached_path = Path(tf.name)
                 try:
@@ -823,7 +886,8 @@ def run_from_config(config_path: Path, verbose: bool = False) -> int:
                                 continue
 
                     use_path = cached_path if cached_path is not None else fpath
-                    cmd = _format_cmd([str(x) for x in cmd_template], combo2, use_path, bin_path=bin_path)
+                    cmd = _format_cmd([str(x) for x in cmd_template], combo2, use_path, bin_path=bin_path,
+                                      native_decompress=native)
                     stamp = time.strftime("%Y%m%d-%H%M%S")
                     rand = f"{random.randrange(16**6):06x}"
                     short = _short_hash_tag(combo2, {"file": display_base, "mem": "" if ml is None else str(ml)})
@@ -843,7 +907,8 @@ def run_from_config(config_path: Path, verbose: bool = False) -> int:
                     }
                     log_header = "# bench_runner header\n" + json.dumps(header_map, sort_keys=True) + "\n# ---- output ----\n"
 
-                    rc, lines = run_with_streaming(cmd, use_path, log, verbose, memlimit_mb=ml, log_header=log_header)
+                    rc, lines = run_with_streaming(cmd, use_path, log, verbose, memlimit_mb=ml, log_header=log_header,
+                                                   native_decompress=native)
                     ok = False
                     try:
                         m = _parse_required_keys(lines, required_keys)
@@ -906,10 +971,15 @@ def _add_core_common(sp: argparse.ArgumentParser) -> None:
     sp.add_argument("--memlimits", type=parse_int_list, default=[], help="Comma list of MB (Linux only; ignored on macOS)")
     sp.add_argument("--cache", dest="cache", action="store_true", help="Cache decompression (not needed with streaming)")
     sp.add_argument("--no-cache", dest="cache", action="store_false")
+    sp.add_argument("--native-decompress", action="store_true",
+                    help="Pass .xz/.gz/.bz2 files directly (-i FILE); the tools decompress in-process")
     sp.set_defaults(cache=True)
     sp.add_argument("--reuse-files", dest="reuse_files", action="store_true", help="Reuse file list from CSV")
     sp.add_argument("--from-csv", type=Path, dest="reuse_csv", default=None, help="CSV path; defaults to algo CSV when --reuse-files used")
     sp.add_argument("--skip-existing", action="store_true", help="Skip runs already present in CSV")
+    sp.add_argument("--service", action="store_true",
+                    help="Send every run to one warm `BIN --serve` process (CNFs and VIGs stay cached); "
+                         "inputs are passed by path (implies --cache without --native-decompress), no --memlimits")
     sp.add_argument("--dry-run", action="store_true", help="Plan only; print intended commands")
     sp.add_argument("-v","--verbose", action="store_true", help="Verbose output")
     sp.add_argument("--bench-dir", type=Path, default=BENCH_DIR_DEFAULT)
@@ -1007,8 +1077,15 @@ def run_algorithm_from_registry(algo_name: str, ns: argparse.Namespace, algo_cfg
         print(f"Could not find binary for {algo_name}. Build and/or pass --bin", file=sys.stderr)
         return 2
 
-    # Files
-    all_files = list_bench_files(ns.bench_dir)
+    # Files; a service reads its inputs by path (stdin carries the requests)
+    use_service = bool(getattr(ns, "service", False))
+    if use_service and ns.memlimits:
+        print("--memlimits cannot be applied to a --service run", file=sys.stderr)
+        return 2
+    native = bool(getattr(ns, "native_decompress", False))
+    if use_service and not native:
+        ns.cache = True  # .xz inputs are decompressed to a temp file and passed by path
+    all_files = list_bench_files(ns.bench_dir, native_decompress=native)
     if not all_files:
         print(f"No benchmark files found in {ns.bench_dir}", file=sys.stderr)
         return 4
@@ -1057,12 +1134,14 @@ def run_algorithm_from_registry(algo_name: str, ns: argparse.Namespace, algo_cfg
             spec["when"] = pdef.get("when")
         param_specs.append(spec)
 
+    service = ServiceClient(bin_path, ns.verbose) if use_service and not ns.dry_run else None
+
     # Iterate selections
     for fpath in sel_files:
         display_base = fpath.name
         # Optional per-file cache for .xz
         cached_path: Optional[Path] = None
-        if ns.cache and (fpath.suffix == '.xz') and (not ns.dry_run):
+        if ns.cache and _pipes_input(fpath, native) and (not ns.dry_run):
             with tempfile.NamedTemporaryFile(prefix='cached_', suffix='.cnf', delete=False, dir=str(ns.out_dir)) as tf:
                 cached_path = Path(tf.name)
             try:
@@ -1082,7 +1161,7 @@ def run_algorithm_from_registry(algo_name: str, ns: argparse.Namespace, algo_cfg
                 combo2 = {**combo, **aut}
                 use_path = cached_path if cached_path is not None else fpath
                 cmd_template: List[str] = [str(x) for x in (algo_cfg.get("cmd_template") or [])]
-                cmd = _format_cmd(cmd_template, combo2, use_path, bin_path=bin_path)
+                cmd = _format_cmd(cmd_template, combo2, use_path, bin_path=bin_path, native_decompress=native)
                 # Log path: include params
                 stamp = time.strftime("%Y%m%d-%H%M%S")
                 params_tag = _params_tag(combo2, exclude_keys=["comp_out_dir", "comp_base"]) 
@@ -1126,7 +1205,11 @@ def run_algorithm_from_registry(algo_name: str, ns: argparse.Namespace, algo_cfg
                     "memlimit_mb": None if ml is None else ml,
                 }
                 log_header = "# bench_runner header\n" + json.dumps(header_map, sort_keys=True) + "\n# ---- output ----\n"
-                rc, lines = run_with_streaming(cmd, use_path, log, ns.verbose, memlimit_mb=ml, log_header=log_header)
+                if service is not None:
+                    rc, lines = service.run(cmd, log, ns.verbose, log_header=log_header)
+                else:
+                    rc, lines = run_with_streaming(cmd, use_path, log, ns.verbose, memlimit_mb=ml, log_header=log_header,
+                                                   native_decompress=native)
                 ok = False
                 try:
                     m = _parse_required_keys(lines, required_keys)
@@ -1162,6 +1245,8 @@ def run_algorithm_from_registry(algo_name: str, ns: argparse.Namespace, algo_cfg
             except Exception:
                 pass
 
+    if service is not None:
+        service.close()
     return 0
 
 
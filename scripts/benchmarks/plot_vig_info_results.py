@@ -1,5 +1,6 @@
 #!/usr/bin/env python
 import argparse
+import json
 import os
 from typing import List
 
@@ -202,14 +203,67 @@ def _plot_corr_heatmap(df: pd.DataFrame, outpath: str, title: str, *, exclude_th
     plt.close()
 
 
+def load_bench_json(paths: List[str]) -> pd.DataFrame:
+    """One row per (run, benchmark) from thesis_bench --json files, runs in the given order."""
+    rows = []
+    for run, path in enumerate(paths):
+        with open(path) as f:
+            doc = json.load(f)
+        label = doc.get("context", {}).get("label") or os.path.splitext(os.path.basename(path))[0]
+        for b in doc.get("benchmarks", []):
+            params = " ".join(f"{k}={v}" for k, v in b.get("params", {}).items())
+            rows.append({
+                "run": run,
+                "run_label": label,
+                "bench": f"{b['name']} {params}".strip(),
+                "min_sec": float(b["min_sec"]),
+                "median_sec": float(b["median_sec"]),
+            })
+    return pd.DataFrame(rows)
+
+
+def plot_bench_history(df: pd.DataFrame, outdir: str):
+    """min_sec of every kernel across runs (e.g. commits), relative to the first run that has it."""
+    if df.empty:
+        return
+    d = df.sort_values("run").copy()
+    first = d.groupby("bench")["min_sec"].transform("first")
+    d["rel_min_sec"] = d["min_sec"] / first.where(first > 0)
+    run_labels = dict(zip(d["run"], d["run_label"]))
+
+    pt = d.pivot_table(index="bench", columns="run", values="rel_min_sec", aggfunc="first")
+    pt.columns = [run_labels[c] for c in pt.columns]
+    plot_heatmap(pt, title="kernel time relative to the first run (min over repeats)", cbar_label="min_sec / first",
+                 outpath=os.path.join(outdir, "bench_history_heatmap.png"), cmap="vlag")
+
+    for name, g in d.groupby(d["bench"].str.split(" ").str[0]):
+        plt.figure(figsize=(10, 6))
+        ax = sns.lineplot(data=g, x="run", y="min_sec", hue="bench", marker="o", markersize=6)
+        ax.set_xticks(list(run_labels))
+        ax.set_xticklabels(list(run_labels.values()), rotation=45, ha="right")
+        ax.set_yscale("log")
+        ax.set_title(f"{name}: min_sec per run")
+        ax.set_xlabel("run")
+        ax.set_ylabel("seconds")
+        plt.tight_layout()
+        plt.savefig(os.path.join(outdir, f"bench_history_{name}.png"), dpi=150)
+        plt.close()
+
+
 def main():
     ap = argparse.ArgumentParser(description="Plot VIG construction results heatmaps over tau × threads.")
     ap.add_argument("--csv", default="scripts/benchmarks/out/vig_info_results.csv")
     ap.add_argument("--outdir", default="scripts/benchmarks/out/vig_build_plots")
     ap.add_argument("--impl", default=None, help="Optional: filter to a specific impl (e.g., opt or naive)")
+    ap.add_argument("--bench-json", nargs="+", default=None, metavar="FILE",
+                    help="Instead of --csv: thesis_bench --json files, one per run (e.g. per commit), in order")
     args = ap.parse_args()
 
     ensure_dir(args.outdir)
+    if args.bench_json:
+        plot_bench_history(load_bench_json(args.bench_json), args.outdir)
+        print(f"Wrote plots to {args.outdir}")
+        return
     df = load(args.csv)
 
     # Optional impl filter
@@ -19,6 +19,7 @@ JSON config example:
   "impl": "opt",            # or "naive"
   "threads": 0,             # 0 = auto
   "maxbuf": 50000000,
+  "sweep_threads": 0,       # segment sweep points in parallel (0 = auto)
   "tau": "inf",
   "k": "10,30,100",
   "size_exp": "1.0,1.95",
@@ -126,6 +127,7 @@ def run_seg_eval_on_file(bin_path: Path, cnf_path: Path, out_csv: Path, cfg: dic
     maybe("dq_vscale", "--dq-vscale")
     maybe("ambiguous", "--ambiguous")
     maybe("gate_margin", "--gate-margin")
+    maybe("sweep_threads", "--sweep-threads")
 
     # Print a compact status line
     print(f"[run] {cnf_path} -> {out_csv}")
@@ -0,0 +1,78 @@
+#!/usr/bin/env python
+"""
+Read binary columnar tables (.tcol) written by the C++ tools with --out-format tcol
+(see include/thesis/columnar.hpp for the layout).
+
+Standard library only: columns come back as array.array objects (typecodes 'I',
+'Q', 'f', 'd'), which numpy.asarray() and pandas accept without a copy.
+
+Example:
+  from tcol_utils import read_tcol
+  cols = read_tcol("out/sample.edges.tcol")   # {"u": array('I'), "v": ..., "w": array('d')}
+"""
+from __future__ import annotations
+
+import array
+import struct
+import sys
+from typing import Dict
+
+MAGIC = b"THTCOL\0\n"
+VERSION = 1
+ENDIAN_TAG = 0x01020304
+_HEADER = struct.Struct("=8sIIIIQ")  # magic, version, endian_tag, column_count, reserved, row_count
+_COLUMN = struct.Struct("=24sII")   # name, type, reserved
+# TcolType -> (array typecode, item size)
+_TYPES = {1: ("I", 4), 2: ("Q", 8), 3: ("f", 4), 4: ("d", 8)}
+
+
+def read_tcol(path: str) -> Dict[str, array.array]:
+    """Load every column of a .tcol file, in file order."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < _HEADER.size:
+        raise ValueError(f"{path}: too short for a .tcol header")
+    magic, version, endian_tag, ncols, _, nrows = _HEADER.unpack_from(data, 0)
+    if magic != MAGIC:
+        raise ValueError(f"{path}: not a .tcol file")
+    if version != VERSION:
+        raise ValueError(f"{path}: unsupported .tcol version {version}")
+    if endian_tag != ENDIAN_TAG:
+        raise ValueError(f"{path}: written with the other byte order")
+
+    specs = []
+    pos = _HEADER.size
+    for _ in range(ncols):
+        name, ctype, _ = _COLUMN.unpack_from(data, pos)
+        pos += _COLUMN.size
+        if ctype not in _TYPES:
+            raise ValueError(f"{path}: unknown column type {ctype}")
+        specs.append((name.split(b"\0", 1)[0].decode(), ctype))
+
+    cols: Dict[str, array.array] = {}
+    for name, ctype in specs:
+        code, size = _TYPES[ctype]
+        nbytes = nrows * size
+        if pos + nbytes > len(data):
+            raise ValueError(f"{path}: truncated column '{name}'")
+        col = array.array(code)
+        col.frombytes(data[pos:pos + nbytes])
+        cols[name] = col
+        pos += nbytes + (-nbytes % 8)
+    return cols
+
+
+def main() -> None:
+    # Print a .tcol file as CSV (for quick inspection / diffing against the CSV output).
+    if len(sys.argv) != 2:
+        sys.stderr.write("usage: tcol_utils.py FILE.tcol\n")
+        sys.exit(2)
+    cols = read_tcol(sys.argv[1])
+    names = list(cols)
+    print(",".join(names))
+    for row in zip(*(cols[n] for n in names)):
+        print(",".join(repr(x) if isinstance(x, float) else str(x) for x in row))
+
+
+if __name__ == "__main__":
+    main()
@@ -46,6 +46,23 @@ class TestBenchRunnerCore(unittest.TestCase):
         # maxbuf should be pruned entirely
         self.assertEqual(cmd, ["/bin/echo", "-i", str(infile), "-t", "2"])
 
+    def test_format_cmd_compressed_input(self):
+        tmpl = ["${bin}", "-i", "${input}"]
+        infile = Path("/tmp/test.cnf.xz")
+        # default: .xz is piped through xz -dc, so the tool reads stdin
+        self.assertEqual(br._format_cmd(tmpl, {}, infile, bin_path=Path("/bin/echo")), ["/bin/echo", "-i", "-"])
+        # native: the tool gets the compressed path and decodes it itself
+        self.assertEqual(br._format_cmd(tmpl, {}, infile, bin_path=Path("/bin/echo"), native_decompress=True),
+                         ["/bin/echo", "-i", str(infile)])
+
+    def test_list_bench_files_native_includes_gz_bz2(self):
+        with tempfile.TemporaryDirectory() as d:
+            for name in ("a.cnf", "b.cnf.xz", "c.cnf.gz", "d.cnf.bz2"):
+                (Path(d) / name).write_text("")
+            self.assertEqual([p.name for p in br.list_bench_files(Path(d))], ["a.cnf", "b.cnf.xz"])
+            self.assertEqual([p.name for p in br.list_bench_files(Path(d), native_decompress=True)],
+                             ["a.cnf", "b.cnf.xz", "c.cnf.gz", "d.cnf.bz2"])
+
     def test_product_sweep_with_conditions(self):
         base = {"threads": "1"}
         specs = [
@@ -105,7 +122,7 @@ class TestRunAlgorithmSkipExisting(unittest.TestCase):
         # Patch the runner to avoid executing external binaries
         self._orig_runner = br.run_with_streaming
 
-        def fake_run(cmd, infile, log_path, verbose, memlimit_mb=None):
+        def fake_run(cmd, infile, log_path, verbose, memlimit_mb=None, **_kwargs):
             # Simulate tool output lines with required keys
             # Echo the chosen foo/bar if present
             foo = None
@@ -1,6 +1,7 @@
 #!/usr/bin/env python
 """
 Visualize graph CSVs produced by --graph-out (nodes and edges files).
+Binary .tcol files (--out-format tcol) are read directly, no text parsing.
 
 Inputs:
   - nodes CSV: must have column 'id'; may optionally have 'component' for coloring (from segmentation).
@@ -32,6 +33,8 @@ import random
 import sys
 from typing import List, Optional, Tuple
 
+from tcol_utils import read_tcol
+
 # Prefer a non-interactive backend for headless environments before importing pyplot
 try:
     import matplotlib as mpl
@@ -53,8 +56,8 @@ except Exception as e:
 
 def parse_args() -> argparse.Namespace:
     p = argparse.ArgumentParser(description="Visualize graph from nodes/edges CSVs.")
-    p.add_argument("--nodes", required=True, help="Path to nodes CSV (id[,component])")
-    p.add_argument("--edges", required=True, help="Path to edges CSV (u,v,w)")
+    p.add_argument("--nodes", required=True, help="Path to nodes CSV or .tcol (id[,component])")
+    p.add_argument("--edges", required=True, help="Path to edges CSV or .tcol (u,v,w)")
     p.add_argument("--out", required=True, help="Output image path (e.g., .png, .pdf)")
     p.add_argument("--title", default=None, help="Figure title")
     p.add_argument("--layout", default="spring", choices=[
@@ -81,6 +84,12 @@ def parse_args() -> argparse.Namespace:
 
 
 def read_nodes(nodes_path: str) -> Tuple[List[int], Optional[List[int]]]:
+    if nodes_path.endswith(".tcol"):
+        cols = read_tcol(nodes_path)
+        if "id" not in cols:
+            raise ValueError(f"nodes file missing 'id' column: {list(cols)}")
+        comp = cols.get("component")
+        return list(cols["id"]), (list(comp) if comp is not None else None)
     node_ids: List[int] = []
     components: Optional[List[int]] = None
     with open(nodes_path, newline="") as f:
@@ -107,6 +116,11 @@ def read_nodes(nodes_path: str) -> Tuple[List[int], Optional[List[int]]]:
 
 
 def read_edges(edges_path: str) -> List[Tuple[int, int, float]]:
+    if edges_path.endswith(".tcol"):
+        cols = read_tcol(edges_path)
+        if not {"u", "v", "w"}.issubset(cols):
+            raise ValueError(f"edges file missing columns; expected u,v,w, got {list(cols)}")
+        return list(zip(cols["u"], cols["v"], (float(w) for w in cols["w"])))
     edges: List[Tuple[int, int, float]] = []
     with open(edges_path, newline="") as f:
         rdr = csv.DictReader(f)
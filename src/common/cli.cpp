@@ -178,8 +178,22 @@ std::size_t ArgParser::get_size(const std::string& longName) const {
     const char* begin = s.data();
     const char* end = s.data() + s.size();
     auto [ptr, ec] = std::from_chars(begin, end, value);
+    // Optional binary suffix: K, M, G, T (case-insensitive).
+    unsigned shift = 0;
+    if (ec == std::errc{} && ptr + 1 == end) {
+        switch (*ptr) {
+        case 'k': case 'K': shift = 10; break;
+        case 'm': case 'M': shift = 20; break;
+        case 'g': case 'G': shift = 30; break;
+        case 't': case 'T': shift = 40; break;
+        default: break;
+        }
+        if (shift) ++ptr;
+    }
     if (ec != std::errc{} || ptr != end) throw std::invalid_argument("invalid size: " + s);
-    return static_cast<std::size_t>(value);
+    if (shift && value > (std::numeric_limits<unsigned long long>::max() >> shift))
+        throw std::invalid_argument("size out of range: " + s);
+    return static_cast<std::size_t>(value << shift);
 }
 
 bool ArgParser::get_flag(const std::string& longName) const {
@@ -0,0 +1,625 @@
+// ----------------------------------------------------------------------------
+// cnf.cpp
+//
+// DIMACS CNF loader.
+//
+// Implementation highlights:
+//  - Input is a contiguous byte buffer: regular files are memory-mapped
+//    (thesis::MappedFile), streams (stdin) are read into one buffer in chunks.
+//  - gzip/xz/bzip2 input (detected by magic bytes) is decompressed on a
+//    background thread (thesis::DecompressingReader) and scanned block by block
+//    while decoding continues; nothing is written to disk.
+//  - Single pass over the bytes with a hand-written integer scanner; no line
+//    splitting, so clauses may span lines and several clauses may share a line.
+//  - Clauses are stored in a flat arena (CSR): literals + clause_offsets.
+//  - Parallel mode (num_threads > 1, large inputs): the clause section is cut
+//    right after clause-terminating 0 tokens, each thread scans its chunk into
+//    a local arena, and the arenas are stitched in order.
+//  - Compaction and normalization work in place on the arena, over clause
+//    ranges balanced by literal count. Compaction merges per-range
+//    first-occurrence tables so renumbering matches the sequential order;
+//    normalization shrinks each range in place, then closes the gaps.
+// ----------------------------------------------------------------------------
+#include "thesis/cnf.hpp"
+
+#include "thesis/decompress.hpp"
+#include "thesis/mapped_file.hpp"
+#include "thesis/numa.hpp"
+#include "thesis/profile.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace thesis {
+
+namespace {
+
+inline bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+inline const char *skip_line(const char *p, const char *end) {
+  const void *nl = std::memchr(p, '\n', static_cast<std::size_t>(end - p));
+  return nl ? static_cast<const char *>(nl) + 1 : end;
+}
+
+// Parse an unsigned decimal at p. Returns false on missing digits or overflow past max.
+inline bool scan_unsigned(const char *&p, const char *end, std::uint64_t max, std::uint64_t &out) {
+  if (p == end || !is_digit(*p)) return false;
+  std::uint64_t v = 0;
+  while (p < end && is_digit(*p)) {
+    v = v * 10u + static_cast<std::uint64_t>(*p - '0');
+    if (v > max) return false;
+    ++p;
+  }
+  out = v;
+  return true;
+}
+
+// Below this many bytes per thread the serial scanner is faster than spawning.
+constexpr std::size_t kMinParallelChunkBytes = std::size_t{1} << 20;
+
+// Threads to use for `units` of work: the request (0 = hardware concurrency),
+// capped so that every thread gets at least `min_units` units.
+inline unsigned effective_threads(unsigned requested, std::size_t units, std::size_t min_units) {
+  unsigned t = requested;
+  if (t == 0) {
+    const unsigned hc = std::thread::hardware_concurrency();
+    t = hc ? hc : 1u;
+  }
+  const std::size_t cap = std::max<std::size_t>(1, units / std::max<std::size_t>(1, min_units));
+  return static_cast<unsigned>(std::min<std::size_t>(t, cap));
+}
+
+// Run fn(tid) for tid in [0, t); the calling thread takes tid 0.
+template <class Fn>
+void run_parallel(unsigned t, Fn &&fn) {
+  if (t <= 1) {
+    fn(0u);
+    return;
+  }
+  std::vector<std::thread> pool;
+  pool.reserve(t - 1);
+  for (unsigned tid = 1; tid < t; ++tid)
+    pool.emplace_back([&fn, tid, t] {
+      ScopedPlacement pin(tid, t);
+      fn(tid);
+    });
+  {
+    ScopedPlacement pin(0, t);
+    fn(0u);
+  }
+  for (auto &th : pool) th.join();
+}
+
+// True if [b, e) is a literal whose value is 0 (a clause terminator).
+inline bool is_zero_token(const char *b, const char *e) {
+  if (b < e && (*b == '-' || *b == '+')) ++b;
+  if (b == e) return false;
+  for (; b < e; ++b)
+    if (*b != '0') return false;
+  return true;
+}
+
+// First position at or after `from` that directly follows a clause-terminating
+// 0 token (or a '%' marker). Starts at the next line start so it never begins
+// inside a comment.
+const char *find_clause_boundary(const char *from, const char *body_begin, const char *end) {
+  const char *p = from;
+  if (p > body_begin && p[-1] != '\n') p = skip_line(p, end);
+  while (p < end) {
+    if (is_space(*p)) {
+      ++p;
+      continue;
+    }
+    if (*p == 'c') {
+      p = skip_line(p, end);
+      continue;
+    }
+    if (*p == '%') return p;
+    const char *tok = p;
+    while (p < end && !is_space(*p)) ++p;
+    if (is_zero_token(tok, p)) return p;
+  }
+  return end;
+}
+
+// Appends clauses scanned from a byte range to a CSR arena. Offsets are relative
+// to `lits`; `offs` must start with a 0 entry.
+struct ArenaScanner {
+  std::vector<int> &lits;
+  std::vector<std::size_t> &offs;
+  std::size_t clause_start = 0;
+  std::uint64_t max_var = 0;
+  bool saw_end_marker = false;
+
+  ArenaScanner(std::vector<int> &l, std::vector<std::size_t> &o) : lits(l), offs(o), clause_start(l.size()) {}
+
+  // Returns nullptr on success or the position of a malformed token.
+  const char *scan(const char *p, const char *end) {
+    while (p < end) {
+      const char ch = *p;
+      if (is_space(ch)) {
+        ++p;
+        continue;
+      }
+      if (ch == 'c') { // comment line
+        p = skip_line(p, end);
+        continue;
+      }
+      if (ch == '%') { // SATLIB end-of-clauses marker
+        saw_end_marker = true;
+        return nullptr;
+      }
+
+      bool negative = false;
+      if (ch == '-' || ch == '+') {
+        negative = (ch == '-');
+        ++p;
+      }
+      std::uint64_t v = 0;
+      if (!scan_unsigned(p, end, static_cast<std::uint64_t>(INT_MAX), v) || (p < end && !is_space(*p)))
+        return p;
+      if (v == 0) {
+        // Clause end; empty clauses are dropped as before
+        if (lits.size() > clause_start) offs.push_back(lits.size());
+        clause_start = lits.size();
+        continue;
+      }
+      if (v > max_var) max_var = v;
+      const int lit = static_cast<int>(v);
+      lits.push_back(negative ? -lit : lit);
+    }
+    return nullptr;
+  }
+
+  // Close a final clause that lacks its terminating 0.
+  void finish() {
+    if (lits.size() > clause_start) offs.push_back(lits.size());
+    clause_start = lits.size();
+  }
+};
+
+enum class HeaderStatus { Ok, Error, NeedMore };
+
+// Skip leading comments/blank space and parse 'p cnf <vars> <clauses>', leaving p
+// just after the clause count. With `partial`, a buffer that ends before the
+// problem line is complete yields NeedMore instead of an error.
+HeaderStatus scan_problem_line(const char *&p, const char *end, std::uint64_t &vars, std::uint64_t &clauses,
+                               bool partial, std::string &error) {
+  // Skip comment lines (starting with 'c') and blank space up to the problem line
+  for (;;) {
+    while (p < end && is_space(*p)) ++p;
+    if (p < end && *p == 'c') {
+      const char *next = skip_line(p, end);
+      if (partial && next == end && (next == p || next[-1] != '\n')) return HeaderStatus::NeedMore;
+      p = next;
+      continue;
+    }
+    break;
+  }
+  if (partial && (p == end || !std::memchr(p, '\n', static_cast<std::size_t>(end - p))))
+    return HeaderStatus::NeedMore;
+
+  // Parse the 'p cnf <vars> <clauses>' line
+  if (p == end || *p != 'p') {
+    error = "no valid problem line (starting with 'p') found";
+    return HeaderStatus::Error;
+  }
+  ++p;
+  while (p < end && (*p == ' ' || *p == '\t')) ++p;
+  while (p < end && !is_space(*p)) ++p; // format token ("cnf")
+  while (p < end && (*p == ' ' || *p == '\t')) ++p;
+  bool header_ok = scan_unsigned(p, end, UINT_MAX, vars);
+  while (p < end && (*p == ' ' || *p == '\t')) ++p;
+  header_ok = header_ok && scan_unsigned(p, end, UINT_MAX, clauses);
+  if (!header_ok) {
+    error = "malformed problem line (expected 'p cnf <vars> <clauses>')";
+    return HeaderStatus::Error;
+  }
+  return HeaderStatus::Ok;
+}
+
+} // namespace
+
+void CNF::reset() {
+  valid = false;
+  error_message.clear();
+  variable_count = 0;
+  clause_count = 0;
+  literals.clear();
+  clause_offsets.assign(1, 0);
+}
+
+CNF::CNF(std::istream &in, bool variable_compaction, bool normalize, unsigned num_threads) {
+  profile::ScopedPhase phase("parse");
+  // Slurp the stream into one contiguous buffer; the scanner needs random access.
+  std::vector<char> buf;
+  constexpr std::size_t kChunk = std::size_t{1} << 20;
+  std::size_t used = 0;
+  for (;;) {
+    buf.resize(used + kChunk);
+    in.read(buf.data() + used, static_cast<std::streamsize>(kChunk));
+    const std::size_t got = static_cast<std::size_t>(in.gcount());
+    used += got;
+    if (used == got) {
+      // First chunk: compressed streams are decoded on the fly instead
+      const Compression c = detect_compression(buf.data(), used);
+      if (c != Compression::None) {
+        DecompressingReader reader(c, in, std::string(buf.data(), used));
+        parse_stream(reader, variable_compaction, normalize, num_threads);
+        return;
+      }
+    }
+    if (got < kChunk) break;
+  }
+  buf.resize(used);
+  parse_buffer(buf.data(), buf.data() + buf.size(), variable_compaction, normalize, num_threads);
+}
+
+CNF::CNF(const std::string &file_path, bool variable_compaction, bool normalize, unsigned num_threads) {
+  profile::ScopedPhase phase("parse");
+  MappedFile file(file_path);
+  if (!file.is_open()) {
+    error_message = "could not open the file";
+    return;
+  }
+  const Compression c = detect_compression(file.data(), file.size());
+  if (c != Compression::None) {
+    DecompressingReader reader(c, file.data(), file.size());
+    parse_stream(reader, variable_compaction, normalize, num_threads);
+    return;
+  }
+  parse_buffer(file.data(), file.data() + file.size(), variable_compaction, normalize, num_threads);
+}
+
+bool CNF::parse_stream(DecompressingReader &reader, bool variable_compaction, bool normalize,
+                       unsigned num_threads) {
+  reset();
+
+  // Blocks are scanned in line-complete pieces so no token straddles two calls;
+  // only the partial last line of each block is copied (into `carry`).
+  std::string carry;
+  bool header_done = false;
+  std::size_t consumed = 0; // decompressed bytes before carry, for error offsets
+  ArenaScanner sc(literals, clause_offsets);
+
+  auto scan_piece = [&](const char *b, const char *e) {
+    if (const char *bad = sc.scan(b, e)) {
+      error_message = "malformed literal near byte offset " + std::to_string(consumed + static_cast<std::size_t>(bad - b));
+      return false;
+    }
+    consumed += static_cast<std::size_t>(e - b);
+    return true;
+  };
+  // Parse the problem line from the start of carry once it is complete.
+  auto try_header = [&](bool at_eof) {
+    const char *p = carry.data();
+    const char *end = p + carry.size();
+    std::uint64_t vars = 0, clauses = 0;
+    switch (scan_problem_line(p, end, vars, clauses, /*partial=*/!at_eof, error_message)) {
+    case HeaderStatus::NeedMore: return true;
+    case HeaderStatus::Error: return false;
+    case HeaderStatus::Ok: break;
+    }
+    variable_count = static_cast<unsigned int>(vars);
+    clause_count = static_cast<unsigned int>(clauses);
+    clause_offsets.reserve(static_cast<std::size_t>(clause_count) + 1);
+    header_done = true;
+    consumed = static_cast<std::size_t>(p - carry.data());
+    carry.erase(0, consumed);
+    return true;
+  };
+
+  std::string_view block;
+  while (!sc.saw_end_marker && reader.next(block)) {
+    if (!header_done) {
+      carry.append(block);
+      if (!try_header(false)) return false;
+      continue;
+    }
+    const char *b = block.data();
+    const char *e = b + block.size();
+    const char *last_nl = e;
+    while (last_nl > b && last_nl[-1] != '\n') --last_nl;
+    if (last_nl == b) { // no line end in this block
+      carry.append(block);
+      continue;
+    }
+    // Complete the carried line with this block's first line, then scan the
+    // whole lines in place.
+    const char *first_nl = static_cast<const char *>(std::memchr(b, '\n', block.size())) + 1;
+    carry.append(b, first_nl);
+    if (!scan_piece(carry.data(), carry.data() + carry.size())) return false;
+    if (!sc.saw_end_marker && first_nl < last_nl && !scan_piece(first_nl, last_nl)) return false;
+    carry.assign(last_nl, e);
+  }
+  if (reader.failed()) {
+    error_message = reader.error();
+    return false;
+  }
+  if (!header_done && !try_header(true)) return false;
+  if (!sc.saw_end_marker && !scan_piece(carry.data(), carry.data() + carry.size())) return false;
+  sc.finish();
+
+  return finalize(sc.max_var, variable_compaction, normalize, num_threads);
+}
+
+bool CNF::parse_buffer(const char *begin, const char *end, bool variable_compaction, bool normalize,
+                       unsigned num_threads) {
+  reset();
+
+  const char *p = begin;
+  std::uint64_t declared_vars = 0, declared_clauses = 0;
+  if (scan_problem_line(p, end, declared_vars, declared_clauses, /*partial=*/false, error_message) != HeaderStatus::Ok)
+    return false;
+  variable_count = static_cast<unsigned int>(declared_vars);
+  clause_count = static_cast<unsigned int>(declared_clauses);
+
+  // Read and parse the clauses: a stream of integers where 0 terminates a clause
+  const std::size_t body_bytes = static_cast<std::size_t>(end - p);
+  const unsigned t = effective_threads(num_threads, body_bytes, kMinParallelChunkBytes);
+  std::uint64_t max_var = 0;
+  if (t == 1) {
+    clause_offsets.reserve(static_cast<std::size_t>(clause_count) + 1);
+    ArenaScanner sc(literals, clause_offsets);
+    if (const char *bad = sc.scan(p, end)) {
+      error_message = "malformed literal near byte offset " + std::to_string(bad - begin);
+      return false;
+    }
+    sc.finish();
+    max_var = sc.max_var;
+  } else {
+    // Cut the body right after clause terminators so no clause straddles two chunks.
+    std::vector<const char *> cuts(t + 1, end);
+    cuts[0] = p;
+    for (unsigned i = 1; i < t; ++i) {
+      const char *target = std::max(p + (body_bytes * i) / t, cuts[i - 1]);
+      cuts[i] = find_clause_boundary(target, p, end);
+    }
+
+    struct Chunk {
+      std::vector<int> lits;
+      std::vector<std::size_t> offs{0};
+      std::uint64_t max_var = 0;
+      bool saw_end_marker = false;
+      const char *bad = nullptr;
+    };
+    std::vector<Chunk> chunks(t);
+    run_parallel(t, [&](unsigned tid) {
+      Chunk &ch = chunks[tid];
+      const std::size_t bytes = static_cast<std::size_t>(cuts[tid + 1] - cuts[tid]);
+      ch.lits.reserve(bytes / 4); // rough guess: short literals plus a separator
+      ArenaScanner sc(ch.lits, ch.offs);
+      ch.bad = sc.scan(cuts[tid], cuts[tid + 1]);
+      sc.finish();
+      ch.max_var = sc.max_var;
+      ch.saw_end_marker = sc.saw_end_marker;
+    });
+
+    // Chunks after a '%' marker are ignored, exactly like the serial scan.
+    unsigned used_chunks = t;
+    for (unsigned i = 0; i < t; ++i) {
+      if (chunks[i].bad) {
+        error_message = "malformed literal near byte offset " + std::to_string(chunks[i].bad - begin);
+        return false;
+      }
+      if (chunks[i].saw_end_marker) {
+        used_chunks = i + 1;
+        break;
+      }
+    }
+
+    // Stitch the chunk arenas in order.
+    std::vector<std::size_t> lit_base(used_chunks + 1, 0), clause_base(used_chunks + 1, 0);
+    for (unsigned i = 0; i < used_chunks; ++i) {
+      lit_base[i + 1] = lit_base[i] + chunks[i].lits.size();
+      clause_base[i + 1] = clause_base[i] + (chunks[i].offs.size() - 1);
+      max_var = std::max(max_var, chunks[i].max_var);
+    }
+    literals.resize(lit_base[used_chunks]);
+    clause_offsets.resize(clause_base[used_chunks] + 1);
+    clause_offsets[0] = 0;
+    run_parallel(used_chunks, [&](unsigned tid) {
+      Chunk &ch = chunks[tid];
+      std::copy(ch.lits.begin(), ch.lits.end(), literals.begin() + static_cast<std::ptrdiff_t>(lit_base[tid]));
+      for (std::size_t c = 1; c < ch.offs.size(); ++c)
+        clause_offsets[clause_base[tid] + c] = lit_base[tid] + ch.offs[c];
+      std::vector<int>().swap(ch.lits);
+      std::vector<std::size_t>().swap(ch.offs);
+    });
+  }
+
+  return finalize(max_var, variable_compaction, normalize, t);
+}
+
+bool CNF::finalize(std::uint64_t max_var, bool variable_compaction, bool normalize, unsigned num_threads) {
+  // Files that use more variables than declared would otherwise index out of range
+  if (max_var > variable_count) variable_count = static_cast<unsigned int>(max_var);
+
+  // Perform optional variable compaction first
+  valid = true; // We'll normalize and set clause_count to actual retained clauses
+
+  if (variable_compaction) {
+    do_compact_variables(num_threads);
+  }
+
+  // Normalize all clauses and update clause_count if requested
+  if (valid && normalize) {
+    do_normalize_clauses(num_threads);
+  }
+  return valid;
+}
+
+std::vector<std::size_t> CNF::clause_partition(unsigned parts) const {
+  // parts+1 clause indices; ranges carry roughly equal literal counts.
+  const std::size_t num = clause_offsets.size() - 1;
+  const std::size_t total = literals.size();
+  std::vector<std::size_t> cuts(parts + 1, num);
+  cuts[0] = 0;
+  for (unsigned i = 1; i < parts; ++i) {
+    const std::size_t target = (total * i) / parts;
+    auto it = std::lower_bound(clause_offsets.begin(), clause_offsets.end() - 1, target);
+    cuts[i] = std::max(static_cast<std::size_t>(it - clause_offsets.begin()), cuts[i - 1]);
+  }
+  return cuts;
+}
+
+void CNF::do_compact_variables(unsigned num_threads) {
+  // Remap variable indices to a dense range starting at 1, preserving sign.
+  // Numbering follows first occurrence in clause order, so it is deterministic.
+  const unsigned t = effective_threads(num_threads, literals.size(), kMinParallelChunkBytes / 4);
+  if (t == 1) {
+    std::vector<int> variable_map(variable_count, 0);
+    unsigned int current_renamed_variable = 1;
+    for (int &literal : literals) {
+      unsigned int var_idx = static_cast<unsigned int>(std::abs(literal)) - 1;
+      if (var_idx >= variable_map.size()) {
+        // Extend map if the file declared fewer variables than used
+        variable_map.resize(var_idx + 1, 0);
+      }
+      if (variable_map[var_idx] == 0) {
+        variable_map[var_idx] = current_renamed_variable++;
+      }
+      int literal_sign = (literal < 0) ? -1 : 1;
+      literal = literal_sign * variable_map[var_idx];
+    }
+    variable_count = current_renamed_variable - 1;
+    return;
+  }
+
+  // Parallel: a variable's global rank is (first range it occurs in, rank within
+  // that range), which is exactly its sequential first-occurrence rank.
+  std::size_t n = variable_count;
+  for (int lit : literals) n = std::max<std::size_t>(n, static_cast<std::size_t>(std::abs(lit)));
+  const std::vector<std::size_t> cuts = clause_partition(t);
+  auto lit_range = [&](unsigned tid) {
+    return std::make_pair(clause_offsets[cuts[tid]], clause_offsets[cuts[tid + 1]]);
+  };
+
+  // 1) owner[v] = first range containing v
+  std::unique_ptr<std::atomic<unsigned>[]> owner(new std::atomic<unsigned>[n]);
+  run_parallel(t, [&](unsigned tid) {
+    const std::size_t b = (n * tid) / t, e = (n * (tid + 1)) / t;
+    for (std::size_t v = b; v < e; ++v) owner[v].store(UINT_MAX, std::memory_order_relaxed);
+  });
+  run_parallel(t, [&](unsigned tid) {
+    const auto [b, e] = lit_range(tid);
+    for (std::size_t i = b; i < e; ++i) {
+      auto &o = owner[static_cast<std::size_t>(std::abs(literals[i])) - 1];
+      unsigned cur = o.load(std::memory_order_relaxed);
+      while (tid < cur && !o.compare_exchange_weak(cur, tid, std::memory_order_relaxed)) {
+      }
+    }
+  });
+
+  // 2) each range numbers the variables it owns in local first-occurrence order
+  std::vector<unsigned> local_id(n, 0);
+  std::vector<unsigned> owned(t, 0);
+  run_parallel(t, [&](unsigned tid) {
+    const auto [b, e] = lit_range(tid);
+    unsigned cnt = 0;
+    for (std::size_t i = b; i < e; ++i) {
+      const std::size_t v = static_cast<std::size_t>(std::abs(literals[i])) - 1;
+      // Only the owner touches local_id[v], so check ownership first.
+      if (owner[v].load(std::memory_order_relaxed) == tid && local_id[v] == 0) local_id[v] = ++cnt;
+    }
+    owned[tid] = cnt;
+  });
+
+  // 3) merge the tables (prefix over ranges) and rewrite literals
+  std::vector<unsigned> base(t, 0);
+  for (unsigned i = 1; i < t; ++i) base[i] = base[i - 1] + owned[i - 1];
+  run_parallel(t, [&](unsigned tid) {
+    const auto [b, e] = lit_range(tid);
+    for (std::size_t i = b; i < e; ++i) {
+      const int literal = literals[i];
+      const std::size_t v = static_cast<std::size_t>(std::abs(literal)) - 1;
+      const int renamed = static_cast<int>(base[owner[v].load(std::memory_order_relaxed)] + local_id[v]);
+      literals[i] = (literal < 0) ? -renamed : renamed;
+    }
+  });
+  variable_count = base[t - 1] + owned[t - 1];
+}
+
+void CNF::do_normalize_clauses(unsigned num_threads) {
+  const unsigned t = effective_threads(num_threads, literals.size(), kMinParallelChunkBytes / 4);
+  const std::vector<std::size_t> cuts = clause_partition(t);
+
+  // Each range shrinks its clauses in place inside its own literal span and
+  // records the (absolute) end offsets of retained clauses.
+  std::vector<std::vector<std::size_t>> kept_ends(t);
+  std::vector<std::size_t> span_begin(t, 0), span_end(t, 0);
+  run_parallel(t, [&](unsigned tid) {
+    std::size_t write = clause_offsets[cuts[tid]]; // next free slot in literals
+    span_begin[tid] = write;
+    auto &ends = kept_ends[tid];
+    ends.reserve(cuts[tid + 1] - cuts[tid]);
+    for (std::size_t ci = cuts[tid]; ci < cuts[tid + 1]; ++ci) {
+      const std::size_t b = clause_offsets[ci];
+      const std::size_t e = clause_offsets[ci + 1];
+      if (b == e) continue; // Skip empty
+
+      std::sort(literals.begin() + static_cast<std::ptrdiff_t>(b), literals.begin() + static_cast<std::ptrdiff_t>(e),
+                [](int x, int y) {
+                  int xx = std::abs(x), yy = std::abs(y);
+                  if (xx != yy) return xx < yy;
+                  return x < y; // tie-break for deterministic order
+                });
+
+      const std::size_t out_begin = write;
+      bool taut = false;
+      int prev_abs = 0;
+      int prev_sign = 0;
+      bool has_prev = false;
+      for (std::size_t i = b; i < e; ++i) {
+        const int lit = literals[i];
+        const int a = std::abs(lit);
+        const int s = (lit < 0) ? -1 : 1;
+        if (has_prev && a == prev_abs) {
+          if (s != prev_sign) { taut = true; break; } // literal and its negation present
+          // duplicate with same sign, skip
+          continue;
+        }
+        // new variable (by abs); write <= i, so this never clobbers unread input
+        literals[write++] = lit;
+        prev_abs = a; prev_sign = s; has_prev = true;
+      }
+
+      if (taut || write == out_begin) {
+        write = out_begin; // drop the clause
+        continue;
+      }
+      ends.push_back(write);
+    }
+    span_end[tid] = write;
+  });
+
+  // Close the gaps between ranges (left to right, so moves never overlap unread data).
+  std::size_t write = 0;
+  std::size_t kept = 0;
+  for (unsigned tid = 0; tid < t; ++tid) {
+    const std::size_t src = span_begin[tid];
+    const std::size_t len = span_end[tid] - src;
+    if (src != write && len)
+      std::memmove(literals.data() + write, literals.data() + src, len * sizeof(int));
+    for (std::size_t end_abs : kept_ends[tid]) clause_offsets[++kept] = end_abs - src + write;
+    write += len;
+  }
+
+  literals.resize(write);
+  clause_offsets.resize(kept + 1);
+  clause_count = static_cast<unsigned int>(kept);
+}
+
+} // namespace thesis
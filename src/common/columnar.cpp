@@ -0,0 +1,60 @@
+#include "thesis/columnar.hpp"
+
+#include <cstring>
+#include <iostream>
+
+namespace thesis {
+
+ColumnarWriter::ColumnarWriter(const std::string& path, uint64_t rows, const std::vector<Spec>& columns)
+    : rows_(rows) {
+    out_.open(path, std::ios::binary | std::ios::trunc);
+    if (!out_) return;
+    TcolHeader h{};
+    std::memcpy(h.magic, TcolHeader::kMagic, sizeof(h.magic));
+    h.version = TcolHeader::kVersion;
+    h.endian_tag = TcolHeader::kEndianTag;
+    h.column_count = static_cast<uint32_t>(columns.size());
+    h.row_count = rows;
+    write_bytes(&h, sizeof(h));
+    for (const Spec& s : columns) {
+        TcolColumn c{};
+        std::strncpy(c.name, s.name.c_str(), sizeof(c.name) - 1);
+        c.type = s.type;
+        write_bytes(&c, sizeof(c));
+        types_.push_back(s.type);
+    }
+}
+
+ColumnarWriter::~ColumnarWriter() {
+    if (out_.is_open()) out_.close();
+}
+
+bool ColumnarWriter::begin_column(TcolType type) {
+    if (!out_) return false;
+    if (next_ >= types_.size() || types_[next_] != type) {
+        std::cerr << "Error: .tcol column " << next_ << " written with the wrong type or out of order\n";
+        out_.setstate(std::ios::failbit);
+        return false;
+    }
+    return true;
+}
+
+void ColumnarWriter::end_column(uint64_t bytes) {
+    static constexpr char kZeros[8] = {};
+    write_bytes(kZeros, static_cast<std::size_t>((8 - bytes % 8) % 8));
+    ++next_;
+}
+
+void ColumnarWriter::write_bytes(const void* p, std::size_t n) {
+    if (n) out_.write(static_cast<const char*>(p), static_cast<std::streamsize>(n));
+}
+
+bool ColumnarWriter::close() {
+    if (!out_.is_open()) return false;
+    out_.flush();
+    const bool ok = static_cast<bool>(out_) && next_ == types_.size();
+    out_.close();
+    return ok;
+}
+
+} // namespace thesis
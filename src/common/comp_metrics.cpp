@@ -1,6 +1,7 @@
 // Implementation of compact metrics for component sizes.
 // See include/thesis/comp_metrics.hpp for API and detailed semantics.
 #include "thesis/comp_metrics.hpp"
+#include "thesis/profile.hpp"
 #include <algorithm>
 #include <numeric>
 #include <cmath>
@@ -10,6 +11,7 @@ namespace thesis {
 
 // Compute the summary metrics for a given vector of component sizes.
 CompSummary summarize_components(const std::vector<uint32_t>& sizes) {
+    profile::ScopedPhase phase("metrics.summarize");
     CompSummary s;
     s.K = static_cast<uint32_t>(sizes.size());
     const uint64_t S64 = std::accumulate(sizes.begin(), sizes.end(), uint64_t{0});
@@ -0,0 +1,59 @@
+#include "thesis/concurrent_disjoint_set.hpp"
+
+#include <utility>
+
+namespace thesis {
+
+ConcurrentDisjointSets::ConcurrentDisjointSets(std::size_t n) {
+    reset(n);
+}
+
+void ConcurrentDisjointSets::reset(std::size_t n) {
+    if (n != n_ || !parent_) parent_ = std::make_unique<std::atomic<unsigned>[]>(n);
+    n_ = n;
+    for (unsigned i = 0; i < n; ++i) parent_[i].store(i, std::memory_order_relaxed);
+    rank_.assign(n, 0);
+    comp_count_.store(static_cast<unsigned>(n), std::memory_order_relaxed);
+}
+
+void ConcurrentDisjointSets::assign(const DisjointSets& s) {
+    const std::vector<unsigned>& parent = s.parents();
+    if (parent.size() != n_ || !parent_) parent_ = std::make_unique<std::atomic<unsigned>[]>(parent.size());
+    n_ = parent.size();
+    for (std::size_t i = 0; i < n_; ++i) parent_[i].store(parent[i], std::memory_order_relaxed);
+    rank_ = s.ranks();
+    comp_count_.store(s.components(), std::memory_order_relaxed);
+}
+
+void ConcurrentDisjointSets::copy_to(DisjointSets& s) const {
+    std::vector<unsigned> parent(n_);
+    for (std::size_t i = 0; i < n_; ++i) parent[i] = parent_[i].load(std::memory_order_relaxed);
+    s.assign(std::move(parent), rank_);
+}
+
+unsigned ConcurrentDisjointSets::find(unsigned x) {
+    for (;;) {
+        unsigned p = parent_[x].load(std::memory_order_acquire);
+        if (p == x) return x;
+        const unsigned gp = parent_[p].load(std::memory_order_acquire);
+        if (gp != p) {
+            // Path halving: point x at its grandparent. Losing the race is harmless,
+            // whoever won also moved x's link upwards.
+            parent_[x].compare_exchange_weak(p, gp, std::memory_order_release, std::memory_order_relaxed);
+        }
+        x = gp;
+    }
+}
+
+unsigned ConcurrentDisjointSets::unite_serial(unsigned a, unsigned b) {
+    unsigned ra = find(a);
+    unsigned rb = find(b);
+    if (ra == rb) return ra;
+    if (rank_[ra] < rank_[rb]) std::swap(ra, rb);
+    else if (rank_[ra] == rank_[rb]) ++rank_[ra];
+    parent_[rb].store(ra, std::memory_order_release);
+    comp_count_.fetch_sub(1, std::memory_order_relaxed);
+    return ra;
+}
+
+} // namespace thesis
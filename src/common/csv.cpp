@@ -1,56 +1,68 @@
 #include "thesis/csv.hpp"
 
+#include <cstring>
+
 namespace thesis {
 
 CSVWriter::CSVWriter(const std::string& filePath, bool fixedFloat, int precision)
     : fixedFloat_(fixedFloat), precision_(precision) {
-    ofs_.open(filePath, std::ios::out | std::ios::trunc);
-    if (ofs_) {
-        if (fixedFloat_) ofs_.setf(std::ios::fixed, std::ios::floatfield);
-        ofs_ << std::setprecision(precision_);
-    }
+    ofs_.open(filePath, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (ofs_) buf_.resize(kBufferSize);
 }
 
-CSVWriter::~CSVWriter() { if (ofs_) ofs_.flush(); }
-
-void CSVWriter::close() { if (ofs_) { ofs_.flush(); ofs_.close(); } }
+CSVWriter::~CSVWriter() { close(); }
 
-bool CSVWriter::needs_quoting(std::string_view s) {
-    for (char c : s) {
-        if (c == ',' || c == '"' || c == '\n' || c == '\r') return true;
+void CSVWriter::close() {
+    if (ofs_.is_open()) {
+        flush_buffer();
+        ofs_.close();
     }
-    if (!s.empty() && (s.front() == ' ' || s.back() == ' ')) return true;
-    return false;
 }
 
-std::string CSVWriter::escape_cell(std::string_view s) {
-    if (!needs_quoting(s)) return std::string(s);
-    std::string out; out.reserve(s.size() + 2);
-    out.push_back('"');
-    for (char c : s) {
-        if (c == '"') out.push_back('"');
-        out.push_back(c);
+void CSVWriter::flush_buffer() {
+    if (len_ && ofs_) ofs_.write(buf_.data(), static_cast<std::streamsize>(len_));
+    len_ = 0;
+}
+
+void CSVWriter::raw(std::string_view s) {
+    if (s.size() > buf_.size()) {
+        flush_buffer();
+        if (ofs_) ofs_.write(s.data(), static_cast<std::streamsize>(s.size()));
+        return;
     }
-    out.push_back('"');
-    return out;
+    std::memcpy(reserve(s.size()), s.data(), s.size());
+    len_ += s.size();
 }
 
-void CSVWriter::header(const std::vector<std::string>& cols) {
-    if (!ofs_) return;
-    for (size_t i = 0; i < cols.size(); ++i) {
-        if (i) ofs_ << ',';
-        ofs_ << escape_cell(cols[i]);
+void CSVWriter::text(std::string_view s) {
+    bool quote = !s.empty() && (s.front() == ' ' || s.back() == ' ');
+    for (char c : s) {
+        if (c == ',' || c == '"' || c == '\n' || c == '\r') { quote = true; break; }
     }
-    ofs_ << '\n';
+    if (!quote) {
+        raw(s);
+        return;
+    }
+    put('"');
+    for (std::size_t i = 0; i < s.size();) {
+        const std::size_t q = s.find('"', i);
+        const std::size_t end = q == std::string_view::npos ? s.size() : q + 1;
+        raw(s.substr(i, end - i));
+        if (q != std::string_view::npos) put('"');
+        i = end;
+    }
+    put('"');
 }
 
+void CSVWriter::header(const std::vector<std::string>& cols) { row(cols); }
+
 void CSVWriter::row(const std::vector<std::string>& cells) {
     if (!ofs_) return;
-    for (size_t i = 0; i < cells.size(); ++i) {
-        if (i) ofs_ << ',';
-        ofs_ << escape_cell(cells[i]);
+    for (std::size_t i = 0; i < cells.size(); ++i) {
+        if (i) put(',');
+        text(cells[i]);
     }
-    ofs_ << '\n';
+    put('\n');
 }
 
 } // namespace thesis
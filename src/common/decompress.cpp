@@ -0,0 +1,367 @@
+// ----------------------------------------------------------------------------
+// decompress.cpp
+//
+// Magic-byte detection and a background-thread decompressor for gzip, xz and
+// bzip2 inputs. Each codec is optional and enabled when CMake finds the
+// library (THESIS_HAVE_ZLIB / THESIS_HAVE_LZMA / THESIS_HAVE_BZIP2).
+//
+// Design:
+//  - One decoder thread per reader pulls compressed input (a memory-mapped
+//    span or an istream) and writes into a bounded ring of buffers; the
+//    consumer receives filled buffers in order and returns each one on its
+//    next call. At most `buffers` blocks are in flight, so memory stays bounded
+//    however large the decompressed file is.
+//  - Concatenated members/streams (e.g. `cat a.gz b.gz`) are decoded back to
+//    back like the command-line tools do.
+// ----------------------------------------------------------------------------
+
+#include "thesis/decompress.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <utility>
+
+#if defined(THESIS_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(THESIS_HAVE_LZMA)
+#include <lzma.h>
+#endif
+#if defined(THESIS_HAVE_BZIP2)
+#include <bzlib.h>
+#endif
+
+namespace thesis {
+
+Compression detect_compression(const char* data, std::size_t size) {
+    const auto* b = reinterpret_cast<const unsigned char*>(data);
+    if (size >= 2 && b[0] == 0x1f && b[1] == 0x8b) return Compression::Gzip;
+    if (size >= 6 && b[0] == 0xfd && b[1] == '7' && b[2] == 'z' && b[3] == 'X' && b[4] == 'Z' && b[5] == 0x00)
+        return Compression::Xz;
+    if (size >= 3 && b[0] == 'B' && b[1] == 'Z' && b[2] == 'h') return Compression::Bzip2;
+    return Compression::None;
+}
+
+const char* compression_name(Compression c) {
+    switch (c) {
+    case Compression::None: return "none";
+    case Compression::Gzip: return "gzip";
+    case Compression::Xz: return "xz";
+    case Compression::Bzip2: return "bzip2";
+    }
+    return "unknown";
+}
+
+bool compression_supported(Compression c) {
+    switch (c) {
+    case Compression::None: return true;
+#if defined(THESIS_HAVE_ZLIB)
+    case Compression::Gzip: return true;
+#endif
+#if defined(THESIS_HAVE_LZMA)
+    case Compression::Xz: return true;
+#endif
+#if defined(THESIS_HAVE_BZIP2)
+    case Compression::Bzip2: return true;
+#endif
+    default: return false;
+    }
+}
+
+namespace {
+
+// Largest input/output window handed to a codec in one call (their counters are 32-bit).
+constexpr std::size_t kMaxCodecChunk = std::size_t{1} << 30;
+
+// One streaming codec. step() consumes from `in` and writes to `out`, advancing
+// both; `end` is set when a member/stream is complete.
+struct Decoder {
+    virtual ~Decoder() = default;
+    virtual bool step(const char*& in, std::size_t& in_left, char*& out, std::size_t& out_left,
+                      bool input_finished, bool& end, std::string& err) = 0;
+    // Prepare for another concatenated member.
+    virtual bool restart(std::string& err) = 0;
+};
+
+#if defined(THESIS_HAVE_ZLIB)
+struct GzipDecoder final : Decoder {
+    z_stream zs{};
+    bool ok = false;
+    GzipDecoder() { ok = (inflateInit2(&zs, 15 + 32) == Z_OK); } // 32: auto-detect gzip/zlib header
+    ~GzipDecoder() override { if (ok) inflateEnd(&zs); }
+    bool step(const char*& in, std::size_t& in_left, char*& out, std::size_t& out_left,
+              bool, bool& end, std::string& err) override {
+        const std::size_t in_n = std::min(in_left, kMaxCodecChunk);
+        const std::size_t out_n = std::min(out_left, kMaxCodecChunk);
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in));
+        zs.avail_in = static_cast<uInt>(in_n);
+        zs.next_out = reinterpret_cast<Bytef*>(out);
+        zs.avail_out = static_cast<uInt>(out_n);
+        const int rc = inflate(&zs, Z_NO_FLUSH);
+        const std::size_t used_in = in_n - zs.avail_in, used_out = out_n - zs.avail_out;
+        in += used_in; in_left -= used_in;
+        out += used_out; out_left -= used_out;
+        if (rc == Z_STREAM_END) { end = true; return true; }
+        if (rc == Z_OK || rc == Z_BUF_ERROR) return true;
+        err = std::string("gzip: ") + (zs.msg ? zs.msg : "inflate failed");
+        return false;
+    }
+    bool restart(std::string& err) override {
+        if (inflateReset(&zs) == Z_OK) return true;
+        err = "gzip: inflateReset failed";
+        return false;
+    }
+};
+#endif
+
+#if defined(THESIS_HAVE_LZMA)
+struct XzDecoder final : Decoder {
+    lzma_stream strm = LZMA_STREAM_INIT;
+    bool ok = false;
+    XzDecoder() { ok = (lzma_stream_decoder(&strm, UINT64_MAX, LZMA_CONCATENATED) == LZMA_OK); }
+    ~XzDecoder() override { lzma_end(&strm); }
+    bool step(const char*& in, std::size_t& in_left, char*& out, std::size_t& out_left,
+              bool input_finished, bool& end, std::string& err) override {
+        strm.next_in = reinterpret_cast<const uint8_t*>(in);
+        strm.avail_in = in_left;
+        strm.next_out = reinterpret_cast<uint8_t*>(out);
+        strm.avail_out = out_left;
+        const lzma_ret rc = lzma_code(&strm, input_finished ? LZMA_FINISH : LZMA_RUN);
+        const std::size_t used_in = in_left - strm.avail_in, used_out = out_left - strm.avail_out;
+        in += used_in; in_left -= used_in;
+        out += used_out; out_left -= used_out;
+        if (rc == LZMA_STREAM_END) { end = true; return true; }
+        if (rc == LZMA_OK || rc == LZMA_BUF_ERROR) return true;
+        err = "xz: decoding failed (code " + std::to_string(static_cast<int>(rc)) + ")";
+        return false;
+    }
+    bool restart(std::string&) override { return true; } // LZMA_CONCATENATED handles multi-stream files
+};
+#endif
+
+#if defined(THESIS_HAVE_BZIP2)
+struct Bzip2Decoder final : Decoder {
+    bz_stream bz{};
+    bool ok = false;
+    Bzip2Decoder() { ok = (BZ2_bzDecompressInit(&bz, 0, 0) == BZ_OK); }
+    ~Bzip2Decoder() override { if (ok) BZ2_bzDecompressEnd(&bz); }
+    bool step(const char*& in, std::size_t& in_left, char*& out, std::size_t& out_left,
+              bool, bool& end, std::string& err) override {
+        const std::size_t in_n = std::min(in_left, kMaxCodecChunk);
+        const std::size_t out_n = std::min(out_left, kMaxCodecChunk);
+        bz.next_in = const_cast<char*>(in);
+        bz.avail_in = static_cast<unsigned int>(in_n);
+        bz.next_out = out;
+        bz.avail_out = static_cast<unsigned int>(out_n);
+        const int rc = BZ2_bzDecompress(&bz);
+        const std::size_t used_in = in_n - bz.avail_in, used_out = out_n - bz.avail_out;
+        in += used_in; in_left -= used_in;
+        out += used_out; out_left -= used_out;
+        if (rc == BZ_STREAM_END) { end = true; return true; }
+        if (rc == BZ_OK) return true;
+        err = "bzip2: decoding failed (code " + std::to_string(rc) + ")";
+        return false;
+    }
+    bool restart(std::string& err) override {
+        BZ2_bzDecompressEnd(&bz);
+        bz = bz_stream{};
+        ok = (BZ2_bzDecompressInit(&bz, 0, 0) == BZ_OK);
+        if (!ok) err = "bzip2: re-initialisation failed";
+        return ok;
+    }
+};
+#endif
+
+std::unique_ptr<Decoder> make_decoder(Compression c, std::string& err) {
+    switch (c) {
+#if defined(THESIS_HAVE_ZLIB)
+    case Compression::Gzip: {
+        auto d = std::make_unique<GzipDecoder>();
+        if (d->ok) return d;
+        err = "gzip: inflateInit failed";
+        return nullptr;
+    }
+#endif
+#if defined(THESIS_HAVE_LZMA)
+    case Compression::Xz: {
+        auto d = std::make_unique<XzDecoder>();
+        if (d->ok) return d;
+        err = "xz: decoder initialisation failed";
+        return nullptr;
+    }
+#endif
+#if defined(THESIS_HAVE_BZIP2)
+    case Compression::Bzip2: {
+        auto d = std::make_unique<Bzip2Decoder>();
+        if (d->ok) return d;
+        err = "bzip2: decoder initialisation failed";
+        return nullptr;
+    }
+#endif
+    default:
+        err = std::string(compression_name(c)) + " input is not supported by this build";
+        return nullptr;
+    }
+}
+
+} // namespace
+
+DecompressingReader::DecompressingReader(Compression c, const char* data, std::size_t size,
+                                         std::size_t buffers, std::size_t buffer_bytes) {
+    bool given = false;
+    start(c, [data, size, given]() mutable {
+        if (given) return std::string_view{};
+        given = true;
+        return std::string_view(data, size);
+    }, buffers, buffer_bytes);
+}
+
+DecompressingReader::DecompressingReader(Compression c, std::istream& in, std::string prefix,
+                                         std::size_t buffers, std::size_t buffer_bytes) {
+    constexpr std::size_t kReadChunk = std::size_t{1} << 20;
+    auto chunk = std::make_shared<std::vector<char>>();
+    auto pre = std::make_shared<std::string>(std::move(prefix));
+    start(c, [&in, chunk, pre]() -> std::string_view {
+        if (!pre->empty()) {
+            chunk->assign(pre->begin(), pre->end());
+            pre->clear();
+            return std::string_view(chunk->data(), chunk->size());
+        }
+        if (!in) return {};
+        chunk->resize(kReadChunk);
+        in.read(chunk->data(), static_cast<std::streamsize>(kReadChunk));
+        return std::string_view(chunk->data(), static_cast<std::size_t>(in.gcount()));
+    }, buffers, buffer_bytes);
+}
+
+void DecompressingReader::start(Compression c, Source src, std::size_t buffers, std::size_t buffer_bytes) {
+    buffers = std::max<std::size_t>(buffers, 2);
+    buffer_bytes = std::max<std::size_t>(buffer_bytes, 4096);
+    storage_.reserve(buffers);
+    for (std::size_t i = 0; i < buffers; ++i) {
+        auto b = std::make_unique<Buffer>();
+        b->data.resize(buffer_bytes);
+        free_.push_back(b.get());
+        storage_.push_back(std::move(b));
+    }
+    worker_ = std::thread([this, c, src = std::move(src)]() mutable { produce(c, std::move(src)); });
+}
+
+DecompressingReader::~DecompressingReader() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+bool DecompressingReader::next(std::string_view& block) {
+    std::unique_lock<std::mutex> lk(mu_);
+    if (held_) {
+        held_->used = 0;
+        free_.push_back(held_);
+        held_ = nullptr;
+        cv_.notify_all();
+    }
+    cv_.wait(lk, [&] { return !filled_.empty() || done_; });
+    if (filled_.empty()) return false; // done: end of data or failure
+    held_ = filled_.front();
+    filled_.pop_front();
+    block = std::string_view(held_->data.data(), held_->used);
+    return true;
+}
+
+DecompressingReader::Buffer* DecompressingReader::acquire_free() {
+    std::unique_lock<std::mutex> lk(mu_);
+    cv_.wait(lk, [&] { return !free_.empty() || stop_; });
+    if (stop_) return nullptr;
+    Buffer* b = free_.front();
+    free_.pop_front();
+    return b;
+}
+
+void DecompressingReader::publish(Buffer* b) {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        filled_.push_back(b);
+    }
+    cv_.notify_all();
+}
+
+void DecompressingReader::finish(const std::string& err) {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        done_ = true;
+        if (!err.empty()) {
+            failed_ = true;
+            error_ = err;
+        }
+    }
+    cv_.notify_all();
+}
+
+void DecompressingReader::produce(Compression c, Source src) {
+    std::string err;
+    std::unique_ptr<Decoder> dec = make_decoder(c, err);
+    if (!dec) {
+        finish(err);
+        return;
+    }
+
+    std::string_view in = src();
+    bool input_finished = in.empty();
+    Buffer* b = acquire_free();
+    if (!b) return;
+    const std::size_t cap = b->data.size();
+
+    for (;;) {
+        if (in.empty() && !input_finished) {
+            in = src();
+            input_finished = in.empty();
+        }
+        const char* ip = in.data();
+        std::size_t il = in.size();
+        char* op = b->data.data() + b->used;
+        std::size_t ol = cap - b->used;
+        bool end = false;
+        if (!dec->step(ip, il, op, ol, input_finished, end, err)) {
+            finish(err);
+            return;
+        }
+        const std::size_t produced = (cap - b->used) - ol;
+        const bool consumed = (il != in.size());
+        b->used = cap - ol;
+        in = std::string_view(ip, il);
+
+        if (b->used == cap) {
+            publish(b);
+            if (!(b = acquire_free())) return;
+        }
+        if (end) {
+            if (in.empty() && !input_finished) {
+                in = src();
+                input_finished = in.empty();
+            }
+            if (in.empty()) break; // clean end of the last member
+            if (!dec->restart(err)) {
+                finish(err);
+                return;
+            }
+        } else if (in.empty() && input_finished && !produced && !consumed) {
+            finish(std::string(compression_name(c)) + ": unexpected end of input (truncated file?)");
+            return;
+        }
+    }
+
+    if (b->used) {
+        publish(b);
+    } else {
+        std::lock_guard<std::mutex> lk(mu_);
+        free_.push_back(b);
+    }
+    finish("");
+}
+
+} // namespace thesis
@@ -1,5 +1,7 @@
 #include "thesis/disjoint_set.hpp"
 
+#include <utility>
+
 namespace thesis {
 
 DisjointSets::DisjointSets(std::size_t n) {
@@ -57,6 +59,15 @@ unsigned DisjointSets::unite(unsigned a, unsigned b) {
     }
 }
 
+void DisjointSets::assign(std::vector<unsigned> parent, std::vector<unsigned char> rank) {
+    assert(parent.size() == rank.size());
+    parent_ = std::move(parent);
+    rank_ = std::move(rank);
+    comp_count_ = 0;
+    for (unsigned i = 0; i < parent_.size(); ++i)
+        if (parent_[i] == i) ++comp_count_;
+}
+
 std::vector<unsigned> DisjointSets::roots() const
 {
     std::vector<unsigned> root_nodes;
@@ -69,4 +80,18 @@ std::vector<unsigned> DisjointSets::roots() const
     assert(root_nodes.size() == comp_count_);
     return root_nodes;
 }
+
+void DisjointSets::flatten(std::vector<unsigned>& out) const
+{
+    constexpr unsigned kUnset = ~0u;
+    out.assign(parent_.size(), kUnset);
+    for (unsigned i = 0; i < parent_.size(); ++i) {
+        if (out[i] != kUnset) continue;
+        unsigned r = i;
+        while (out[r] == kUnset && parent_[r] != r) r = parent_[r];
+        const unsigned root = out[r] != kUnset ? out[r] : r;
+        for (unsigned x = i; x != r; x = parent_[x]) out[x] = root;
+        out[r] = root;
+    }
+}
 } // namespace thesis
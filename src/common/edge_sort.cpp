@@ -0,0 +1,305 @@
+// ----------------------------------------------------------------------------
+// edge_sort.cpp
+//
+// Sorting VIG edge lists into segmentation order (w desc, then u, v asc).
+//
+//  - Std: std::sort with edge_order_before (comparison sort, one thread).
+//  - Radix: LSD radix sort over the composite key (~bits(w), u, v) with 11-bit
+//    digits. For w >= 0 the IEEE-754 bit pattern orders like the value, so its
+//    complement sorts descending; u and v are packed into just as many bits as
+//    the largest endpoint needs. One sweep histograms every digit; passes whose
+//    digit is the same for all edges are skipped. Each remaining pass is a
+//    stable counting scatter: workers count their chunk, thread 0 turns the
+//    counts into per-(digit, worker) offsets, workers scatter. Fixed pool plus
+//    std::barrier between phases, as in the optimized VIG builder.
+//  - The key is total for a VIG (no duplicate pairs), so both methods and any
+//    thread count produce the identical order.
+//  - SoA lists: Std sorts an index permutation and gathers each column; Radix
+//    packs the columns into a temporary AoS array, sorts and unpacks.
+//  - Pair order (sort_edges_by_pair): the same radix sort with the key parts
+//    swapped, (u, v, ~bits(w)), so each endpoint pair is one run, heaviest first.
+//  - Memory: Radix needs one extra edge array (ping-pong buffer).
+// ----------------------------------------------------------------------------
+
+#include "thesis/edge_sort.hpp"
+#include "thesis/numa.hpp"
+#include "thesis/profile.hpp"
+
+#include <algorithm>
+#include <array>
+#include <barrier>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+namespace thesis {
+
+const char* edge_sort_name(EdgeSortMethod m) {
+    switch (m) {
+    case EdgeSortMethod::Auto: return "auto";
+    case EdgeSortMethod::Std: return "std";
+    case EdgeSortMethod::Radix: return "radix";
+    }
+    return "auto";
+}
+
+bool parse_edge_sort(const std::string& s, EdgeSortMethod& out) {
+    if (s == "auto") out = EdgeSortMethod::Auto;
+    else if (s == "std") out = EdgeSortMethod::Std;
+    else if (s == "radix") out = EdgeSortMethod::Radix;
+    else return false;
+    return true;
+}
+
+namespace {
+
+constexpr unsigned kDigitBits = 11;
+constexpr std::size_t kBuckets = std::size_t{1} << kDigitBits;
+// Below this many edges per worker, extra threads cost more in barriers than they save.
+constexpr std::size_t kMinEdgesPerThread = std::size_t{1} << 15;
+
+template <class W>
+using WeightBits = std::conditional_t<sizeof(W) == 8, uint64_t, uint32_t>;
+
+// Digit extraction from the key  hi:lo. Segmentation order: hi = ~bits(w) and
+// lo = (u << v_bits) | v. PairMajor (pair order): the two parts swap places.
+template <class W, bool PairMajor = false>
+struct RadixKey {
+    unsigned v_bits = 0;
+    unsigned pair_bits = 0; // u_bits + v_bits, <= 64
+
+    static constexpr unsigned kWeightBits = 8u * static_cast<unsigned>(sizeof(W));
+    unsigned total_bits() const { return pair_bits + kWeightBits; }
+
+    inline std::size_t digit(const BasicEdge<W>& e, unsigned shift) const {
+        const uint64_t wkey = static_cast<WeightBits<W>>(~std::bit_cast<WeightBits<W>>(e.w));
+        const uint64_t pkey = (static_cast<uint64_t>(e.u) << v_bits) | e.v;
+        const uint64_t hi = PairMajor ? pkey : wkey;
+        const uint64_t lo = PairMajor ? wkey : pkey;
+        const unsigned lo_bits = PairMajor ? kWeightBits : pair_bits;
+        uint64_t d;
+        if (shift >= lo_bits) {
+            d = hi >> (shift - lo_bits);
+        } else {
+            d = lo >> shift;
+            if (shift + kDigitBits > lo_bits) d |= hi << (lo_bits - shift);
+        }
+        return static_cast<std::size_t>(d & (kBuckets - 1));
+    }
+};
+
+using Histogram = std::array<std::size_t, kBuckets>;
+
+template <class W, bool PairMajor = false>
+void radix_sort(std::vector<BasicEdge<W>>& edges, unsigned threads) {
+    const std::size_t E = edges.size();
+    if (E < 2) return;
+
+    unsigned t = threads;
+    if (t == 0) {
+        const unsigned hc = std::thread::hardware_concurrency();
+        t = hc ? hc : 1u;
+    }
+    t = static_cast<unsigned>(std::max<std::size_t>(1, std::min<std::size_t>(t, E / kMinEdgesPerThread)));
+
+    std::vector<BasicEdge<W>> buffer(E);
+    BasicEdge<W>* const ping = edges.data();
+    BasicEdge<W>* const pong = buffer.data();
+
+    std::vector<std::size_t> cbegin(t), cend(t);
+    for (unsigned tid = 0; tid < t; ++tid) {
+        cbegin[tid] = (E * tid) / t;
+        cend[tid] = (E * (tid + 1)) / t;
+    }
+
+    std::vector<uint32_t> max_u(t, 0), max_v(t, 0);
+    RadixKey<W, PairMajor> key;
+    unsigned passes = 0;
+    std::vector<std::vector<Histogram>> local_hist(t); // [worker][pass]
+    std::vector<Histogram> hist;                       // [pass], whole array
+    std::vector<unsigned> active;                      // passes that move edges
+    std::vector<Histogram> offsets(t);                 // [worker] scatter cursors
+
+    std::barrier sync(t);
+
+    auto worker = [&](unsigned tid) {
+        ScopedPlacement pin(tid, t);
+        const std::size_t lo = cbegin[tid], hi = cend[tid];
+
+        // Phase 0: key widths.
+        uint32_t mu = 0, mv = 0;
+        for (std::size_t i = lo; i < hi; ++i) {
+            mu = std::max(mu, ping[i].u);
+            mv = std::max(mv, ping[i].v);
+        }
+        max_u[tid] = mu;
+        max_v[tid] = mv;
+        sync.arrive_and_wait();
+        if (tid == 0) {
+            const uint32_t U = *std::max_element(max_u.begin(), max_u.end());
+            const uint32_t V = *std::max_element(max_v.begin(), max_v.end());
+            key.v_bits = static_cast<unsigned>(std::bit_width(V));
+            key.pair_bits = key.v_bits + static_cast<unsigned>(std::bit_width(U));
+            passes = (key.total_bits() + kDigitBits - 1) / kDigitBits;
+            for (auto& lh : local_hist) lh.assign(passes, Histogram{});
+            hist.assign(passes, Histogram{});
+        }
+        sync.arrive_and_wait();
+
+        // Phase 1: histogram of every digit in one sweep.
+        {
+            auto& lh = local_hist[tid];
+            for (std::size_t i = lo; i < hi; ++i)
+                for (unsigned p = 0; p < passes; ++p)
+                    ++lh[p][key.digit(ping[i], p * kDigitBits)];
+        }
+        sync.arrive_and_wait();
+        if (tid == 0) {
+            for (unsigned p = 0; p < passes; ++p) {
+                for (unsigned w = 0; w < t; ++w)
+                    for (std::size_t b = 0; b < kBuckets; ++b)
+                        hist[p][b] += local_hist[w][p][b];
+                const bool constant = std::any_of(hist[p].begin(), hist[p].end(), [E](std::size_t c) { return c == E; });
+                if (!constant) active.push_back(p);
+            }
+        }
+        sync.arrive_and_wait();
+
+        // Phase 2: one stable scatter per active pass, alternating buffers.
+        for (std::size_t ai = 0; ai < active.size(); ++ai) {
+            const unsigned p = active[ai];
+            const unsigned shift = p * kDigitBits;
+            const BasicEdge<W>* src = (ai % 2 == 0) ? ping : pong;
+            BasicEdge<W>* dst = (ai % 2 == 0) ? pong : ping;
+
+            // The chunk histogram of the first active pass is already known; later
+            // passes see a permuted array and recount (a single worker's chunk is the
+            // whole array, whose histogram never changes).
+            Histogram& cnt = offsets[tid];
+            if (t == 1)
+                cnt = hist[p];
+            else if (ai == 0)
+                cnt = local_hist[tid][p];
+            else {
+                cnt.fill(0);
+                for (std::size_t i = lo; i < hi; ++i)
+                    ++cnt[key.digit(src[i], shift)];
+            }
+            sync.arrive_and_wait();
+            if (tid == 0) {
+                std::size_t run = 0;
+                for (std::size_t b = 0; b < kBuckets; ++b)
+                    for (unsigned w = 0; w < t; ++w) {
+                        const std::size_t c = offsets[w][b];
+                        offsets[w][b] = run;
+                        run += c;
+                    }
+            }
+            sync.arrive_and_wait();
+            for (std::size_t i = lo; i < hi; ++i)
+                dst[cnt[key.digit(src[i], shift)]++] = src[i];
+            sync.arrive_and_wait();
+        }
+    };
+
+    if (t == 1) {
+        worker(0);
+    } else {
+        std::vector<std::thread> pool;
+        pool.reserve(t);
+        for (unsigned tid = 0; tid < t; ++tid)
+            pool.emplace_back(worker, tid);
+        for (auto& th : pool)
+            th.join();
+    }
+
+    if (active.size() % 2 == 1)
+        edges.swap(buffer);
+}
+
+EdgeSortMethod resolve(const EdgeSortOptions& opt, std::size_t n) {
+    if (opt.method != EdgeSortMethod::Auto) return opt.method;
+    return n >= opt.radix_threshold ? EdgeSortMethod::Radix : EdgeSortMethod::Std;
+}
+
+template <class W>
+EdgeSortMethod sort_aos(std::vector<BasicEdge<W>>& edges, const EdgeSortOptions& opt) {
+    profile::ScopedPhase phase("sort");
+    const EdgeSortMethod m = resolve(opt, edges.size());
+    if (m == EdgeSortMethod::Radix)
+        radix_sort(edges, opt.threads);
+    else
+        std::sort(edges.begin(), edges.end(), edge_order_before<W>);
+    return m;
+}
+
+template <class W>
+EdgeSortMethod sort_aos_by_pair(std::vector<BasicEdge<W>>& edges, const EdgeSortOptions& opt) {
+    profile::ScopedPhase phase("sort.pair");
+    const EdgeSortMethod m = resolve(opt, edges.size());
+    if (m == EdgeSortMethod::Radix)
+        radix_sort<W, true>(edges, opt.threads);
+    else
+        std::sort(edges.begin(), edges.end(), pair_order_before<W>);
+    return m;
+}
+
+template <class T>
+void gather(std::vector<T>& col, const std::vector<uint32_t>& perm) {
+    std::vector<T> out(col.size());
+    for (std::size_t i = 0; i < perm.size(); ++i)
+        out[i] = col[perm[i]];
+    col.swap(out);
+}
+
+template <class W>
+EdgeSortMethod sort_soa(EdgeColumns<W>& edges, const EdgeSortOptions& opt) {
+    profile::ScopedPhase phase("sort");
+    const std::size_t E = edges.size();
+    const EdgeSortMethod m = resolve(opt, E);
+    if (m == EdgeSortMethod::Radix) {
+        std::vector<BasicEdge<W>> tmp(E);
+        for (std::size_t i = 0; i < E; ++i)
+            tmp[i] = BasicEdge<W>{edges.u[i], edges.v[i], edges.w[i]};
+        radix_sort(tmp, opt.threads);
+        for (std::size_t i = 0; i < E; ++i) {
+            edges.u[i] = tmp[i].u;
+            edges.v[i] = tmp[i].v;
+            edges.w[i] = tmp[i].w;
+        }
+        return m;
+    }
+    // Sort a permutation (reads the columns only through it), then gather each
+    // column. Peak extra memory is one index plus one column.
+    if (E > std::numeric_limits<uint32_t>::max())
+        throw std::length_error("EdgeColumns sort: more than 2^32 edges");
+    std::vector<uint32_t> perm(E);
+    std::iota(perm.begin(), perm.end(), 0u);
+    const uint32_t* u = edges.u.data();
+    const uint32_t* v = edges.v.data();
+    const W* w = edges.w.data();
+    std::sort(perm.begin(), perm.end(), [u, v, w](uint32_t a, uint32_t b) {
+        if (w[a] != w[b]) return w[a] > w[b];
+        if (u[a] != u[b]) return u[a] < u[b];
+        return v[a] < v[b];
+    });
+    gather(edges.u, perm);
+    gather(edges.v, perm);
+    gather(edges.w, perm);
+    return m;
+}
+
+} // namespace
+
+EdgeSortMethod sort_edges_desc(std::vector<Edge>& edges, const EdgeSortOptions& opt) { return sort_aos(edges, opt); }
+EdgeSortMethod sort_edges_desc(std::vector<EdgeF>& edges, const EdgeSortOptions& opt) { return sort_aos(edges, opt); }
+EdgeSortMethod sort_edges_desc(EdgeColumns<double>& edges, const EdgeSortOptions& opt) { return sort_soa(edges, opt); }
+EdgeSortMethod sort_edges_desc(EdgeColumns<float>& edges, const EdgeSortOptions& opt) { return sort_soa(edges, opt); }
+
+EdgeSortMethod sort_edges_by_pair(std::vector<Edge>& edges, const EdgeSortOptions& opt) { return sort_aos_by_pair(edges, opt); }
+
+} // namespace thesis
@@ -0,0 +1,93 @@
+#include "thesis/mapped_file.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define THESIS_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace thesis {
+
+MappedFile::MappedFile(const std::string& path) {
+#if defined(THESIS_HAVE_MMAP)
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        // Not a regular file (pipe, device, ...): read it through a stream instead.
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) return;
+        buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+        open_ = true;
+        return;
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ == 0) {
+        ::close(fd);
+        open_ = true; // empty file: valid, nothing to map
+        return;
+    }
+    void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps its own reference
+    if (p == MAP_FAILED) {
+        size_ = 0;
+        return;
+    }
+    ::madvise(p, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(p);
+    mapped_ = true;
+    open_ = true;
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return;
+    in.seekg(0, std::ios::end);
+    const auto len = in.tellg();
+    in.seekg(0, std::ios::beg);
+    if (len > 0) {
+        buffer_.resize(static_cast<std::size_t>(len));
+        in.read(buffer_.data(), len);
+        buffer_.resize(static_cast<std::size_t>(in.gcount()));
+    }
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    open_ = true;
+#endif
+}
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this == &other) return *this;
+    close();
+    mapped_ = std::exchange(other.mapped_, false);
+    open_ = std::exchange(other.open_, false);
+    size_ = std::exchange(other.size_, 0);
+    buffer_ = std::move(other.buffer_);
+    const char* d = std::exchange(other.data_, nullptr);
+    data_ = mapped_ ? d : buffer_.data();
+    return *this;
+}
+
+void MappedFile::close() {
+#if defined(THESIS_HAVE_MMAP)
+    if (mapped_ && data_) ::munmap(const_cast<char*>(data_), size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    open_ = false;
+    mapped_ = false;
+    std::vector<char>().swap(buffer_);
+}
+
+} // namespace thesis
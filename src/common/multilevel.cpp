@@ -0,0 +1,129 @@
+#include "thesis/multilevel.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include "thesis/edge_sort.hpp"
+#include "thesis/profile.hpp"
+#include "thesis/timer.hpp"
+
+namespace thesis {
+
+const char* quotient_weight_name(QuotientWeight q) { return q == QuotientWeight::Max ? "max" : "sum"; }
+
+bool parse_quotient_weight(const std::string& s, QuotientWeight& out) {
+    if (s == "sum") out = QuotientWeight::Sum;
+    else if (s == "max") out = QuotientWeight::Max;
+    else return false;
+    return true;
+}
+
+namespace {
+
+constexpr unsigned kNoSuper = std::numeric_limits<unsigned>::max();
+
+// Edges between the supernodes sid[root[x]], one per pair with u < v: sorted
+// into pair order (heaviest first within a pair), then folded per pair.
+template <class Edges>
+std::vector<SegEdge> contract(const Edges& edges, const std::vector<unsigned>& root, const std::vector<unsigned>& sid,
+                              QuotientWeight weight, const EdgeSortOptions& sort_opt) {
+    std::vector<SegEdge> q;
+    const std::size_t m = edge_count(edges);
+    for (std::size_t i = 0; i < m; ++i) {
+        const auto e = edge_at(edges, i);
+        const unsigned a = sid[root[e.u]], b = sid[root[e.v]];
+        if (a != b) q.push_back(SegEdge{std::min(a, b), std::max(a, b), static_cast<double>(e.w)});
+    }
+    sort_edges_by_pair(q, sort_opt);
+    std::size_t out = 0;
+    for (std::size_t i = 0; i < q.size(); ++i) {
+        if (out > 0 && q[out - 1].u == q[i].u && q[out - 1].v == q[i].v) {
+            if (weight == QuotientWeight::Sum) q[out - 1].w += q[i].w;
+            continue;
+        }
+        q[out++] = q[i];
+    }
+    q.resize(out);
+    return q;
+}
+
+} // namespace
+
+template <class Edges>
+std::vector<SegLevel> segment_levels(std::span<const unsigned> labels, const Edges& edges, double k,
+                                     const GraphSegmenterFH::Config& cfg, const MultilevelOptions& opt) {
+    profile::ScopedPhase phase("segment.levels");
+    const std::size_t n = labels.size();
+    EdgeSortOptions sort_opt;
+    sort_opt.method = cfg.edge_sort;
+    sort_opt.radix_threshold = cfg.radix_sort_threshold;
+    sort_opt.threads = cfg.sort_threads;
+    GraphSegmenterFH::Config level_cfg = cfg;
+    level_cfg.candidates = CandidateStore::None;
+    level_cfg.record_trajectory = false;
+
+    // The current graph: cur_n nodes (supernodes after level 1) with edges `cur`,
+    // its partition `root`, the supernode of every original node and the
+    // level-0 representative of every supernode.
+    std::size_t cur_n = n;
+    std::vector<SegEdge> cur;
+    std::vector<unsigned> root(labels.begin(), labels.end());
+    std::vector<unsigned> node_super(n), rep(n);
+    for (std::size_t v = 0; v < n; ++v)
+        node_super[v] = rep[v] = static_cast<unsigned>(v);
+
+    std::vector<SegLevel> out;
+    double level_k = k;
+    for (unsigned level = 1; level <= opt.levels; ++level) {
+        Timer t;
+        level_k *= opt.k_factor;
+
+        // Components of the level below become supernodes 0.., in node order.
+        std::vector<unsigned> sid(cur_n, kNoSuper);
+        std::vector<unsigned> next_rep;
+        for (std::size_t x = 0; x < cur_n; ++x) {
+            const unsigned r = root[x];
+            if (sid[r] != kNoSuper) continue;
+            sid[r] = static_cast<unsigned>(next_rep.size());
+            next_rep.push_back(rep[r]);
+        }
+        std::vector<SegEdge> q = level == 1 ? contract(edges, root, sid, opt.weight, sort_opt)
+                                            : contract(cur, root, sid, opt.weight, sort_opt);
+        if (q.empty()) break;
+        for (unsigned& s : node_super)
+            s = sid[root[s]];
+        rep.swap(next_rep);
+        cur.swap(q);
+        cur_n = rep.size();
+
+        GraphSegmenterFH seg(static_cast<unsigned>(cur_n), level_k);
+        seg.set_config(level_cfg);
+        seg.run(cur);
+        seg.component_labels(root);
+        if (seg.num_components() == cur_n) break; // nothing merged: same partition as below
+
+        SegLevel l;
+        l.level = level;
+        l.k = level_k;
+        l.nodes = static_cast<unsigned>(cur_n);
+        l.edges = cur.size();
+        l.comps = seg.num_components();
+        l.labels.resize(n);
+        for (std::size_t v = 0; v < n; ++v)
+            l.labels[v] = rep[root[node_super[v]]];
+        l.sec = t.sec();
+        out.push_back(std::move(l));
+    }
+    return out;
+}
+
+template std::vector<SegLevel> segment_levels(std::span<const unsigned>, const std::vector<Edge>&, double,
+                                              const GraphSegmenterFH::Config&, const MultilevelOptions&);
+template std::vector<SegLevel> segment_levels(std::span<const unsigned>, const std::vector<EdgeF>&, double,
+                                              const GraphSegmenterFH::Config&, const MultilevelOptions&);
+template std::vector<SegLevel> segment_levels(std::span<const unsigned>, const EdgeColumns<float>&, double,
+                                              const GraphSegmenterFH::Config&, const MultilevelOptions&);
+template std::vector<SegLevel> segment_levels(std::span<const unsigned>, const EdgeColumns<double>&, double,
+                                              const GraphSegmenterFH::Config&, const MultilevelOptions&);
+
+} // namespace thesis
@@ -0,0 +1,666 @@
+// ----------------------------------------------------------------------------
+// neighbor_reduce.cpp
+//
+// Sort-and-reduce of one variable's {neighbor, weight} contribution run.
+//
+//  - Each entry becomes the 64-bit key (b << 32) | bits(w). Weights are
+//    non-negative, so key order is (b, w) order; equal keys are equal entries,
+//    which makes the sorted sequence unique whatever the input order.
+//  - Reduce: per distinct b, sum the weights in double in key order, starting
+//    from 0.0. Every kernel performs exactly these additions, so results are
+//    bit-identical across kernels.
+//  - Scalar: std::sort on the keys, sequential reduce.
+//  - AVX2 / AVX-512: bitonic network sort of 4 / 8 keys per register, then
+//    bottom-up register merges (two sorted blocks through a bitonic merge) in a
+//    ping-pong buffer; the tail is padded with the maximum key. Reduce finds
+//    segment heads with vector compares and sums several segments at once, one
+//    lane per segment, gathering the k-th weight of every segment per step.
+//  - Dispatch: __builtin_cpu_supports at first use (GCC/Clang on x86-64, with
+//    target attributes, so no global -m flags); everything else uses Scalar.
+//  - reduce_neighbors(): for runs with many repeated keys, Spa (counters over
+//    neighbor window x distinct weights, swept in key order) or Hash (flat
+//    {key, count} table, entries sorted afterwards) replace the sort. Both add
+//    each weight `count` times in key order, i.e. the sort path's additions.
+//    Auto samples 128 neighbors to estimate the repeats.
+// ----------------------------------------------------------------------------
+
+#include "thesis/neighbor_reduce.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define THESIS_NEIGHBOR_X86 1
+#include <immintrin.h>
+#endif
+
+namespace thesis {
+
+const char* neighbor_kernel_name(NeighborKernel k) {
+    switch (k) {
+    case NeighborKernel::Auto: return "auto";
+    case NeighborKernel::Scalar: return "scalar";
+    case NeighborKernel::Avx2: return "avx2";
+    case NeighborKernel::Avx512: return "avx512";
+    }
+    return "auto";
+}
+
+bool parse_neighbor_kernel(const std::string& s, NeighborKernel& out) {
+    if (s == "auto") out = NeighborKernel::Auto;
+    else if (s == "scalar") out = NeighborKernel::Scalar;
+    else if (s == "avx2") out = NeighborKernel::Avx2;
+    else if (s == "avx512") out = NeighborKernel::Avx512;
+    else return false;
+    return true;
+}
+
+namespace {
+
+constexpr uint64_t kMaxKey = ~uint64_t{0}; // padding; above every real key (w bits < 0x7f800000)
+
+inline uint64_t pack_key(const NeighborContribution& c) {
+    return (static_cast<uint64_t>(c.b) << 32) | std::bit_cast<uint32_t>(c.w);
+}
+
+template <class T>
+inline T* ensure(std::vector<T>& v, std::size_t n) {
+    if (v.size() < n) v.resize(n);
+    return v.data();
+}
+
+// Sequential reduce over sorted keys (shared by Scalar and as the reference order).
+std::size_t reduce_sorted(const uint64_t* k, std::size_t n, NeighborReduceScratch& sc) {
+    uint32_t* out_b = ensure(sc.out_b, n);
+    double* out_w = ensure(sc.out_w, n);
+    std::size_t m = 0;
+    uint32_t curr = static_cast<uint32_t>(k[0] >> 32);
+    double sum = 0.0;
+    for (std::size_t i = 0; i < n; ++i) {
+        const uint32_t b = static_cast<uint32_t>(k[i] >> 32);
+        if (b != curr) {
+            out_b[m] = curr;
+            out_w[m] = sum;
+            ++m;
+            curr = b;
+            sum = 0.0;
+        }
+        sum += static_cast<double>(std::bit_cast<float>(static_cast<uint32_t>(k[i])));
+    }
+    out_b[m] = curr;
+    out_w[m] = sum;
+    return m + 1;
+}
+
+std::size_t scalar_kernel(const NeighborContribution* run, std::size_t n, NeighborReduceScratch& sc) {
+    uint64_t* k = ensure(sc.keys, n);
+    for (std::size_t i = 0; i < n; ++i)
+        k[i] = pack_key(run[i]);
+    std::sort(k, k + n);
+    return reduce_sorted(k, n, sc);
+}
+
+#if defined(THESIS_NEIGHBOR_X86)
+
+// Key buffers get this many spare entries so unaligned head scans may read past N.
+constexpr std::size_t kSlack = 8;
+
+// Bottom-up merge passes over N keys in sorted blocks of B (B = register width).
+// MergeRuns(a, la, b, lb, out) merges two sorted runs whose lengths are multiples of B.
+template <std::size_t B, class MergeRuns>
+uint64_t* merge_passes(uint64_t* from, uint64_t* to, std::size_t N, MergeRuns merge_runs) {
+    for (std::size_t width = B; width < N; width *= 2) {
+        for (std::size_t lo = 0; lo < N; lo += 2 * width) {
+            const std::size_t mid = std::min(lo + width, N);
+            const std::size_t hi = std::min(lo + 2 * width, N);
+            if (mid >= hi)
+                std::memcpy(to + lo, from + lo, (hi - lo) * sizeof(uint64_t));
+            else
+                merge_runs(from + lo, mid - lo, from + mid, hi - mid, to + lo);
+        }
+        std::swap(from, to);
+    }
+    return from;
+}
+
+// ---------------------------- AVX-512 (8 lanes) -----------------------------
+
+alignas(64) constexpr int64_t kPerm1[8] = {1, 0, 3, 2, 5, 4, 7, 6}; // i ^ 1
+alignas(64) constexpr int64_t kPerm2[8] = {2, 3, 0, 1, 6, 7, 4, 5}; // i ^ 2
+alignas(64) constexpr int64_t kPerm3[8] = {3, 2, 1, 0, 7, 6, 5, 4}; // i ^ 3
+alignas(64) constexpr int64_t kPerm4[8] = {4, 5, 6, 7, 0, 1, 2, 3}; // i ^ 4
+alignas(64) constexpr int64_t kPerm7[8] = {7, 6, 5, 4, 3, 2, 1, 0}; // i ^ 7 (reverse)
+
+// The unmasked forms of several AVX-512 intrinsics pass GCC's undefined-register
+// placeholder as the merge source, which -Wall reports as uninitialized once they
+// are inlined (at link time with LTO). The kernels below use the merge-masked
+// forms with every lane selected instead: same instructions, defined operands.
+constexpr __mmask8 kAll8 = 0xFF;
+
+// Compare-exchange every lane i with lane perm[i]; lanes in `upper` keep the max.
+__attribute__((target("avx512f,avx512vl"))) inline __m512i cas8(__m512i v, const int64_t* perm, __mmask8 upper) {
+    const __m512i p = _mm512_mask_permutexvar_epi64(v, kAll8, _mm512_load_si512(perm), v);
+    return _mm512_mask_blend_epi64(upper, _mm512_mask_min_epu64(v, kAll8, v, p), _mm512_mask_max_epu64(v, kAll8, v, p));
+}
+
+__attribute__((target("avx512f,avx512vl"))) inline __m512i sort8(__m512i v) {
+    v = cas8(v, kPerm1, 0xAA);
+    v = cas8(v, kPerm3, 0xCC);
+    v = cas8(v, kPerm1, 0xAA);
+    v = cas8(v, kPerm7, 0xF0);
+    v = cas8(v, kPerm2, 0xCC);
+    return cas8(v, kPerm1, 0xAA);
+}
+
+// Sort a bitonic register.
+__attribute__((target("avx512f,avx512vl"))) inline __m512i clean8(__m512i v) {
+    v = cas8(v, kPerm4, 0xF0);
+    v = cas8(v, kPerm2, 0xCC);
+    return cas8(v, kPerm1, 0xAA);
+}
+
+// Two sorted registers -> the 8 smallest (lo) and 8 largest (hi), both sorted.
+__attribute__((target("avx512f,avx512vl"))) inline void merge16(__m512i a, __m512i b, __m512i& lo, __m512i& hi) {
+    const __m512i rb = _mm512_mask_permutexvar_epi64(b, kAll8, _mm512_load_si512(kPerm7), b);
+    lo = clean8(_mm512_mask_min_epu64(a, kAll8, a, rb));
+    hi = clean8(_mm512_mask_max_epu64(a, kAll8, a, rb));
+}
+
+__attribute__((target("avx512f,avx512vl")))
+void merge_runs8(const uint64_t* a, std::size_t la, const uint64_t* b, std::size_t lb, uint64_t* out) {
+    __m512i va = _mm512_loadu_si512(a), vb = _mm512_loadu_si512(b), lo, hi;
+    std::size_t ia = 8, ib = 8;
+    for (;;) {
+        merge16(va, vb, lo, hi);
+        _mm512_storeu_si512(out, lo);
+        out += 8;
+        if (ia < la && (ib >= lb || a[ia] <= b[ib])) {
+            va = _mm512_loadu_si512(a + ia);
+            ia += 8;
+        } else if (ib < lb) {
+            va = _mm512_loadu_si512(b + ib);
+            ib += 8;
+        } else {
+            break;
+        }
+        vb = hi;
+    }
+    _mm512_storeu_si512(out, hi);
+}
+
+__attribute__((target("avx512f,avx512vl")))
+std::size_t avx512_kernel(const NeighborContribution* run, std::size_t n, NeighborReduceScratch& sc) {
+    const std::size_t N = (n + 7) & ~std::size_t{7};
+    uint64_t* keys = ensure(sc.keys, N + kSlack);
+    uint64_t* tmp = ensure(sc.tmp, N + kSlack);
+    const uint64_t* words = reinterpret_cast<const uint64_t*>(run); // {b, w} in memory = bits(w):b
+    const __m512i pad = _mm512_set1_epi64(static_cast<long long>(kMaxKey));
+    for (std::size_t i = 0; i < N; i += 8) {
+        const __mmask8 live = n - i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n - i)) - 1);
+        const __m512i raw = _mm512_mask_loadu_epi64(pad, live, words + i);
+        const __m512i v = _mm512_mask_ror_epi64(raw, kAll8, raw, 32);
+        _mm512_storeu_si512(keys + i, sort8(v));
+    }
+    const uint64_t* k = merge_passes<8>(keys, tmp, N, merge_runs8);
+
+    // Segment heads: lanes whose neighbor differs from the previous key.
+    uint32_t* starts = ensure(sc.starts, n + 1);
+    uint32_t* out_b = ensure(sc.out_b, n + 8);
+    double* out_w = ensure(sc.out_w, n + 8);
+    std::size_t m = 0;
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    for (std::size_t i = 0; i < n; i += 8) {
+        const __mmask8 live = n - i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n - i)) - 1);
+        const __m512i cur = _mm512_maskz_loadu_epi64(live, k + i);
+        const __m512i prev = i ? _mm512_loadu_si512(k + i - 1)
+                               : _mm512_mask_loadu_epi64(_mm512_set1_epi64(static_cast<long long>(k[0] ^ (uint64_t{1} << 32))),
+                                                         0xFE, k - 1);
+        const __m512i bcur = _mm512_mask_srli_epi64(cur, kAll8, cur, 32);
+        const __m512i bprev = _mm512_mask_srli_epi64(prev, kAll8, prev, 32);
+        const __mmask8 heads = _mm512_mask_cmpneq_epu64_mask(live, bcur, bprev);
+        const __m512i pos = _mm512_add_epi64(lane, _mm512_set1_epi64(static_cast<long long>(i)));
+        const __m256i zero = _mm256_setzero_si256();
+        _mm256_mask_compressstoreu_epi32(starts + m, heads, _mm512_mask_cvtepi64_epi32(zero, kAll8, pos));
+        _mm256_mask_compressstoreu_epi32(out_b + m, heads, _mm512_mask_cvtepi64_epi32(zero, kAll8, bcur));
+        m += static_cast<std::size_t>(std::popcount(static_cast<unsigned>(heads)));
+    }
+    starts[m] = static_cast<uint32_t>(n);
+
+    // Segment sums, 8 segments per step; lane j adds the it-th weight of its segment.
+    const float* wbase = reinterpret_cast<const float*>(k); // low half of key i is float 2i
+    for (std::size_t j = 0; j < m; j += 8) {
+        const __mmask8 live = m - j >= 8 ? 0xFF : static_cast<__mmask8>((1u << (m - j)) - 1);
+        const __m256i st = _mm256_maskz_loadu_epi32(live, starts + j);
+        const __m256i len = _mm256_sub_epi32(_mm256_maskz_loadu_epi32(live, starts + j + 1), st);
+        const __m512i st64 = _mm512_mask_cvtepu32_epi64(_mm512_setzero_si512(), kAll8, st);
+        __m512i idx = _mm512_mask_slli_epi64(st64, kAll8, st64, 1);
+        __m512d acc = _mm512_setzero_pd();
+        for (uint32_t it = 0;; ++it) {
+            const __mmask8 act = _mm256_mask_cmpgt_epu32_mask(live, len, _mm256_set1_epi32(static_cast<int>(it)));
+            if (!act) break;
+            const __m256 w = _mm512_mask_i64gather_ps(_mm256_setzero_ps(), act, idx, wbase, 4);
+            acc = _mm512_mask_add_pd(acc, act, acc, _mm512_mask_cvtps_pd(acc, kAll8, w));
+            idx = _mm512_add_epi64(idx, _mm512_set1_epi64(2));
+        }
+        _mm512_mask_storeu_pd(out_w + j, live, acc);
+    }
+    return m;
+}
+
+// ------------------------------ AVX2 (4 lanes) ------------------------------
+// No unsigned 64-bit compare: keys are kept with the sign bit flipped and
+// compared signed (the padding key flips to INT64_MAX).
+
+constexpr uint64_t kSign = uint64_t{1} << 63;
+
+template <int Perm, int Upper>
+__attribute__((target("avx2"))) inline __m256i cas4(__m256i v) {
+    const __m256i p = _mm256_permute4x64_epi64(v, Perm);
+    const __m256i gt = _mm256_cmpgt_epi64(v, p);
+    const __m256i mn = _mm256_blendv_epi8(v, p, gt);
+    const __m256i mx = _mm256_blendv_epi8(p, v, gt);
+    return _mm256_blend_epi32(mn, mx, Upper);
+}
+
+constexpr int kSwap1 = 0xB1;   // lanes 1,0,3,2 (i ^ 1)
+constexpr int kSwap2 = 0x4E;   // lanes 2,3,0,1 (i ^ 2)
+constexpr int kReverse = 0x1B; // lanes 3,2,1,0 (i ^ 3)
+
+__attribute__((target("avx2"))) inline __m256i sort4(__m256i v) {
+    v = cas4<kSwap1, 0xCC>(v);
+    v = cas4<kReverse, 0xF0>(v);
+    return cas4<kSwap1, 0xCC>(v);
+}
+
+__attribute__((target("avx2"))) inline void merge8(__m256i a, __m256i b, __m256i& lo, __m256i& hi) {
+    const __m256i rb = _mm256_permute4x64_epi64(b, kReverse);
+    const __m256i gt = _mm256_cmpgt_epi64(a, rb);
+    lo = cas4<kSwap1, 0xCC>(cas4<kSwap2, 0xF0>(_mm256_blendv_epi8(a, rb, gt)));
+    hi = cas4<kSwap1, 0xCC>(cas4<kSwap2, 0xF0>(_mm256_blendv_epi8(rb, a, gt)));
+}
+
+__attribute__((target("avx2"))) inline __m256i load4(const uint64_t* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+__attribute__((target("avx2"))) inline void store4(uint64_t* p, __m256i v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+}
+
+__attribute__((target("avx2")))
+void merge_runs4(const uint64_t* a, std::size_t la, const uint64_t* b, std::size_t lb, uint64_t* out) {
+    __m256i va = load4(a), vb = load4(b), lo, hi;
+    std::size_t ia = 4, ib = 4;
+    for (;;) {
+        merge8(va, vb, lo, hi);
+        store4(out, lo);
+        out += 4;
+        if (ia < la && (ib >= lb || static_cast<int64_t>(a[ia]) <= static_cast<int64_t>(b[ib]))) {
+            va = load4(a + ia);
+            ia += 4;
+        } else if (ib < lb) {
+            va = load4(b + ib);
+            ib += 4;
+        } else {
+            break;
+        }
+        vb = hi;
+    }
+    store4(out, hi);
+}
+
+__attribute__((target("avx2")))
+std::size_t avx2_kernel(const NeighborContribution* run, std::size_t n, NeighborReduceScratch& sc) {
+    const std::size_t N = (n + 3) & ~std::size_t{3};
+    uint64_t* keys = ensure(sc.keys, N + kSlack);
+    uint64_t* tmp = ensure(sc.tmp, N + kSlack);
+    const long long* words = reinterpret_cast<const long long*>(run);
+    const __m256i sign = _mm256_set1_epi64x(static_cast<long long>(kSign));
+    const __m256i pad = _mm256_set1_epi64x(static_cast<long long>(kMaxKey ^ kSign));
+    const __m256i lane = _mm256_set_epi64x(3, 2, 1, 0);
+    for (std::size_t i = 0; i < N; i += 4) {
+        const __m256i live = _mm256_cmpgt_epi64(_mm256_set1_epi64x(static_cast<long long>(n - i)), lane);
+        __m256i v = _mm256_maskload_epi64(words + i, live);
+        v = _mm256_xor_si256(_mm256_shuffle_epi32(v, 0xB1), sign); // rotate by 32, flip sign
+        v = _mm256_blendv_epi8(pad, v, live);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(keys + i), sort4(v));
+    }
+    uint64_t* k = merge_passes<4>(keys, tmp, N, merge_runs4);
+
+    // Unflip, then find segment heads.
+    uint32_t* starts = ensure(sc.starts, n + 1);
+    uint32_t* out_b = ensure(sc.out_b, n + 4);
+    double* out_w = ensure(sc.out_w, n + 4);
+    for (std::size_t i = 0; i < N; i += 4) {
+        __m256i* p = reinterpret_cast<__m256i*>(k + i);
+        _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), sign));
+    }
+    std::size_t m = 0;
+    starts[m] = 0;
+    out_b[m++] = static_cast<uint32_t>(k[0] >> 32);
+    for (std::size_t i = 1; i < n; i += 4) {
+        const __m256i cur = _mm256_srli_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(k + i)), 32);
+        const __m256i prev = _mm256_srli_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(k + i - 1)), 32);
+        unsigned heads = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(
+            _mm256_xor_si256(_mm256_cmpeq_epi64(cur, prev), _mm256_set1_epi64x(-1)))));
+        if (n - i < 4) heads &= (1u << (n - i)) - 1;
+        while (heads) {
+            const std::size_t pos = i + static_cast<std::size_t>(std::countr_zero(heads));
+            starts[m] = static_cast<uint32_t>(pos);
+            out_b[m++] = static_cast<uint32_t>(k[pos] >> 32);
+            heads &= heads - 1;
+        }
+    }
+    starts[m] = static_cast<uint32_t>(n);
+
+    // Segment sums, 4 segments per step.
+    const float* wbase = reinterpret_cast<const float*>(k);
+    for (std::size_t j = 0; j < m; j += 4) {
+        const std::size_t lanes = std::min<std::size_t>(4, m - j);
+        alignas(16) uint32_t st[4] = {0, 0, 0, 0}, len[4] = {0, 0, 0, 0};
+        for (std::size_t l = 0; l < lanes; ++l) {
+            st[l] = starts[j + l];
+            len[l] = starts[j + l + 1] - starts[j + l];
+        }
+        const __m128i vlen = _mm_load_si128(reinterpret_cast<const __m128i*>(len));
+        __m256i idx = _mm256_slli_epi64(_mm256_cvtepu32_epi64(_mm_load_si128(reinterpret_cast<const __m128i*>(st))), 1);
+        __m256d acc = _mm256_setzero_pd();
+        for (int it = 0;; ++it) {
+            const __m128i act = _mm_cmpgt_epi32(vlen, _mm_set1_epi32(it));
+            if (_mm_testz_si128(act, act)) break;
+            const __m128 w = _mm256_mask_i64gather_ps(_mm_setzero_ps(), wbase, idx, _mm_castsi128_ps(act), 4);
+            acc = _mm256_add_pd(acc, _mm256_cvtps_pd(w)); // inactive lanes add +0.0
+            idx = _mm256_add_epi64(idx, _mm256_set1_epi64x(2));
+        }
+        alignas(32) double sums[4];
+        _mm256_store_pd(sums, acc);
+        for (std::size_t l = 0; l < lanes; ++l)
+            out_w[j + l] = sums[l];
+    }
+    return m;
+}
+
+#endif // THESIS_NEIGHBOR_X86
+
+NeighborKernel detect_kernel() {
+#if defined(THESIS_NEIGHBOR_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")) return NeighborKernel::Avx512;
+    if (__builtin_cpu_supports("avx2")) return NeighborKernel::Avx2;
+#endif
+    return NeighborKernel::Scalar;
+}
+
+NeighborKernel detected_kernel() {
+    static const NeighborKernel k = detect_kernel();
+    return k;
+}
+
+std::atomic<NeighborKernel> g_forced{NeighborKernel::Auto};
+
+} // namespace
+
+bool neighbor_kernel_supported(NeighborKernel k) {
+    switch (k) {
+    case NeighborKernel::Auto:
+    case NeighborKernel::Scalar: return true;
+    case NeighborKernel::Avx2: return detected_kernel() != NeighborKernel::Scalar;
+    case NeighborKernel::Avx512: return detected_kernel() == NeighborKernel::Avx512;
+    }
+    return false;
+}
+
+NeighborKernel active_neighbor_kernel() {
+    const NeighborKernel f = g_forced.load(std::memory_order_relaxed);
+    return f == NeighborKernel::Auto ? detected_kernel() : f;
+}
+
+void set_neighbor_kernel(NeighborKernel k) {
+    if (!neighbor_kernel_supported(k))
+        throw std::invalid_argument(std::string("neighbor kernel not supported on this CPU: ") + neighbor_kernel_name(k));
+    g_forced.store(k, std::memory_order_relaxed);
+}
+
+std::size_t sort_reduce_neighbors(const NeighborContribution* run, std::size_t n, NeighborReduceScratch& scratch) {
+    if (n == 0) return 0;
+#if defined(THESIS_NEIGHBOR_X86)
+    // Segment starts are 32-bit in the vector kernels.
+    if (n < (std::size_t{1} << 31)) {
+        switch (active_neighbor_kernel()) {
+        case NeighborKernel::Avx512: return avx512_kernel(run, n, scratch);
+        case NeighborKernel::Avx2: return avx2_kernel(run, n, scratch);
+        default: break;
+        }
+    }
+#endif
+    return scalar_kernel(run, n, scratch);
+}
+
+const char* neighbor_accumulator_name(NeighborAccumulator a) {
+    switch (a) {
+    case NeighborAccumulator::Auto: return "auto";
+    case NeighborAccumulator::Sort: return "sort";
+    case NeighborAccumulator::Spa: return "spa";
+    case NeighborAccumulator::Hash: return "hash";
+    }
+    return "auto";
+}
+
+bool parse_neighbor_accumulator(const std::string& s, NeighborAccumulator& out) {
+    if (s == "auto") out = NeighborAccumulator::Auto;
+    else if (s == "sort") out = NeighborAccumulator::Sort;
+    else if (s == "spa") out = NeighborAccumulator::Spa;
+    else if (s == "hash") out = NeighborAccumulator::Hash;
+    else return false;
+    return true;
+}
+
+namespace {
+
+// Runs shorter than this are always sorted.
+constexpr std::size_t kAdaptiveMinRun = 128;
+// Spa: at most this many distinct weights per run and this many dense counters;
+// Auto also wants at most kSpaCountersPerContribution counters per contribution.
+constexpr std::size_t kSpaMaxClasses = 8;
+constexpr std::size_t kSpaMaxCounters = std::size_t{1} << 16;
+constexpr std::size_t kSpaCountersPerContribution = 2;
+// Auto: leave the sort path when a sample of kSample neighbors holds at most
+// kSample / factor distinct ones; the vector sorts are about 4x faster than
+// std::sort, so they need more repeats. Such runs go to Spa if its counters fit
+// (and are few per contribution), else to Hash.
+constexpr std::size_t kSample = 128;
+constexpr std::size_t kDupFactorScalar = 2;
+constexpr std::size_t kDupFactorVector = 16;
+
+std::atomic<NeighborAccumulator> g_forced_accumulator{NeighborAccumulator::Auto};
+
+// Distinct neighbors among kSample evenly spaced entries (bitmap, exact up to collisions).
+std::size_t sampled_distinct(const NeighborContribution* run, std::size_t n) {
+    uint64_t bits[16] = {};
+    const std::size_t stride = n / kSample;
+    for (std::size_t i = 0; i < kSample; ++i) {
+        const uint32_t h = (run[i * stride].b * 0x9E3779B1u) >> 22; // 10 bits
+        bits[h >> 6] |= uint64_t{1} << (h & 63);
+    }
+    std::size_t c = 0;
+    for (uint64_t w : bits) c += static_cast<std::size_t>(std::popcount(w));
+    return c;
+}
+
+// Append one neighbor's sum: each weight added `count` times, weights ascending.
+struct EntryReducer {
+    uint32_t* out_b;
+    double* out_w;
+    std::size_t m = 0;
+    bool open = false;
+    uint32_t curr = 0;
+    double sum = 0.0;
+
+    void add(uint32_t b, float w, uint64_t count) {
+        if (!open || b != curr) {
+            flush();
+            open = true;
+            curr = b;
+            sum = 0.0;
+        }
+        const double wd = static_cast<double>(w);
+        for (uint64_t k = 0; k < count; ++k)
+            sum += wd;
+    }
+    void flush() {
+        if (!open) return;
+        out_b[m] = curr;
+        out_w[m] = sum;
+        ++m;
+    }
+};
+
+// Distinct weights of a run, for Spa. Each weight owns one slot of a 16-entry
+// direct-mapped table (so the class lookup has no data-dependent branch); a slot
+// collision or more than kSpaMaxClasses weights rules Spa out.
+struct WeightClasses {
+    static constexpr unsigned kSlotBits = 4;
+    uint32_t w[kSpaMaxClasses];     // ascending (bits of non-negative floats order like the values)
+    std::size_t count = 0;
+    uint8_t slot_class[1u << kSlotBits];
+
+    static unsigned slot(uint32_t wbits) { return (wbits * 0x9E3779B1u) >> (32 - kSlotBits); }
+
+    bool build(const NeighborContribution* run, std::size_t n) {
+        uint32_t slot_w[1u << kSlotBits];
+        std::fill(std::begin(slot_w), std::end(slot_w), ~0u); // NaN bits: never a weight
+        count = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            const uint32_t wb = std::bit_cast<uint32_t>(run[i].w);
+            const unsigned h = slot(wb);
+            if (slot_w[h] == wb) continue;
+            if (slot_w[h] != ~0u || count == kSpaMaxClasses) return false;
+            slot_w[h] = wb;
+            w[count++] = wb;
+        }
+        std::sort(w, w + count);
+        for (std::size_t c = 0; c < count; ++c)
+            slot_class[slot(w[c])] = static_cast<uint8_t>(c);
+        return true;
+    }
+};
+
+// Dense counters indexed by (neighbor - bmin, weight class); swept in key order.
+std::size_t spa_reduce(const NeighborContribution* run, std::size_t n, uint32_t bmin, std::size_t window,
+                       const WeightClasses& wc, NeighborReduceScratch& sc) {
+    const std::size_t classes = wc.count;
+    uint32_t* cnt = ensure(sc.spa, window * classes); // all zero between calls
+    for (std::size_t i = 0; i < n; ++i) {
+        const std::size_t ci = wc.slot_class[WeightClasses::slot(std::bit_cast<uint32_t>(run[i].w))];
+        ++cnt[static_cast<std::size_t>(run[i].b - bmin) * classes + ci];
+    }
+    EntryReducer red{ensure(sc.out_b, n), ensure(sc.out_w, n)};
+    for (std::size_t s = 0; s < window; ++s) {
+        uint32_t* row = cnt + s * classes;
+        for (std::size_t c = 0; c < classes; ++c) {
+            if (!row[c]) continue;
+            red.add(bmin + static_cast<uint32_t>(s), std::bit_cast<float>(wc.w[c]), row[c]);
+            row[c] = 0;
+        }
+    }
+    red.flush();
+    return red.m;
+}
+
+// Flat open-addressing table of {key, count}; kMaxKey marks an empty slot.
+std::size_t hash_reduce(const NeighborContribution* run, std::size_t n, std::size_t distinct_hint,
+                        NeighborReduceScratch& sc) {
+    std::size_t cap = std::bit_ceil(std::max<std::size_t>(64, 4 * distinct_hint));
+    unsigned shift = 64 - static_cast<unsigned>(std::countr_zero(cap));
+    auto& table = sc.table;
+    table.assign(cap, NeighborAccumEntry{kMaxKey, 0});
+    std::size_t used = 0;
+    auto home = [&](uint64_t key) { return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> shift); };
+    for (std::size_t i = 0; i < n; ++i) {
+        const uint64_t key = pack_key(run[i]);
+        std::size_t h = home(key);
+        while (table[h].key != key && table[h].key != kMaxKey)
+            h = (h + 1) & (cap - 1);
+        if (table[h].key == key) {
+            ++table[h].count;
+            continue;
+        }
+        table[h] = NeighborAccumEntry{key, 1};
+        if (2 * ++used > cap) { // keep the load at or below 1/2
+            auto& old = sc.entries;
+            old.swap(table);
+            cap *= 2;
+            --shift;
+            table.assign(cap, NeighborAccumEntry{kMaxKey, 0});
+            for (const auto& e : old) {
+                if (e.key == kMaxKey) continue;
+                std::size_t g = home(e.key);
+                while (table[g].key != kMaxKey) g = (g + 1) & (cap - 1);
+                table[g] = e;
+            }
+        }
+    }
+    auto& entries = sc.entries;
+    entries.clear();
+    for (const auto& e : table)
+        if (e.key != kMaxKey) entries.push_back(e);
+    std::sort(entries.begin(), entries.end(),
+              [](const NeighborAccumEntry& x, const NeighborAccumEntry& y) { return x.key < y.key; });
+    EntryReducer red{ensure(sc.out_b, entries.size()), ensure(sc.out_w, entries.size())};
+    for (const auto& e : entries)
+        red.add(static_cast<uint32_t>(e.key >> 32), std::bit_cast<float>(static_cast<uint32_t>(e.key)), e.count);
+    red.flush();
+    return red.m;
+}
+
+} // namespace
+
+void set_neighbor_accumulator(NeighborAccumulator a) { g_forced_accumulator.store(a, std::memory_order_relaxed); }
+
+NeighborAccumulator forced_neighbor_accumulator() { return g_forced_accumulator.load(std::memory_order_relaxed); }
+
+std::size_t reduce_neighbors(const NeighborContribution* run, std::size_t n, NeighborReduceScratch& scratch) {
+    const NeighborAccumulator forced = forced_neighbor_accumulator();
+    // Counts are 32-bit.
+    if (n == 0 || forced == NeighborAccumulator::Sort || n >= std::numeric_limits<uint32_t>::max() ||
+        (forced == NeighborAccumulator::Auto && n < kAdaptiveMinRun)) {
+        ++scratch.sort_runs;
+        return sort_reduce_neighbors(run, n, scratch);
+    }
+    if (forced == NeighborAccumulator::Hash) {
+        ++scratch.hash_runs;
+        return hash_reduce(run, n, kSample, scratch);
+    }
+
+    // Auto: only runs whose sample shows enough repeats leave the sort path.
+    std::size_t d = kSample;
+    if (forced == NeighborAccumulator::Auto) {
+        d = sampled_distinct(run, n);
+        const std::size_t factor =
+            active_neighbor_kernel() == NeighborKernel::Scalar ? kDupFactorScalar : kDupFactorVector;
+        if (d * factor > kSample) {
+            ++scratch.sort_runs;
+            return sort_reduce_neighbors(run, n, scratch);
+        }
+    }
+
+    uint32_t bmin = run[0].b, bmax = run[0].b;
+    for (std::size_t i = 1; i < n; ++i) {
+        bmin = std::min(bmin, run[i].b);
+        bmax = std::max(bmax, run[i].b);
+    }
+    const std::size_t window = static_cast<std::size_t>(bmax - bmin) + 1;
+    WeightClasses wc;
+    const bool spa_fits = window <= kSpaMaxCounters && wc.build(run, n) && window * wc.count <= kSpaMaxCounters;
+    if (spa_fits && (forced == NeighborAccumulator::Spa || window * wc.count <= kSpaCountersPerContribution * n)) {
+        ++scratch.spa_runs;
+        return spa_reduce(run, n, bmin, window, wc, scratch);
+    }
+    ++scratch.hash_runs;
+    return hash_reduce(run, n, d, scratch);
+}
+
+} // namespace thesis
@@ -0,0 +1,203 @@
+#include "thesis/numa.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include "thesis/cli.hpp"
+
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace thesis {
+
+namespace {
+
+std::atomic<ThreadPlacement> g_placement{ThreadPlacement::None};
+
+constexpr std::size_t kPageBytes = 4096;
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+std::vector<unsigned> parse_cpu_list(const std::string& s) {
+    std::vector<unsigned> cpus;
+    std::size_t i = 0;
+    while (i < s.size()) {
+        std::size_t j = s.find(',', i);
+        if (j == std::string::npos) j = s.size();
+        const std::string part = s.substr(i, j - i);
+        const std::size_t dash = part.find('-');
+        try {
+            const unsigned lo = static_cast<unsigned>(std::stoul(part.substr(0, dash)));
+            const unsigned hi = dash == std::string::npos ? lo : static_cast<unsigned>(std::stoul(part.substr(dash + 1)));
+            for (unsigned c = lo; c <= hi; ++c) cpus.push_back(c);
+        } catch (...) {
+            // blank or malformed entry (e.g. the trailing newline): skip
+        }
+        i = j + 1;
+    }
+    return cpus;
+}
+
+NumaTopology read_topology() {
+    NumaTopology topo;
+    std::vector<unsigned> allowed;
+#if defined(__linux__)
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+        for (unsigned c = 0; c < CPU_SETSIZE; ++c)
+            if (CPU_ISSET(c, &mask)) allowed.push_back(c);
+    }
+    std::error_code ec;
+    std::vector<std::pair<unsigned, std::vector<unsigned>>> found;
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.size() < 5 || name.compare(0, 4, "node") != 0 ||
+            !std::all_of(name.begin() + 4, name.end(), [](char c) { return c >= '0' && c <= '9'; }))
+            continue;
+        std::ifstream in(entry.path() / "cpulist");
+        std::string list;
+        std::getline(in, list);
+        std::vector<unsigned> cpus;
+        for (unsigned c : parse_cpu_list(list))
+            if (std::binary_search(allowed.begin(), allowed.end(), c)) cpus.push_back(c);
+        if (!cpus.empty()) found.emplace_back(static_cast<unsigned>(std::stoul(name.substr(4))), std::move(cpus));
+    }
+    std::sort(found.begin(), found.end());
+    for (auto& [id, cpus] : found) {
+        topo.node_ids.push_back(id);
+        topo.node_cpus.push_back(std::move(cpus));
+    }
+#endif
+    if (topo.node_ids.empty()) {
+        if (allowed.empty()) {
+            const unsigned hc = std::max(1u, std::thread::hardware_concurrency());
+            for (unsigned c = 0; c < hc; ++c) allowed.push_back(c);
+        }
+        topo.node_ids.push_back(0);
+        topo.node_cpus.push_back(std::move(allowed));
+    }
+    return topo;
+}
+
+} // namespace
+
+const char* thread_placement_name(ThreadPlacement p) {
+    switch (p) {
+    case ThreadPlacement::Compact: return "compact";
+    case ThreadPlacement::Spread: return "spread";
+    case ThreadPlacement::None: break;
+    }
+    return "none";
+}
+
+bool parse_thread_placement(const std::string& s, ThreadPlacement& out) {
+    if (s == "none") out = ThreadPlacement::None;
+    else if (s == "compact") out = ThreadPlacement::Compact;
+    else if (s == "spread") out = ThreadPlacement::Spread;
+    else return false;
+    return true;
+}
+
+void set_thread_placement(ThreadPlacement p) {
+    // Read the topology now, while the calling thread still has the process mask.
+    if (p != ThreadPlacement::None) NumaTopology::system();
+    g_placement.store(p, std::memory_order_relaxed);
+}
+
+ThreadPlacement thread_placement() { return g_placement.load(std::memory_order_relaxed); }
+
+std::size_t NumaTopology::cpus() const {
+    std::size_t n = 0;
+    for (const auto& c : node_cpus) n += c.size();
+    return n;
+}
+
+const NumaTopology& NumaTopology::system() {
+    static const NumaTopology topo = read_topology();
+    return topo;
+}
+
+unsigned placement_node(unsigned tid) {
+    const ThreadPlacement p = thread_placement();
+    if (p == ThreadPlacement::None) return 0;
+    const NumaTopology& topo = NumaTopology::system();
+    if (p == ThreadPlacement::Spread) return tid % topo.nodes();
+    // Compact: the node of the tid-th allowed CPU, nodes in order.
+    std::size_t k = tid % topo.cpus();
+    for (unsigned node = 0; node < topo.nodes(); ++node) {
+        if (k < topo.node_cpus[node].size()) return node;
+        k -= topo.node_cpus[node].size();
+    }
+    return 0;
+}
+
+ScopedPlacement::ScopedPlacement(unsigned tid, unsigned threads) {
+    if (thread_placement() == ThreadPlacement::None || threads <= 1) return;
+    node_ = placement_node(tid);
+#if defined(__linux__)
+    cpu_set_t old_mask, mask;
+    CPU_ZERO(&old_mask);
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(old_mask), &old_mask) != 0) return;
+    for (unsigned c : NumaTopology::system().node_cpus[node_]) CPU_SET(c, &mask);
+    if (sched_setaffinity(0, sizeof(mask), &mask) != 0) return;
+    saved_.resize(sizeof(old_mask));
+    std::memcpy(saved_.data(), &old_mask, sizeof(old_mask));
+    pinned_ = true;
+#endif
+}
+
+ScopedPlacement::~ScopedPlacement() {
+#if defined(__linux__)
+    if (!pinned_) return;
+    cpu_set_t mask;
+    std::memcpy(&mask, saved_.data(), sizeof(mask));
+    sched_setaffinity(0, sizeof(mask), &mask);
+#endif
+}
+
+void interleave_pages(const void* p, std::size_t bytes) {
+    const NumaTopology& topo = NumaTopology::system();
+    if (thread_placement() == ThreadPlacement::None || topo.nodes() < 2 || bytes == 0) return;
+#if defined(__linux__) && defined(SYS_mbind)
+    const unsigned max_id = *std::max_element(topo.node_ids.begin(), topo.node_ids.end());
+    constexpr unsigned kBits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> nodemask(max_id / kBits + 1, 0);
+    for (unsigned id : topo.node_ids) nodemask[id / kBits] |= 1ul << (id % kBits);
+    const auto lo = reinterpret_cast<std::uintptr_t>(p) / kPageBytes * kPageBytes;
+    const auto hi = (reinterpret_cast<std::uintptr_t>(p) + bytes + kPageBytes - 1) / kPageBytes * kPageBytes;
+    // Best effort: without the permission to move pages, only new pages interleave.
+    syscall(SYS_mbind, lo, hi - lo, MPOL_INTERLEAVE, nodemask.data(), nodemask.size() * kBits + 1, MPOL_MF_MOVE);
+#endif
+}
+
+void first_touch(void* p, std::size_t bytes) {
+    auto* b = static_cast<volatile unsigned char*>(p);
+    for (std::size_t i = 0; i < bytes; i += kPageBytes) b[i] = 0;
+}
+
+void add_placement_option(ArgParser& cli) {
+    cli.add_option(OptionSpec{.longName = "placement", .shortName = '\0', .type = ArgType::String, .valueName = "none|compact|spread", .help = "Pin worker threads to NUMA nodes (compact: fill one node first; spread: round-robin)", .required = false, .defaultValue = "none"});
+}
+
+bool apply_placement_option(const ArgParser& cli) {
+    ThreadPlacement p = ThreadPlacement::None;
+    if (!parse_thread_placement(cli.get_string("placement"), p)) {
+        std::cerr << "--placement must be none|compact|spread\n";
+        return false;
+    }
+    set_thread_placement(p);
+    return true;
+}
+
+} // namespace thesis
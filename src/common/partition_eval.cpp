@@ -0,0 +1,124 @@
+#include "thesis/partition_eval.hpp"
+#include "thesis/profile.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+namespace thesis {
+
+namespace {
+
+// Below this many nodes plus edges per thread, the thread start-up and the
+// per-thread label arrays cost more than the pass itself.
+constexpr std::size_t kMinWorkPerEvalThread = 1u << 16;
+
+template <class Fn>
+void run_slices(unsigned threads, Fn&& fn) {
+    if (threads == 1) {
+        fn(0u);
+        return;
+    }
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; ++t) pool.emplace_back(fn, t);
+    fn(0u);
+    for (auto& th : pool) th.join();
+}
+
+} // namespace
+
+template <class Edges>
+PartitionEvaluator<Edges>::PartitionEvaluator(uint32_t n, const Edges& edges, unsigned threads)
+    : n_(n), edges_(&edges), threads_(threads), k_(n, 0.0) {
+    if (threads_ == 0) {
+        const unsigned hc = std::thread::hardware_concurrency();
+        threads_ = hc ? hc : 1u;
+    }
+    for_each_edge(edges, [&](uint32_t u, uint32_t v, double w) {
+        k_[u] += w;
+        k_[v] += w;
+        m_ += w;
+    });
+}
+
+template <class Edges>
+PartitionScore PartitionEvaluator<Edges>::evaluate(std::span<const unsigned> labels, Scratch& s, double gamma) const {
+    assert(labels.size() == n_);
+    profile::ScopedPhase phase("metrics.evaluate");
+    PartitionScore out;
+    const Edges& edges = *edges_;
+    const std::size_t m = edge_count(edges);
+    const unsigned T = static_cast<unsigned>(std::clamp<std::size_t>(
+        (n_ + m) / kMinWorkPerEvalThread, 1, threads_));
+
+    s.tot.resize(T);
+    s.in.resize(T);
+    s.count.resize(T);
+    // Pass 1: every thread sums a contiguous slice of the nodes and one of the
+    // edges into its own label-indexed arrays.
+    run_slices(T, [&](unsigned t) {
+        std::vector<double>& tot = s.tot[t];
+        std::vector<double>& in = s.in[t];
+        std::vector<uint32_t>& count = s.count[t];
+        tot.assign(n_, 0.0);
+        in.assign(n_, 0.0);
+        count.assign(n_, 0u);
+        const std::size_t v0 = static_cast<std::size_t>(n_) * t / T, v1 = static_cast<std::size_t>(n_) * (t + 1) / T;
+        for (std::size_t v = v0; v < v1; ++v) {
+            const unsigned r = labels[v];
+            tot[r] += k_[v];
+            ++count[r];
+        }
+        const std::size_t e0 = m * t / T, e1 = m * (t + 1) / T;
+        for (std::size_t i = e0; i < e1; ++i) {
+            const auto e = edge_at(edges, i);
+            const unsigned r = labels[e.u];
+            if (r == labels[e.v]) in[r] += e.w;
+        }
+    });
+    // Pass 2: fold the slices into thread 0's arrays, slice order per label.
+    if (T > 1) {
+        run_slices(T, [&](unsigned t) {
+            const std::size_t r0 = static_cast<std::size_t>(n_) * t / T, r1 = static_cast<std::size_t>(n_) * (t + 1) / T;
+            for (unsigned j = 1; j < T; ++j) {
+                for (std::size_t r = r0; r < r1; ++r) {
+                    s.tot[0][r] += s.tot[j][r];
+                    s.in[0][r] += s.in[j][r];
+                    s.count[0][r] += s.count[j][r];
+                }
+            }
+        });
+    }
+    const std::vector<double>& tot = s.tot[0];
+    const std::vector<double>& in = s.in[0];
+    const std::vector<uint32_t>& count = s.count[0];
+
+    // Communities in order of first appearance, as modularity() sums them.
+    if (m_ != 0.0) {
+        const double two_m = 2.0 * m_;
+        s.seen.assign(n_, 0);
+        double Q = 0.0;
+        for (uint32_t v = 0; v < n_; ++v) {
+            const unsigned r = labels[v];
+            if (s.seen[r]) continue;
+            s.seen[r] = 1;
+            Q += (in[r] / m_) - gamma * (tot[r] / two_m) * (tot[r] / two_m);
+        }
+        out.Q = Q;
+    }
+    // Sizes in label order, as component_sizes() returns them.
+    s.sizes.clear();
+    for (uint32_t r = 0; r < n_; ++r)
+        if (count[r] != 0u) s.sizes.push_back(count[r]);
+    out.comps = static_cast<uint32_t>(s.sizes.size());
+    out.cs = summarize_components(s.sizes);
+    return out;
+}
+
+template class PartitionEvaluator<std::vector<Edge>>;
+template class PartitionEvaluator<std::vector<EdgeF>>;
+template class PartitionEvaluator<EdgeColumns<float>>;
+template class PartitionEvaluator<EdgeColumns<double>>;
+
+} // namespace thesis
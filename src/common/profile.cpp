@@ -0,0 +1,315 @@
+#include "thesis/profile.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "thesis/cli.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace thesis {
+namespace profile {
+
+namespace detail {
+std::atomic<bool> g_enabled{false};
+std::atomic<bool> g_hardware{false};
+} // namespace detail
+
+namespace {
+
+constexpr const char* kHwNames[] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+
+struct PhaseStats {
+    std::string name;
+    uint64_t calls = 0;
+    double sec = 0.0;
+    std::size_t peak_rss = 0;
+    uint64_t hw_calls = 0; // calls that produced hardware counts
+    uint64_t hw[4] = {};
+};
+
+struct Counter {
+    std::string name;
+    double value = 0.0;
+};
+
+struct ThreadCounter {
+    std::string name;
+    std::vector<double> values; // by tid
+};
+
+// Entries in order of first use, found by name.
+struct Registry {
+    std::mutex mu;
+    std::vector<PhaseStats> phases;
+    std::unordered_map<std::string, std::size_t> phase_index;
+    std::vector<Counter> counters;
+    std::unordered_map<std::string, std::size_t> counter_index;
+    std::vector<ThreadCounter> thread_counters;
+    std::unordered_map<std::string, std::size_t> thread_counter_index;
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+template <class T>
+T& entry(std::vector<T>& list, std::unordered_map<std::string, std::size_t>& index, const char* name) {
+    auto [it, fresh] = index.emplace(name, list.size());
+    if (fresh) {
+        list.emplace_back();
+        list.back().name = name;
+    }
+    return list[it->second];
+}
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void record_phase(const char* name, double sec, const uint64_t* hw) {
+    const std::size_t rss = peak_rss_bytes();
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lk(r.mu);
+    PhaseStats& p = entry(r.phases, r.phase_index, name);
+    ++p.calls;
+    p.sec += sec;
+    p.peak_rss = std::max(p.peak_rss, rss);
+    if (hw) {
+        ++p.hw_calls;
+        for (int i = 0; i < 4; ++i) p.hw[i] += hw[i];
+    }
+}
+
+#if defined(__linux__)
+int open_hw_counter(int which) {
+    static constexpr uint64_t kConfigs[] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = kConfigs[which];
+    attr.inherit = 1; // also count threads started inside the phase
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+#endif
+
+} // namespace
+
+const char* format_name(Format f) {
+    switch (f) {
+    case Format::Text: return "text";
+    case Format::Json: return "json";
+    case Format::Off: break;
+    }
+    return "off";
+}
+
+bool parse_format(const std::string& s, Format& out) {
+    if (s == "off") out = Format::Off;
+    else if (s == "text") out = Format::Text;
+    else if (s == "json") out = Format::Json;
+    else return false;
+    return true;
+}
+
+void enable(bool hardware) {
+    detail::g_hardware.store(hardware, std::memory_order_relaxed);
+    detail::g_enabled.store(true, std::memory_order_relaxed);
+}
+
+void reset() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lk(r.mu);
+    r.phases.clear();
+    r.phase_index.clear();
+    r.counters.clear();
+    r.counter_index.clear();
+    r.thread_counters.clear();
+    r.thread_counter_index.clear();
+}
+
+void add_phase(const char* name, double sec) {
+    if (enabled()) record_phase(name, sec, nullptr);
+}
+
+void add(const char* name, double value) {
+    if (!enabled()) return;
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lk(r.mu);
+    entry(r.counters, r.counter_index, name).value += value;
+}
+
+void add_thread(const char* name, unsigned tid, double value) {
+    if (!enabled()) return;
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lk(r.mu);
+    std::vector<double>& v = entry(r.thread_counters, r.thread_counter_index, name).values;
+    if (v.size() <= tid) v.resize(static_cast<std::size_t>(tid) + 1, 0.0);
+    v[tid] += value;
+}
+
+std::size_t peak_rss_bytes() {
+#if defined(__unix__) || defined(__APPLE__)
+    rusage ru{};
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#if defined(__APPLE__)
+    return static_cast<std::size_t>(ru.ru_maxrss); // bytes
+#else
+    return static_cast<std::size_t>(ru.ru_maxrss) * 1024; // KiB
+#endif
+#else
+    return 0;
+#endif
+}
+
+void ScopedPhase::start(const char* name) {
+    name_ = name;
+#if defined(__linux__)
+    if (detail::g_hardware.load(std::memory_order_relaxed)) {
+        for (int i = 0; i < kHwCounters; ++i) hw_fd_[i] = open_hw_counter(i);
+    }
+#endif
+    start_ns_ = now_ns();
+}
+
+void ScopedPhase::stop() {
+    const double sec = static_cast<double>(now_ns() - start_ns_) * 1e-9;
+    uint64_t hw[kHwCounters] = {};
+    bool hw_ok = hw_fd_[0] >= 0;
+#if defined(__linux__)
+    for (int i = 0; i < kHwCounters; ++i) {
+        if (hw_fd_[i] < 0) {
+            hw_ok = false;
+            continue;
+        }
+        if (read(hw_fd_[i], &hw[i], sizeof(hw[i])) != static_cast<ssize_t>(sizeof(hw[i]))) hw_ok = false;
+        close(hw_fd_[i]);
+    }
+#endif
+    record_phase(name_, sec, hw_ok ? hw : nullptr);
+}
+
+namespace {
+
+void write_json_string(std::ostream& out, const std::string& s) {
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') out << '\\';
+        out << c;
+    }
+    out << '"';
+}
+
+// Counts as integers, times with full precision.
+void write_number(std::ostream& out, double v) {
+    if (v == std::floor(v) && std::fabs(v) < 9.007199254740992e15) out << static_cast<int64_t>(v);
+    else out << std::setprecision(9) << v << std::setprecision(6);
+}
+
+} // namespace
+
+void report(std::ostream& out, Format format) {
+    if (format == Format::Off) return;
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lk(r.mu);
+    const std::size_t rss = peak_rss_bytes();
+    if (format == Format::Text) {
+        for (const PhaseStats& p : r.phases) {
+            out << "profile phase=" << p.name << " calls=" << p.calls << " sec=" << p.sec << " peak_rss=" << p.peak_rss;
+            if (p.hw_calls)
+                for (int i = 0; i < 4; ++i) out << " " << kHwNames[i] << "=" << p.hw[i];
+            out << "\n";
+        }
+        for (const Counter& c : r.counters) {
+            out << "profile counter=" << c.name << " value=";
+            write_number(out, c.value);
+            out << "\n";
+        }
+        for (const ThreadCounter& c : r.thread_counters)
+            for (std::size_t t = 0; t < c.values.size(); ++t) {
+                out << "profile thread_counter=" << c.name << " tid=" << t << " value=";
+                write_number(out, c.values[t]);
+                out << "\n";
+            }
+        out << "profile peak_rss=" << rss << "\n";
+        return;
+    }
+    out << "{\"peak_rss_bytes\": " << rss << ", \"phases\": [";
+    for (std::size_t i = 0; i < r.phases.size(); ++i) {
+        const PhaseStats& p = r.phases[i];
+        out << (i ? ", " : "") << "{\"name\": ";
+        write_json_string(out, p.name);
+        out << ", \"calls\": " << p.calls << ", \"sec\": " << p.sec << ", \"peak_rss_bytes\": " << p.peak_rss;
+        if (p.hw_calls)
+            for (int k = 0; k < 4; ++k) out << ", \"" << kHwNames[k] << "\": " << p.hw[k];
+        out << "}";
+    }
+    out << "], \"counters\": {";
+    for (std::size_t i = 0; i < r.counters.size(); ++i) {
+        out << (i ? ", " : "");
+        write_json_string(out, r.counters[i].name);
+        out << ": ";
+        write_number(out, r.counters[i].value);
+    }
+    out << "}, \"thread_counters\": {";
+    for (std::size_t i = 0; i < r.thread_counters.size(); ++i) {
+        out << (i ? ", " : "");
+        write_json_string(out, r.thread_counters[i].name);
+        out << ": [";
+        for (std::size_t t = 0; t < r.thread_counters[i].values.size(); ++t) {
+            out << (t ? ", " : "");
+            write_number(out, r.thread_counters[i].values[t]);
+        }
+        out << "]";
+    }
+    out << "}}\n";
+}
+
+void Session::add_options(ArgParser& cli) {
+    cli.add_option(OptionSpec{.longName = "profile", .shortName = '\0', .type = ArgType::String, .valueName = "off|text|json", .help = "Report per-phase times, counters and peak RSS at exit", .required = false, .defaultValue = "off"});
+    cli.add_option(OptionSpec{.longName = "profile-out", .shortName = '\0', .type = ArgType::String, .valueName = "FILE", .help = "Write the --profile report to FILE instead of stderr", .required = false, .defaultValue = ""});
+    cli.add_flag("profile-hw", '\0', "With --profile: add hardware counters per phase (Linux perf_event_open)");
+}
+
+Session::Session(const ArgParser& cli) {
+    if (!parse_format(cli.get_string("profile"), format_)) {
+        std::cerr << "invalid profile value (use off|text|json)\n";
+        ok_ = false;
+        format_ = Format::Off;
+        return;
+    }
+    if (cli.provided("profile-out")) out_path_ = cli.get_string("profile-out");
+    if (format_ != Format::Off) enable(cli.get_flag("profile-hw"));
+}
+
+Session::~Session() {
+    if (format_ == Format::Off) return;
+    if (out_path_.empty()) {
+        report(std::cerr, format_);
+        return;
+    }
+    std::ofstream out(out_path_, std::ios::trunc);
+    if (out) report(out, format_);
+    else std::cerr << "Failed to write profile report: " << out_path_ << "\n";
+}
+
+} // namespace profile
+} // namespace thesis
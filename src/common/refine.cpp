@@ -0,0 +1,230 @@
+#include "thesis/refine.hpp"
+
+#include <algorithm>
+#include <barrier>
+#include <cassert>
+#include <limits>
+#include <numeric>
+#include <thread>
+
+#include "thesis/numa.hpp"
+#include "thesis/profile.hpp"
+#include "thesis/timer.hpp"
+
+namespace thesis {
+
+namespace {
+
+// Below this many batch nodes per thread, a thread only adds barrier waits.
+constexpr std::size_t kMinNodesPerRefineThread = 256;
+
+constexpr unsigned kNoColour = std::numeric_limits<unsigned>::max();
+
+// One decided move of a batch node: its best neighbouring community `to`
+// (its own if none gains) and its edge weight into the old and new community.
+struct Move {
+    unsigned to;
+    double w_from, w_to;
+};
+
+} // namespace
+
+ModularityRefiner::ModularityRefiner(const SegNeighbors& nb)
+    : nb_(&nb), n_(static_cast<uint32_t>(nb.offsets.size() - 1)), k_(n_, 0.0) {
+    for (uint32_t x = 0; x < n_; ++x) {
+        for (std::size_t j = nb.offsets[x]; j < nb.offsets[x + 1]; ++j)
+            k_[x] += nb.adj[j].second;
+        m_ += k_[x];
+    }
+    m_ /= 2.0;
+
+    // Greedy colouring, largest degree first (ties by id): fewer colours, so
+    // fewer and larger batches.
+    std::vector<unsigned> order(n_);
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+        return nb.offsets[a + 1] - nb.offsets[a] > nb.offsets[b + 1] - nb.offsets[b];
+    });
+    std::vector<unsigned> colour(n_, kNoColour), taken_by;
+    unsigned num_colours = 0;
+    for (unsigned x : order) {
+        for (std::size_t j = nb.offsets[x]; j < nb.offsets[x + 1]; ++j) {
+            const unsigned c = colour[nb.adj[j].first];
+            if (c != kNoColour) taken_by[c] = x;
+        }
+        unsigned c = 0;
+        while (c < num_colours && taken_by[c] == x) ++c;
+        if (c == num_colours) {
+            ++num_colours;
+            taken_by.push_back(kNoColour);
+        }
+        colour[x] = c;
+    }
+    colour_offsets_.assign(static_cast<std::size_t>(num_colours) + 1, 0);
+    for (uint32_t x = 0; x < n_; ++x) colour_offsets_[colour[x] + 1]++;
+    for (unsigned c = 0; c < num_colours; ++c) colour_offsets_[c + 1] += colour_offsets_[c];
+    colour_nodes_.resize(n_);
+    std::vector<std::size_t> cursor(colour_offsets_.begin(), colour_offsets_.end() - 1);
+    for (uint32_t x = 0; x < n_; ++x) colour_nodes_[cursor[colour[x]]++] = x;
+}
+
+RefineStats ModularityRefiner::refine(std::vector<unsigned>& labels, const RefineOptions& opt) const {
+    assert(labels.size() == n_);
+    profile::ScopedPhase phase("refine");
+    Timer timer;
+    RefineStats st;
+    if (m_ == 0.0 || opt.max_rounds == 0) {
+        st.converged = m_ == 0.0;
+        return st;
+    }
+    const SegNeighbors& nb = *nb_;
+    const double gamma = opt.gamma;
+    const double inv_m = 1.0 / m_;
+    const double vol_scale = gamma / (2.0 * m_ * m_);
+
+    std::vector<double> tot(n_, 0.0);
+    for (uint32_t x = 0; x < n_; ++x) tot[labels[x]] += k_[x];
+
+    unsigned T = opt.threads;
+    if (T == 0) {
+        const unsigned hc = std::thread::hardware_concurrency();
+        T = hc ? hc : 1u;
+    }
+    std::size_t max_batch = 0;
+    for (std::size_t c = 0; c + 1 < colour_offsets_.size(); ++c)
+        max_batch = std::max(max_batch, colour_offsets_[c + 1] - colour_offsets_[c]);
+    T = static_cast<unsigned>(std::clamp<std::size_t>(max_batch / kMinNodesPerRefineThread, 1, T));
+
+    // Nodes to decide this round; cleared when decided, set for the
+    // neighbours of every node that moves.
+    std::vector<unsigned char> active(n_, 1);
+    std::vector<unsigned> batch;
+    std::vector<Move> moves(max_batch);
+    batch.reserve(max_batch);
+
+    // Batch control, only touched by thread 0 between the barriers.
+    const unsigned num_colours = colours();
+    unsigned colour = 0;
+    uint64_t round_moves = 0;
+    double round_gain = 0.0;
+    bool done = false;
+
+    // Fill `batch` with the active nodes of the next colour that has any,
+    // closing rounds on the way; sets `done` when a budget is spent or a round
+    // ends without a move.
+    auto next_batch = [&]() {
+        batch.clear();
+        while (batch.empty()) {
+            if (colour == num_colours) {
+                ++st.rounds;
+                const bool stalled = round_moves == 0 || round_gain <= opt.min_round_gain;
+                st.converged = round_moves == 0;
+                if (stalled || st.rounds >= opt.max_rounds) {
+                    done = true;
+                    return;
+                }
+                colour = 0;
+                round_moves = 0;
+                round_gain = 0.0;
+            }
+            if (opt.time_limit > 0.0 && timer.sec() >= opt.time_limit) {
+                st.converged = false;
+                done = true;
+                return;
+            }
+            for (std::size_t i = colour_offsets_[colour]; i < colour_offsets_[colour + 1]; ++i)
+                if (active[colour_nodes_[i]]) batch.push_back(colour_nodes_[i]);
+            ++colour;
+        }
+    };
+
+    auto apply = [&]() {
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            const unsigned x = batch[i];
+            const Move& mv = moves[i];
+            const unsigned from = labels[x];
+            if (mv.to == from) continue;
+            // Earlier moves of this batch may have changed both volumes.
+            const double gain = (mv.w_to - mv.w_from) * inv_m - vol_scale * k_[x] * (tot[mv.to] - tot[from] + k_[x]);
+            if (gain <= 0.0) continue;
+            labels[x] = mv.to;
+            tot[from] -= k_[x];
+            tot[mv.to] += k_[x];
+            round_gain += gain;
+            ++round_moves;
+            ++st.moves;
+            st.gain += gain;
+            for (std::size_t j = nb.offsets[x]; j < nb.offsets[x + 1]; ++j)
+                active[nb.adj[j].first] = 1;
+        }
+        st.evaluated += batch.size();
+    };
+
+    std::barrier sync(T);
+    auto worker = [&](unsigned tid) {
+        ScopedPlacement pin(tid, T);
+        // Edge weight from the node being decided to each neighbouring community.
+        std::vector<double> acc(n_, 0.0);
+        std::vector<unsigned char> seen(n_, 0);
+        std::vector<unsigned> touched;
+        for (;;) {
+            if (tid == 0) next_batch();
+            sync.arrive_and_wait();
+            if (done) break;
+
+            const std::size_t lo = batch.size() * tid / T, hi = batch.size() * (tid + 1) / T;
+            for (std::size_t i = lo; i < hi; ++i) {
+                const unsigned x = batch[i];
+                active[x] = 0;
+                const unsigned from = labels[x];
+                Move mv{from, 0.0, 0.0};
+                const double kx = k_[x];
+                for (std::size_t j = nb.offsets[x]; j < nb.offsets[x + 1]; ++j) {
+                    const unsigned c = labels[nb.adj[j].first];
+                    if (!seen[c]) {
+                        seen[c] = 1;
+                        touched.push_back(c);
+                    }
+                    acc[c] += nb.adj[j].second;
+                }
+                mv.w_from = acc[from];
+                double best = 0.0;
+                for (unsigned c : touched) {
+                    if (c == from) continue;
+                    const double gain = (acc[c] - mv.w_from) * inv_m - vol_scale * kx * (tot[c] - tot[from] + kx);
+                    if (gain > best || (gain == best && gain > 0.0 && c < mv.to)) {
+                        best = gain;
+                        mv.to = c;
+                        mv.w_to = acc[c];
+                    }
+                }
+                for (unsigned c : touched) {
+                    acc[c] = 0.0;
+                    seen[c] = 0;
+                }
+                touched.clear();
+                moves[i] = mv;
+            }
+            sync.arrive_and_wait();
+            if (tid == 0) apply();
+        }
+    };
+
+    if (T == 1) {
+        worker(0);
+    } else {
+        std::vector<std::thread> pool;
+        pool.reserve(T - 1);
+        for (unsigned tid = 1; tid < T; ++tid)
+            pool.emplace_back(worker, tid);
+        worker(0);
+        for (auto& th : pool)
+            th.join();
+    }
+    st.sec = timer.sec();
+    profile::add("refine.moves", static_cast<double>(st.moves));
+    profile::add("refine.evaluated", static_cast<double>(st.evaluated));
+    return st;
+}
+
+} // namespace thesis
@@ -6,11 +6,17 @@
 //
 // Implementation highlights (matches code below):
 //  - Inputs: undirected similarity edges (u,v,w) with w>0; distance d=1/w.
-//  - Preprocessing: edges sorted descending by weight (strongest first).
+//  - Preprocessing: edges sorted descending by weight (strongest first), ties
+//    by (u, v); std::sort or a parallel radix sort per Config::edge_sort.
+//    run() is a template over the VIG edge layouts (AoS double/float, SoA);
+//    weights are widened to double on read, so all guard arithmetic is shared.
 //  - FH predicate with tunable bias: each component C keeps max_dist(C)
 //    (max edge distance seen within C so far). The gate is
 //        Gate(C) = max_dist(C) + k / |C|^sizeExponent
 //    A merge (a,b) is allowed if (1/w)/d_scale <= min(Gate(a), Gate(b)).
+//    |C|^sizeExponent is cached per root and refreshed on each union (from a
+//    table for small sizes; no pow() at all for sizeExponent == 1), so a gate
+//    test costs a division, not two pow() calls.
 //  - Union-Find backbone: union-by-rank + path compression. On accept,
 //    update comp_size, max_dist and (if enabled) modularity guard state.
 //  - Modularity guard (optional): prevents merges that would clearly reduce
@@ -29,25 +35,147 @@
 //    Tolerance can be annealed: small negative allowed for tiny comps,
 //    contracts toward 0 with component volume (scale ~ mean degree by default).
 //  - Inter-component candidates: edges that failed merge are stored (in the
-//    same descending order). strongest_inter_component_edges() returns at most
-//    one strongest edge per unordered pair of final components (first seen wins
-//    due to sort order).
+//    same descending order): all of them, only the first per pair of roots at
+//    rejection time (a flat hash set of pair keys; the first is the heaviest and
+//    the pair maps to one final pair), or none (Config::candidates).
+//    strongest_inter_component_edges() relabels them by final root on several
+//    threads, sorts them by (root pair, weight desc) with the edge sorter and
+//    keeps the first of each pair: one strongest edge per unordered pair of
+//    final components, in pair order.
+//  - Incremental k (guard off, Config::record_trajectory): each run logs its
+//    unions and the gate inputs of every rejected edge. Gate(C) grows with k
+//    for fixed state, so at a larger k the run is unchanged up to the first
+//    logged rejection that now passes; resume_presorted() replays the unions
+//    before it and continues from there.
 //  - Complexity: one sort O(E log E) + near-linear passes with DSU operations.
-//  - Determinism: order is driven by the sort and stable arithmetic; no threads.
+//  - Parallel merge loop (Config::seg_threads > 1): the sorted edges are cut
+//    into blocks. Workers split a block and, on a DSU with concurrent finds (CAS
+//    path halving, see concurrent_disjoint_set.hpp), resolve each edge's roots and
+//    FH gate against the state at the block start; nothing is written but DSU
+//    shortcuts. Thread 0 then runs the ordinary merge loop over the block: an
+//    edge whose two roots took part in no earlier union of the block sees
+//    exactly the prefetched state, so its decision is kept; the others are
+//    recomputed. Unions, guard tests and all per-component updates stay in
+//    edge order on one thread, with DisjointSets' root choice, so the result is
+//    identical to the sequential loop. The gain is in the finds and gate
+//    evaluations of rejected and intra-component edges, usually the bulk.
+//  - Determinism: the edge order is total, so results do not depend on the
+//    builder's output order, on the sort method/threads or on seg_threads.
 //  - Memory: minimal extra state (DSU arrays, a few per-component vectors,
 //    and the optional candidate list).
 // ----------------------------------------------------------------------------
 
 #include "thesis/segmentation.hpp"
+#include "thesis/numa.hpp"
+#include "thesis/profile.hpp"
+#include <barrier>
+#include <bit>
 #include <numeric>
-#include <unordered_map>
 #include <unordered_set>
 #include <cstdlib>
 #include <iostream>
+#include <stdexcept>
+#include <cassert>
+#include <thread>
+#include <type_traits>
 
 namespace thesis
 {
 
+    const char *seg_state_layout_name(SegStateLayout l)
+    {
+        return l == SegStateLayout::Packed ? "packed" : "split";
+    }
+
+    bool parse_seg_state_layout(const std::string &s, SegStateLayout &out)
+    {
+        if (s == "split") out = SegStateLayout::Split;
+        else if (s == "packed") out = SegStateLayout::Packed;
+        else return false;
+        return true;
+    }
+
+    const char *node_relabel_name(NodeRelabel r)
+    {
+        switch (r)
+        {
+        case NodeRelabel::None: return "none";
+        case NodeRelabel::Bfs: return "bfs";
+        case NodeRelabel::Degree: return "degree";
+        }
+        return "none";
+    }
+
+    bool parse_node_relabel(const std::string &s, NodeRelabel &out)
+    {
+        if (s == "none") out = NodeRelabel::None;
+        else if (s == "bfs") out = NodeRelabel::Bfs;
+        else if (s == "degree") out = NodeRelabel::Degree;
+        else return false;
+        return true;
+    }
+
+    const char *candidate_store_name(CandidateStore c)
+    {
+        switch (c)
+        {
+        case CandidateStore::All: return "all";
+        case CandidateStore::PairMax: return "pairmax";
+        case CandidateStore::None: return "none";
+        }
+        return "all";
+    }
+
+    bool parse_candidate_store(const std::string &s, CandidateStore &out)
+    {
+        if (s == "all") out = CandidateStore::All;
+        else if (s == "pairmax") out = CandidateStore::PairMax;
+        else if (s == "none") out = CandidateStore::None;
+        else return false;
+        return true;
+    }
+
+    void GraphSegmenterFH::PairKeySet::clear()
+    {
+        slots.clear();
+        used = 0;
+        shift = 64;
+    }
+
+    bool GraphSegmenterFH::PairKeySet::insert(std::uint64_t key)
+    {
+        constexpr std::uint64_t kEmpty = ~std::uint64_t{0};
+        auto home = [this](std::uint64_t k) { return static_cast<std::size_t>((k * 0x9E3779B97F4A7C15ull) >> shift); };
+        if (2 * (used + 1) > slots.size()) // keep the load at or below 1/2
+        {
+            std::vector<std::uint64_t> old;
+            old.swap(slots);
+            const std::size_t cap = std::max<std::size_t>(64, 2 * old.size());
+            shift = 64 - static_cast<unsigned>(std::countr_zero(cap));
+            slots.assign(cap, kEmpty);
+            for (const std::uint64_t k : old)
+            {
+                if (k == kEmpty)
+                    continue;
+                std::size_t g = home(k);
+                while (slots[g] != kEmpty)
+                    g = (g + 1) & (cap - 1);
+                slots[g] = k;
+            }
+        }
+        const std::size_t mask = slots.size() - 1;
+        std::size_t h = home(key);
+        while (slots[h] != kEmpty)
+        {
+            if (slots[h] == key)
+                return false;
+            h = (h + 1) & mask;
+        }
+        slots[h] = key;
+        ++used;
+        return true;
+    }
+
     GraphSegmenterFH::GraphSegmenterFH(unsigned n, double k) { reset(n, k); }
 
     void GraphSegmenterFH::reset(unsigned n, double k)
@@ -56,86 +184,210 @@ namespace thesis
         mod_guard_lb_accepts_ = 0;
         mod_guard_ub_rejects_ = 0;
         mod_guard_ambiguous_ = 0;
+        mod_lookups_ = 0;
+        mod_lookup_scanned_ = 0;
+        mod_lookup_probed_ = 0;
         comp_size_.assign(n, 1);
-        if (cfg_.use_modularity_guard)
-        {
-            comp_vol_.assign(n, 0);
-            lb_comp_internal_w_.assign(n, 0);
-        }
+        // The guard's per-node state is set up by the run, after any set_config().
+        comp_vol_.clear();
+        lb_comp_internal_w_.clear();
+        next_member_.clear();
         max_dist_.assign(n, 0);
+        size_term_.assign(n, 1.0); // |1|^x
         k_ = k;
         d_scale_ = 1.0;
         intercomp_candidates_.clear();
+        candidate_pairs_.clear();
+        traj_valid_ = false;
     }
 
-    static inline bool edge_desc(const SegEdge &a, const SegEdge &b) { return a.w > b.w; }
-
-    void GraphSegmenterFH::run(std::vector<SegEdge> &edges)
+    namespace
     {
-        // Sort edges to process in order of weight
-        std::sort(edges.begin(), edges.end(), edge_desc);
+        // Parallel merge loop: edges per block, and the fewest edges left to
+        // process per worker thread before the loop stays sequential.
+        constexpr std::size_t kParallelSegBlock = std::size_t{1} << 14;
+        constexpr std::size_t kMinEdgesPerSegThread = std::size_t{1} << 15;
+        // strongest_inter_component_edges(): fewest candidates per relabeling thread.
+        constexpr std::size_t kMinCandidatesPerThread = std::size_t{1} << 15;
 
-        // Create a copy of edges for neighbor tracking
-        const size_t num_vars = dsu_.size();
-        std::vector<unsigned> var_edge_counts(num_vars, 0);
-        for (const auto &e : edges)
+        // EdgePrefetch::kind
+        constexpr unsigned char kPrefetchSkip = 0;   // w <= 0
+        constexpr unsigned char kPrefetchIntra = 1;  // same root at block start
+        constexpr unsigned char kPrefetchReject = 2; // FH gate fails
+        constexpr unsigned char kPrefetchPass = 3;   // FH gate passes
+
+        // Size term |C|^x of the gate (at least 1), as used from the first release on.
+        inline double size_term_value(unsigned size, double exponent)
         {
-            var_edge_counts[e.u]++;
-            var_edge_counts[e.v]++;
+            const double st = std::pow(static_cast<double>(size), exponent);
+            return st > 0 ? st : 1.0;
         }
-        for (unsigned i = 1; i < num_vars; i++)
+
+        // Size-term policies of the merge loop, evaluated once per union (the gate
+        // reads the root's cached value). PowSizeTerm tabulates the small sizes,
+        // where nearly all unions land; UnitSizeTerm is classic FH.
+        struct PowSizeTerm
         {
-            var_edge_counts[i] += var_edge_counts[i - 1];
-        }
-        const size_t total_var_edges = var_edge_counts.back();
-        std::vector<std::pair<unsigned, double>> var_neighbors(total_var_edges);
-        for (const auto &e : edges)
+            static constexpr unsigned kTableSize = 4096;
+            std::vector<double> table;
+            double exponent;
+
+            PowSizeTerm(double x, unsigned n) : table(std::min(n, kTableSize - 1) + 1), exponent(x)
+            {
+                for (unsigned s = 0; s < table.size(); ++s)
+                    table[s] = size_term_value(s, x);
+            }
+            double operator()(unsigned size) const { return size < table.size() ? table[size] : size_term_value(size, exponent); }
+        };
+        struct UnitSizeTerm
+        {
+            double operator()(unsigned size) const { return static_cast<double>(size); }
+        };
+
+        // a[to[x]] = a[x] for every node x.
+        template <class T>
+        void permute(std::vector<T> &a, const std::vector<unsigned> &to)
         {
-            var_neighbors[--var_edge_counts[e.u]] = std::make_pair(e.v, e.w);
-            var_neighbors[--var_edge_counts[e.v]] = std::make_pair(e.u, e.w);
+            std::vector<T> out(a.size());
+            for (std::size_t x = 0; x < a.size(); ++x)
+                out[to[x]] = a[x];
+            a.swap(out);
         }
 
-        // function to get sum of weights of edges from u to component c
-        auto sum_weights_to_comp = [&](unsigned u, unsigned c) {
-            double sum = 0.0;
-            unsigned start = var_edge_counts[u];
-            unsigned end_idx = (u + 1 < num_vars ? var_edge_counts[u + 1] : total_var_edges);
-            for (unsigned i = start; i < end_idx; ++i) {
-                unsigned v = var_neighbors[i].first;
-                double w = var_neighbors[i].second;
-                if (dsu_.find(v) == c) {
-                    sum += w;
+        // New node order for Config::relabel: order[new id] = old id.
+        std::vector<unsigned> relabel_order(NodeRelabel r, const SegNeighbors &nb)
+        {
+            const unsigned n = static_cast<unsigned>(nb.offsets.size() - 1);
+            std::vector<unsigned> order;
+            order.reserve(n);
+            if (r == NodeRelabel::Degree)
+            {
+                order.resize(n);
+                std::iota(order.begin(), order.end(), 0u);
+                std::stable_sort(order.begin(), order.end(), [&nb](unsigned a, unsigned b) {
+                    return nb.offsets[a + 1] - nb.offsets[a] > nb.offsets[b + 1] - nb.offsets[b];
+                });
+                return order;
+            }
+            // Bfs: components in order of their smallest id; order doubles as the queue.
+            std::vector<bool> seen(n, false);
+            for (unsigned s = 0; s < n; ++s)
+            {
+                if (seen[s])
+                    continue;
+                seen[s] = true;
+                order.push_back(s);
+                for (std::size_t q = order.size() - 1; q < order.size(); ++q)
+                {
+                    const unsigned x = order[q];
+                    for (std::size_t i = nb.offsets[x]; i < nb.offsets[x + 1]; ++i)
+                    {
+                        const unsigned y = nb.adj[i].first;
+                        if (!seen[y])
+                        {
+                            seen[y] = true;
+                            order.push_back(y);
+                        }
+                    }
                 }
             }
-            return sum;
-        };
+            return order;
+        }
+
+        // Counting sort of both edge directions by endpoint. Each node's list is
+        // filled back to front, i.e. in reverse edge order.
+        template <class Edges>
+        SegNeighbors build_neighbors(unsigned n, const Edges &edges, bool hub_index)
+        {
+            SegNeighbors nb;
+            nb.offsets.assign(static_cast<std::size_t>(n) + 1, 0);
+            const std::size_t num_edges = edge_count(edges);
+            for (std::size_t i = 0; i < num_edges; ++i)
+            {
+                const auto e = edge_at(edges, i);
+                nb.offsets[e.u + 1]++;
+                nb.offsets[e.v + 1]++;
+            }
+            for (std::size_t x = 1; x <= n; ++x)
+                nb.offsets[x] += nb.offsets[x - 1];
+            nb.adj.resize(nb.offsets[n]);
+            // Fill through per-node end cursors; afterwards cursor[x] == offsets[x].
+            std::vector<std::size_t> cursor(nb.offsets.begin() + 1, nb.offsets.end());
+            for (std::size_t i = 0; i < num_edges; ++i)
+            {
+                const auto e = edge_at(edges, i);
+                nb.adj[--cursor[e.u]] = std::make_pair(e.v, static_cast<double>(e.w));
+                nb.adj[--cursor[e.v]] = std::make_pair(e.u, static_cast<double>(e.w));
+            }
+            if (!hub_index)
+                return nb;
+
+            nb.hub_offsets.assign(static_cast<std::size_t>(n) + 1, 0);
+            for (std::size_t x = 0; x < n; ++x)
+            {
+                const std::size_t deg = nb.offsets[x + 1] - nb.offsets[x];
+                nb.hub_offsets[x + 1] = nb.hub_offsets[x] + (deg >= SegNeighbors::kHubDegree ? deg : 0);
+            }
+            nb.hub_index.resize(nb.hub_offsets[n]);
+            for (std::size_t x = 0; x < n; ++x)
+            {
+                const std::size_t h = nb.hub_offsets[x];
+                const std::size_t deg = nb.hub_offsets[x + 1] - h;
+                for (std::size_t j = 0; j < deg; ++j)
+                    nb.hub_index[h + j] = std::make_pair(nb.adj[nb.offsets[x] + j].first, static_cast<unsigned>(j));
+                std::sort(nb.hub_index.begin() + h, nb.hub_index.begin() + h + deg);
+            }
+            return nb;
+        }
+    } // namespace
 
-        //// function to get weight of edge from node a to node b (0 if none)
-        // auto a_b_weight = [&](unsigned a, unsigned b) {
-        //     unsigned start_a = var_edge_counts[a];
-        //     unsigned end_a = (a + 1 < num_vars ? var_edge_counts[a + 1] : total_var_edges);
-        //     unsigned start_b = var_edge_counts[b];
-        //     unsigned end_b = (b + 1 < num_vars ? var_edge_counts[b + 1] : total_var_edges);
-        //     unsigned second = b, start = start_a, end = end_a;
-        //     if (end_a - start_a > end_b - start_b) {
-        //         second = a; start = start_b; end = end_b;
-        //     }
-        //     for (unsigned i = start; i < end; ++i) {
-        //         unsigned v = var_neighbors[i].first;
-        //         double w = var_neighbors[i].second;
-        //         if (dsu_.find(v) == second) {
-        //             return w;
-        //         }
-        //     }
-        //     return 0.0;
-        // };
+    SegNeighbors SegNeighbors::build(unsigned n, std::span<const SegEdge> edges, bool hub_index)
+    {
+        return build_neighbors(n, edges, hub_index);
+    }
+
+    template <class Edges>
+    void GraphSegmenterFH::run(Edges &edges)
+    {
+        // Sort edges to process in order of weight (ties by (u, v), see edge_sort.hpp)
+        EdgeSortOptions sort_opt;
+        sort_opt.method = cfg_.edge_sort;
+        sort_opt.radix_threshold = cfg_.radix_sort_threshold;
+        sort_opt.threads = cfg_.sort_threads;
+        last_edge_sort_ = sort_edges_desc(edges, sort_opt);
+        run_sorted(edges, build_neighbors(node_count(), edges, cfg_.use_modularity_guard && cfg_.hub_index));
+    }
+
+    void GraphSegmenterFH::run_presorted(std::span<const SegEdge> edges)
+    {
+        run_presorted(edges, SegNeighbors::build(node_count(), edges, cfg_.use_modularity_guard && cfg_.hub_index));
+    }
+
+    void GraphSegmenterFH::run_presorted(std::span<const SegEdge> edges, const SegNeighbors &neighbors)
+    {
+        if (neighbors.offsets.size() != static_cast<std::size_t>(node_count()) + 1 || neighbors.adj.size() != 2 * edges.size())
+            throw std::invalid_argument("run_presorted: neighbor lists do not match the segmenter/edges");
+        assert(std::is_sorted(edges.begin(), edges.end(), edge_order_before<double>));
+        run_sorted(edges, neighbors);
+    }
+
+    template <class Edges>
+    void GraphSegmenterFH::run_sorted(const Edges &edges, const SegNeighbors &neighbors)
+    {
+        const std::size_t num_edges = edge_count(edges);
 
         // Accumulate total weight and per-node volumes in a single pass
         sum_weights_ = 0.0;
         if (cfg_.use_modularity_guard)
         {
-            for (const auto &e : edges)
+            const unsigned n = node_count();
+            comp_vol_.assign(n, 0);
+            lb_comp_internal_w_.assign(n, 0);
+            next_member_.resize(n);
+            std::iota(next_member_.begin(), next_member_.end(), 0u);
+            for (std::size_t i = 0; i < num_edges; ++i)
             {
+                const auto e = edge_at(edges, i);
                 sum_weights_ += e.w;
                 // Initially each variable is its own component, we expect no self-loops
                 comp_vol_[e.u] += e.w;
@@ -144,44 +396,558 @@ namespace thesis
         }
 
         intercomp_candidates_.clear();
+        candidate_pairs_.clear();
+        traj_unions_.clear();
+        traj_rejects_.clear();
+        // PairMax drops candidates by pair, so they cannot be cut back to a position.
+        traj_valid_ = cfg_.record_trajectory && !cfg_.use_modularity_guard && cfg_.candidates != CandidateStore::PairMax;
+        traj_edge_count_ = num_edges;
 
-        for (const auto &e : edges)
+        if (cfg_.relabel == NodeRelabel::None)
         {
-            if (!(e.w > 0))
-                continue;
-            unsigned a = dsu_.find(e.u);
-            unsigned b = dsu_.find(e.v);
+            merge_edges(edges, neighbors, 0);
+            return;
+        }
+
+        // Relabeled run: same edge sequence with renamed endpoints (u stays the first
+        // endpoint, so every tie in the loop resolves as before), then rename back.
+        const std::vector<unsigned> order = relabel_order(cfg_.relabel, neighbors); // new id -> old id
+        std::vector<unsigned> to(order.size());                                     // old id -> new id
+        for (unsigned x = 0; x < order.size(); ++x)
+            to[order[x]] = x;
+        std::vector<SegEdge> relabeled(num_edges);
+        for (std::size_t i = 0; i < num_edges; ++i)
+        {
+            const auto e = edge_at(edges, i);
+            relabeled[i] = SegEdge{to[e.u], to[e.v], static_cast<double>(e.w)};
+        }
+        // The guard's lookups need neighbor lists in the new ids (same per-node order).
+        const SegNeighbors relabeled_nb = cfg_.use_modularity_guard ? build_neighbors(node_count(), relabeled, cfg_.hub_index) : SegNeighbors{};
+        permute_nodes(to);
+        merge_edges(relabeled, relabeled_nb, 0);
+        permute_nodes(order);
+        for (SegEdge &e : intercomp_candidates_)
+        {
+            e.u = order[e.u];
+            e.v = order[e.v];
+        }
+    }
+
+    void GraphSegmenterFH::permute_nodes(const std::vector<unsigned> &to)
+    {
+        const std::size_t n = to.size();
+        std::vector<unsigned> parent(n);
+        std::vector<unsigned char> rank(n);
+        const std::vector<unsigned> &old_parent = dsu_.parents();
+        const std::vector<unsigned char> &old_rank = dsu_.ranks();
+        for (std::size_t x = 0; x < n; ++x)
+        {
+            parent[to[x]] = to[old_parent[x]];
+            rank[to[x]] = old_rank[x];
+        }
+        dsu_.assign(std::move(parent), std::move(rank));
+        permute(comp_size_, to);
+        permute(max_dist_, to);
+        permute(size_term_, to);
+        if (cfg_.use_modularity_guard)
+        {
+            permute(comp_vol_, to);
+            permute(lb_comp_internal_w_, to);
+            std::vector<unsigned> next(n);
+            for (std::size_t x = 0; x < n; ++x)
+                next[to[x]] = to[next_member_[x]];
+            next_member_.swap(next);
+        }
+    }
+
+    std::size_t GraphSegmenterFH::resume_presorted(double k, std::span<const SegEdge> edges, const SegNeighbors &neighbors)
+    {
+        if (!traj_valid_ || cfg_.use_modularity_guard || traj_edge_count_ != edges.size() || !(k >= k_))
+        {
+            reset(node_count(), k);
+            run_presorted(edges, neighbors);
+            return 0;
+        }
+
+        // First rejected edge whose gate test passes at the new k. Recomputed with
+        // gate_value() so the decision is bit-identical to a fresh run's.
+        std::size_t j = 0;
+        for (; j < traj_rejects_.size(); ++j)
+        {
+            const RejectedGate &g = traj_rejects_[j];
+            const double ga = gate_value(g.max_dist_a, g.size_term_a, k);
+            const double gb = gate_value(g.max_dist_b, g.size_term_b, k);
+            if (g.dist <= (ga < gb ? ga : gb))
+                break;
+        }
+        k_ = k;
+        if (j == traj_rejects_.size())
+            return edges.size(); // every decision holds: same partition
+
+        // Rebuild the state just before that edge by replaying the earlier unions
+        // in order (union-by-rank then picks the same roots), then continue there.
+        const std::size_t p = traj_rejects_[j].pos;
+        const unsigned n = node_count();
+        dsu_.reset(n);
+        comp_size_.assign(n, 1);
+        max_dist_.assign(n, 0);
+        size_term_.assign(n, 1.0);
+        std::size_t u = 0;
+        for (; u < traj_unions_.size() && traj_unions_[u] < p; ++u)
+        {
+            const SegEdge &e = edges[traj_unions_[u]];
+            const unsigned a = dsu_.find(e.u);
+            const unsigned b = dsu_.find(e.v);
+            const double connection_distance = (1 / e.w) / d_scale_;
+            const unsigned r = dsu_.unite(a, b);
+            comp_size_[r] = comp_size_[a] + comp_size_[b];
+            max_dist_[r] = std::max(std::max(max_dist_[a], max_dist_[b]), connection_distance);
+            size_term_[r] = cfg_.sizeExponent == 1.0 ? UnitSizeTerm{}(comp_size_[r]) : size_term_value(comp_size_[r], cfg_.sizeExponent);
+        }
+        traj_unions_.resize(u);
+        traj_rejects_.resize(j);
+        if (cfg_.candidates == CandidateStore::All)
+            intercomp_candidates_.resize(j);
+
+        merge_edges(edges, neighbors, p);
+        return p;
+    }
+
+    // State view over the split arrays and a union-find backbone (DisjointSets, or
+    // ConcurrentDisjointSets in the parallel loop); the guard arrays only with Guard.
+    template <class Dsu, bool Guard>
+    struct GraphSegmenterFH::SplitState
+    {
+        GraphSegmenterFH &s;
+        Dsu &dsu;
+
+        unsigned find(unsigned x) { return dsu.find(x); }
+        unsigned size(unsigned r) const { return s.comp_size_[r]; }
+        double max_dist(unsigned r) const { return s.max_dist_[r]; }
+        double size_term(unsigned r) const { return s.size_term_[r]; }
+        double vol(unsigned r) const { return s.comp_vol_[r]; }
+        double lb(unsigned r) const { return s.lb_comp_internal_w_[r]; }
+        void add_internal(unsigned r, double w) { s.lb_comp_internal_w_[r] += w; }
+
+        // Unite roots a != b over an edge of weight w at distance d; `term` is the size
+        // term of the merged component. Returns the new root.
+        unsigned merge(unsigned a, unsigned b, double d, double w, double term)
+        {
+            unsigned r;
+            if constexpr (std::is_same_v<Dsu, ConcurrentDisjointSets>)
+                r = dsu.unite_serial(a, b);
+            else
+                r = dsu.unite(a, b);
+            s.comp_size_[r] = s.comp_size_[a] + s.comp_size_[b];
+            s.size_term_[r] = term;
+            if constexpr (Guard)
+            {
+                s.comp_vol_[r] = s.comp_vol_[a] + s.comp_vol_[b];
+                s.lb_comp_internal_w_[r] = s.lb_comp_internal_w_[a] + s.lb_comp_internal_w_[b] + w;
+            }
+            // Track maximum distance within the component (use connection_distance)
+            const double prev_max = std::max(s.max_dist_[a], s.max_dist_[b]);
+            s.max_dist_[r] = std::max(prev_max, d);
+            return r;
+        }
+    };
+
+    namespace
+    {
+        // Everything the merge loop reads or writes for a root in one record:
+        // 24 bytes with the guard off, 40 with it on.
+        struct PackedRoot
+        {
+            unsigned parent; // parent id, or kPackedRoot | rank for a root
+            unsigned size;
+            double max_dist;
+            double size_term;
+        };
+        struct PackedGuardRoot : PackedRoot
+        {
+            double vol;
+            double lb_internal;
+        };
+        static_assert(sizeof(PackedRoot) == 24 && sizeof(PackedGuardRoot) == 40);
+        constexpr unsigned kPackedRoot = 1u << 31;
+    } // namespace
+
+    // State view over packed records. Union by rank with DisjointSets' tie rule, so
+    // the roots are the split layout's. Loaded from and stored back into the split
+    // arrays around each merge loop, so everything else sees one representation.
+    template <bool Guard>
+    struct GraphSegmenterFH::PackedState
+    {
+        using Root = std::conditional_t<Guard, PackedGuardRoot, PackedRoot>;
+        std::vector<Root> nodes;
+
+        explicit PackedState(const GraphSegmenterFH &s)
+        {
+            const unsigned n = s.node_count();
+            if (n >= kPackedRoot)
+                throw std::length_error("packed segmentation state: more than 2^31 nodes");
+            const std::vector<unsigned> &parent = s.dsu_.parents();
+            const std::vector<unsigned char> &rank = s.dsu_.ranks();
+            nodes.resize(n);
+            for (unsigned x = 0; x < n; ++x)
+            {
+                Root &p = nodes[x];
+                p.parent = parent[x] == x ? (kPackedRoot | rank[x]) : parent[x];
+                p.size = s.comp_size_[x];
+                p.max_dist = s.max_dist_[x];
+                p.size_term = s.size_term_[x];
+                if constexpr (Guard)
+                {
+                    p.vol = s.comp_vol_[x];
+                    p.lb_internal = s.lb_comp_internal_w_[x];
+                }
+            }
+        }
+
+        void store(GraphSegmenterFH &s) const
+        {
+            const unsigned n = static_cast<unsigned>(nodes.size());
+            std::vector<unsigned> parent(n);
+            std::vector<unsigned char> rank(n, 0);
+            for (unsigned x = 0; x < n; ++x)
+            {
+                const Root &p = nodes[x];
+                if (p.parent & kPackedRoot)
+                {
+                    parent[x] = x;
+                    rank[x] = static_cast<unsigned char>(p.parent & ~kPackedRoot);
+                }
+                else
+                    parent[x] = p.parent;
+                s.comp_size_[x] = p.size;
+                s.max_dist_[x] = p.max_dist;
+                s.size_term_[x] = p.size_term;
+                if constexpr (Guard)
+                {
+                    s.comp_vol_[x] = p.vol;
+                    s.lb_comp_internal_w_[x] = p.lb_internal;
+                }
+            }
+            s.dsu_.assign(std::move(parent), std::move(rank));
+        }
+
+        unsigned find(unsigned x)
+        {
+            unsigned root = x;
+            while (!(nodes[root].parent & kPackedRoot))
+                root = nodes[root].parent;
+            while (x != root)
+            {
+                const unsigned p = nodes[x].parent;
+                nodes[x].parent = root;
+                x = p;
+            }
+            return root;
+        }
+        unsigned size(unsigned r) const { return nodes[r].size; }
+        double max_dist(unsigned r) const { return nodes[r].max_dist; }
+        double size_term(unsigned r) const { return nodes[r].size_term; }
+        double vol(unsigned r) const
+        {
+            if constexpr (Guard)
+                return nodes[r].vol;
+            else
+                return 0.0;
+        }
+        double lb(unsigned r) const
+        {
+            if constexpr (Guard)
+                return nodes[r].lb_internal;
+            else
+                return 0.0;
+        }
+        void add_internal(unsigned r, double w)
+        {
+            if constexpr (Guard)
+                nodes[r].lb_internal += w;
+        }
+
+        unsigned merge(unsigned a, unsigned b, double d, double w, double term)
+        {
+            Root *ra = &nodes[a];
+            Root *rb = &nodes[b];
+            if constexpr (Guard)
+            {
+                // Sums in the split layout's operand order, so the values are bit-identical.
+                const double vol = ra->vol + rb->vol;
+                const double lb_internal = ra->lb_internal + rb->lb_internal + w;
+                ra->vol = rb->vol = vol;
+                ra->lb_internal = rb->lb_internal = lb_internal;
+            }
+            // The parent words of two roots compare like their ranks.
+            unsigned r = a;
+            if (ra->parent < rb->parent)
+            {
+                std::swap(ra, rb);
+                r = b;
+            }
+            else if (ra->parent == rb->parent)
+                ++ra->parent;
+            rb->parent = r;
+            ra->size += rb->size;
+            ra->size_term = term;
+            ra->max_dist = std::max(std::max(ra->max_dist, rb->max_dist), d);
+            return r;
+        }
+    };
+
+    template <class Edges>
+    void GraphSegmenterFH::merge_edges(const Edges &edges, const SegNeighbors &neighbors, std::size_t begin)
+    {
+        profile::ScopedPhase phase("segment.fh");
+        const uint64_t lookups0 = mod_lookups_, scanned0 = mod_lookup_scanned_, probed0 = mod_lookup_probed_;
+        const unsigned acc0 = mod_guard_lb_accepts_, rej0 = mod_guard_ub_rejects_, amb0 = mod_guard_ambiguous_;
+        // One kernel per (guard mode, size term), picked here once: the loop itself
+        // has no per-edge tests of the guard settings. Classic FH (|C|^1) needs no
+        // pow() at all.
+        const GuardMode guard = !cfg_.use_modularity_guard       ? GuardMode::Off
+                                : cfg_.anneal_modularity_guard ? GuardMode::Annealed
+                                                               : GuardMode::Static;
+        auto with_term = [&](const auto &term) {
+            switch (guard)
+            {
+            case GuardMode::Off:
+                merge_edges_with<GuardMode::Off>(edges, neighbors, begin, term);
+                break;
+            case GuardMode::Static:
+                merge_edges_with<GuardMode::Static>(edges, neighbors, begin, term);
+                break;
+            case GuardMode::Annealed:
+                merge_edges_with<GuardMode::Annealed>(edges, neighbors, begin, term);
+                break;
+            }
+        };
+        if (cfg_.sizeExponent == 1.0)
+            with_term(UnitSizeTerm{});
+        else
+            with_term(PowSizeTerm(cfg_.sizeExponent, node_count()));
+        if (profile::enabled())
+        {
+            profile::add("segment.edges", static_cast<double>(edge_count(edges) - std::min(begin, edge_count(edges))));
+            profile::add("guard.lookups", static_cast<double>(mod_lookups_ - lookups0));
+            profile::add("guard.lookup_scanned", static_cast<double>(mod_lookup_scanned_ - scanned0));
+            profile::add("guard.lookup_probed", static_cast<double>(mod_lookup_probed_ - probed0));
+            profile::add("guard.accepts", static_cast<double>(mod_guard_lb_accepts_ - acc0));
+            profile::add("guard.rejects", static_cast<double>(mod_guard_ub_rejects_ - rej0));
+            profile::add("guard.ambiguous", static_cast<double>(mod_guard_ambiguous_ - amb0));
+        }
+    }
+
+    template <GraphSegmenterFH::GuardMode Guard, class Edges, class SizeTerm>
+    void GraphSegmenterFH::merge_edges_with(const Edges &edges, const SegNeighbors &neighbors, std::size_t begin, const SizeTerm &term)
+    {
+        const std::size_t num_edges = edge_count(edges);
+        unsigned t = cfg_.seg_threads;
+        if (t == 0)
+        {
+            const unsigned hc = std::thread::hardware_concurrency();
+            t = hc ? hc : 1u;
+        }
+        const std::size_t remaining = num_edges > begin ? num_edges - begin : 0;
+        t = static_cast<unsigned>(std::max<std::size_t>(1, std::min<std::size_t>(t, remaining / kMinEdgesPerSegThread)));
+        last_seg_threads_ = t;
+        last_state_layout_ = t == 1 ? cfg_.state_layout : SegStateLayout::Split;
+        par_prefetched_ = 0;
+        par_replayed_ = 0;
+        if (t > 1)
+        {
+            merge_edges_parallel<Guard>(edges, neighbors, begin, t, term);
+        }
+        else if (cfg_.state_layout == SegStateLayout::Packed)
+        {
+            PackedState<Guard != GuardMode::Off> st(*this);
+            merge_range<Guard>(edges, neighbors, begin, num_edges, st, term, nullptr, 0);
+            st.store(*this);
+        }
+        else
+        {
+            SplitState<DisjointSets, Guard != GuardMode::Off> st{*this, dsu_};
+            merge_range<Guard>(edges, neighbors, begin, num_edges, st, term, nullptr, 0);
+        }
+    }
+
+    template <GraphSegmenterFH::GuardMode Guard, class Edges, class SizeTerm>
+    void GraphSegmenterFH::merge_edges_parallel(const Edges &edges, const SegNeighbors &neighbors, std::size_t begin, unsigned threads,
+                                                const SizeTerm &term)
+    {
+        const std::size_t num_edges = edge_count(edges);
+        pdsu_.assign(dsu_);
+        touched_.assign(node_count(), 0);
+        std::vector<EdgePrefetch> pre(kParallelSegBlock);
+        SplitState<ConcurrentDisjointSets, Guard != GuardMode::Off> st{*this, pdsu_};
+        std::barrier sync(threads);
+
+        auto worker = [&](unsigned tid) {
+            ScopedPlacement pin(tid, threads);
+            unsigned block = 0;
+            for (std::size_t lo = begin; lo < num_edges; lo += kParallelSegBlock)
+            {
+                ++block;
+                const std::size_t hi = std::min(lo + kParallelSegBlock, num_edges);
+                const std::size_t len = hi - lo;
+                // Read-only on the segment state: only DSU shortcuts are written.
+                const std::size_t jb = lo + (len * tid) / threads, je = lo + (len * (tid + 1)) / threads;
+                for (std::size_t j = jb; j < je; ++j)
+                {
+                    const auto e = edge_at(edges, j);
+                    const double w = static_cast<double>(e.w);
+                    EdgePrefetch &p = pre[j - lo];
+                    if (!(w > 0))
+                    {
+                        p.kind = kPrefetchSkip;
+                        continue;
+                    }
+                    p.a = pdsu_.find(e.u);
+                    p.b = pdsu_.find(e.v);
+                    if (p.a == p.b)
+                        p.kind = kPrefetchIntra;
+                    else
+                        p.kind = allow_merge(st, p.a, p.b, (1 / w) / d_scale_) ? kPrefetchPass : kPrefetchReject;
+                }
+                sync.arrive_and_wait();
+                if (tid == 0)
+                    merge_range<Guard>(edges, neighbors, lo, hi, st, term, pre.data(), block);
+                sync.arrive_and_wait();
+            }
+        };
+
+        std::vector<std::thread> pool;
+        pool.reserve(threads - 1);
+        for (unsigned tid = 1; tid < threads; ++tid)
+            pool.emplace_back(worker, tid);
+        worker(0);
+        for (auto &th : pool)
+            th.join();
+
+        pdsu_.copy_to(dsu_);
+    }
+
+    template <GraphSegmenterFH::GuardMode Guard, class Edges, class State, class SizeTerm>
+    void GraphSegmenterFH::merge_range(const Edges &edges, const SegNeighbors &neighbors, std::size_t begin, std::size_t end,
+                                       State &st, const SizeTerm &term, const EdgePrefetch *pre, unsigned block)
+    {
+        constexpr bool guard = Guard != GuardMode::Off;
+        const auto &nb_offsets = neighbors.offsets;
+        const auto &var_neighbors = neighbors.adj;
+
+        // function to get sum of weights of edges from u to component c
+        std::vector<unsigned> hits;
+        const bool use_hubs = cfg_.hub_index && !neighbors.hub_offsets.empty();
+        auto sum_weights_to_comp = [&](unsigned u, unsigned c) {
+            ++mod_lookups_;
+            double sum = 0.0;
+            const std::size_t start = nb_offsets[u];
+            const std::size_t end_idx = nb_offsets[u + 1];
+            const std::size_t deg = end_idx - start;
+            // Hub with a small target component: probe c's members in u's by-id
+            // index instead of scanning every neighbor. The hits are summed in
+            // adjacency order, so the result is bit-identical to the scan.
+            const std::size_t hb = use_hubs ? neighbors.hub_offsets[u] : 0, he = use_hubs ? neighbors.hub_offsets[u + 1] : 0;
+            if (he > hb && static_cast<std::size_t>(st.size(c)) * std::bit_width(deg) < deg) {
+                const auto first = neighbors.hub_index.begin() + static_cast<std::ptrdiff_t>(hb);
+                const auto last = neighbors.hub_index.begin() + static_cast<std::ptrdiff_t>(he);
+                hits.clear();
+                unsigned x = c;
+                do {
+                    ++mod_lookup_probed_;
+                    const auto it = std::lower_bound(first, last, std::make_pair(x, 0u));
+                    if (it != last && it->first == x)
+                        hits.push_back(it->second);
+                    x = next_member_[x];
+                } while (x != c);
+                std::sort(hits.begin(), hits.end());
+                for (unsigned j : hits)
+                    sum += var_neighbors[start + j].second;
+                return sum;
+            }
+            mod_lookup_scanned_ += deg;
+            for (std::size_t i = start; i < end_idx; ++i) {
+                unsigned v = var_neighbors[i].first;
+                double w = var_neighbors[i].second;
+                if (st.find(v) == c) {
+                    sum += w;
+                }
+            }
+            return sum;
+        };
+
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            const auto ei = edge_at(edges, i);
+            const SegEdge e{ei.u, ei.v, static_cast<double>(ei.w)};
+            unsigned a, b;
+            int prefetched_gate = -1; // FH gate outcome from the prefetch, -1 if not known
+            if (pre)
+            {
+                const EdgePrefetch &p = pre[i - begin];
+                if (p.kind == kPrefetchSkip)
+                    continue;
+                if (p.kind == kPrefetchIntra)
+                {
+                    if constexpr (guard)
+                        st.add_internal(st.find(p.a), e.w);
+                    continue;
+                }
+                if (touched_[p.a] != block && touched_[p.b] != block)
+                {
+                    // Both still roots with the block-start state: same decision.
+                    a = p.a;
+                    b = p.b;
+                    prefetched_gate = p.kind == kPrefetchPass;
+                    ++par_prefetched_;
+                }
+                else
+                {
+                    a = st.find(e.u);
+                    b = st.find(e.v);
+                    ++par_replayed_;
+                }
+            }
+            else
+            {
+                if (!(e.w > 0))
+                    continue;
+                a = st.find(e.u);
+                b = st.find(e.v);
+            }
             if (a == b)
             { // intra-component edge: not a cross-component candidate
-                if (cfg_.use_modularity_guard)
+                if constexpr (guard)
                 {
-                    lb_comp_internal_w_[a] += e.w;
+                    st.add_internal(a, e.w);
                 }
                 continue;
             };
             const double connection_distance = (1 / e.w) / d_scale_;
-            if (!allow_merge(a, b, connection_distance))
+            if (prefetched_gate >= 0 ? prefetched_gate == 0 : !allow_merge(st, a, b, connection_distance))
             {
                 // Edge did not cause a union; track it for post-processing
-                intercomp_candidates_.push_back(e);
+                keep_candidate(a, b, e);
+                if (!guard && traj_valid_)
+                    traj_rejects_.push_back(RejectedGate{i, connection_distance, st.max_dist(a), st.max_dist(b), st.size_term(a), st.size_term(b)});
                 continue;
             }
             // FH criterion passed, now check modularity guard
-            if (cfg_.use_modularity_guard)
+            if constexpr (guard)
             {
                 // Compute ΔQ tolerance
-                double tolerance = dq_tolerance(a, b);
+                double tolerance = dq_tolerance<Guard>(st, a, b);
                 // Lower-bound of sum of weights of edges between components a and b
                 float w_ab_lb = static_cast<float>(sum_weights_to_comp(e.u, b) + sum_weights_to_comp(e.v, a)) - e.w;
-                if (accept_by_modularity_lowerbound(a, b, w_ab_lb, tolerance))
+                if (accept_by_modularity_lowerbound(st, a, b, w_ab_lb, tolerance))
                 {
                     mod_guard_lb_accepts_++;
                 }
                 else
                 {
-                    if (reject_by_modularity_upperbound(a, b, 0))
+                    if (reject_by_modularity_upperbound(st, a, b, 0))
                     {
-                        intercomp_candidates_.push_back(e);
+                        keep_candidate(a, b, e);
                         mod_guard_ub_rejects_++;
                         continue;
                     }
@@ -192,17 +958,17 @@ namespace thesis
                         // do nothing; we’ll accept below
                         break;
                     case Config::Ambiguous::Reject:
-                        intercomp_candidates_.push_back(e);
+                        keep_candidate(a, b, e);
                         continue;
                     case Config::Ambiguous::GateMargin:
                     {
                         // require the FH distance to be comfortably inside the gate
-                        const double g = std::min(gate(a), gate(b));
+                        const double g = std::min(gate(st, a), gate(st, b));
                         const double margin_ok = (g > 0.0) &&
                                                  ((g - connection_distance) >= cfg_.gate_margin_ratio * g);
                         if (!margin_ok)
                         {
-                            intercomp_candidates_.push_back(e);
+                            keep_candidate(a, b, e);
                             continue;
                         }
                         // else accept
@@ -212,57 +978,76 @@ namespace thesis
                 }
             }
 
-            // unite returns new representative; we need to merge sizes and min-sim
-            // Determine which representative will be the parent by consulting union-by-rank inside dsu
-            unsigned r = dsu_.unite(a, b);
-            comp_size_[r] = comp_size_[a] + comp_size_[b];
-            if (cfg_.use_modularity_guard)
-            {
-                comp_vol_[r] = comp_vol_[a] + comp_vol_[b];
-                lb_comp_internal_w_[r] = lb_comp_internal_w_[a] + lb_comp_internal_w_[b] + e.w;
-            }
-            // Track maximum distance within the component (use connection_distance)
-            double prev_max = std::max(max_dist_[a], max_dist_[b]);
-            max_dist_[r] = std::max(prev_max, connection_distance);
+            st.merge(a, b, connection_distance, e.w, term(st.size(a) + st.size(b)));
+            if (pre)
+                touched_[a] = touched_[b] = block;
+            if (!guard && traj_valid_)
+                traj_unions_.push_back(i);
+            if constexpr (guard)
+                std::swap(next_member_[a], next_member_[b]);
         }
     }
 
+    template void GraphSegmenterFH::run(std::vector<Edge> &);
+    template void GraphSegmenterFH::run(std::vector<EdgeF> &);
+    template void GraphSegmenterFH::run(EdgeColumns<float> &);
+    template void GraphSegmenterFH::run(EdgeColumns<double> &);
+
     std::vector<SegEdge> GraphSegmenterFH::strongest_inter_component_edges() const
     {
-        // Build a map from unordered component pair -> strongest edge (max weight)
-        std::unordered_map<std::uint64_t, SegEdge> best;
-        best.reserve(intercomp_candidates_.size());
+        const std::size_t C = intercomp_candidates_.size();
+        if (C == 0)
+            return {};
+        std::vector<unsigned> labels;
+        dsu_.flatten(labels);
 
-        // Allow early stop when all pairs are covered
-        const unsigned num_components = dsu_.components();
-        const std::size_t target_pairs = num_components < 2 ? 0 : (num_components * (num_components - 1)) / 2;
-
-        for (const auto &e : intercomp_candidates_)
+        unsigned t = cfg_.sort_threads;
+        if (t == 0)
         {
-            unsigned a = dsu_.find_no_compress(e.u);
-            unsigned b = dsu_.find_no_compress(e.v);
-            if (a == b)
-                continue; // now within same component, ignore
-            unsigned aa = a, bb = b;
-            if (aa > bb)
-                std::swap(aa, bb);
-            std::uint64_t key = (static_cast<std::uint64_t>(aa) << 32) | static_cast<std::uint64_t>(bb);
-            auto it = best.find(key);
-            if (it == best.end())
+            const unsigned hc = std::thread::hardware_concurrency();
+            t = hc ? hc : 1u;
+        }
+        t = static_cast<unsigned>(std::max<std::size_t>(1, std::min<std::size_t>(t, C / kMinCandidatesPerThread)));
+
+        // Relabel by final root, smaller root first. Edges now inside one
+        // component get u == v and are dropped after the sort.
+        std::vector<SegEdge> rel(C);
+        auto relabel = [&](unsigned tid) {
+            ScopedPlacement pin(tid, t);
+            const std::size_t lo = (C * tid) / t, hi = (C * (tid + 1)) / t;
+            for (std::size_t i = lo; i < hi; ++i)
             {
-                // store representative endpoints to be clear
-                best.emplace(key, SegEdge{aa, bb, e.w});
-                if (best.size() == target_pairs)
-                    break; // all pairs covered
+                const SegEdge &e = intercomp_candidates_[i];
+                const unsigned a = labels[e.u], b = labels[e.v];
+                rel[i] = SegEdge{std::min(a, b), std::max(a, b), e.w};
             }
-            // else: edges were processed in descending order; the first is the strongest
-        }
+        };
+        std::vector<std::thread> pool;
+        pool.reserve(t - 1);
+        for (unsigned tid = 1; tid < t; ++tid)
+            pool.emplace_back(relabel, tid);
+        relabel(0);
+        for (auto &th : pool)
+            th.join();
 
-        std::vector<SegEdge> out;
-        out.reserve(best.size());
-        for (auto &kv : best)
-            out.push_back(kv.second);
-        return out;
+        // Pair order puts each pair's heaviest edge first.
+        EdgeSortOptions sort_opt;
+        sort_opt.method = cfg_.edge_sort;
+        sort_opt.radix_threshold = cfg_.radix_sort_threshold;
+        sort_opt.threads = cfg_.sort_threads;
+        sort_edges_by_pair(rel, sort_opt);
+
+        std::size_t m = 0;
+        for (std::size_t i = 0; i < C; ++i)
+        {
+            const SegEdge &e = rel[i];
+            if (e.u == e.v || (m > 0 && rel[m - 1].u == e.u && rel[m - 1].v == e.v))
+                continue;
+            rel[m++] = e;
+        }
+        rel.resize(m);
+        rel.shrink_to_fit();
+        return rel;
     }
 
 } // namespace thesis
@@ -0,0 +1,423 @@
+#include "thesis/service.hpp"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace thesis {
+
+namespace {
+
+class JsonReader {
+public:
+    explicit JsonReader(const std::string& s) : s_(s) {}
+
+    bool object(std::vector<std::pair<std::string, JsonValue>>& out) {
+        skip_ws();
+        if (!eat('{')) return fail("expected '{'");
+        skip_ws();
+        if (eat('}')) return end();
+        for (;;) {
+            skip_ws();
+            std::string name;
+            if (!string(name)) return false;
+            skip_ws();
+            if (!eat(':')) return fail("expected ':'");
+            JsonValue v;
+            if (!value(v)) return false;
+            out.emplace_back(std::move(name), std::move(v));
+            skip_ws();
+            if (eat('}')) return end();
+            if (!eat(',')) return fail("expected ',' or '}'");
+        }
+    }
+
+    const std::string& error() const { return error_; }
+
+private:
+    bool value(JsonValue& v) {
+        skip_ws();
+        if (i_ == s_.size()) return fail("unexpected end of input");
+        const char c = s_[i_];
+        if (c == '"') {
+            v.kind = JsonValue::Kind::String;
+            return string(v.text);
+        }
+        if (c == '[') {
+            ++i_;
+            v.kind = JsonValue::Kind::Array;
+            skip_ws();
+            if (eat(']')) return true;
+            for (;;) {
+                JsonValue item;
+                if (!value(item)) return false;
+                if (item.kind != JsonValue::Kind::String && item.kind != JsonValue::Kind::Number)
+                    return fail("arrays may only hold strings and numbers");
+                v.items.push_back(std::move(item.text));
+                skip_ws();
+                if (eat(']')) return true;
+                if (!eat(',')) return fail("expected ',' or ']'");
+            }
+        }
+        if (c == '{') return fail("nested objects are not supported");
+        for (const char* word : {"true", "false", "null"}) {
+            if (s_.compare(i_, std::strlen(word), word) == 0) {
+                i_ += std::strlen(word);
+                v.kind = word[0] == 'n' ? JsonValue::Kind::Null : JsonValue::Kind::Bool;
+                if (v.kind == JsonValue::Kind::Bool) v.text = word;
+                return true;
+            }
+        }
+        const std::size_t start = i_;
+        while (i_ < s_.size() && (std::isdigit(static_cast<unsigned char>(s_[i_])) ||
+                                     (s_[i_] != '\0' && std::strchr("+-.eE", s_[i_]))))
+            ++i_;
+        if (i_ == start) return fail("unexpected character");
+        v.kind = JsonValue::Kind::Number;
+        v.text = s_.substr(start, i_ - start);
+        if (!is_number(v.text)) return fail("malformed number");
+        return true;
+    }
+
+    // JSON number grammar: -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    static bool is_number(const std::string& t) {
+        std::size_t i = 0;
+        auto digits = [&] {
+            const std::size_t from = i;
+            while (i < t.size() && std::isdigit(static_cast<unsigned char>(t[i]))) ++i;
+            return i > from;
+        };
+        if (i < t.size() && t[i] == '-') ++i;
+        if (i < t.size() && t[i] == '0') ++i;
+        else if (!digits()) return false;
+        if (i < t.size() && t[i] == '.') {
+            ++i;
+            if (!digits()) return false;
+        }
+        if (i < t.size() && (t[i] == 'e' || t[i] == 'E')) {
+            ++i;
+            if (i < t.size() && (t[i] == '+' || t[i] == '-')) ++i;
+            if (!digits()) return false;
+        }
+        return i == t.size();
+    }
+
+    bool string(std::string& out) {
+        if (!eat('"')) return fail("expected a string");
+        while (i_ < s_.size()) {
+            const char c = s_[i_++];
+            if (c == '"') return true;
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (i_ == s_.size()) break;
+            const char e = s_[i_++];
+            switch (e) {
+            case '"': case '\\': case '/': out += e; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                if (i_ + 4 > s_.size()) return fail("truncated \\u escape");
+                char* endp = nullptr;
+                const std::string hex = s_.substr(i_, 4);
+                const unsigned long cp = std::strtoul(hex.c_str(), &endp, 16);
+                if (*endp != '\0') return fail("malformed \\u escape");
+                i_ += 4;
+                // UTF-8 of a BMP code point (surrogate pairs are passed through as-is)
+                if (cp < 0x80) {
+                    out += static_cast<char>(cp);
+                } else if (cp < 0x800) {
+                    out += static_cast<char>(0xC0 | (cp >> 6));
+                    out += static_cast<char>(0x80 | (cp & 0x3F));
+                } else {
+                    out += static_cast<char>(0xE0 | (cp >> 12));
+                    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (cp & 0x3F));
+                }
+                break;
+            }
+            default: return fail("unknown escape");
+            }
+        }
+        return fail("unterminated string");
+    }
+
+    bool end() {
+        skip_ws();
+        return i_ == s_.size() ? true : fail("trailing characters after the object");
+    }
+
+    void skip_ws() {
+        while (i_ < s_.size() && std::isspace(static_cast<unsigned char>(s_[i_]))) ++i_;
+    }
+
+    bool eat(char c) {
+        if (i_ < s_.size() && s_[i_] == c) {
+            ++i_;
+            return true;
+        }
+        return false;
+    }
+
+    bool fail(const char* what) {
+        error_ = std::string(what) + " at offset " + std::to_string(i_);
+        return false;
+    }
+
+    const std::string& s_;
+    std::size_t i_ = 0;
+    std::string error_;
+};
+
+void write_response(std::ostream& out, const std::string& id, int status, const std::string& output,
+                    const std::string& error) {
+    out << "{\"id\": " << (id.empty() ? "null" : id) << ", \"status\": " << status << ", \"output\": ";
+    write_json_string(out, output);
+    out << ", \"error\": ";
+    write_json_string(out, error);
+    out << "}";
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+bool send_all(int fd, const std::string& data) {
+#if defined(MSG_NOSIGNAL)
+    constexpr int kFlags = MSG_NOSIGNAL; // a vanished client must not kill the service
+#else
+    constexpr int kFlags = 0;
+#endif
+    std::size_t sent = 0;
+    while (sent < data.size()) {
+        const ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, kFlags);
+        if (n <= 0) return false;
+        sent += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+#endif
+
+} // namespace
+
+bool parse_json_object(const std::string& text, std::vector<std::pair<std::string, JsonValue>>& out,
+                       std::string& error) {
+    out.clear();
+    JsonReader reader(text);
+    if (reader.object(out)) return true;
+    error = reader.error();
+    return false;
+}
+
+void write_json_string(std::ostream& out, const std::string& s) {
+    out << '"';
+    for (const char c : s) {
+        switch (c) {
+        case '"': out << "\\\""; break;
+        case '\\': out << "\\\\"; break;
+        case '\n': out << "\\n"; break;
+        case '\r': out << "\\r"; break;
+        case '\t': out << "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(static_cast<unsigned char>(c)));
+                out << buf;
+            } else {
+                out << c;
+            }
+        }
+    }
+    out << '"';
+}
+
+bool serve_request(const std::string& line, const ServiceHandler& handler, std::string& response) {
+    std::ostringstream resp;
+    std::vector<std::pair<std::string, JsonValue>> members;
+    std::string error;
+    if (!parse_json_object(line, members, error)) {
+        write_response(resp, "", 2, "", "bad request: " + error + "\n");
+        response = resp.str();
+        return true;
+    }
+
+    // The id goes back as it came: numbers bare, anything else as a string.
+    std::string id;
+    bool shutdown = false;
+    std::vector<std::string> args;
+    for (const auto& [name, v] : members) {
+        if (name == "id") {
+            std::ostringstream os;
+            if (v.kind == JsonValue::Kind::Number) os << v.text;
+            else if (v.kind != JsonValue::Kind::Null) write_json_string(os, v.text);
+            id = os.str();
+        } else if (name == "shutdown") {
+            shutdown = v.kind == JsonValue::Kind::Bool && v.text == "true";
+        } else if (name == "args") {
+            args.insert(args.end(), v.items.begin(), v.items.end());
+        } else if (v.kind == JsonValue::Kind::Bool) {
+            if (v.text == "true") args.push_back("--" + name);
+        } else if (v.kind == JsonValue::Kind::Array) {
+            for (const std::string& item : v.items) {
+                args.push_back("--" + name);
+                args.push_back(item);
+            }
+        } else if (v.kind != JsonValue::Kind::Null) {
+            args.push_back("--" + name);
+            args.push_back(v.text);
+        }
+    }
+    if (shutdown) {
+        write_response(resp, id, 0, "", "");
+        response = resp.str();
+        return false;
+    }
+
+    std::ostringstream out, err;
+    int status = 0;
+    try {
+        status = handler(args, out, err);
+    } catch (const std::exception& e) {
+        err << e.what() << "\n";
+        status = 1;
+    }
+    write_response(resp, id, status, out.str(), err.str());
+    response = resp.str();
+    return true;
+}
+
+void serve_stream(std::istream& in, std::ostream& out, const ServiceHandler& handler) {
+    std::string line, response;
+    while (std::getline(in, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        const bool more = serve_request(line, handler, response);
+        out << response << "\n" << std::flush;
+        if (!more) return;
+    }
+}
+
+bool serve_unix_socket(const std::string& path, const ServiceHandler& handler) {
+#if defined(__unix__) || defined(__APPLE__)
+    sockaddr_un addr{};
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "socket path must be 1.." << sizeof(addr.sun_path) - 1 << " bytes: " << path << "\n";
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    std::error_code ec;
+    if (std::filesystem::is_socket(path, ec)) std::filesystem::remove(path, ec);
+    const int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0 || ::bind(listen_fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listen_fd, 8) != 0) {
+        std::cerr << "Failed to listen on " << path << ": " << std::strerror(errno) << "\n";
+        if (listen_fd >= 0) ::close(listen_fd);
+        return false;
+    }
+
+    bool running = true;
+    std::string pending, response;
+    char buf[1 << 16];
+    while (running) {
+        const int fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "accept failed: " << std::strerror(errno) << "\n";
+            break;
+        }
+        pending.clear();
+        bool open = true;
+        while (running && open) {
+            const ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                // A final request without a newline still gets its answer.
+                open = false;
+                if (pending.find_first_not_of(" \t\r") == std::string::npos) break;
+                pending += '\n';
+            } else {
+                pending.append(buf, static_cast<std::size_t>(n));
+            }
+            std::size_t start = 0, nl;
+            while (running && (nl = pending.find('\n', start)) != std::string::npos) {
+                const std::string line = pending.substr(start, nl - start);
+                start = nl + 1;
+                if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+                running = serve_request(line, handler, response);
+                if (!send_all(fd, response + "\n")) open = false;
+            }
+            pending.erase(0, start);
+        }
+        ::close(fd);
+    }
+    ::close(listen_fd);
+    std::filesystem::remove(path, ec);
+    return true;
+#else
+    (void)handler;
+    std::cerr << "Unix sockets are not available on this platform: " << path << "\n";
+    return false;
+#endif
+}
+
+void GraphCache::store_cnf(const std::string& key, std::shared_ptr<const CNF> cnf) {
+    const std::size_t b = cnf_bytes(*cnf);
+    store(key, std::move(cnf), b);
+}
+
+void GraphCache::store_vig(const std::string& key, std::shared_ptr<VIG> vig) {
+    const std::size_t b = vig_bytes(*vig);
+    store(key, std::move(vig), b);
+}
+
+void GraphCache::store(const std::string& key, Value value, std::size_t bytes) {
+    if (const auto it = index_.find(key); it != index_.end()) {
+        bytes_ -= it->second->bytes;
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+    if (bytes > budget_) return;
+    lru_.push_front(Entry{key, std::move(value), bytes});
+    index_[key] = lru_.begin();
+    bytes_ += bytes;
+    while (bytes_ > budget_) {
+        bytes_ -= lru_.back().bytes;
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+        ++evictions_;
+    }
+}
+
+std::size_t GraphCache::cnf_bytes(const CNF& cnf) {
+    return sizeof(CNF) + cnf.get_literals().capacity() * sizeof(int) +
+           cnf.get_clause_offsets().capacity() * sizeof(std::size_t);
+}
+
+std::size_t GraphCache::vig_bytes(const VIG& g) { return sizeof(VIG) + edge_storage_bytes(g.edges); }
+
+std::string cnf_cache_key(const std::string& path) {
+    std::error_code ec;
+    const std::filesystem::path abs = std::filesystem::absolute(path, ec);
+    if (ec) return {};
+    const auto size = std::filesystem::file_size(abs, ec);
+    if (ec) return {};
+    const auto mtime = std::filesystem::last_write_time(abs, ec);
+    if (ec) return {};
+    return abs.string() + "|" + std::to_string(size) + "|" + std::to_string(mtime.time_since_epoch().count());
+}
+
+} // namespace thesis
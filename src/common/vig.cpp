@@ -10,37 +10,67 @@
 //  - Memory-aware planning: compute total_contrib and size per-thread buffers under a user cap,
 //    bumping to the max per-variable contrib when needed; derive passes/rounds.
 //  - Partition variables into contiguous batches by contribution mass; map var->active batch each round.
-//  - Per round (ONE PASS over assigned clauses per thread):
-//      * for each u that is active, do a single atomic fetch_add(delta = s-1-i)
-//        to reserve a contiguous segment, then write all neighbors (b, w_pair) into the flat buffer.
+//  - Per round (ONE PASS over the clauses):
+//      * workers prepare the round's active batches in parallel (one batch per claim);
+//      * clause chunks, balanced by estimated work and with oversized clauses split by
+//        position, are claimed from an atomic cursor. For each u that is active, do a single
+//        atomic fetch_add(delta = s-1-i) to reserve a contiguous segment, then write all
+//        neighbors (b, w_pair) into the flat buffer.
 //    => one clause scan per round, few atomics, deterministic per-variable multiset.
-//  - Per-variable accumulation: local sort [off, off+cnt) by neighbor id and reduce to (a,b,weight) edges.
+//  - Per-variable accumulation: batches are cut into reduction units claimed from a shared
+//    cursor; reduce_neighbors() sums [off, off+cnt) per neighbor into (a,b,weight) edges,
+//    choosing per variable between a SIMD sort (kernel picked at runtime), a dense slot
+//    array over the neighbor window and a flat hash (see neighbor_reduce.cpp). Wall time
+//    of the ACCUM phases is reported in accum_sec.
 //  - 32-bit offsets/counts with overflow guards; throws on overflow.
 //  - Thread pool with fixed workers + std::barrier across phases; no spawn/join per round.
 //  - Weight table precomputed up to the observed max clause size; falls back to direct compute if needed.
 //  - Logging & accounting: optional VIG_OPT_DEBUG planning/stats and detailed memory breakdown when
 //    THESIS_VIG_MEMORY_ACCOUNTING is enabled (tracks transient peak and merge buffer peaks).
-//  - Results: per-thread edge buffers merged; edges left unsorted (consumers may sort downstream).
+//  - Batch arrays live in per-batch arenas reused across rounds (allocated once at the
+//    largest batch, huge-page backed on Linux, never zeroed).
+//  - Results: units append to per-thread stages that thread 0 copies into result.edges in
+//    unit order (ascending u) while the next round fills; one thread appends in place. Not
+//    sorted by weight (consumers sort downstream). VIG_OPT_DEBUG also prints per-thread
+//    busy/idle time.
+//  - Optional HugeClauseSampling: clauses above the cutoff skip the rounds; uniformly drawn
+//    pairs with rescaled weights are aggregated separately and merged into the ordered edges.
 // ----------------------------------------------------------------------------
 
 #include "thesis/vig.hpp"
+#include "thesis/mapped_file.hpp"
+#include "thesis/neighbor_reduce.hpp"
+#include "thesis/numa.hpp"
+#include "thesis/profile.hpp"
 
 #include <algorithm>
 #include <atomic>
 #include <barrier>
 #include <cassert>
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iterator>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <new>
 #include <numeric>
 #include <stdexcept>
+#include <string>
 #include <thread>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
 namespace thesis
 {
   namespace detail
@@ -62,6 +92,52 @@ namespace thesis
 
     static MemGauge g_mem_gauge;
 
+    // Uninitialized storage for trivially copyable T that only grows. Blocks of
+    // 2 MiB and more are 2 MiB aligned and, on Linux, marked for transparent huge
+    // pages, so filling them takes far fewer page faults and TLB misses.
+    template <class T>
+    class RawArray
+    {
+      static_assert(std::is_trivially_copyable_v<T>);
+
+    public:
+      static constexpr size_t kHugePage = size_t{2} << 20;
+
+      RawArray() = default;
+      RawArray(const RawArray &) = delete;
+      RawArray &operator=(const RawArray &) = delete;
+      ~RawArray() { std::free(data_); }
+
+      // Make room for n elements; old contents are not kept.
+      void ensure(size_t n)
+      {
+        if (n <= capacity_)
+          return;
+        std::free(data_);
+        data_ = nullptr;
+        capacity_ = 0;
+        const size_t bytes = n * sizeof(T);
+        const size_t align = bytes >= kHugePage ? kHugePage : alignof(std::max_align_t);
+        const size_t rounded = (bytes + align - 1) / align * align;
+        void *p = std::aligned_alloc(align, rounded);
+        if (!p)
+          throw std::bad_alloc();
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if (align == kHugePage)
+          ::madvise(p, rounded, MADV_HUGEPAGE);
+#endif
+        data_ = static_cast<T *>(p);
+        capacity_ = rounded / sizeof(T);
+      }
+      T *data() { return data_; }
+      size_t capacity() const { return capacity_; }
+      size_t bytes() const { return capacity_ * sizeof(T); }
+
+    private:
+      T *data_ = nullptr;
+      size_t capacity_ = 0;
+    };
+
     static inline uint64_t pack_pair(uint32_t u, uint32_t v)
     {
       return (static_cast<uint64_t>(u) << 32) | static_cast<uint64_t>(v);
@@ -157,9 +233,17 @@ namespace thesis
   VIG build_vig_naive(const CNF &cnf,
                       unsigned clause_size_threshold)
   {
-    VIG result;
+    return build_vig_naive<VIG>(cnf, clause_size_threshold);
+  }
+
+  template <class G>
+  G build_vig_naive(const CNF &cnf,
+                    unsigned clause_size_threshold)
+  {
+    profile::ScopedPhase phase("vig.naive");
+    G result;
     result.n = cnf.get_variable_count();
-    const auto &clauses = cnf.get_clauses();
+    const ClauseRange clauses = cnf.clauses();
 
     using detail::inv_binom2; // still used for legacy fallback path only
     using detail::pack_pair;
@@ -208,7 +292,7 @@ namespace thesis
     for (const auto &kv : agg)
     {
       auto [u, v] = detail::unpack_pair(kv.first);
-      result.edges.push_back(Edge{u, v, kv.second});
+      result.edges.emplace_back(u, v, kv.second);
     }
 
     // No sorting here; consumers can sort if needed (e.g., segmentation).
@@ -216,7 +300,7 @@ namespace thesis
     // Memory accounting: only if enabled at compile time.
 #if defined(THESIS_VIG_MEMORY_ACCOUNTING)
     const size_t map_bytes_exact = detail::CountingAllocator<KV>::bytes.load(std::memory_order_relaxed);
-    const size_t result_edges_bytes = result.edges.capacity() * sizeof(Edge);
+    const size_t result_edges_bytes = edge_storage_bytes(result.edges);
     result.aggregation_memory = map_bytes_exact + result_edges_bytes;
 #else
     result.aggregation_memory = 0;
@@ -232,12 +316,79 @@ namespace thesis
   {
     uint32_t start, end;
   };
-  struct BufferEntry
+  using BufferEntry = NeighborContribution;
+  // Scheduling granularity: clause chunks per worker for FILL, reduction units per batch for ACCUM.
+  constexpr size_t kChunksPerThread = 16;
+  constexpr size_t kUnitsPerBatch = 8;
+
+  // Phase 1 output: per-variable contribution counts (s-1-i for the variable at
+  // position i of an eligible clause) and the clause statistics the planner needs.
+  struct ContribCounts
   {
-    uint32_t b;
-    float w;
+    std::vector<uint64_t> counts;
+    size_t max_clause_size = 0;     // largest eligible clause
+    uint64_t eligible_literals = 0; // literals in clauses with 2 <= s <= tau
+
+    explicit ContribCounts(uint32_t n) : counts(n, 0) {}
+
+    // Count one clause; returns false if it is not eligible.
+    bool add(ClauseView c, unsigned clause_size_threshold)
+    {
+      const size_t s = c.size();
+      if (s < 2 || s > clause_size_threshold)
+        return false;
+      if (s > max_clause_size)
+        max_clause_size = s;
+      eligible_literals += s;
+      for (size_t i = 0; i + 1 < s; ++i)
+      {
+        const uint32_t a = static_cast<uint32_t>(std::abs(c[i]) - 1);
+        counts[a] += static_cast<uint64_t>(s - 1 - i);
+      }
+      return true;
+    }
   };
 
+  // Weighting of the optimized builders, derived from tau.
+  static inline Weighting builder_weighting(unsigned clause_size_threshold)
+  {
+    Weighting weighting;
+    weighting.alpha = pick_alpha_tau_only(clause_size_threshold, 1e-3);
+    return weighting;
+  }
+
+  // How rounds are sized. Exactly one of max_buffer_contributions / mem_limit is set;
+  // it is echoed in [vig_opt_plan].
+  struct RoundPlan
+  {
+    size_t per_thread_buffer = 0; // contributions one batch may buffer (before bump_to_fit)
+    bool overlap = false;         // prepare round r+1 during ACCUM of round r (two rounds live)
+    size_t max_buffer_contributions = 0;
+    size_t mem_limit = 0;
+  };
+
+  namespace detail
+  {
+    // Builder memory that does not depend on the round size: contrib_counts,
+    // var_to_active and the per-variable offsets/counts/write pointers of active batches.
+    static inline size_t fixed_builder_bytes(uint32_t n)
+    {
+      return static_cast<size_t>(n) * (sizeof(uint64_t) + sizeof(int) + 3 * sizeof(uint32_t));
+    }
+
+    // Largest per-batch buffer (in contributions) such that the fixed arrays plus
+    // `live_rounds` rounds of t batch buffers stay within mem_limit bytes.
+    static inline size_t per_thread_buffer_for_limit(size_t mem_limit, uint32_t n, size_t total_contrib,
+                                                    unsigned t, unsigned live_rounds)
+    {
+      const size_t fixed = fixed_builder_bytes(n);
+      const size_t avail = mem_limit > fixed ? mem_limit - fixed : 0;
+      const size_t per = avail / (static_cast<size_t>(live_rounds) * t * sizeof(BufferEntry));
+      const size_t even = (total_contrib + t - 1) / t; // no point in batches larger than an even split
+      return std::max<size_t>(1, std::min(per, even));
+    }
+  } // namespace detail
+
   VIG build_vig_optimized(const CNF &cnf,
                           unsigned clause_size_threshold,
                           std::size_t max_buffer_contributions)
@@ -253,51 +404,28 @@ namespace thesis
                           std::size_t max_buffer_contributions,
                           unsigned num_threads)
   {
-    using detail::inv_binom2; // fallback if s beyond precomputed table
-
-    VIG result;
-    result.n = cnf.get_variable_count();
-    const auto &clauses = cnf.get_clauses();
-    const uint32_t n = result.n;
+    return build_vig_optimized<VIG>(cnf, clause_size_threshold, max_buffer_contributions, num_threads);
+  }
 
-    // Reset transient-memory gauge for this build if accounting is enabled.
-#if defined(THESIS_VIG_MEMORY_ACCOUNTING)
-    detail::g_mem_gauge.current.store(0, std::memory_order_relaxed);
-    detail::g_mem_gauge.peak.store(0, std::memory_order_relaxed);
-#endif
+  // Phases 2-3 of the optimized builder over any clause arena (the CNF itself or a
+  // memory-mapped spill), given the Phase 1 counts and a round plan.
+  template <class G>
+  static G build_vig_rounds(ClauseRange clauses, uint32_t n, unsigned clause_size_threshold, const Weighting &weighting,
+                            ContribCounts &&phase1, const RoundPlan &plan, unsigned t)
+  {
+    using detail::inv_binom2; // fallback if s beyond precomputed table
+    using EdgeList = typename G::edge_list;
 
-    if (n == 0)
-      return result;
-    if (max_buffer_contributions == 0)
-      throw std::invalid_argument("max_buffer_contributions must be > 0");
-    if (num_threads == 0)
-      throw std::invalid_argument("num_threads must be > 0");
+    G result;
+    result.n = n;
 
-    const unsigned t = std::max(1u, num_threads);
-
-    // ---------- Phase 1: per-variable contribution counts (O(s)) ----------
-    // Also track the maximum clause size actually observed (bounded by threshold)
-    size_t max_clause_size_observed = 0;
-    std::vector<uint64_t> contrib_counts(n, 0);
-    for (const auto &c : clauses)
-    {
-      const size_t s = c.size();
-      if (s < 2 || s > clause_size_threshold)
-        continue;
-      if (s > max_clause_size_observed)
-        max_clause_size_observed = s;
-      for (size_t i = 0; i + 1 < s; ++i)
-      {
-        const uint32_t a = static_cast<uint32_t>(std::abs(c[i]) - 1);
-        contrib_counts[a] += static_cast<uint64_t>(s - 1 - i);
-      }
-    }
+    std::vector<uint64_t> contrib_counts = std::move(phase1.counts);
+    const size_t max_clause_size_observed = phase1.max_clause_size;
+    const uint64_t eligible_literals = phase1.eligible_literals;
 
     const size_t total_contrib = std::accumulate(contrib_counts.begin(), contrib_counts.end(), 0ull);
     const size_t max_contrib = *std::max_element(contrib_counts.begin(), contrib_counts.end());
-    const size_t user_cap = std::min(total_contrib, static_cast<size_t>(max_buffer_contributions));
-    auto opt = detail::plan(total_contrib, t, user_cap);
-    size_t per_thread_buffer = opt.per_thread_buffer;
+    size_t per_thread_buffer = plan.per_thread_buffer;
 
     bool bumped_to_fit = false;
     if (per_thread_buffer < max_contrib)
@@ -346,13 +474,16 @@ namespace thesis
     const double batch_contrib_avg = batches.empty() ? 0.0
                                                      : static_cast<double>(batch_contrib_sum) / static_cast<double>(batches.size());
 
-    if (std::getenv("VIG_OPT_DEBUG") != nullptr)
+    const bool debug = std::getenv("VIG_OPT_DEBUG") != nullptr;
+    if (debug)
     {
       std::cerr << "[vig_opt_plan] batches=" << batches.size()
                 << " total_contrib=" << total_contrib
-                << " max_buffer_contributions_user=" << max_buffer_contributions
+                << " max_buffer_contributions_user=" << plan.max_buffer_contributions
+                << " mem_limit=" << plan.mem_limit
                 << " per_thread_buffer=" << per_thread_buffer
                 << " bumped_to_fit=" << (bumped_to_fit ? 1 : 0)
+                << " overlap=" << (plan.overlap ? 1 : 0)
                 << " target_passes=" << target_passes
                 << " batch_contrib_min=" << (batches.empty() ? 0 : batch_contrib_min)
                 << " batch_contrib_max=" << (batches.empty() ? 0 : batch_contrib_max)
@@ -363,249 +494,508 @@ namespace thesis
     // ---------- Phase 3: process batches in rounds ----------
     const size_t total_batches = batches.size();
     const size_t rounds = (total_batches + t - 1) / t;
+    const bool overlap = plan.overlap && rounds > 1;
+
+    // Reduction units: each batch is cut into contiguous variable ranges of similar
+    // contribution mass; ACCUM hands them out from a shared cursor.
+    std::vector<Batch> units;
+    std::vector<uint64_t> unit_contrib;
+    std::vector<size_t> unit_batch;
+    std::vector<size_t> batch_unit_begin; // units of batch b: [batch_unit_begin[b], batch_unit_begin[b + 1])
+    {
+      const size_t per_batch = (t == 1) ? 1 : kUnitsPerBatch;
+      for (size_t bi = 0; bi < total_batches; ++bi)
+      {
+        batch_unit_begin.push_back(units.size());
+        const Batch &b = batches[bi];
+        const uint64_t target = std::max<uint64_t>(1, batch_contrib_sizes[bi] / per_batch);
+        uint32_t start = b.start;
+        uint64_t accum = 0;
+        for (uint32_t v = b.start; v <= b.end; ++v)
+        {
+          const uint64_t cnt = contrib_counts[v];
+          if (accum + cnt > target && v > start)
+          {
+            units.push_back(Batch{start, v - 1});
+            unit_contrib.push_back(accum);
+            unit_batch.push_back(bi);
+            start = v;
+            accum = 0;
+          }
+          accum += cnt;
+        }
+        units.push_back(Batch{start, b.end});
+        unit_contrib.push_back(accum);
+        unit_batch.push_back(bi);
+      }
+      batch_unit_begin.push_back(units.size());
+    }
+
+    // Clause chunks for FILL, balanced by estimated per-round work: every literal
+    // is looked up once, and about 1/rounds of the pair writes land in a round.
+    // A clause heavier than one chunk is split by position (each position i
+    // writes its neighbors independently), so a huge clause is shared too.
+    struct ClauseChunk
+    {
+      size_t cbegin, cend; // clause range
+      size_t ibegin, iend; // positions within a split clause; iend == 0 => whole clauses
+    };
+    std::vector<ClauseChunk> chunks;
+    const size_t C = clauses.size();
+    {
+      const double rounds_d = static_cast<double>(std::max<size_t>(1, rounds));
+      const double total_mass = static_cast<double>(eligible_literals) + static_cast<double>(total_contrib) / rounds_d;
+      const double target = (t == 1) ? std::numeric_limits<double>::infinity()
+                                     : std::max(1.0, total_mass / static_cast<double>(t * kChunksPerThread));
+      size_t start = 0;
+      double accum = 0.0;
+      for (size_t ci = 0; ci < C; ++ci)
+      {
+        const size_t s = clauses[ci].size();
+        if (s < 2 || s > clause_size_threshold)
+          continue;
+        const double mass = static_cast<double>(s) + 0.5 * static_cast<double>(s) * static_cast<double>(s - 1) / rounds_d;
+        if (mass <= target)
+        {
+          accum += mass;
+          if (accum >= target)
+          {
+            chunks.push_back(ClauseChunk{start, ci + 1, 0, 0});
+            start = ci + 1;
+            accum = 0.0;
+          }
+          continue;
+        }
+        if (start < ci)
+          chunks.push_back(ClauseChunk{start, ci, 0, 0});
+        size_t i0 = 0;
+        double piece = 0.0;
+        for (size_t i = 0; i + 1 < s; ++i)
+        {
+          piece += 1.0 + static_cast<double>(s - 1 - i) / rounds_d;
+          if (piece >= target && i + 2 < s)
+          {
+            chunks.push_back(ClauseChunk{ci, ci + 1, i0, i + 1});
+            i0 = i + 1;
+            piece = 0.0;
+          }
+        }
+        chunks.push_back(ClauseChunk{ci, ci + 1, i0, s - 1});
+        start = ci + 1;
+        accum = 0.0;
+      }
+      if (start < C)
+        chunks.push_back(ClauseChunk{start, C, 0, 0});
+    }
 
-    std::vector<std::vector<Edge>> worker_edges(t);
+    // Output of ACCUM: units append their edges to their thread's stage; thread 0
+    // copies a round's stages into result.edges in unit order (ascending u) while
+    // the next round fills. With one thread, units append to result.edges directly.
+    std::vector<EdgeList> stages(t > 1 ? t : 0);
+    std::vector<unsigned> unit_thread(units.size());
+    std::vector<size_t> unit_stage_begin(units.size()), unit_edge_count(units.size());
 
-    // var -> active batch id in current round
-    std::vector<int> var_to_active(n, -1);
+    // var -> active batch id (within its round's slot); each worker first-touches
+    // the entries of the batches it owns (see below).
+    std::unique_ptr<int[]> var_to_active(new int[n]);
     // include in transient peak
 #if defined(THESIS_VIG_MEMORY_ACCOUNTING)
-    detail::g_mem_gauge.add(var_to_active.capacity() * sizeof(int));
+    detail::g_mem_gauge.add(static_cast<size_t>(n) * sizeof(int));
 #endif
 
+    // NUMA placement (thread_placement() != None): worker tid is pinned to its
+    // node and owns batch tid of every round. It prepares that batch, so the
+    // batch's arena, var_to_active entries and stage are first-touched on its
+    // node, and it reduces the units of batches on its own node first. The
+    // clause arena, read by every worker, is interleaved over the nodes.
+    const bool placed = thread_placement() != ThreadPlacement::None;
+    std::vector<unsigned> batch_node(t);
+    for (unsigned bi = 0; bi < t; ++bi)
+      batch_node[bi] = placement_node(bi);
+
+    // Storage of active batches, reused from round to round: nothing is freed or
+    // zeroed between rounds (every buffer slot below the write pointers is written
+    // by FILL before ACCUM reads it). Batch bi of round r uses arena bi, or
+    // t + bi for odd rounds with overlap, where two rounds are live; either way
+    // worker bi's.
+    struct BatchArena
+    {
+      std::vector<uint32_t> offsets;  // prefix offsets per variable in batch
+      std::vector<uint32_t> counts32; // contrib count per variable (narrowed)
+      std::unique_ptr<std::atomic<uint32_t>[]> wptrs; // atomic write pointers per variable
+      size_t wptrs_cap = 0;
+      detail::RawArray<BufferEntry> buffer; // flat buffer (b,w)
+      size_t tracked_bytes = 0;             // memory gauge
+    };
+    std::vector<BatchArena> arenas(overlap ? 2 * static_cast<size_t>(t) : t);
+
     struct ActiveBatch
     {
       Batch range;
-      std::vector<uint32_t> offsets;                  // prefix offsets per variable in batch
-      std::vector<uint32_t> counts32;                 // contrib count per variable (narrowed)
-      std::unique_ptr<std::atomic<uint32_t>[]> wptrs; // atomic write pointers per variable
-      size_t wptrs_len = 0;
-      std::vector<BufferEntry> buffer; // flat buffer (b,w)
-      size_t tracked_bytes = 0;        // memory gauge
+      BatchArena *arena = nullptr;
+      std::atomic<uint32_t> *wptrs = nullptr;
+      BufferEntry *buffer = nullptr;
+    };
+
+    // The batches of one round. Round r lives in slots[r % 2]; with overlap the
+    // next round is prepared into the other slot while this one is reduced.
+    struct RoundSlot
+    {
+      std::vector<ActiveBatch> active;
+      size_t batch_count = 0;
+      std::atomic<size_t> prep_cursor{0};
+      std::unique_ptr<std::atomic<size_t>[]> unit_cursor; // per batch: next unit to reduce
     };
+    RoundSlot slots[2];
+    for (auto &slot : slots)
+      slot.unit_cursor.reset(new std::atomic<size_t>[t]);
 
     // Precompute weights up to the observed maximum (bounded). Avoid huge allocations for tau=inf.
-    Weighting weighting; weighting.alpha = pick_alpha_tau_only(clause_size_threshold, 1e-3); // Derive weighting automatically.
     const size_t w_table_max = (max_clause_size_observed >= 2 ? max_clause_size_observed : 2);
     std::vector<float> w_table(w_table_max + 1, 0.0f);
     for (size_t s = 2; s <= w_table_max; ++s)
       w_table[s] = static_cast<float>(weighting.pair_weight(s));
 
-    // Clause domain per worker
-    std::vector<size_t> cbegin(t), cend(t);
-    const size_t C = clauses.size();
-    for (unsigned tid = 0; tid < t; ++tid)
-    {
-      cbegin[tid] = (C * tid) / t;
-      cend[tid] = (C * (tid + 1)) / t;
-    }
-
     std::barrier sync(t);
     std::atomic<size_t> r_idx{0};
+    // Work cursors, reset by thread 0 between rounds (the barrier publishes them).
+    std::atomic<size_t> chunk_cursor{0};
 
-    std::vector<ActiveBatch> active;
-    size_t batch_count_cur = 0;
-
-    // Track peak of per-thread edge buffers across rounds.
+    // Track peak of the per-thread edge stages across rounds.
     size_t worker_edges_peak_bytes = 0;
 
-    auto prepare_round = [&](size_t r)
+    // Serial part (thread 0, or before launch): size round r's slot.
+    auto setup_round = [&](size_t r)
     {
-      active.clear();
-      const size_t first_batch = r * t;
-      batch_count_cur = std::min(static_cast<size_t>(t), total_batches - first_batch);
-      active.reserve(batch_count_cur);
+      RoundSlot &slot = slots[r % 2];
+      slot.batch_count = std::min(static_cast<size_t>(t), total_batches - r * t);
+      slot.active.assign(slot.batch_count, ActiveBatch{});
+      slot.prep_cursor.store(0, std::memory_order_relaxed);
+      for (size_t bi = 0; bi < slot.batch_count; ++bi)
+        slot.unit_cursor[bi].store(batch_unit_begin[r * t + bi], std::memory_order_relaxed);
+    };
 
-      for (size_t bi = 0; bi < batch_count_cur; ++bi)
+    // Index one active batch in its arena, growing the arena to the largest batch
+    // on first use; batches are disjoint, so workers prepare them concurrently.
+    auto prepare_batch = [&](size_t r, size_t bi)
+    {
+      const Batch &bch = batches[r * t + bi];
+      ActiveBatch &ab = slots[r % 2].active[bi];
+      BatchArena &arena = arenas[(overlap && r % 2 ? t : 0) + bi];
+      ab.range = bch;
+      ab.arena = &arena;
+
+      const uint32_t sV = bch.start;
+      const uint32_t eV = bch.end;
+      if (sV <= eV)
       {
-        const Batch &bch = batches[first_batch + bi];
-        ActiveBatch ab;
-        ab.range = bch;
+        const size_t len = static_cast<size_t>(eV - sV + 1);
+        arena.offsets.resize(len);
+        arena.counts32.resize(len);
 
-        const uint32_t sV = bch.start;
-        const uint32_t eV = bch.end;
-        if (sV <= eV)
+        uint64_t pref64 = 0;
+        for (uint32_t a = sV; a <= eV; ++a)
         {
-          const size_t len = static_cast<size_t>(eV - sV + 1);
-          ab.offsets.assign(len, 0u);
-          ab.counts32.assign(len, 0u);
+          const size_t idx = static_cast<size_t>(a - sV);
+          arena.offsets[idx] = static_cast<uint32_t>(pref64);
+          const uint64_t c64 = contrib_counts[a];
+          if (c64 > std::numeric_limits<uint32_t>::max())
+            throw std::overflow_error("per-variable contribution count exceeds 32-bit range");
+          arena.counts32[idx] = static_cast<uint32_t>(c64);
+          pref64 += c64;
+          var_to_active[a] = static_cast<int>(bi);
+        }
+        if (pref64 > static_cast<uint64_t>(std::numeric_limits<size_t>::max()))
+          throw std::overflow_error("active batch buffer size exceeds size_t");
+
+        // Every batch holds at most batch_contrib_max contributions, so the
+        // buffer is allocated once per arena.
+        const size_t old_cap = arena.buffer.capacity();
+        arena.buffer.ensure(std::max<size_t>(1, batch_contrib_max));
+        if (placed && arena.buffer.capacity() != old_cap)
+          first_touch(arena.buffer.data(), arena.buffer.bytes());
+        if (arena.wptrs_cap < len)
+        {
+          arena.wptrs.reset(new std::atomic<uint32_t>[len]);
+          arena.wptrs_cap = len;
+        }
+        for (size_t i = 0; i < len; ++i)
+          arena.wptrs[i].store(arena.offsets[i], std::memory_order_relaxed);
+        ab.wptrs = arena.wptrs.get();
+        ab.buffer = arena.buffer.data();
 
-          uint64_t pref64 = 0;
-          for (uint32_t a = sV; a <= eV; ++a)
-          {
-            const size_t idx = static_cast<size_t>(a - sV);
-            ab.offsets[idx] = static_cast<uint32_t>(pref64);
-            const uint64_t c64 = contrib_counts[a];
-            if (c64 > std::numeric_limits<uint32_t>::max())
-              throw std::overflow_error("per-variable contribution count exceeds 32-bit range");
-            ab.counts32[idx] = static_cast<uint32_t>(c64);
-            pref64 += c64;
-            var_to_active[a] = static_cast<int>(bi);
-          }
+        // Accounting: only growth of the arena is new memory.
+#if defined(THESIS_VIG_MEMORY_ACCOUNTING)
+        const size_t bytes = (arena.offsets.capacity() + arena.counts32.capacity()) * sizeof(uint32_t) +
+                             arena.buffer.bytes() + arena.wptrs_cap * sizeof(std::atomic<uint32_t>);
+        if (bytes > arena.tracked_bytes)
+        {
+          detail::g_mem_gauge.add(bytes - arena.tracked_bytes);
+          arena.tracked_bytes = bytes;
+        }
+#endif
+      }
+    };
+
+    // ONE-PASS SCAN+FILL of a chunk with batched atomics.
+    auto fill_chunk = [&](std::vector<ActiveBatch> &active, const ClauseChunk &ch)
+    {
+      for (size_t ci = ch.cbegin; ci < ch.cend; ++ci)
+      {
+        const auto &c = clauses[ci];
+        const size_t s = c.size();
+        if (s < 2 || s > clause_size_threshold)
+          continue;
+
+        // s is guaranteed <= clause_size_threshold and we recorded max_clause_size_observed accordingly
+        // Ensure index is within table bounds.
+        const float w_pair = (s <= w_table_max) ? w_table[s]
+                                                : static_cast<float>(weighting.pair_weight(s));
+        const size_t iend = ch.iend ? ch.iend : s - 1;
+        for (size_t i = ch.ibegin; i < iend; ++i)
+        {
+          const uint32_t u = static_cast<uint32_t>(std::abs(c[i]) - 1);
+          const int abi = var_to_active[u];
+          if (abi < 0)
+            continue;
 
-          const uint64_t last_off = len ? static_cast<uint64_t>(ab.offsets.back()) : 0ull;
-          const uint64_t last_cnt = len ? static_cast<uint64_t>(ab.counts32.back()) : 0ull;
-          const uint64_t total_sz64 = last_off + last_cnt;
-          if (total_sz64 > static_cast<uint64_t>(std::numeric_limits<size_t>::max()))
-            throw std::overflow_error("active batch buffer size exceeds size_t");
-          const size_t total_sz = static_cast<size_t>(total_sz64);
+          auto &ab = active[static_cast<size_t>(abi)];
+          const size_t idx = static_cast<size_t>(u - ab.range.start);
 
-          ab.buffer.assign(total_sz, BufferEntry{0u, 0.0f});
-          ab.wptrs.reset(new std::atomic<uint32_t>[len]);
-          ab.wptrs_len = len;
-          for (size_t i = 0; i < len; ++i)
-            ab.wptrs[i].store(ab.offsets[i], std::memory_order_relaxed);
+          const uint32_t delta = static_cast<uint32_t>(s - 1 - i);
+          const uint32_t pos0 = ab.wptrs[idx].fetch_add(delta, std::memory_order_relaxed);
 
-          // Accounting
-#if defined(THESIS_VIG_MEMORY_ACCOUNTING)
-          ab.tracked_bytes += ab.offsets.capacity() * sizeof(uint32_t);
-          ab.tracked_bytes += ab.counts32.capacity() * sizeof(uint32_t);
-          ab.tracked_bytes += ab.buffer.capacity() * sizeof(BufferEntry);
-          ab.tracked_bytes += ab.wptrs_len * sizeof(std::atomic<uint32_t>);
-          detail::g_mem_gauge.add(ab.tracked_bytes);
-#endif
+          uint32_t pos = pos0;
+          for (size_t j = i + 1; j < s; ++j)
+          {
+            const uint32_t b = static_cast<uint32_t>(std::abs(c[j]) - 1);
+            ab.buffer[pos++] = BufferEntry{b, w_pair};
+          }
         }
-        active.emplace_back(std::move(ab));
       }
     };
 
-    auto cleanup_round = [&]()
+    // ACCUM of one unit: local sort by neighbor id and reduce into `out`. FILL is
+    // over, so the unit's var_to_active entries are retired here as well.
+    std::vector<NeighborReduceScratch> scratch(t);
+    auto reduce_unit = [&](unsigned tid, size_t r, size_t ui, EdgeList &out)
     {
-      for (size_t bi = 0; bi < batch_count_cur; ++bi)
+      NeighborReduceScratch &sc = scratch[tid];
+      const ActiveBatch &ab = slots[r % 2].active[unit_batch[ui] - r * t];
+      const BatchArena &arena = *ab.arena;
+      unit_thread[ui] = tid;
+      unit_stage_begin[ui] = edge_count(out);
+
+      const uint32_t sV = units[ui].start;
+      const uint32_t eV = units[ui].end;
+      for (uint32_t a = sV; a <= eV; ++a)
       {
-        const auto &bch = active[bi].range;
-        for (uint32_t a = bch.start; a <= bch.end; ++a)
-          var_to_active[a] = -1;
-#if defined(THESIS_VIG_MEMORY_ACCOUNTING)
-        detail::g_mem_gauge.sub(active[bi].tracked_bytes);
-#endif
+        var_to_active[a] = -1;
+        const size_t idx = static_cast<size_t>(a - ab.range.start);
+        const uint32_t off = arena.offsets[idx];
+        const uint32_t cnt = arena.counts32[idx];
+        if (!cnt)
+          continue;
+
+        const size_t m = reduce_neighbors(ab.buffer + off, cnt, sc);
+        for (size_t i = 0; i < m; ++i)
+          out.emplace_back(a, sc.out_b[i], sc.out_w[i]);
       }
-      active.clear();
-      batch_count_cur = 0;
+      unit_edge_count[ui] = edge_count(out) - unit_stage_begin[ui];
+    };
 
-      // After each round, compute current worker_edges footprint and track peak.
-      size_t round_bytes = 0;
-      for (auto &ve : worker_edges)
-        round_bytes += ve.capacity() * sizeof(Edge);
-#if defined(THESIS_VIG_MEMORY_ACCOUNTING)
-      if (round_bytes > worker_edges_peak_bytes)
-        worker_edges_peak_bytes = round_bytes;
-#endif
+    // Contributions of the rounds whose edges are in result.edges.
+    uint64_t contrib_done = 0;
+    auto contrib_of_round = [&](size_t r)
+    {
+      uint64_t s = 0;
+      for (size_t b = r * t; b < std::min(total_batches, (r + 1) * t); ++b)
+        s += batch_contrib_sizes[b];
+      return s;
+    };
+    // Make room for `need` edges in result.edges. Unless `exact`, reserve the
+    // edge count projected from the edges per contribution so far, so that the
+    // list is moved about once instead of at every doubling.
+    auto grow_result = [&](size_t need, bool exact)
+    {
+      const size_t cap = result.edges.capacity();
+      size_t want = need;
+      if (!exact && contrib_done > 0)
+      {
+        const double per_contrib = static_cast<double>(edge_count(result.edges)) / static_cast<double>(contrib_done);
+        want = std::max(want, static_cast<size_t>(per_contrib * static_cast<double>(total_contrib) * 1.0625));
+      }
+      if (want > cap)
+        result.edges.reserve(exact ? want : std::max(want, cap + cap / 2));
     };
 
-    auto worker = [&](unsigned tid)
+    // Thread 0: copy round r's staged edges into result.edges, in unit order.
+    auto flush_round = [&](size_t r)
     {
-      const size_t begin = cbegin[tid];
-      const size_t end = cend[tid];
+      const size_t ub = batch_unit_begin[r * t];
+      const size_t ue = batch_unit_begin[std::min(total_batches, (r + 1) * t)];
+      size_t need = edge_count(result.edges);
+      for (size_t ui = ub; ui < ue; ++ui)
+        need += unit_edge_count[ui];
+      grow_result(need, r + 1 == rounds);
+      for (size_t ui = ub; ui < ue; ++ui)
+        append_edges(result.edges, stages[unit_thread[ui]], unit_stage_begin[ui], unit_edge_count[ui]);
+      contrib_done += contrib_of_round(r);
+    };
 
-      for (;;)
+    auto cleanup_round = [&](size_t r)
+    {
+      RoundSlot &slot = slots[r % 2];
+#if defined(THESIS_VIG_MEMORY_ACCOUNTING)
+      size_t stage_bytes = 0;
+      for (const auto &stage : stages)
+        stage_bytes += edge_storage_bytes(stage);
+      worker_edges_peak_bytes = std::max(worker_edges_peak_bytes, stage_bytes);
+#endif
+      if (t == 1)
       {
-        const size_t r = r_idx.load(std::memory_order_acquire);
-        if (r >= rounds)
-          break;
+        contrib_done += contrib_of_round(r);
+        if (r + 1 < rounds)
+          grow_result(edge_count(result.edges), false);
+      }
+      slot.active.clear();
+      slot.batch_count = 0;
+    };
 
-        if (tid == 0)
-          prepare_round(r);
-        sync.arrive_and_wait(); // active ready
+    // Per-thread scheduling stats, printed under VIG_OPT_DEBUG and reported to
+    // --profile. Idle is time spent in the barrier; busy is the rest of the
+    // worker's lifetime.
+    struct ThreadStats
+    {
+      double busy_sec = 0.0, idle_sec = 0.0;
+      size_t prepared = 0, chunks = 0, units = 0;
+    };
+    std::vector<ThreadStats> thread_stats(t);
+    const bool timed = debug || profile::enabled();
+    // Wall time of the barrier-delimited phases and of the edge copy, measured by thread 0.
+    double prepare_sec = 0.0, fill_sec = 0.0, flush_sec = 0.0;
 
-        // ONE-PASS SCAN+FILL with batched atomics.
-        for (size_t ci = begin; ci < end; ++ci)
+    auto worker = [&](unsigned tid)
+    {
+      ScopedPlacement pin(tid, t);
+      using clock = std::chrono::steady_clock;
+      const auto t_start = clock::now();
+      ThreadStats st;
+      EdgeList &out = (t == 1) ? result.edges : stages[tid];
+      auto wait = [&]()
+      {
+        if (!timed)
         {
-          const auto &c = clauses[ci];
-          const size_t s = c.size();
-          if (s < 2 || s > clause_size_threshold)
-            continue;
-
-          // s is guaranteed <= clause_size_threshold and we recorded max_clause_size_observed accordingly
-          // Ensure index is within table bounds.
-          const float w_pair = (s <= w_table_max) ? w_table[s]
-                                                  : static_cast<float>(weighting.pair_weight(s));
-          for (size_t i = 0; i + 1 < s; ++i)
+          sync.arrive_and_wait();
+          return;
+        }
+        const auto t0 = clock::now();
+        sync.arrive_and_wait();
+        st.idle_sec += std::chrono::duration<double>(clock::now() - t0).count();
+      };
+      auto prepare_claims = [&](size_t r)
+      {
+        RoundSlot &slot = slots[r % 2];
+        if (placed)
+        {
+          if (tid < slot.batch_count)
           {
-            const uint32_t u = static_cast<uint32_t>(std::abs(c[i]) - 1);
-            const int abi = var_to_active[u];
-            if (abi < 0)
-              continue;
-
-            auto &ab = active[static_cast<size_t>(abi)];
-            const size_t idx = static_cast<size_t>(u - ab.range.start);
-
-            const uint32_t delta = static_cast<uint32_t>(s - 1 - i);
-            const uint32_t pos0 = ab.wptrs[idx].fetch_add(delta, std::memory_order_relaxed);
-
-            uint32_t pos = pos0;
-            for (size_t j = i + 1; j < s; ++j)
-            {
-              const uint32_t b = static_cast<uint32_t>(std::abs(c[j]) - 1);
-              ab.buffer[pos++] = BufferEntry{b, w_pair};
-            }
+            prepare_batch(r, tid);
+            ++st.prepared;
           }
+          return;
         }
+        for (size_t bi; (bi = slot.prep_cursor.fetch_add(1, std::memory_order_relaxed)) < slot.batch_count; ++st.prepared)
+          prepare_batch(r, bi);
+      };
+      // Units of the batches on this worker's node first, starting with its own
+      // batch, then the others'.
+      const unsigned node = batch_node[tid];
+      auto reduce_claims = [&](size_t r)
+      {
+        RoundSlot &slot = slots[r % 2];
+        const size_t nb = slot.batch_count;
+        for (int pass = 0; pass < 2; ++pass)
+          for (size_t k = 0; k < nb; ++k)
+          {
+            const size_t bi = (tid + k) % nb;
+            if ((batch_node[bi] == node) != (pass == 0))
+              continue;
+            const size_t ue = batch_unit_begin[r * t + bi + 1];
+            for (size_t ui; (ui = slot.unit_cursor[bi].fetch_add(1, std::memory_order_relaxed)) < ue; ++st.units)
+              reduce_unit(tid, r, ui, out);
+          }
+      };
 
-        sync.arrive_and_wait(); // end FILL
+      for (size_t b = tid; b < total_batches; b += t)
+        std::fill(var_to_active.get() + batches[b].start, var_to_active.get() + batches[b].end + 1, -1);
+      wait(); // var_to_active ready
 
-        // ACCUM: worker tid reduces batch tid if exists.
-        if (tid < batch_count_cur)
+      for (;;)
+      {
+        const size_t r = r_idx.load(std::memory_order_acquire);
+        // The stages of round r - 1 are only reused after the next FILL barrier.
+        if (tid == 0 && t > 1 && r > 0)
         {
-          auto &ab = active[tid];
-          const uint32_t sV = ab.range.start;
-          const uint32_t eV = ab.range.end;
-
-          // Heuristic reservation
-          const size_t global_batch_index = r * t + tid;
-          if (global_batch_index < batch_contrib_sizes.size())
-          {
-            auto &edges_out = worker_edges[tid];
-            const uint64_t contrib_est = batch_contrib_sizes[global_batch_index];
-            edges_out.reserve(edges_out.size() + static_cast<size_t>(contrib_est / 2));
-          }
+          const auto t_flush = clock::now();
+          flush_round(r - 1);
+          if (timed)
+            flush_sec += std::chrono::duration<double>(clock::now() - t_flush).count();
+        }
+        if (r >= rounds)
+          break;
 
-          if (sV <= eV)
-          {
-            auto &edges_out = worker_edges[tid];
-            for (uint32_t a = sV; a <= eV; ++a)
-            {
-              const size_t idx = static_cast<size_t>(a - sV);
-              const uint32_t off = ab.offsets[idx];
-              const uint32_t cnt = ab.counts32[idx];
-              if (!cnt)
-                continue;
-
-              BufferEntry *first = ab.buffer.data() + off;
-              BufferEntry *last = first + cnt;
-
-              std::sort(first, last, [](const BufferEntry &x, const BufferEntry &y)
-                        { return x.b < y.b; });
-
-              uint32_t curr = first->b;
-              double sum = 0.0;
-              for (BufferEntry *p = first; p != last; ++p)
-              {
-                if (p->b != curr)
-                {
-                  edges_out.emplace_back(a, curr, sum);
-                  curr = p->b;
-                  sum = 0.0;
-                }
-                sum += static_cast<double>(p->w);
-              }
-              edges_out.emplace_back(a, curr, sum);
-            }
-          }
+        if (!overlap || r == 0)
+        {
+          const auto t_prepare = clock::now();
+          prepare_claims(r);
+          wait(); // active ready
+          if (tid == 0 && timed)
+            prepare_sec += std::chrono::duration<double>(clock::now() - t_prepare).count();
         }
 
-        sync.arrive_and_wait(); // end ACCUM
+        const auto t_fill = clock::now();
+        auto &active = slots[r % 2].active;
+        for (size_t k; (k = chunk_cursor.fetch_add(1, std::memory_order_relaxed)) < chunks.size(); ++st.chunks)
+          fill_chunk(active, chunks[k]);
+        wait(); // end FILL
+        if (tid == 0 && timed)
+          fill_sec += std::chrono::duration<double>(clock::now() - t_fill).count();
+
+        // ACCUM; with overlap, workers that run out of units prepare the next round.
+        const auto t_accum = clock::now();
+        if (t > 1)
+          out.clear();
+        reduce_claims(r);
+        if (overlap && r + 1 < rounds)
+          prepare_claims(r + 1);
+        wait(); // end ACCUM
+        if (tid == 0)
+          result.accum_sec += std::chrono::duration<double>(clock::now() - t_accum).count();
 
         if (tid == 0)
         {
-          cleanup_round();
+          cleanup_round(r);
           r_idx.fetch_add(1, std::memory_order_acq_rel);
+          const size_t next = overlap ? r + 2 : r + 1; // with overlap, r + 1 is already prepared
+          if (next < rounds)
+            setup_round(next);
+          chunk_cursor.store(0, std::memory_order_relaxed);
         }
-        sync.arrive_and_wait(); // next round
+        wait(); // next round
       }
+      st.busy_sec = std::chrono::duration<double>(clock::now() - t_start).count() - st.idle_sec;
+      thread_stats[tid] = st;
     };
 
     // Launch pool
+    if (placed && C > 0)
+    {
+      const int *lits = clauses[0].data();
+      interleave_pages(lits, static_cast<size_t>(clauses[C - 1].data() + clauses[C - 1].size() - lits) * sizeof(int));
+    }
+    for (size_t r = 0; r < std::min<size_t>(rounds, overlap ? 2 : 1); ++r)
+      setup_round(r);
     std::vector<std::thread> pool;
     pool.reserve(t);
     for (unsigned tid = 0; tid < t; ++tid)
@@ -613,13 +1003,22 @@ namespace thesis
     for (auto &th : pool)
       th.join();
 
-    // Remove var_to_active from transient gauge now that we're done.
+    // Remove var_to_active and the arenas from transient gauge now that we're done.
 #if defined(THESIS_VIG_MEMORY_ACCOUNTING)
-    detail::g_mem_gauge.sub(var_to_active.capacity() * sizeof(int));
+    detail::g_mem_gauge.sub(static_cast<size_t>(n) * sizeof(int));
+    for (const auto &arena : arenas)
+      detail::g_mem_gauge.sub(arena.tracked_bytes);
 #endif
 
-    if (std::getenv("VIG_OPT_DEBUG") != nullptr)
+    if (debug)
     {
+      size_t accum_sort = 0, accum_spa = 0, accum_hash = 0; // variables per strategy
+      for (const auto &sc : scratch)
+      {
+        accum_sort += sc.sort_runs;
+        accum_spa += sc.spa_runs;
+        accum_hash += sc.hash_runs;
+      }
       std::cerr << "[vig_opt_stats] batches=" << batches.size()
                 << " rounds=" << rounds
                 << " passes_over_clauses=" << rounds // one pass per round
@@ -628,20 +1027,53 @@ namespace thesis
                 << " batch_contrib_min=" << (batches.empty() ? 0 : batch_contrib_min)
                 << " batch_contrib_max=" << (batches.empty() ? 0 : batch_contrib_max)
                 << " batch_contrib_avg=" << batch_contrib_avg
+                << " clause_chunks=" << chunks.size()
+                << " accum_units=" << units.size()
+                << " accum_strategy=" << neighbor_accumulator_name(forced_neighbor_accumulator())
+                << " accum_sort=" << accum_sort
+                << " accum_spa=" << accum_spa
+                << " accum_hash=" << accum_hash
                 << "\n";
+      for (unsigned tid = 0; tid < t; ++tid)
+      {
+        const ThreadStats &st = thread_stats[tid];
+        std::cerr << "[vig_opt_thread] tid=" << tid
+                  << " busy_sec=" << st.busy_sec
+                  << " idle_sec=" << st.idle_sec
+                  << " batches_prepared=" << st.prepared
+                  << " chunks=" << st.chunks
+                  << " units=" << st.units
+                  << "\n";
+      }
     }
 
-    // Merge per-thread edge buffers (note: may temporarily double memory with result.edges)
-    size_t total_edges = 0;
-    for (const auto &ve : worker_edges)
-      total_edges += ve.size();
-    result.edges.reserve(total_edges);
-    for (auto &ve : worker_edges)
-    {
-      result.edges.insert(result.edges.end(),
-                          std::make_move_iterator(ve.begin()),
-                          std::make_move_iterator(ve.end()));
-      std::vector<Edge>().swap(ve);
+    if (profile::enabled())
+    {
+      // With overlap, later rounds are prepared inside ACCUM and counted there.
+      profile::add_phase("vig.prepare_round", prepare_sec);
+      profile::add_phase("vig.fill", fill_sec);
+      profile::add_phase("vig.accum", result.accum_sec);
+      if (t > 1)
+        profile::add_phase("vig.merge", flush_sec);
+      profile::add("vig.rounds", static_cast<double>(rounds));
+      profile::add("vig.batches", static_cast<double>(batches.size()));
+      profile::add("vig.chunks", static_cast<double>(chunks.size()));
+      profile::add("vig.units", static_cast<double>(units.size()));
+      for (const auto &sc : scratch)
+      {
+        profile::add("vig.accum_sort", static_cast<double>(sc.sort_runs));
+        profile::add("vig.accum_spa", static_cast<double>(sc.spa_runs));
+        profile::add("vig.accum_hash", static_cast<double>(sc.hash_runs));
+      }
+      for (unsigned tid = 0; tid < t; ++tid)
+      {
+        const ThreadStats &st = thread_stats[tid];
+        profile::add_thread("vig.busy_sec", tid, st.busy_sec);
+        profile::add_thread("vig.idle_sec", tid, st.idle_sec);
+        profile::add_thread("vig.batches_prepared", tid, static_cast<double>(st.prepared));
+        profile::add_thread("vig.chunks", tid, static_cast<double>(st.chunks));
+        profile::add_thread("vig.units", tid, static_cast<double>(st.units));
+      }
     }
 
     // No sorting here; consumers can sort if needed.
@@ -649,11 +1081,13 @@ namespace thesis
     // ---------------- Memory breakdown & final aggregation_memory ----------------
 #if defined(THESIS_VIG_MEMORY_ACCOUNTING)
     const size_t batch_peak_bytes = detail::g_mem_gauge.peak.load(std::memory_order_relaxed);
-    const size_t result_edges_bytes = result.edges.capacity() * sizeof(Edge);
+    const size_t result_edges_bytes = edge_storage_bytes(result.edges);
     const size_t misc_bytes =
-        contrib_counts.capacity() * sizeof(uint64_t) + batches.capacity() * sizeof(Batch) + w_table.capacity() * sizeof(float) + cbegin.capacity() * sizeof(size_t) + cend.capacity() * sizeof(size_t);
+        contrib_counts.capacity() * sizeof(uint64_t) + batches.capacity() * sizeof(Batch) + w_table.capacity() * sizeof(float) + chunks.capacity() * sizeof(ClauseChunk) +
+        units.capacity() * (sizeof(Batch) + sizeof(uint64_t) + sizeof(size_t)) +
+        unit_thread.capacity() * sizeof(unsigned) + (unit_stage_begin.capacity() + unit_edge_count.capacity()) * sizeof(size_t);
 
-    if (std::getenv("VIG_OPT_DEBUG") != nullptr)
+    if (debug)
     {
       std::cerr << "[vig_opt_mem]"
                 << " batch_peak=" << batch_peak_bytes
@@ -673,4 +1107,341 @@ namespace thesis
     return result;
   }
 
+  namespace detail
+  {
+    static inline uint64_t splitmix64(uint64_t &state)
+    {
+      uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, bound) from the high 32 bits of r (multiply-shift).
+    static inline size_t below(uint64_t r, size_t bound)
+    {
+      return static_cast<size_t>(((r >> 32) * static_cast<uint64_t>(bound)) >> 32);
+    }
+
+    // Pairs of the clauses in (cutoff, tau], aggregated and sorted by (u, v). A clause
+    // of size s gets m = pairs_per_literal * s draws of a uniform pair (with replacement),
+    // each weighing w(s) * (s(s-1)/2) / m, so every pair keeps its expected weight and
+    // the clause its exact total. Clauses with m >= s(s-1)/2 are enumerated exactly.
+    // Draws come from an RNG seeded per clause index: the result is deterministic.
+    static std::vector<Edge> sample_huge_clauses(ClauseRange clauses, unsigned cutoff, unsigned clause_size_threshold,
+                                                 const Weighting &weighting, const HugeClauseSampling &sampling,
+                                                 HugeClauseStats &stats)
+    {
+      std::vector<Edge> pairs;
+      for (size_t ci = 0; ci < clauses.size(); ++ci)
+      {
+        const ClauseView c = clauses[ci];
+        const size_t s = c.size();
+        if (s <= cutoff || s > clause_size_threshold)
+          continue;
+        const double w = static_cast<double>(static_cast<float>(weighting.pair_weight(s)));
+        const uint64_t all = static_cast<uint64_t>(s) * (s - 1) / 2;
+        const uint64_t m = static_cast<uint64_t>(sampling.pairs_per_literal) * s;
+        auto var = [&](size_t i) { return static_cast<uint32_t>(std::abs(c[i]) - 1); };
+        if (m >= all)
+        {
+          for (size_t i = 0; i + 1 < s; ++i)
+            for (size_t j = i + 1; j < s; ++j)
+              pairs.push_back(Edge{var(i), var(j), w});
+          continue;
+        }
+        ++stats.clauses;
+        stats.pairs_replaced += all;
+        stats.pairs_drawn += m;
+        const double wd = w * static_cast<double>(all) / static_cast<double>(m);
+        uint64_t state = sampling.seed ^ (static_cast<uint64_t>(ci) * 0xD1B54A32D192ED03ull);
+        for (uint64_t k = 0; k < m; ++k)
+        {
+          size_t i = below(splitmix64(state), s);
+          size_t j = below(splitmix64(state), s - 1);
+          if (j >= i)
+            ++j;
+          else
+            std::swap(i, j);
+          pairs.push_back(Edge{var(i), var(j), wd}); // normalized clause: |c[i]| < |c[j]| for i < j
+        }
+      }
+      // Sum per pair in a fixed order: (u, v, w) is total up to equal entries.
+      std::sort(pairs.begin(), pairs.end(), [](const Edge &x, const Edge &y)
+                {
+                  if (x.u != y.u) return x.u < y.u;
+                  if (x.v != y.v) return x.v < y.v;
+                  return x.w < y.w; });
+      size_t m = 0;
+      for (size_t i = 0; i < pairs.size(); ++i)
+      {
+        if (m > 0 && pairs[m - 1].u == pairs[i].u && pairs[m - 1].v == pairs[i].v)
+          pairs[m - 1].w += pairs[i].w;
+        else
+          pairs[m++] = pairs[i];
+      }
+      pairs.resize(m);
+      return pairs;
+    }
+
+    // Merge `extra` (ascending (u, v), unique) into `edges` (ascending (u, v)),
+    // adding the weights of pairs present in both.
+    template <class Edges>
+    static void merge_sorted_edges(Edges &edges, const std::vector<Edge> &extra)
+    {
+      Edges out;
+      out.reserve(edge_count(edges) + extra.size());
+      const size_t E = edge_count(edges);
+      size_t i = 0, j = 0;
+      while (i < E || j < extra.size())
+      {
+        if (j == extra.size())
+        {
+          const auto e = edge_at(edges, i++);
+          out.emplace_back(e.u, e.v, e.w);
+          continue;
+        }
+        const Edge &x = extra[j];
+        if (i == E || pack_pair(x.u, x.v) < pack_pair(edge_at(edges, i).u, edge_at(edges, i).v))
+        {
+          out.emplace_back(x.u, x.v, x.w);
+          ++j;
+          continue;
+        }
+        const auto e = edge_at(edges, i++);
+        if (e.u == x.u && e.v == x.v)
+        {
+          out.emplace_back(e.u, e.v, static_cast<double>(e.w) + x.w);
+          ++j;
+        }
+        else
+          out.emplace_back(e.u, e.v, e.w);
+      }
+      edges = std::move(out);
+    }
+  } // namespace detail
+
+  template <class G>
+  G build_vig_optimized(const CNF &cnf,
+                        unsigned clause_size_threshold,
+                        std::size_t max_buffer_contributions,
+                        unsigned num_threads)
+  {
+    return build_vig_optimized<G>(cnf, clause_size_threshold, max_buffer_contributions, num_threads,
+                                  HugeClauseSampling{});
+  }
+
+  template <class G>
+  G build_vig_optimized(const CNF &cnf,
+                        unsigned clause_size_threshold,
+                        std::size_t max_buffer_contributions,
+                        unsigned num_threads,
+                        const HugeClauseSampling &sampling,
+                        HugeClauseStats *stats)
+  {
+    // Reset transient-memory gauge for this build if accounting is enabled.
+#if defined(THESIS_VIG_MEMORY_ACCOUNTING)
+    detail::g_mem_gauge.current.store(0, std::memory_order_relaxed);
+    detail::g_mem_gauge.peak.store(0, std::memory_order_relaxed);
+#endif
+    if (stats)
+      *stats = HugeClauseStats{};
+
+    const uint32_t n = cnf.get_variable_count();
+    if (n == 0)
+    {
+      G result;
+      return result;
+    }
+    if (max_buffer_contributions == 0)
+      throw std::invalid_argument("max_buffer_contributions must be > 0");
+    if (num_threads == 0)
+      throw std::invalid_argument("num_threads must be > 0");
+    if (sampling.cutoff != 0 && sampling.pairs_per_literal == 0)
+      throw std::invalid_argument("HugeClauseSampling::pairs_per_literal must be > 0");
+
+    const unsigned t = std::max(1u, num_threads);
+    const Weighting weighting = builder_weighting(clause_size_threshold);
+    // Clauses above the cutoff bypass the round engine and are sampled instead.
+    const bool sample = sampling.cutoff >= 2 && sampling.cutoff < clause_size_threshold;
+    const unsigned exact_limit = sample ? sampling.cutoff : clause_size_threshold;
+
+    // ---------- Phase 1: per-variable contribution counts (O(s)) ----------
+    profile::ScopedPhase build_phase("vig.build");
+    const ClauseRange clauses = cnf.clauses();
+    ContribCounts phase1(n);
+    {
+      profile::ScopedPhase phase1_phase("vig.phase1");
+      for (const auto &c : clauses)
+        phase1.add(c, exact_limit);
+    }
+
+    const size_t total_contrib = std::accumulate(phase1.counts.begin(), phase1.counts.end(), 0ull);
+    const size_t user_cap = std::min(total_contrib, static_cast<size_t>(max_buffer_contributions));
+    RoundPlan plan;
+    plan.per_thread_buffer = detail::plan(total_contrib, t, user_cap).per_thread_buffer;
+    plan.max_buffer_contributions = max_buffer_contributions;
+    G result = build_vig_rounds<G>(clauses, n, exact_limit, weighting, std::move(phase1), plan, t);
+    if (sample)
+    {
+      profile::ScopedPhase sample_phase("vig.sample");
+      HugeClauseStats local;
+      const std::vector<Edge> extra =
+          detail::sample_huge_clauses(clauses, sampling.cutoff, clause_size_threshold, weighting, sampling, local);
+      detail::merge_sorted_edges(result.edges, extra);
+      if (stats)
+        *stats = local;
+    }
+    return result;
+  }
+
+  // --------------------------------------------------------------------------
+  // Streaming builder: spill eligible clauses, free the CNF, build from the map.
+  //
+  // Spill file (native byte order, deleted after the build):
+  //   uint64_t clause_count, literal_count
+  //   int      vars[literal_count]       |lit| per literal, clause after clause
+  //   (padding to 8 bytes)
+  //   size_t   offsets[clause_count + 1]
+  // --------------------------------------------------------------------------
+  namespace
+  {
+    // Removes the spill file when the build leaves scope, normally or by exception.
+    struct SpillFile
+    {
+      std::filesystem::path path;
+      ~SpillFile()
+      {
+        std::error_code ec;
+        if (!path.empty())
+          std::filesystem::remove(path, ec);
+      }
+    };
+
+    std::filesystem::path make_spill_path(const std::string &spill_dir)
+    {
+      std::error_code ec;
+      const std::filesystem::path dir = spill_dir.empty() ? std::filesystem::temp_directory_path(ec)
+                                                          : std::filesystem::path(spill_dir);
+      if (ec)
+        throw std::runtime_error("build_vig_streaming: no temporary directory: " + ec.message());
+      static std::atomic<unsigned> seq{0};
+      const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+      return dir / ("thesis_vig_spill." + std::to_string(stamp) + "." + std::to_string(seq.fetch_add(1)) + ".bin");
+    }
+
+    // Writes the spill for `cnf` while counting Phase 1. Returns the eligible clause count.
+    uint64_t write_spill(const std::filesystem::path &path, const CNF &cnf, unsigned clause_size_threshold,
+                         ContribCounts &phase1)
+    {
+      std::ofstream out(path, std::ios::binary | std::ios::trunc);
+      if (!out)
+        throw std::runtime_error("build_vig_streaming: cannot create spill file " + path.string());
+
+      uint64_t header[2] = {0, 0};
+      out.write(reinterpret_cast<const char *>(header), sizeof(header));
+
+      std::vector<size_t> offsets{0};
+      std::vector<int> block;
+      block.reserve(1u << 16);
+      for (const auto &c : cnf.clauses())
+      {
+        if (!phase1.add(c, clause_size_threshold))
+          continue;
+        for (int lit : c)
+          block.push_back(std::abs(lit));
+        offsets.push_back(offsets.back() + c.size());
+        if (block.size() >= (1u << 16))
+        {
+          out.write(reinterpret_cast<const char *>(block.data()), static_cast<std::streamsize>(block.size() * sizeof(int)));
+          block.clear();
+        }
+      }
+      out.write(reinterpret_cast<const char *>(block.data()), static_cast<std::streamsize>(block.size() * sizeof(int)));
+      header[0] = offsets.size() - 1;
+      header[1] = offsets.back();
+      if ((header[1] * sizeof(int)) % sizeof(size_t) != 0)
+      {
+        const int pad = 0;
+        out.write(reinterpret_cast<const char *>(&pad), sizeof(pad));
+      }
+      out.write(reinterpret_cast<const char *>(offsets.data()), static_cast<std::streamsize>(offsets.size() * sizeof(size_t)));
+      out.seekp(0);
+      out.write(reinterpret_cast<const char *>(header), sizeof(header));
+      out.flush();
+      if (!out)
+        throw std::runtime_error("build_vig_streaming: failed writing spill file " + path.string());
+      return header[0];
+    }
+  } // namespace
+
+  template <class G>
+  G build_vig_streaming(CNF &&cnf,
+                        unsigned clause_size_threshold,
+                        std::size_t mem_limit,
+                        unsigned num_threads,
+                        const std::string &spill_dir)
+  {
+#if defined(THESIS_VIG_MEMORY_ACCOUNTING)
+    detail::g_mem_gauge.current.store(0, std::memory_order_relaxed);
+    detail::g_mem_gauge.peak.store(0, std::memory_order_relaxed);
+#endif
+
+    const uint32_t n = cnf.get_variable_count();
+    if (n == 0)
+    {
+      G result;
+      return result;
+    }
+    if (mem_limit <= detail::fixed_builder_bytes(n))
+      throw std::invalid_argument("mem_limit must exceed the builder's per-variable arrays (" +
+                                  std::to_string(detail::fixed_builder_bytes(n)) + " bytes for " +
+                                  std::to_string(n) + " variables)");
+    if (num_threads == 0)
+      throw std::invalid_argument("num_threads must be > 0");
+    const unsigned t = std::max(1u, num_threads);
+
+    profile::ScopedPhase build_phase("vig.build");
+    SpillFile spill{make_spill_path(spill_dir)};
+    ContribCounts phase1(n);
+    uint64_t clause_count = 0;
+    {
+      profile::ScopedPhase spill_phase("vig.spill"); // Phase 1 counts while spilling
+      CNF owned = std::move(cnf); // freed at the end of this scope
+      clause_count = write_spill(spill.path, owned, clause_size_threshold, phase1);
+    }
+
+    MappedFile map(spill.path.string());
+    if (!map.is_open())
+      throw std::runtime_error("build_vig_streaming: cannot map spill file " + spill.path.string());
+    uint64_t header[2];
+    std::memcpy(header, map.data(), sizeof(header));
+    if (header[0] != clause_count)
+      throw std::runtime_error("build_vig_streaming: spill file " + spill.path.string() + " is inconsistent");
+    const size_t vars_bytes = static_cast<size_t>(header[1]) * sizeof(int);
+    const char *vars = map.data() + sizeof(header);
+    const char *offsets = vars + (vars_bytes + sizeof(size_t) - 1) / sizeof(size_t) * sizeof(size_t);
+    const ClauseRange clauses(reinterpret_cast<const int *>(vars), reinterpret_cast<const size_t *>(offsets),
+                              static_cast<size_t>(clause_count));
+
+    const size_t total_contrib = std::accumulate(phase1.counts.begin(), phase1.counts.end(), 0ull);
+    RoundPlan plan;
+    plan.overlap = true;
+    plan.per_thread_buffer = detail::per_thread_buffer_for_limit(mem_limit, n, total_contrib, t, /*live_rounds=*/2);
+    plan.mem_limit = mem_limit;
+    return build_vig_rounds<G>(clauses, n, clause_size_threshold, builder_weighting(clause_size_threshold),
+                               std::move(phase1), plan, t);
+  }
+
+#define THESIS_VIG_INSTANTIATE_BUILDERS(G)                       \
+  template G build_vig_naive<G>(const CNF &, unsigned); \
+  template G build_vig_optimized<G>(const CNF &, unsigned, std::size_t, unsigned); \
+  template G build_vig_optimized<G>(const CNF &, unsigned, std::size_t, unsigned, const HugeClauseSampling &, HugeClauseStats *); \
+  template G build_vig_streaming<G>(CNF &&, unsigned, std::size_t, unsigned, const std::string &);
+  THESIS_VIG_INSTANTIATE_BUILDERS(VIG)
+  THESIS_VIG_INSTANTIATE_BUILDERS(VIGF)
+  THESIS_VIG_INSTANTIATE_BUILDERS(VIGColumns)
+  THESIS_VIG_INSTANTIATE_BUILDERS(VIGColumnsD)
+#undef THESIS_VIG_INSTANTIATE_BUILDERS
+
 } // namespace thesis
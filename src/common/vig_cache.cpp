@@ -0,0 +1,230 @@
+// ----------------------------------------------------------------------------
+// vig_cache.cpp
+//
+// Reader/writer for the binary VIG format (.vigb) and the directory cache
+// keyed on (CNF fingerprint, tau). See vig_cache.hpp for the layout.
+//
+// Reading is an mmap plus header validation; to_vig() is a single memcpy of
+// the edge array, so a cache hit replaces the whole aggregation phase.
+// ----------------------------------------------------------------------------
+#include "thesis/vig_cache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+namespace thesis
+{
+
+  namespace
+  {
+    // FNV-1a over 32/64-bit words (hashing word-wise is several times faster than
+    // byte-wise and good enough to tell instances apart).
+    constexpr uint64_t kFnvOffset = 0xcbf29ce484222325ull;
+    constexpr uint64_t kFnvPrime = 0x100000001b3ull;
+
+    inline uint64_t mix(uint64_t h, uint64_t x)
+    {
+      h ^= x;
+      return h * kFnvPrime;
+    }
+
+    std::string tau_tag(unsigned tau)
+    {
+      return tau == std::numeric_limits<unsigned>::max() ? std::string("inf") : std::to_string(tau);
+    }
+
+    unsigned long current_pid()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+      return static_cast<unsigned long>(::getpid());
+#else
+      return 0;
+#endif
+    }
+  } // namespace
+
+  uint64_t cnf_fingerprint(const CNF &cnf)
+  {
+    uint64_t h = kFnvOffset;
+    h = mix(h, cnf.get_variable_count());
+    h = mix(h, cnf.get_clause_count());
+    for (int lit : cnf.get_literals())
+      h = mix(h, static_cast<uint32_t>(lit));
+    for (std::size_t off : cnf.get_clause_offsets())
+      h = mix(h, static_cast<uint64_t>(off));
+    return h;
+  }
+
+  void canonicalize_edges(VIG &g)
+  {
+    std::sort(g.edges.begin(), g.edges.end(), [](const Edge &a, const Edge &b)
+              { return a.u != b.u ? a.u < b.u : a.v < b.v; });
+  }
+
+  bool write_vigb(const std::string &path, const VIG &g, unsigned tau, uint64_t cnf_hash)
+  {
+    VigbHeader h{};
+    std::memcpy(h.magic, VigbHeader::kMagic, sizeof(h.magic));
+    h.version = VigbHeader::kVersion;
+    h.endian_tag = VigbHeader::kEndianTag;
+    h.n = g.n;
+    h.tau = tau;
+    h.edge_count = g.edges.size();
+    h.alpha = pick_alpha_tau_only(tau, 1e-3); // same ε as the builders
+    h.cnf_hash = cnf_hash;
+    h.aggregation_memory = g.aggregation_memory;
+
+    // CSR row offsets over u (edges are canonical, so each row is contiguous)
+    std::vector<uint64_t> offsets(static_cast<std::size_t>(g.n) + 1, 0);
+    for (const auto &e : g.edges)
+    {
+      if (e.u >= g.n || e.v >= g.n)
+      {
+        std::cerr << "Error: edge (" << e.u << "," << e.v << ") out of range for n=" << g.n << "\n";
+        return false;
+      }
+      offsets[e.u + 1]++;
+    }
+    for (std::size_t i = 1; i < offsets.size(); ++i)
+      offsets[i] += offsets[i - 1];
+
+    const std::string tmp = path + ".tmp." + std::to_string(current_pid());
+    {
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      if (!out)
+      {
+        std::cerr << "Error: cannot open " << tmp << " for writing\n";
+        return false;
+      }
+      out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+      out.write(reinterpret_cast<const char *>(offsets.data()), static_cast<std::streamsize>(offsets.size() * sizeof(uint64_t)));
+      out.write(reinterpret_cast<const char *>(g.edges.data()), static_cast<std::streamsize>(g.edges.size() * sizeof(Edge)));
+      out.flush();
+      if (!out)
+      {
+        std::cerr << "Error: failed writing " << tmp << "\n";
+        std::remove(tmp.c_str());
+        return false;
+      }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec)
+    {
+      std::cerr << "Error: cannot rename " << tmp << " to " << path << ": " << ec.message() << "\n";
+      std::remove(tmp.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  VigbFile::VigbFile(const std::string &path) : file_(path)
+  {
+    if (!file_.is_open())
+    {
+      error_ = "cannot open " + path;
+      return;
+    }
+    const std::size_t size = file_.size();
+    if (size < sizeof(VigbHeader))
+    {
+      error_ = "file too small for a .vigb header";
+      return;
+    }
+    const auto *h = reinterpret_cast<const VigbHeader *>(file_.data());
+    if (std::memcmp(h->magic, VigbHeader::kMagic, sizeof(h->magic)) != 0)
+    {
+      error_ = "not a .vigb file (bad magic)";
+      return;
+    }
+    if (h->endian_tag != VigbHeader::kEndianTag)
+    {
+      error_ = "written on a machine with different byte order";
+      return;
+    }
+    if (h->version != VigbHeader::kVersion)
+    {
+      error_ = "unsupported .vigb version " + std::to_string(h->version);
+      return;
+    }
+    const uint64_t offsets_bytes = (static_cast<uint64_t>(h->n) + 1) * sizeof(uint64_t);
+    if (h->edge_count > (std::numeric_limits<uint64_t>::max() - sizeof(VigbHeader) - offsets_bytes) / sizeof(Edge) ||
+        sizeof(VigbHeader) + offsets_bytes + h->edge_count * sizeof(Edge) != size)
+    {
+      error_ = "size does not match header (truncated file?)";
+      return;
+    }
+    header_ = h;
+    offsets_ = reinterpret_cast<const uint64_t *>(file_.data() + sizeof(VigbHeader));
+    edges_ = reinterpret_cast<const Edge *>(file_.data() + sizeof(VigbHeader) + offsets_bytes);
+    if (offsets_[0] != 0 || offsets_[h->n] != h->edge_count)
+    {
+      error_ = "corrupt row offsets";
+      return;
+    }
+    valid_ = true;
+  }
+
+  VIG VigbFile::to_vig() const
+  {
+    VIG g;
+    if (!valid_)
+      return g;
+    g.n = header_->n;
+    g.edges.assign(edges_, edges_ + header_->edge_count);
+    g.aggregation_memory = 0;
+    return g;
+  }
+
+  std::string vig_cache_path(const std::string &dir, uint64_t cnf_hash, unsigned tau)
+  {
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(cnf_hash));
+    return (std::filesystem::path(dir) / (std::string(hex) + ".tau" + tau_tag(tau) + ".vigb")).string();
+  }
+
+  bool vig_cache_load(const std::string &dir, uint64_t cnf_hash, unsigned tau, VIG &out)
+  {
+    const std::string path = vig_cache_path(dir, cnf_hash, tau);
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec))
+      return false;
+    VigbFile f(path);
+    if (!f.is_valid())
+    {
+      std::cerr << "Warning: ignoring VIG cache file " << path << ": " << f.error() << "\n";
+      return false;
+    }
+    if (f.header().cnf_hash != cnf_hash || f.header().tau != tau)
+    {
+      std::cerr << "Warning: ignoring VIG cache file " << path << ": key mismatch\n";
+      return false;
+    }
+    out = f.to_vig();
+    return true;
+  }
+
+  bool vig_cache_store(const std::string &dir, uint64_t cnf_hash, unsigned tau, VIG &g)
+  {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec)
+    {
+      std::cerr << "Error: cannot create VIG cache directory " << dir << ": " << ec.message() << "\n";
+      return false;
+    }
+    canonicalize_edges(g);
+    return write_vigb(vig_cache_path(dir, cnf_hash, tau), g, tau, cnf_hash);
+  }
+
+} // namespace thesis
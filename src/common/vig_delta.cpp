@@ -0,0 +1,269 @@
+#include "thesis/vig_delta.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+#include "thesis/profile.hpp"
+#include "thesis/timer.hpp"
+
+namespace thesis {
+
+namespace {
+
+constexpr uint32_t kNotInRegion = std::numeric_limits<uint32_t>::max();
+
+// First entry of a sorted adjacency list with neighbor id >= v.
+template <class List>
+auto find_adjacent(List& list, uint32_t v) {
+    return std::lower_bound(list.begin(), list.end(), v,
+                            [](const MutableVIG::Adjacent& a, uint32_t x) { return a.v < x; });
+}
+
+} // namespace
+
+MutableVIG::MutableVIG(uint32_t n, unsigned tau) : adj_(n), tau_(tau), is_dirty_(n, 0) {
+    weighting_.alpha = pick_alpha_tau_only(tau, 1e-3); // same ε as the builders
+}
+
+MutableVIG::MutableVIG(const CNF& cnf, unsigned tau) : MutableVIG(cnf.get_variable_count(), tau) {
+    profile::ScopedPhase phase("vig_delta.build");
+    // Every pair contribution is listed under both endpoints (CSR by node, in
+    // clause order), then each node's list is stably sorted by neighbor and
+    // reduced, so per-pair sums run in clause order as in build_vig_naive().
+    struct Contribution {
+        uint32_t v;
+        double w;
+    };
+    const uint32_t n = this->n();
+    std::vector<std::size_t> offsets(static_cast<std::size_t>(n) + 1, 0);
+    std::vector<uint32_t>& vars = scratch_;
+    for (const auto& c : cnf.clauses()) {
+        if (!clause_vars(c, vars)) continue;
+        for (const uint32_t x : vars) offsets[x + 1] += vars.size() - 1;
+    }
+    for (uint32_t x = 0; x < n; ++x) offsets[x + 1] += offsets[x];
+
+    std::vector<Contribution> contrib(offsets[n]);
+    std::vector<std::size_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (const auto& c : cnf.clauses()) {
+        if (!clause_vars(c, vars)) continue;
+        const double w = weighting_.pair_weight(vars.size());
+        for (std::size_t i = 0; i + 1 < vars.size(); ++i)
+            for (std::size_t j = i + 1; j < vars.size(); ++j) {
+                contrib[cursor[vars[i]]++] = {vars[j], w};
+                contrib[cursor[vars[j]]++] = {vars[i], w};
+            }
+    }
+
+    for (uint32_t x = 0; x < n; ++x) {
+        const auto first = contrib.begin() + static_cast<std::ptrdiff_t>(offsets[x]);
+        const auto last = contrib.begin() + static_cast<std::ptrdiff_t>(offsets[x + 1]);
+        std::stable_sort(first, last, [](const Contribution& a, const Contribution& b) { return a.v < b.v; });
+        std::vector<Adjacent>& list = adj_[x];
+        for (auto it = first; it != last; ++it) {
+            if (!list.empty() && list.back().v == it->v) {
+                list.back().w += it->w;
+                ++list.back().clauses;
+            } else {
+                list.push_back({it->v, 1, it->w});
+                if (x < it->v) ++edges_;
+            }
+        }
+        list.shrink_to_fit();
+    }
+}
+
+bool MutableVIG::clause_vars(std::span<const int> lits, std::vector<uint32_t>& vars) {
+    scratch_lits_.assign(lits.begin(), lits.end());
+    if (!scratch_lits_.empty() && scratch_lits_.back() == 0) scratch_lits_.pop_back();
+    std::sort(scratch_lits_.begin(), scratch_lits_.end(), [](int a, int b) {
+        const int x = std::abs(a), y = std::abs(b);
+        return x != y ? x < y : a < b;
+    });
+    scratch_lits_.erase(std::unique(scratch_lits_.begin(), scratch_lits_.end()), scratch_lits_.end());
+    vars.clear();
+    for (const int lit : scratch_lits_) {
+        if (lit == 0) throw std::invalid_argument("literal 0 inside a clause");
+        const uint32_t x = static_cast<uint32_t>(std::abs(lit)) - 1;
+        if (!vars.empty() && vars.back() == x) { // x and -x: tautology
+            vars.clear();
+            return false;
+        }
+        vars.push_back(x);
+    }
+    if (vars.size() < 2 || vars.size() > tau_) {
+        vars.clear();
+        return false;
+    }
+    return true;
+}
+
+void MutableVIG::grow(uint32_t n) {
+    if (n <= this->n()) return;
+    adj_.resize(n);
+    is_dirty_.resize(n, 0);
+}
+
+void MutableVIG::mark_dirty(uint32_t x) {
+    if (is_dirty_[x]) return;
+    is_dirty_[x] = 1;
+    dirty_.push_back(x);
+}
+
+void MutableVIG::clear_dirty() {
+    for (const uint32_t x : dirty_) is_dirty_[x] = 0;
+    dirty_.clear();
+}
+
+std::size_t MutableVIG::add_clause(std::span<const int> lits) {
+    std::vector<uint32_t>& vars = scratch_;
+    if (!clause_vars(lits, vars)) return 0;
+    grow(vars.back() + 1);
+    const double w = weighting_.pair_weight(vars.size());
+    for (std::size_t i = 0; i + 1 < vars.size(); ++i) {
+        for (std::size_t j = i + 1; j < vars.size(); ++j) {
+            const uint32_t u = vars[i], v = vars[j];
+            auto it = find_adjacent(adj_[u], v);
+            if (it != adj_[u].end() && it->v == v) {
+                it->w += w;
+                ++it->clauses;
+                auto back = find_adjacent(adj_[v], u);
+                back->w += w;
+                ++back->clauses;
+            } else {
+                adj_[u].insert(it, Adjacent{v, 1, w});
+                adj_[v].insert(find_adjacent(adj_[v], u), Adjacent{u, 1, w});
+                ++edges_;
+            }
+        }
+        mark_dirty(vars[i]);
+    }
+    mark_dirty(vars.back());
+    return vars.size() * (vars.size() - 1) / 2;
+}
+
+std::size_t MutableVIG::remove_clause(std::span<const int> lits) {
+    std::vector<uint32_t>& vars = scratch_;
+    if (!clause_vars(lits, vars)) return 0;
+    // Check every pair before touching any, so a bad removal changes nothing.
+    for (std::size_t i = 0; i + 1 < vars.size(); ++i) {
+        for (std::size_t j = i + 1; j < vars.size(); ++j) {
+            const uint32_t u = vars[i], v = vars[j];
+            if (v >= n()) throw std::invalid_argument("remove_clause: variable " + std::to_string(v + 1) + " is not in the graph");
+            const auto it = find_adjacent(adj_[u], v);
+            if (it == adj_[u].end() || it->v != v)
+                throw std::invalid_argument("remove_clause: no clause left on pair (" + std::to_string(u + 1) + ", " +
+                                            std::to_string(v + 1) + ")");
+        }
+    }
+    const double w = weighting_.pair_weight(vars.size());
+    for (std::size_t i = 0; i + 1 < vars.size(); ++i) {
+        for (std::size_t j = i + 1; j < vars.size(); ++j) {
+            const uint32_t u = vars[i], v = vars[j];
+            auto it = find_adjacent(adj_[u], v);
+            auto back = find_adjacent(adj_[v], u);
+            if (--it->clauses == 0) {
+                adj_[u].erase(it);
+                adj_[v].erase(back);
+                --edges_;
+            } else {
+                it->w -= w;
+                back->w -= w;
+            }
+        }
+        mark_dirty(vars[i]);
+    }
+    mark_dirty(vars.back());
+    return vars.size() * (vars.size() - 1) / 2;
+}
+
+VIG MutableVIG::to_vig() const {
+    VIG g;
+    g.n = n();
+    g.edges.reserve(edges_);
+    for (uint32_t u = 0; u < n(); ++u) {
+        const auto& list = adj_[u];
+        for (auto it = find_adjacent(list, u + 1); it != list.end(); ++it)
+            g.edges.push_back(Edge{u, it->v, it->w});
+    }
+    return g;
+}
+
+IncrementalSegmentation::IncrementalSegmentation(MutableVIG& g, double k, const GraphSegmenterFH::Config& cfg)
+    : k_(k), cfg_(cfg) {
+    cfg_.candidates = CandidateStore::None;
+    cfg_.record_trajectory = false;
+    const uint32_t n = g.n();
+    labels_.resize(n);
+    members_.resize(n);
+    std::vector<uint32_t> all(n);
+    for (uint32_t x = 0; x < n; ++x) all[x] = x;
+    ResegmentStats st;
+    segment(all, g, st);
+    g.clear_dirty();
+}
+
+ResegmentStats IncrementalSegmentation::update(MutableVIG& g) {
+    profile::ScopedPhase phase("vig_delta.reseg");
+    Timer timer;
+    ResegmentStats st;
+    // Nodes new since the last update start as singletons.
+    for (uint32_t x = static_cast<uint32_t>(labels_.size()); x < g.n(); ++x) {
+        labels_.push_back(x);
+        members_.push_back({x});
+        ++components_;
+    }
+
+    // Dissolve every component holding a dirty node; its members form the region.
+    for (const uint32_t x : g.dirty_nodes()) {
+        std::vector<unsigned>& m = members_[labels_[x]];
+        if (m.empty()) continue; // already dissolved
+        region_.insert(region_.end(), m.begin(), m.end());
+        m.clear();
+        ++st.invalidated;
+    }
+    components_ -= st.invalidated;
+    // Ascending, so local ids (and the segmenter's tie-breaks) follow global ids.
+    std::sort(region_.begin(), region_.end());
+    segment(region_, g, st);
+    region_.clear();
+    g.clear_dirty();
+    st.sec = timer.sec();
+    return st;
+}
+
+void IncrementalSegmentation::segment(std::span<const uint32_t> nodes, const MutableVIG& g, ResegmentStats& st) {
+    if (nodes.empty()) return;
+    const uint32_t sub_n = static_cast<uint32_t>(nodes.size());
+    if (local_.size() < g.n()) local_.resize(g.n(), kNotInRegion);
+    for (uint32_t i = 0; i < sub_n; ++i) local_[nodes[i]] = i;
+
+    std::vector<Edge> edges;
+    for (uint32_t i = 0; i < sub_n; ++i) {
+        const uint32_t x = nodes[i];
+        for (const MutableVIG::Adjacent& a : g.neighbors(x)) {
+            if (a.v > x && local_[a.v] != kNotInRegion) edges.push_back(Edge{i, local_[a.v], a.w});
+        }
+    }
+    st.nodes = sub_n;
+    st.edges = edges.size();
+
+    GraphSegmenterFH seg(sub_n, k_);
+    seg.set_config(cfg_);
+    seg.run(edges);
+    std::vector<unsigned> local_labels;
+    seg.component_labels(local_labels);
+    for (uint32_t i = 0; i < sub_n; ++i) {
+        const unsigned label = nodes[local_labels[i]];
+        labels_[nodes[i]] = label;
+        members_[label].push_back(nodes[i]);
+    }
+    st.components = seg.num_components();
+    components_ += st.components;
+    for (const uint32_t x : nodes) local_[x] = kNotInRegion;
+}
+
+} // namespace thesis
@@ -0,0 +1,51 @@
+#!/usr/bin/env bash
+# Random DIMACS CNF for the tests:
+#
+#   gen_cnf.sh VARS CLAUSES MAX_LEN SEED OUT [options]
+#
+# CLAUSES clauses of 2..MAX_LEN variables drawn uniformly from 1..VARS, written
+# to OUT. awk's rand() is seeded with SEED, so the file is reproducible.
+#
+#   --min-len N    shortest clause (default 2)
+#   --signs        negate each literal with probability 1/2
+#   --window W     draw each clause's variables from W consecutive ids (local structure)
+#   --stride S     append one clause of every S-th variable (1, 1+S, ...)
+#   --huge N LEN   append N clauses of LEN variables
+set -e
+if [ $# -lt 5 ]; then
+  echo "usage: $0 VARS CLAUSES MAX_LEN SEED OUT [--min-len N] [--signs] [--window W] [--stride S] [--huge N LEN]" >&2
+  exit 2
+fi
+vars=$1 clauses=$2 max_len=$3 seed=$4 out=$5
+shift 5
+min_len=2 signs=0 window=0 stride=0 huge=0 huge_len=0
+while [ $# -gt 0 ]; do
+  case $1 in
+    --min-len) min_len=$2; shift 2 ;;
+    --signs) signs=1; shift ;;
+    --window) window=$2; shift 2 ;;
+    --stride) stride=$2; shift 2 ;;
+    --huge) huge=$2; huge_len=$3; shift 3 ;;
+    *) echo "$0: unknown option $1" >&2; exit 2 ;;
+  esac
+done
+
+awk -v vars="$vars" -v clauses="$clauses" -v min_len="$min_len" -v max_len="$max_len" -v seed="$seed" \
+    -v signs="$signs" -v window="$window" -v stride="$stride" -v huge="$huge" -v huge_len="$huge_len" '
+  function lit(base, range,   v) {
+    v = base + int(rand() * range)
+    if (signs && rand() < 0.5) v = -v
+    return v
+  }
+  BEGIN {
+    srand(seed)
+    print "p cnf", vars, clauses + (stride > 0) + huge
+    for (i = 0; i < clauses; i++) {
+      if (window > 0) x = 1 + int(rand() * (vars - window))
+      s = min_len + int(rand() * (max_len - min_len + 1)); l = ""
+      for (j = 0; j < s; j++) l = l (window > 0 ? lit(x, window) : lit(1, vars)) " "
+      print l "0"
+    }
+    if (stride > 0) { l = ""; for (v = 1; v <= vars; v += stride) l = l v " "; print l "0" }
+    for (h = 0; h < huge; h++) { l = ""; for (j = 0; j < huge_len; j++) l = l lit(1, vars) " "; print l "0" }
+  }' > "$out"